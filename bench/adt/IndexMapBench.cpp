@@ -0,0 +1,229 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <optional>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "monomux/adt/PagedIndexMap.hpp"
+#include "monomux/adt/SmallIndexMap.hpp"
+
+using namespace monomux;
+
+/// The same configuration as the file descriptor lookup of the server.
+static constexpr std::size_t SmallSize = 256;
+using IndexMap = SmallIndexMap<int*,
+                               SmallSize,
+                               /* StoreInPlace =*/true,
+                               /* IntrusiveDefaultSentinel =*/true>;
+
+/// Adapts \p PagedIndexMap to the interface of the other containers.
+class PagedMap
+{
+  PagedIndexMap<int*> Storage;
+
+public:
+  void set(std::size_t Key, int* Value) { Storage.set(Key, Value); }
+  int* const* tryGet(std::size_t Key) const noexcept
+  {
+    return Storage.tryGet(Key);
+  }
+  void erase(std::size_t Key) { Storage.erase(Key); }
+};
+
+/// A flat vector indexed by the key, growing to the largest key seen.
+class FlatVector
+{
+  std::vector<int*> Storage;
+
+public:
+  void set(std::size_t Key, int* Value)
+  {
+    if (Key >= Storage.size())
+      Storage.resize(Key + 1);
+    Storage[Key] = Value;
+  }
+  int* const* tryGet(std::size_t Key) const noexcept
+  {
+    if (Key >= Storage.size() || !Storage[Key])
+      return nullptr;
+    return &Storage[Key];
+  }
+  void erase(std::size_t Key) noexcept
+  {
+    if (Key < Storage.size())
+      Storage[Key] = nullptr;
+  }
+};
+
+/// Adapts \p std::unordered_map to the interface of the other containers.
+class HashMap
+{
+  std::unordered_map<std::size_t, int*> Storage;
+
+public:
+  void set(std::size_t Key, int* Value) { Storage[Key] = Value; }
+  int* const* tryGet(std::size_t Key) const noexcept
+  {
+    auto It = Storage.find(Key);
+    if (It == Storage.end())
+      return nullptr;
+    return &It->second;
+  }
+  void erase(std::size_t Key) { Storage.erase(Key); }
+};
+
+static int Dummy;
+
+/// Maps every key in \p [0, Keys) in \p M.
+template <typename Map> static void fill(Map& M, std::size_t Keys)
+{
+  for (std::size_t I = 0; I < Keys; ++I)
+    M.set(I, &Dummy);
+}
+
+/// Looks up every key of a container holding \p State.range(0) keys.
+/// For \p SmallIndexMap, the containers up to \p SmallSize are in the small
+/// representation, the larger ones in the large.
+template <typename Map> static void tryGet(benchmark::State& State)
+{
+  const auto Keys = static_cast<std::size_t>(State.range(0));
+  Map M;
+  fill(M, Keys);
+
+  std::size_t Key = 0;
+  for (auto _ : State)
+  {
+    benchmark::DoNotOptimize(M.tryGet(Key));
+    if (++Key == Keys)
+      Key = 0;
+  }
+}
+
+/// Erases and sets back a key in a container holding \p State.range(0) keys.
+template <typename Map> static void eraseAndSet(benchmark::State& State)
+{
+  const auto Keys = static_cast<std::size_t>(State.range(0));
+  Map M;
+  fill(M, Keys);
+
+  std::size_t Key = 0;
+  for (auto _ : State)
+  {
+    M.erase(Key);
+    M.set(Key, &Dummy);
+    benchmark::ClobberMemory();
+    if (++Key == Keys)
+      Key = 0;
+  }
+}
+
+/// Sets and erases a key just past the small range of a container holding
+/// \p State.range(0) low keys. For \p SmallIndexMap with few elements, this
+/// converts to the large representation and back in every iteration.
+template <typename Map> static void crossBoundary(benchmark::State& State)
+{
+  const auto Keys = static_cast<std::size_t>(State.range(0));
+  Map M;
+  fill(M, Keys);
+
+  for (auto _ : State)
+  {
+    M.set(SmallSize, &Dummy);
+    M.erase(SmallSize);
+    benchmark::ClobberMemory();
+  }
+}
+
+#define MONOMUX_MAP_BENCHMARKS(MAP)                                            \
+  BENCHMARK_TEMPLATE(tryGet, MAP)                                              \
+    ->Arg(SmallSize / 2)                                                       \
+    ->Arg(SmallSize)                                                           \
+    ->Arg(SmallSize * 2)                                                       \
+    ->Arg(SmallSize * 64);                                                     \
+  BENCHMARK_TEMPLATE(eraseAndSet, MAP)                                         \
+    ->Arg(SmallSize / 2)                                                       \
+    ->Arg(SmallSize)                                                           \
+    ->Arg(SmallSize * 2)                                                       \
+    ->Arg(SmallSize * 64);                                                     \
+  BENCHMARK_TEMPLATE(crossBoundary, MAP)                                       \
+    ->Arg(SmallSize / 4)                                                       \
+    ->Arg(SmallSize - 1);
+
+MONOMUX_MAP_BENCHMARKS(IndexMap)
+MONOMUX_MAP_BENCHMARKS(PagedMap)
+MONOMUX_MAP_BENCHMARKS(HashMap)
+MONOMUX_MAP_BENCHMARKS(FlatVector)
+
+#undef MONOMUX_MAP_BENCHMARKS
+
+/// The element type of the file descriptor lookup of the server.
+using Entity = std::variant<std::monostate, int*, std::size_t>;
+using SmallFDMap = SmallIndexMap<Entity,
+                                 SmallSize,
+                                 /* StoreInPlace =*/true,
+                                 /* IntrusiveDefaultSentinel =*/true>;
+using PagedFDMap = PagedIndexMap<Entity>;
+
+/// Looks up the entities of \p State.range(0) open file descriptors in a
+/// scattered order, like the events returned by a poll. The descriptors start
+/// after the standard streams and the listening sockets, like in the server.
+template <typename Map> static void fdLookup(benchmark::State& State)
+{
+  static constexpr std::size_t FirstFD = 5;
+  const auto FDs = static_cast<std::size_t>(State.range(0));
+  Map M;
+  for (std::size_t I = 0; I < FDs; ++I)
+    M[FirstFD + I] = Entity{I};
+
+  // A fixed odd stride visits every descriptor in a cache-unfriendly order.
+  static constexpr std::size_t Stride = 7919;
+  std::size_t I = 0;
+  for (auto _ : State)
+  {
+    benchmark::DoNotOptimize(M.tryGet(FirstFD + I));
+    I = (I + Stride) % FDs;
+  }
+}
+BENCHMARK_TEMPLATE(fdLookup, SmallFDMap)->Arg(100)->Arg(1000)->Arg(50000);
+BENCHMARK_TEMPLATE(fdLookup, PagedFDMap)->Arg(100)->Arg(1000)->Arg(50000);
+
+/// Opens and closes a descriptor in a table of \p State.range(0) open file
+/// descriptors, like a client connecting and disconnecting.
+template <typename Map> static void fdChurn(benchmark::State& State)
+{
+  static constexpr std::size_t FirstFD = 5;
+  const auto FDs = static_cast<std::size_t>(State.range(0));
+  Map M;
+  for (std::size_t I = 0; I < FDs; ++I)
+    M[FirstFD + I] = Entity{I};
+
+  const std::size_t NewFD = FirstFD + FDs;
+  for (auto _ : State)
+  {
+    M[NewFD] = Entity{NewFD};
+    M.erase(NewFD);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK_TEMPLATE(fdChurn, SmallFDMap)->Arg(100)->Arg(1000)->Arg(50000);
+BENCHMARK_TEMPLATE(fdChurn, PagedFDMap)->Arg(100)->Arg(1000)->Arg(50000);
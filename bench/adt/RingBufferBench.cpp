@@ -0,0 +1,123 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstddef>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "monomux/adt/RingBuffer.hpp"
+#include "monomux/system/MagicRingBuffer.hpp"
+
+using namespace monomux;
+
+static constexpr std::size_t Capacity = 4096;
+
+using TrackedBuffer = RingBuffer<char>;
+using UntrackedBuffer = RingBuffer<char, detail::RingBufferNoTracking>;
+
+/// Fills \p B with \p Resident elements that are kept in the buffer during the
+/// measurement. As every iteration puts and takes the same amount, the logical
+/// window slides over the physical storage and the operations cross the
+/// physical end of the buffer periodically. If \p Resident is \p 0, the buffer
+/// empties after every iteration and always restarts at the physical begin.
+template <typename Buffer>
+static void makeResident(Buffer& B, std::size_t Resident)
+{
+  std::vector<char> Filler(Resident, 'x');
+  B.putBack(Filler.data(), Filler.size());
+}
+
+/// Puts and takes a chunk of \p State.range(0) characters into and from a
+/// buffer which contains \p State.range(1) resident elements.
+template <typename Buffer>
+static void putBackTakeFront(benchmark::State& State)
+{
+  const auto Chunk = static_cast<std::size_t>(State.range(0));
+  const auto Resident = static_cast<std::size_t>(State.range(1));
+  Buffer B(Capacity);
+  makeResident(B, Resident);
+  std::vector<char> Data(Chunk, 'y');
+
+  for (auto _ : State)
+  {
+    B.putBack(Data.data(), Data.size());
+    std::vector<char> Out = B.takeFront(Chunk);
+    benchmark::DoNotOptimize(Out.data());
+  }
+
+  State.SetBytesProcessed(static_cast<std::int64_t>(State.iterations()) *
+                          static_cast<std::int64_t>(Chunk));
+}
+BENCHMARK_TEMPLATE(putBackTakeFront, TrackedBuffer)
+  ->ArgNames({"chunk", "resident"})
+  ->ArgsProduct({{16, 256, 1024, 4000}, {0, 1, Capacity / 3}});
+BENCHMARK_TEMPLATE(putBackTakeFront, UntrackedBuffer)
+  ->ArgNames({"chunk", "resident"})
+  ->ArgsProduct({{16, 256, 1024, 4000}, {0, 1, Capacity / 3}});
+
+/// Puts a chunk of \p State.range(0) characters and drops it without copying
+/// it out, measuring only the insertion and the bookkeeping.
+template <typename Buffer>
+static void putBackDropFront(benchmark::State& State)
+{
+  const auto Chunk = static_cast<std::size_t>(State.range(0));
+  const auto Resident = static_cast<std::size_t>(State.range(1));
+  Buffer B(Capacity);
+  makeResident(B, Resident);
+  std::vector<char> Data(Chunk, 'y');
+
+  for (auto _ : State)
+  {
+    B.putBack(Data.data(), Data.size());
+    B.dropFront(Chunk);
+    benchmark::ClobberMemory();
+  }
+
+  State.SetBytesProcessed(static_cast<std::int64_t>(State.iterations()) *
+                          static_cast<std::int64_t>(Chunk));
+}
+BENCHMARK_TEMPLATE(putBackDropFront, TrackedBuffer)
+  ->ArgNames({"chunk", "resident"})
+  ->ArgsProduct({{16, 256, 1024, 4000}, {0, 1, Capacity / 3}});
+BENCHMARK_TEMPLATE(putBackDropFront, UntrackedBuffer)
+  ->ArgNames({"chunk", "resident"})
+  ->ArgsProduct({{16, 256, 1024, 4000}, {0, 1, Capacity / 3}});
+BENCHMARK_TEMPLATE(putBackDropFront, MagicRingBuffer)
+  ->ArgNames({"chunk", "resident"})
+  ->ArgsProduct({{16, 256, 1024, 4000}, {0, 1, Capacity / 3}});
+
+/// Puts \p State.range(0) characters into a buffer of the default capacity,
+/// growing it, and then drains it.
+static void putBackGrowing(benchmark::State& State)
+{
+  const auto Chunk = static_cast<std::size_t>(State.range(0));
+  std::vector<char> Data(Chunk, 'y');
+
+  for (auto _ : State)
+  {
+    RingBuffer<char> B(Capacity);
+    B.putBack(Data.data(), Data.size());
+    std::vector<char> Out = B.takeFront(Chunk);
+    benchmark::DoNotOptimize(Out.data());
+  }
+
+  State.SetBytesProcessed(static_cast<std::int64_t>(State.iterations()) *
+                          static_cast<std::int64_t>(Chunk));
+}
+BENCHMARK(putBackGrowing)->Arg(2 * Capacity)->Arg(16 * Capacity);
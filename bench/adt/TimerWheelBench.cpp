@@ -0,0 +1,92 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "monomux/adt/TimerWheel.hpp"
+
+using namespace monomux;
+
+/// The same configuration as the timers of the event loop.
+static constexpr std::chrono::milliseconds Resolution{10};
+
+/// Arms and cancels a keepalive-like timer in a wheel that already holds
+/// \p State.range(0) timers, as done for every client and session.
+static void armAndCancel(benchmark::State& State)
+{
+  const auto Timers = static_cast<std::size_t>(State.range(0));
+  const TimerWheel::Clock::time_point Origin = TimerWheel::Clock::now();
+  TimerWheel W{Resolution, Origin};
+  for (std::size_t I = 0; I < Timers; ++I)
+    W.arm(Origin + std::chrono::seconds(60) + I * Resolution, [] {});
+
+  for (auto _ : State)
+  {
+    TimerWheel::Timer T = W.arm(Origin + std::chrono::seconds(60), [] {});
+    W.cancel(T);
+    benchmark::ClobberMemory();
+  }
+}
+
+/// Advances, one tick at a time, a wheel that holds \p State.range(0) timers
+/// far in the future, none of which fire.
+static void advanceIdle(benchmark::State& State)
+{
+  const auto Timers = static_cast<std::size_t>(State.range(0));
+  const TimerWheel::Clock::time_point Origin = TimerWheel::Clock::now();
+  TimerWheel W{Resolution, Origin};
+  for (std::size_t I = 0; I < Timers; ++I)
+    W.arm(Origin + std::chrono::hours(24) + I * Resolution, [] {});
+
+  TimerWheel::Clock::time_point Now = Origin;
+  for (auto _ : State)
+  {
+    Now += Resolution;
+    benchmark::DoNotOptimize(W.advance(Now));
+  }
+}
+
+/// Arms \p State.range(0) timers in the same tick and fires all of them.
+static void fireBatch(benchmark::State& State)
+{
+  const auto Timers = static_cast<std::size_t>(State.range(0));
+  const TimerWheel::Clock::time_point Origin = TimerWheel::Clock::now();
+  TimerWheel W{Resolution, Origin};
+  std::size_t Fired = 0;
+
+  TimerWheel::Clock::time_point Now = Origin;
+  for (auto _ : State)
+  {
+    for (std::size_t I = 0; I < Timers; ++I)
+      W.arm(Now + Resolution, [&Fired] { ++Fired; });
+    Now += Resolution;
+    W.advance(Now);
+  }
+  benchmark::DoNotOptimize(Fired);
+  State.SetItemsProcessed(static_cast<std::int64_t>(State.iterations()) *
+                          State.range(0));
+}
+
+BENCHMARK(armAndCancel)->Arg(0)->Arg(1024)->Arg(65536);
+BENCHMARK(advanceIdle)->Arg(1024)->Arg(65536);
+BENCHMARK(fireBatch)->Arg(1)->Arg(64)->Arg(1024);
@@ -0,0 +1,259 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <csignal>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "monomux/control/Message.hpp"
+
+using namespace monomux;
+using namespace monomux::message;
+
+namespace
+{
+
+message::ClientID sampleClientID()
+{
+  message::ClientID ID;
+  ID.ID = 42;
+  ID.Nonce = 0xDEADBEEF;
+  return ID;
+}
+
+LatencyMetrics sampleLatency()
+{
+  LatencyMetrics L;
+  L.Count = 1000;
+  L.Sum = 123456789;
+  L.Max = 987654;
+  for (std::size_t I = 0; I < 16; ++I)
+    L.Buckets.emplace_back(I * 4, I * 10);
+  return L;
+}
+
+request::MakeSession sampleMakeSession()
+{
+  request::MakeSession M;
+  M.Name = "session";
+  M.SpawnOpts.Program = "/bin/bash";
+  M.SpawnOpts.Arguments = {"-l", "-c", "echo Hello World!"};
+  M.SpawnOpts.SetEnvironment = {{"TERM", "xterm-256color"},
+                                {"LANG", "en_GB.UTF-8"}};
+  M.SpawnOpts.UnsetEnvironment = {"MONOMUX_SOCKET", "MONOMUX_SESSION"};
+  return M;
+}
+
+/// The number of sessions in the batch messages.
+constexpr std::size_t BatchSize = 8;
+
+request::MakeSessionBatch sampleMakeSessionBatch()
+{
+  request::MakeSessionBatch B;
+  for (std::size_t I = 0; I < BatchSize; ++I)
+  {
+    B.Sessions.push_back(sampleMakeSession());
+    B.Sessions.back().Name = "session-" + std::to_string(I);
+  }
+  return B;
+}
+
+std::vector<std::string> sampleSessionNames()
+{
+  std::vector<std::string> Names;
+  for (std::size_t I = 0; I < BatchSize; ++I)
+    Names.push_back("session-" + std::to_string(I));
+  return Names;
+}
+
+/// Creates a batch response of type \p T with a result for every session.
+template <typename T> T sampleBatchResults()
+{
+  T R;
+  for (std::string& Name : sampleSessionNames())
+    R.Results.push_back(SessionResult{std::move(Name), {true}});
+  return R;
+}
+
+response::SessionList sampleSessionList()
+{
+  response::SessionList L;
+  for (std::size_t I = 0; I < 8; ++I)
+    L.Sessions.push_back(
+      message::SessionData{"session-" + std::to_string(I), 1640000000});
+  return L;
+}
+
+response::Metrics sampleMetrics()
+{
+  response::Metrics M;
+  M.LoopIterations = 1000000;
+  M.ClientCount = 4;
+  M.SessionCount = 2;
+  M.LoopIteration = sampleLatency();
+  for (std::size_t I = 0; I < M.SessionCount; ++I)
+  {
+    SessionMetrics S;
+    S.Name = "session-" + std::to_string(I);
+    S.BytesIn = 1 << 20;
+    S.Reader = BufferMetrics{1024, 4096, 2048};
+    S.ReadToSend = sampleLatency();
+    M.Sessions.emplace_back(std::move(S));
+  }
+  for (std::size_t I = 0; I < M.ClientCount; ++I)
+  {
+    ClientMetrics C;
+    C.ID = I;
+    C.Session = "session-" + std::to_string(I % M.SessionCount);
+    C.DataWrite = BufferMetrics{512, 4096, 4096};
+    C.ReadToSend = sampleLatency();
+    C.WriteQueue = sampleLatency();
+    M.Clients.emplace_back(std::move(C));
+  }
+  return M;
+}
+
+response::LogLevel sampleLogLevel()
+{
+  response::LogLevel L;
+  L.Success = true;
+  L.DefaultLevel = 3;
+  for (const char* F : {"server/Server", "system/Event", "system/Process"})
+    L.Facilities.push_back(FacilityLevel{F, 4, true});
+  return L;
+}
+
+request::Search sampleSearchRequest()
+{
+  request::Search S;
+  S.Pattern = "error:";
+  S.Session = "session";
+  S.Context = 2;
+  S.Limit = 100;
+  return S;
+}
+
+response::Search sampleSearchResponse()
+{
+  response::Search S;
+  S.Success = true;
+  for (std::size_t I = 0; I < 16; ++I)
+    S.Matches.push_back(
+      SearchMatch{"session-" + std::to_string(I % 2),
+                  I * 4096,
+                  "make[1]: Entering directory\r\nfoo.cpp:" +
+                    std::to_string(I) + ": error: expected ';'\r\n",
+                  29});
+  return S;
+}
+
+} // namespace
+
+/// Encodes \p Msg into its transmissible form.
+template <typename T> static void encodeMessage(benchmark::State& State, T Msg)
+{
+  std::size_t Bytes = 0;
+  for (auto _ : State)
+  {
+    std::string Data = encode(Msg);
+    Bytes += Data.size();
+    benchmark::DoNotOptimize(Data.data());
+  }
+  State.SetBytesProcessed(static_cast<std::int64_t>(Bytes));
+}
+
+/// Decodes the transmissible form of \p Msg.
+template <typename T> static void decodeMessage(benchmark::State& State, T Msg)
+{
+  const std::string Data = encode(Msg);
+  for (auto _ : State)
+  {
+    std::optional<T> Out = decode<T>(Data);
+    benchmark::DoNotOptimize(Out);
+  }
+  State.SetBytesProcessed(static_cast<std::int64_t>(State.iterations()) *
+                          static_cast<std::int64_t>(Data.size()));
+}
+
+/// Registers the encode and decode benchmark of a message, named after its
+/// \p MessageKind.
+#define MONOMUX_MESSAGE_BENCHMARKS(KIND, ...)                                  \
+  BENCHMARK_CAPTURE(encodeMessage, KIND, __VA_ARGS__);                         \
+  BENCHMARK_CAPTURE(decodeMessage, KIND, __VA_ARGS__);
+
+MONOMUX_MESSAGE_BENCHMARKS(ConnectionNotification,
+                           notification::Connection{{true}, {}})
+MONOMUX_MESSAGE_BENCHMARKS(ClientIDRequest, request::ClientID{})
+MONOMUX_MESSAGE_BENCHMARKS(ClientIDResponse,
+                           response::ClientID{sampleClientID()})
+MONOMUX_MESSAGE_BENCHMARKS(DataSocketRequest,
+                           request::DataSocket{sampleClientID()})
+MONOMUX_MESSAGE_BENCHMARKS(DataSocketResponse, response::DataSocket{{true}})
+MONOMUX_MESSAGE_BENCHMARKS(SessionListRequest, request::SessionList{})
+MONOMUX_MESSAGE_BENCHMARKS(SessionListResponse, sampleSessionList())
+MONOMUX_MESSAGE_BENCHMARKS(MakeSessionRequest, sampleMakeSession())
+MONOMUX_MESSAGE_BENCHMARKS(MakeSessionResponse,
+                           response::MakeSession{{true}, "session"})
+MONOMUX_MESSAGE_BENCHMARKS(AttachRequest, request::Attach{"session"})
+MONOMUX_MESSAGE_BENCHMARKS(
+  AttachResponse,
+  response::Attach{{true}, message::SessionData{"session", 1640000000}})
+MONOMUX_MESSAGE_BENCHMARKS(DetachRequest,
+                           request::Detach{request::Detach::All})
+MONOMUX_MESSAGE_BENCHMARKS(DetachResponse, response::Detach{})
+MONOMUX_MESSAGE_BENCHMARKS(
+  DetachedNotification,
+  notification::Detached{notification::Detached::Kicked, 0, "Overflow"})
+MONOMUX_MESSAGE_BENCHMARKS(SignalRequest, request::Signal{SIGINT})
+MONOMUX_MESSAGE_BENCHMARKS(RedrawNotification,
+                           notification::Redraw{50, 160})
+MONOMUX_MESSAGE_BENCHMARKS(KeepaliveNotification, notification::Keepalive{})
+MONOMUX_MESSAGE_BENCHMARKS(StatisticsRequest, request::Statistics{})
+MONOMUX_MESSAGE_BENCHMARKS(StatisticsResponse,
+                           response::Statistics{std::string(2048, 'x')})
+MONOMUX_MESSAGE_BENCHMARKS(MetricsRequest, request::Metrics{})
+MONOMUX_MESSAGE_BENCHMARKS(MetricsResponse, sampleMetrics())
+MONOMUX_MESSAGE_BENCHMARKS(TraceRequest, request::Trace{})
+MONOMUX_MESSAGE_BENCHMARKS(TraceResponse,
+                           response::Trace{std::string(24 * 4096, '\0')})
+MONOMUX_MESSAGE_BENCHMARKS(LogLevelRequest,
+                           request::LogLevel{true, "server/Server", 5})
+MONOMUX_MESSAGE_BENCHMARKS(LogLevelResponse, sampleLogLevel())
+MONOMUX_MESSAGE_BENCHMARKS(MakeSessionBatchRequest, sampleMakeSessionBatch())
+MONOMUX_MESSAGE_BENCHMARKS(
+  MakeSessionBatchResponse,
+  sampleBatchResults<response::MakeSessionBatch>())
+MONOMUX_MESSAGE_BENCHMARKS(
+  SignalSessionsBatchRequest,
+  request::SignalSessionsBatch{SIGTERM, sampleSessionNames()})
+MONOMUX_MESSAGE_BENCHMARKS(
+  SignalSessionsBatchResponse,
+  sampleBatchResults<response::SignalSessionsBatch>())
+MONOMUX_MESSAGE_BENCHMARKS(DestroySessionsBatchRequest,
+                           request::DestroySessionsBatch{sampleSessionNames()})
+MONOMUX_MESSAGE_BENCHMARKS(
+  DestroySessionsBatchResponse,
+  sampleBatchResults<response::DestroySessionsBatch>())
+MONOMUX_MESSAGE_BENCHMARKS(SearchRequest, sampleSearchRequest())
+MONOMUX_MESSAGE_BENCHMARKS(SearchResponse, sampleSearchResponse())
+
+#undef MONOMUX_MESSAGE_BENCHMARKS
@@ -0,0 +1,99 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <unistd.h>
+
+#include "monomux/server/Server.hpp"
+#include "monomux/server/SessionData.hpp"
+#include "monomux/system/Socket.hpp"
+
+using namespace monomux;
+using namespace monomux::server;
+
+/// Creates a \p Server on a throwaway socket, without starting its loop.
+static Server makeServer()
+{
+  static std::size_t Counter = 0;
+  std::string Path = "/tmp/monomux-bench-" + std::to_string(::getpid()) +
+                     '-' + std::to_string(Counter++) + ".sock";
+  return Server{Socket::create(std::move(Path))};
+}
+
+/// Registers \p N sessions with default names into \p S.
+static std::vector<std::string> populate(Server& S, std::size_t N)
+{
+  std::vector<std::string> Names;
+  Names.reserve(N);
+  for (std::size_t I = 0; I < N; ++I)
+    Names.emplace_back(
+      S.makeSession(SessionData{S.makeDefaultSessionName()})->name());
+  return Names;
+}
+
+static void getSessionByName(benchmark::State& State)
+{
+  Server S = makeServer();
+  std::vector<std::string> Names =
+    populate(S, static_cast<std::size_t>(State.range(0)));
+
+  std::size_t I = 0;
+  for (auto _ : State)
+  {
+    benchmark::DoNotOptimize(S.getSession(Names[I]));
+    if (++I == Names.size())
+      I = 0;
+  }
+}
+BENCHMARK(getSessionByName)->Arg(100)->Arg(10000);
+
+static void makeAndRemoveDefaultNamedSession(benchmark::State& State)
+{
+  Server S = makeServer();
+  std::vector<std::string> Names =
+    populate(S, static_cast<std::size_t>(State.range(0)));
+
+  for (auto _ : State)
+  {
+    SessionData* New = S.makeSession(SessionData{S.makeDefaultSessionName()});
+    benchmark::DoNotOptimize(New);
+    S.removeSession(*New);
+  }
+}
+BENCHMARK(makeAndRemoveDefaultNamedSession)->Arg(100)->Arg(10000);
+
+static void reuseFreedDefaultName(benchmark::State& State)
+{
+  Server S = makeServer();
+  std::vector<std::string> Names =
+    populate(S, static_cast<std::size_t>(State.range(0)));
+
+  // Punch a hole in the middle of the name range, which is filled in and
+  // emptied again in every iteration.
+  S.removeSession(*S.getSession(Names[Names.size() / 2]));
+  for (auto _ : State)
+  {
+    SessionData* New = S.makeSession(SessionData{S.makeDefaultSessionName()});
+    benchmark::DoNotOptimize(New);
+    S.removeSession(*New);
+  }
+}
+BENCHMARK(reuseFreedDefaultName)->Arg(100)->Arg(10000);
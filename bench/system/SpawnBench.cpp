@@ -0,0 +1,103 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <memory>
+
+#include <benchmark/benchmark.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utmp.h>
+
+#include "monomux/system/Process.hpp"
+#include "monomux/system/Pty.hpp"
+
+using namespace monomux;
+
+/// Makes the resident memory of the benchmark process grow by \p MiB
+/// mebibytes, like the buffers and sessions of a long-running server do, as
+/// the cost of duplicating a process depends on the memory mapped.
+static std::unique_ptr<char[]> ballast(std::size_t MiB)
+{
+  const std::size_t Size = (MiB << 20) + 1;
+  auto Memory = std::make_unique<char[]>(Size);
+  std::memset(Memory.get(), 1, Size);
+  return Memory;
+}
+
+/// The options to create a session that runs \p /bin/true.
+static Process::SpawnOptions sessionOptions()
+{
+  Process::SpawnOptions SO;
+  SO.Program = "/bin/true";
+  SO.CreatePTY = true;
+  SO.Environment["MONOMUX_SOCKET"] = "/tmp/monomux-bench.sock";
+  SO.Environment["MONOMUX_SESSION"] = "bench";
+  return SO;
+}
+
+static void spawnSession(benchmark::State& State)
+{
+  auto Ballast = ballast(static_cast<std::size_t>(State.range(0)));
+  const Process::SpawnOptions SO = sessionOptions();
+
+  for (auto _ : State)
+  {
+    Process P = Process::spawn(SO);
+    State.PauseTiming();
+    P.wait();
+    State.ResumeTiming();
+  }
+}
+BENCHMARK(spawnSession)
+  ->Arg(0)
+  ->Arg(256)
+  ->Arg(1024)
+  ->Unit(benchmark::kMicrosecond);
+
+/// The baseline of \p spawnSession, which creates the process with \p fork()
+/// and sets up the environment in the child before \p exec().
+static void forkSession(benchmark::State& State)
+{
+  auto Ballast = ballast(static_cast<std::size_t>(State.range(0)));
+  const Process::SpawnOptions SO = sessionOptions();
+
+  for (auto _ : State)
+  {
+    Pty PTY;
+    ::pid_t PID = ::fork();
+    if (PID == 0)
+    {
+      ::setsid();
+      ::login_tty(PTY.raw());
+      for (const auto& E : SO.Environment)
+        ::setenv(E.first.c_str(), E.second->c_str(), 1);
+      ::execl(SO.Program.c_str(), SO.Program.c_str(), nullptr);
+      ::_exit(1);
+    }
+    PTY.setupParentSide();
+    State.PauseTiming();
+    ::waitpid(PID, nullptr, 0);
+    State.ResumeTiming();
+  }
+}
+BENCHMARK(forkSession)
+  ->Arg(0)
+  ->Arg(256)
+  ->Arg(1024)
+  ->Unit(benchmark::kMicrosecond);
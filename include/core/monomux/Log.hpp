@@ -17,10 +17,15 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #pragma once
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <sstream>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include "monomux/Config.h"
 #include "monomux/Debug.h"
@@ -69,23 +74,97 @@ constexpr std::int8_t MaximumVerbosity = log::Min - log::Default;
 /// The smallest verbosity (largest quietness) the user can decrease to.
 constexpr std::int8_t MinimumVerbosity = log::Default - log::Max - 1;
 
+/// A named source of log messages, such as \p "server/Server".
+///
+/// Facilities are interned: every name has exactly one instance for the
+/// lifetime of the program, which the logging macros look up once per call
+/// site. Each facility has its own severity limit, which either follows the
+/// limit of the global \p Logger, or is set explicitly.
+class Facility
+{
+public:
+  std::string_view name() const noexcept { return Name; }
+
+  /// \returns the most verbose severity that is emitted for the facility.
+  Severity limit() const noexcept
+  {
+    return Limit.load(std::memory_order_relaxed);
+  }
+
+  /// \returns whether a message of severity \p S is emitted for the facility.
+  bool enabled(Severity S) const noexcept { return S <= limit(); }
+
+  /// \returns whether the facility has its own limit set, instead of following
+  /// the limit of the global \p Logger.
+  bool hasOwnLimit() const noexcept { return OwnLimit; }
+
+  /// Creates a facility. Use \p facility() instead to get the interned
+  /// instance.
+  Facility(std::string Name, Severity Limit)
+    : Name(std::move(Name)), Limit(Limit), OwnLimit(false)
+  {}
+
+private:
+  friend class FacilityRegistry;
+
+  std::string Name;
+  std::atomic<Severity> Limit;
+  bool OwnLimit;
+};
+
+/// \returns the interned \p Facility for \p Name, creating it if needed.
+Facility& facility(std::string_view Name);
+
+/// Sets the severity limit of the facility \p Name to \p Limit. If \p Limit is
+/// \p std::nullopt, the facility follows the limit of the global \p Logger
+/// again.
+///
+/// \returns whether the facility exists. Unknown names are not interned.
+bool setFacilityLimit(std::string_view Name, std::optional<Severity> Limit);
+
+/// \returns all the facilities that were interned so far.
+std::vector<const Facility*> facilities();
+
+/// What the asynchronous log writer does with a new record if its queue is
+/// full.
+enum class DropPolicy
+{
+  /// Throw the new record away and count it as dropped. The thread emitting the
+  /// log message never blocks.
+  DropNewest,
+  /// Wait for the background writer to make space in the queue.
+  Block,
+};
+
+class AsyncWriter;
+
 /// The \p Logger class handles emitting log messages to an output device.
 ///
-/// \note This object is \b NOT thread-safe!
+/// By default, messages are written synchronously to the output stream. After
+/// \p startAsync(), the formatted records are handed over to a bounded queue
+/// which a background thread writes to a file descriptor in batches, so
+/// logging does not block the emitting thread on I/O.
+///
+/// \note This object is \b NOT thread-safe, except for emitting messages
+/// while the asynchronous writer is running.
 class Logger
 {
 private:
   class OutputBuffer
   {
     bool Discard;
-    std::ostream* OS;
+    Severity S;
+    Logger* Owner;
     std::ostringstream Buffer;
 
   public:
-    /// Wraps an output device into a log buffer.
+    /// Wraps the output of \p Owner into a log buffer.
     ///
     /// \param Discard Whether to throw the logged data away.
-    OutputBuffer(std::ostream& OS, bool Discard, std::string_view Prefix);
+    OutputBuffer(Logger& Owner,
+                 bool Discard,
+                 Severity S,
+                 std::string_view Prefix);
 
     /// Print the contents of the log buffer to the output device.
     ~OutputBuffer() noexcept(false);
@@ -102,6 +181,11 @@ private:
   /// A global instance of the logger.
   static std::unique_ptr<Logger> Singleton;
 
+  /// Handler for \p fork() in the child process: the background writer thread
+  /// does not exist in the child, so the global instance must fall back to
+  /// synchronous output.
+  static void forgetAsyncAfterFork() noexcept;
+
 public:
   /// \returns a human-readable tag for the specified severity.
   static const char* levelName(Severity S) noexcept;
@@ -124,22 +208,62 @@ public:
   ///
   /// \see get()
   Logger(Severity SeverityLimit, std::ostream& OS);
+  ~Logger();
 
   Severity getLimit() const noexcept { return SeverityLimit; }
-  void setLimit(Severity Limit) noexcept { SeverityLimit = Limit; }
+  /// Sets the severity limit of the logger. If \p this is the global instance,
+  /// the limit applies to every \p Facility that does not have its own.
+  void setLimit(Severity Limit) noexcept;
 
   /// Redirects all log messages after the call to this function to another
   /// output device.
   void setOutput(std::ostream& OS) noexcept { this->OS = &OS; }
 
+  /// The default number of records the asynchronous writer can queue.
+  static constexpr std::size_t DefaultAsyncCapacity = 4096;
+
+  /// Starts a background thread and switches the logger to write the log
+  /// messages to \p FD through it. Records are queued in a lock-free queue of
+  /// \p Capacity elements, and \p Policy decides what happens if it is full.
+  ///
+  /// \note \p FD is not owned by the logger, and must outlive it, or the
+  /// call to \p stopAsync().
+  ///
+  /// \warning Call this function \b after any \p daemon() or \p fork() that
+  /// continues running the calling process, as threads do not survive those.
+  void startAsync(int FD,
+                  std::size_t Capacity = DefaultAsyncCapacity,
+                  DropPolicy Policy = DropPolicy::DropNewest);
+
+  /// Writes all pending records and stops the background thread, returning to
+  /// synchronous output.
+  void stopAsync() noexcept;
+
+  bool isAsync() const noexcept { return static_cast<bool>(Async); }
+
+  /// \returns the number of records thrown away by the asynchronous writer
+  /// because its queue was full.
+  std::uint64_t droppedRecords() const noexcept;
+
   /// Starts printing a log message with the specified \p S severity.
   /// If the \p S severity is lower than the current severity limit, the message
   /// will be discarded.
   OutputBuffer operator()(Severity S, std::string_view Facility);
 
+  /// Starts printing a log message with the specified \p S severity for the
+  /// interned \p F.
+  ///
+  /// \note This overload does \b NOT check the severity limit, the caller is
+  /// expected to have checked \p F.enabled() already.
+  OutputBuffer operator()(Severity S, const Facility& F);
+
 private:
   Severity SeverityLimit;
   std::ostream* OS;
+  std::unique_ptr<AsyncWriter> Async;
+
+  /// Sends the formatted \p Line to the output.
+  void emit(Severity S, std::string Line);
 };
 
 #define MONOMUX_LOGGER_SHORTCUT(NAME, SEVERITY)                                \
@@ -161,6 +285,55 @@ MONOMUX_LOGGER_SHORTCUT(data, Data);
 
 #undef MONOMUX_LOGGER_SHORTCUT
 
+/// The severities under the names of the shortcut functions, for use in
+/// \p MONOMUX_LOG.
+namespace level
+{
+constexpr Severity always = None;  // NOLINT(readability-identifier-naming)
+constexpr Severity log = Default;  // NOLINT(readability-identifier-naming)
+constexpr Severity fatal = Fatal;  // NOLINT(readability-identifier-naming)
+constexpr Severity error = Error;  // NOLINT(readability-identifier-naming)
+constexpr Severity warn = Warning; // NOLINT(readability-identifier-naming)
+constexpr Severity info = Info;    // NOLINT(readability-identifier-naming)
+constexpr Severity debug = Debug;  // NOLINT(readability-identifier-naming)
+constexpr Severity trace = Trace;  // NOLINT(readability-identifier-naming)
+constexpr Severity data = Data;    // NOLINT(readability-identifier-naming)
+} // namespace level
+
+namespace detail
+{
+
+/// Turns the type of a log expression into \p void, so it can be the operand
+/// of a conditional with \p (void)0. \p & binds looser than \p << but tighter
+/// than \p ?:, so the entire message is on the right-hand side.
+struct Voidify
+{
+  template <typename T> void operator&(const T& /* Buffer */) const noexcept {}
+};
+
+} // namespace detail
+
+/* Expands to the \p Facility named \p FACILITY, which is looked up only once
+ * per call site.
+ */
+#define MONOMUX_LOG_FACILITY(FACILITY)                                         \
+  ([]() -> const monomux::log::Facility& {                                     \
+    static const monomux::log::Facility& F = monomux::log::facility(FACILITY); \
+    return F;                                                                  \
+  }())
+
+/* Starts a log message of \p SEVERITY (one of the shortcut names, such as
+ * \p info or \p debug) for \p FACILITY. If the severity is disabled for the
+ * facility, nothing is constructed and the operands of the following \p <<
+ * are \b NOT evaluated.
+ */
+#define MONOMUX_LOG(SEVERITY, FACILITY)                                        \
+  !MONOMUX_LOG_FACILITY(FACILITY).enabled(monomux::log::level::SEVERITY)       \
+    ? (void)0                                                                  \
+    : monomux::log::detail::Voidify{} &                                        \
+        monomux::log::Logger::get()(monomux::log::level::SEVERITY,             \
+                                    MONOMUX_LOG_FACILITY(FACILITY))
+
 #ifdef MONOMUX_NON_ESSENTIAL_LOGS
 /* Wrap logging code into this macro to suppress building it if config option
  * \p MONOMUX_NON_ESSENTIAL_LOGS is turned off.
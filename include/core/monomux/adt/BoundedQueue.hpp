@@ -0,0 +1,144 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace monomux
+{
+
+/// A fixed-capacity, lock-free queue that any number of threads may push to
+/// and pop from concurrently.
+///
+/// Every slot carries a sequence number that tells producers and consumers
+/// whether it is free to write or ready to read, so the only contended
+/// operations are a single compare-and-swap on either end of the queue.
+/// (This is D. Vyukov's bounded MPMC queue.)
+///
+/// \note The capacity is rounded up to the next power of two.
+template <typename T> class BoundedQueue
+{
+public:
+  explicit BoundedQueue(std::size_t Capacity)
+  {
+    std::size_t RealCapacity = 2;
+    while (RealCapacity < Capacity)
+      RealCapacity <<= 1;
+    Mask = RealCapacity - 1;
+
+    Cells = std::make_unique<Cell[]>(RealCapacity);
+    for (std::size_t I = 0; I < RealCapacity; ++I)
+      Cells[I].Sequence.store(I, std::memory_order_relaxed);
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  std::size_t capacity() const noexcept { return Mask + 1; }
+
+  /// \returns the number of elements in the queue. This value might be stale
+  /// by the time it is used if other threads are accessing the queue.
+  std::size_t sizeApprox() const noexcept
+  {
+    std::size_t Tail = DequeuePos.load(std::memory_order_relaxed);
+    std::size_t Head = EnqueuePos.load(std::memory_order_relaxed);
+    return Head >= Tail ? Head - Tail : 0;
+  }
+
+  /// Moves \p Value to the end of the queue.
+  ///
+  /// \returns \p false, without modifying \p Value, if the queue is full.
+  bool tryPush(T&& Value) noexcept(std::is_nothrow_move_assignable_v<T>)
+  {
+    Cell* C;
+    std::size_t Pos = EnqueuePos.load(std::memory_order_relaxed);
+    while (true)
+    {
+      C = &Cells[Pos & Mask];
+      std::size_t Seq = C->Sequence.load(std::memory_order_acquire);
+      auto Diff = static_cast<std::ptrdiff_t>(Seq) -
+                  static_cast<std::ptrdiff_t>(Pos);
+      if (Diff == 0)
+      {
+        if (EnqueuePos.compare_exchange_weak(
+              Pos, Pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (Diff < 0)
+        return false;
+      else
+        Pos = EnqueuePos.load(std::memory_order_relaxed);
+    }
+
+    C->Data = std::move(Value);
+    C->Sequence.store(Pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Moves the first element of the queue to \p Out.
+  ///
+  /// \returns \p false, without modifying \p Out, if the queue is empty.
+  bool tryPop(T& Out) noexcept(std::is_nothrow_move_assignable_v<T>)
+  {
+    Cell* C;
+    std::size_t Pos = DequeuePos.load(std::memory_order_relaxed);
+    while (true)
+    {
+      C = &Cells[Pos & Mask];
+      std::size_t Seq = C->Sequence.load(std::memory_order_acquire);
+      auto Diff = static_cast<std::ptrdiff_t>(Seq) -
+                  static_cast<std::ptrdiff_t>(Pos + 1);
+      if (Diff == 0)
+      {
+        if (DequeuePos.compare_exchange_weak(
+              Pos, Pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (Diff < 0)
+        return false;
+      else
+        Pos = DequeuePos.load(std::memory_order_relaxed);
+    }
+
+    Out = std::move(C->Data);
+    C->Sequence.store(Pos + Mask + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  struct Cell
+  {
+    std::atomic<std::size_t> Sequence;
+    T Data;
+  };
+
+  /// The size of a cache line, to keep the two ends of the queue from false
+  /// sharing.
+  static constexpr std::size_t CacheLine = 64;
+
+  std::unique_ptr<Cell[]> Cells;
+  std::size_t Mask;
+  alignas(CacheLine) std::atomic<std::size_t> EnqueuePos = 0;
+  alignas(CacheLine) std::atomic<std::size_t> DequeuePos = 0;
+};
+
+} // namespace monomux
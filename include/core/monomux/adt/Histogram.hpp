@@ -0,0 +1,147 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+
+namespace monomux
+{
+
+/// A fixed-memory histogram of unsigned values with logarithmic buckets, each
+/// of which is split linearly into \p 2^SubBucketBits sub-buckets.
+///
+/// Values smaller than \p 2^SubBucketBits are counted exactly. Larger values
+/// are counted with a relative error bounded by \p 2^-SubBucketBits, which
+/// makes the histogram suitable for latencies spanning several orders of
+/// magnitude. Values at or above \p 2^MaxExponent are clamped into the last
+/// bucket. Recording a value is a handful of integer operations and never
+/// allocates.
+template <unsigned SubBucketBits = 3, unsigned MaxExponent = 36>
+class LogLinearHistogram
+{
+  static_assert(SubBucketBits > 0 && SubBucketBits < MaxExponent,
+                "Invalid bucket layout");
+  static_assert(MaxExponent < 64, "Values are at most 64-bit");
+
+public:
+  using ValueTy = std::uint64_t;
+  using CountTy = std::uint32_t;
+
+  static constexpr std::size_t SubBucketCount = 1ULL << SubBucketBits;
+  static constexpr std::size_t BucketCount =
+    (MaxExponent - SubBucketBits + 1) * SubBucketCount;
+  /// The largest value that is still counted accurately.
+  static constexpr ValueTy MaxValue = (1ULL << MaxExponent) - 1;
+
+  /// \returns the index of the bucket \p V is counted in.
+  static constexpr std::size_t bucketIndex(ValueTy V) noexcept
+  {
+    V = std::min(V, MaxValue);
+    if (V < SubBucketCount)
+      return static_cast<std::size_t>(V);
+
+    unsigned Exponent = 63 - static_cast<unsigned>(__builtin_clzll(V));
+    unsigned Shift = Exponent - SubBucketBits;
+    return (Shift + 1) * SubBucketCount +
+           static_cast<std::size_t>((V >> Shift) - SubBucketCount);
+  }
+
+  /// \returns the smallest value that is counted in the bucket \p Index.
+  static constexpr ValueTy bucketLowerBound(std::size_t Index) noexcept
+  {
+    if (Index < SubBucketCount)
+      return Index;
+    ValueTy Shift = Index / SubBucketCount - 1;
+    ValueTy Sub = Index % SubBucketCount;
+    return (SubBucketCount + Sub) << Shift;
+  }
+
+  /// \returns the largest value that is counted in the bucket \p Index.
+  static constexpr ValueTy bucketUpperBound(std::size_t Index) noexcept
+  {
+    if (Index + 1 >= BucketCount)
+      return MaxValue;
+    return bucketLowerBound(Index + 1) - 1;
+  }
+
+  void record(ValueTy V) noexcept
+  {
+    ++Buckets[bucketIndex(V)];
+    ++Count;
+    Sum += V;
+    Max = std::max(Max, V);
+  }
+
+  /// Clears every recorded value.
+  void reset() noexcept
+  {
+    Buckets.fill(0);
+    Count = 0;
+    Sum = 0;
+    Max = 0;
+  }
+
+  std::uint64_t count() const noexcept { return Count; }
+  ValueTy sum() const noexcept { return Sum; }
+  ValueTy max() const noexcept { return Max; }
+  bool empty() const noexcept { return Count == 0; }
+  CountTy bucket(std::size_t Index) const noexcept { return Buckets[Index]; }
+
+  /// \returns an upper estimate of the value below which \p Quantile fraction
+  /// of the recorded values fall. \p Quantile must be in the range [0, 1].
+  ValueTy quantile(double Quantile) const noexcept
+  {
+    if (Count == 0)
+      return 0;
+
+    auto Rank = static_cast<std::uint64_t>(Quantile * Count);
+    Rank = std::clamp<std::uint64_t>(Rank, 1, Count);
+    std::uint64_t Seen = 0;
+    for (std::size_t I = 0; I < BucketCount; ++I)
+    {
+      Seen += Buckets[I];
+      if (Seen >= Rank)
+        return std::min(bucketUpperBound(I), Max);
+    }
+    return Max;
+  }
+
+  /// Calls \p Fn with the index and the count of every non-empty bucket, in
+  /// increasing order of values.
+  template <typename Fun> void forEachBucket(Fun&& Fn) const
+  {
+    for (std::size_t I = 0; I < BucketCount; ++I)
+      if (Buckets[I])
+        Fn(I, Buckets[I]);
+  }
+
+private:
+  std::array<CountTy, BucketCount> Buckets{};
+  std::uint64_t Count = 0;
+  ValueTy Sum = 0;
+  ValueTy Max = 0;
+};
+
+/// The histogram used for timing the server's operations, with values in
+/// nanoseconds. The values are accurate within 12.5% up to about a minute.
+using LatencyHistogram = LogLinearHistogram<3, 36>;
+
+} // namespace monomux
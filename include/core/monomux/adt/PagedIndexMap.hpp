@@ -0,0 +1,237 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "monomux/adt/MemberFunctionHelper.hpp"
+
+namespace monomux
+{
+
+/// An implementation of a \p std::map where keys are fixed to be unsigned
+/// integer types, densely packed from \p 0, like file descriptors. The
+/// elements are stored in fixed size pages of a two-level array, indexed
+/// directly by the key. Lookup is a constant operation at every key value,
+/// and the pages are only allocated when a key in their range is mapped.
+///
+///   \code
+///
+///      Pages:  [ * | - | * ]
+///                |       \-> [ 512 .. 767 ]
+///                \---------> [   0 .. 255 ]
+///
+///   \endcode
+///
+/// Unlike \p SmallIndexMap, large keys do not degrade the representation of
+/// the entire map.
+///
+/// \tparam PageSize The number of elements stored in a page. Must be a power
+/// of two.
+///
+/// \note Elements are stored in place, so references to them are invalidated
+/// only if the element is erased, or its page is released.
+template <typename T, std::size_t PageSize = 256, typename KeyTy = std::size_t>
+class PagedIndexMap
+{
+  static_assert(std::is_integral_v<KeyTy> && std::is_unsigned_v<KeyTy>,
+                "Keys must be index-like for direct indexing to work!");
+  static_assert(PageSize != 0 && (PageSize & (PageSize - 1)) == 0,
+                "PageSize must be a power of two!");
+  static_assert(std::is_default_constructible_v<T>,
+                "Elements are default-constructed when their page is created.");
+
+  struct Page
+  {
+    std::array<T, PageSize> Elements{};
+    std::bitset<PageSize> Mapped;
+    std::size_t Count = 0;
+  };
+
+  std::vector<std::unique_ptr<Page>> Pages;
+
+  /// The number of mapped elements.
+  std::size_t Size = 0;
+
+  static constexpr std::size_t pageOf(KeyTy Key) noexcept
+  {
+    return static_cast<std::size_t>(Key) / PageSize;
+  }
+  static constexpr std::size_t slotOf(KeyTy Key) noexcept
+  {
+    return static_cast<std::size_t>(Key) & (PageSize - 1);
+  }
+
+public:
+  /// \returns the size of the container, i.e. the number of elements added
+  /// into it.
+  ///
+  /// This is a \e constant-time query.
+  std::size_t size() const noexcept { return Size; }
+
+  /// \returns whether the container is empty.
+  ///
+  /// This is a \e constant-time query.
+  bool empty() const noexcept { return Size == 0; }
+
+  /// \returns the number of pages currently allocated.
+  std::size_t pageCount() const noexcept
+  {
+    std::size_t N = 0;
+    for (const auto& P : Pages)
+      N += static_cast<bool>(P);
+    return N;
+  }
+
+  /// \returns whether the \p Key is mapped.
+  bool contains(KeyTy Key) const noexcept { return tryGet(Key); }
+
+  /// Sets the element to one constructed by forwarding \p Args, overwriting
+  /// any potential already stored element.
+  template <typename... Arg> void set(KeyTy Key, Arg&&... Args)
+  {
+    slot(Key) = T{std::forward<Arg>(Args)...};
+  }
+
+  /// Deletes the element mapped to \p Key if such element exists.
+  ///
+  /// If the page of the element becomes empty, it is released.
+  void erase(KeyTy Key)
+  {
+    const std::size_t PageIdx = pageOf(Key);
+    if (PageIdx >= Pages.size() || !Pages[PageIdx])
+      return;
+
+    Page& P = *Pages[PageIdx];
+    const std::size_t Slot = slotOf(Key);
+    if (!P.Mapped.test(Slot))
+      return;
+
+    P.Elements[Slot] = T{};
+    P.Mapped.reset(Slot);
+    --P.Count;
+    --Size;
+
+    if (!P.Count)
+      Pages[PageIdx].reset();
+  }
+
+  /// Deletes all mapped elements.
+  ///
+  /// \note The already allocated pages are kept, so refilling the map with
+  /// similar keys does not allocate again.
+  void clear()
+  {
+    for (auto& P : Pages)
+    {
+      if (!P || !P->Count)
+        continue;
+
+      for (std::size_t I = 0; I < PageSize; ++I)
+        if (P->Mapped.test(I))
+          P->Elements[I] = T{};
+      P->Mapped.reset();
+      P->Count = 0;
+    }
+    Size = 0;
+  }
+
+  /// Retrieve a non-mutable pointer to the element mapped for \p Key, or
+  /// \p nullptr if \p Key is not mapped.
+  const T* tryGet(KeyTy Key) const noexcept
+  {
+    const std::size_t PageIdx = pageOf(Key);
+    if (PageIdx >= Pages.size() || !Pages[PageIdx])
+      return nullptr;
+
+    const Page& P = *Pages[PageIdx];
+    const std::size_t Slot = slotOf(Key);
+    if (!P.Mapped.test(Slot))
+      return nullptr;
+    return &P.Elements[Slot];
+  }
+  /// Retrieve a mutable pointer to the element mapped for \p Key, or
+  /// \p nullptr if \p Key is not mapped.
+  MEMBER_FN_NON_CONST_1_NOEXCEPT(T*, tryGet, KeyTy, Key);
+
+  /// Retrieve a non-mutable reference to the element mapped for \p Key.
+  /// \throws std::out_of_range if \p Key is not mapped.
+  const T& get(KeyTy Key) const
+  {
+    const T* P = tryGet(Key);
+    if (!P)
+      throw std::out_of_range(std::to_string(Key) + " is not mapped");
+    return *P;
+  }
+  /// Retrieve a mutable reference to the element mapped for \p Key.
+  MEMBER_FN_NON_CONST_1(T&, get, KeyTy, Key);
+
+  /// Create a mutable reference to the element mapped for \p Key.
+  /// If no such element exists, a default-constructed element is created and
+  /// mapped for \p Key.
+  T& operator[](KeyTy Key) { return slot(Key); }
+
+  /// Calls \p Fn with every mapped key and a mutable reference to its element,
+  /// in increasing order of the keys. Unallocated pages are skipped entirely.
+  ///
+  /// \warning \p Fn must not map or erase elements.
+  template <typename Fn> void forEach(Fn&& F)
+  {
+    for (std::size_t PageIdx = 0; PageIdx < Pages.size(); ++PageIdx)
+    {
+      Page* P = Pages[PageIdx].get();
+      if (!P || !P->Count)
+        continue;
+
+      for (std::size_t I = 0; I < PageSize; ++I)
+        if (P->Mapped.test(I))
+          F(static_cast<KeyTy>(PageIdx * PageSize + I), P->Elements[I]);
+    }
+  }
+
+private:
+  /// \returns the storage for \p Key, allocating its page and marking it
+  /// mapped if needed.
+  T& slot(KeyTy Key)
+  {
+    const std::size_t PageIdx = pageOf(Key);
+    if (PageIdx >= Pages.size())
+      Pages.resize(PageIdx + 1);
+    if (!Pages[PageIdx])
+      Pages[PageIdx] = std::make_unique<Page>();
+
+    Page& P = *Pages[PageIdx];
+    const std::size_t Slot = slotOf(Key);
+    if (!P.Mapped.test(Slot))
+    {
+      P.Mapped.set(Slot);
+      ++P.Count;
+      ++Size;
+    }
+    return P.Elements[Slot];
+  }
+};
+
+} // namespace monomux
@@ -21,9 +21,13 @@
 #include <cassert>
 #include <chrono>
 #include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <memory>
 #include <optional>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "monomux/adt/MemberFunctionHelper.hpp"
@@ -35,13 +39,19 @@ namespace monomux
 namespace detail
 {
 
+/// \returns the smallest power of two that is not less than \p N.
+constexpr std::size_t ceilPowerOfTwo(std::size_t N) noexcept
+{
+  std::size_t P = 1;
+  while (P < N)
+    P <<= 1;
+  return P;
+}
+
 /// Helper class that contains the details of \p RingBuffer that is not
-/// dependent on the \p T template parameter, and also deals with calculating
-/// optimal shrinking resizes for the buffer.
+/// dependent on the template parameters.
 class RingBufferBase
 {
-  static constexpr std::size_t Kilo = 1024;
-
   const std::size_t OriginalCapacity;
 
 public:
@@ -50,6 +60,31 @@ public:
   bool empty() const noexcept { return Size == 0; }
 
   std::size_t originalCapacity() const noexcept { return OriginalCapacity; }
+
+protected:
+  /// The physical size of the allocated buffer. This is always a power of two.
+  std::size_t Capacity = 0;
+  /// The number of elements mapped.
+  std::size_t Size = 0;
+
+  RingBufferBase(std::size_t Capacity)
+    : OriginalCapacity(ceilPowerOfTwo(Capacity)),
+      Capacity(ceilPowerOfTwo(Capacity))
+  {}
+
+  /// \returns the mask that maps a logical position to the physical storage.
+  std::size_t mask() const noexcept { return Capacity - 1; }
+};
+
+/// The default usage tracking policy of \p RingBuffer, which records the time
+/// of the last access and the peaks of the size between the buffer emptying.
+/// These drive the heuristics that shrink a grown buffer back to its original
+/// capacity.
+class RingBufferUsageTracking
+{
+  static constexpr std::size_t Kilo = 1024;
+
+public:
   std::chrono::time_point<std::chrono::system_clock> lastAccess() const noexcept
   {
     return LastAccess;
@@ -68,57 +103,56 @@ public:
     return Peaks;
   }
 
-protected:
-  /// The physical size of the allocated buffer.
-  std::size_t Capacity = 0;
-  /// The number of elements mapped.
-  std::size_t Size = 0;
-
-  RingBufferBase(std::size_t Capacity)
-    : OriginalCapacity(Capacity), Capacity(Capacity)
+  /// \returns the largest size peak in \p peakStats(), without copying the
+  /// profiling data.
+  std::size_t maxPeak() const noexcept
   {
-    markAccess();
-    SizePeaks.resize(((Capacity / Kilo) + 2) * 1);
+    return SizePeaks.empty()
+             ? 0
+             : *std::max_element(SizePeaks.begin(), SizePeaks.end());
   }
 
-  void incSize() noexcept
-  {
-    ++Size;
-    markAccess();
-    mayBePeak();
-  }
-  void decSize() noexcept
-  {
-    assert(Size != 0);
-    --Size;
-    markAccess();
-    mayBeValley();
-  }
-  void addSize(std::size_t N) noexcept
+protected:
+  RingBufferUsageTracking(const RingBufferBase& Buffer)
   {
-    Size += N;
     markAccess();
-    mayBePeak();
+    SizePeaks.resize(((Buffer.originalCapacity() / Kilo) + 2) * 1);
   }
-  void subSize(std::size_t N) noexcept
+
+  void markAccess() noexcept { LastAccess = std::chrono::system_clock::now(); }
+
+  /// Marks the current size as the peak of the current zone, if sufficient.
+  void mayBePeak(const RingBufferBase& Buffer) noexcept
   {
-    assert(N <= Size);
-    Size -= N;
-    markAccess();
-    mayBeValley();
+    if (Buffer.empty() || Buffer.capacity() <= Buffer.originalCapacity())
+      return;
+
+    if (Buffer.size() > SizePeaks[CurrentPeakIndex])
+      SizePeaks[CurrentPeakIndex] = Buffer.size();
   }
-  void zeroSize() noexcept
+
+  /// "Commits" the previous peak and starts counting the size for the next peak
+  /// after the current size has reached zero.
+  void mayBeValley(const RingBufferBase& Buffer) noexcept
   {
-    Size = 0;
-    mayBeValley();
+    if (!Buffer.empty() || Buffer.capacity() <= Buffer.originalCapacity())
+      return;
+    if (SizePeaks[CurrentPeakIndex] == 0)
+      return;
+
+    ++CurrentPeakIndex;
+    if (CurrentPeakIndex >= SizePeaks.size())
+      // If we reached the end of the measurement vector, restart from the
+      // start. This is a little ring buffer of itself. :)
+      CurrentPeakIndex = 0;
   }
 
   /// \returns whether the \p RingBuffer should shrink itself back to the
   /// \p originalCapacity() because most of the recent buffer uses did not
   /// exceed it meaningfully.
-  bool shouldShrink() const noexcept
+  bool shouldShrink(const RingBufferBase& Buffer) const noexcept
   {
-    if (Capacity <= OriginalCapacity)
+    if (Buffer.capacity() <= Buffer.originalCapacity())
       return false;
 
     static constexpr std::size_t TimeThresholdSeconds = 60;
@@ -137,19 +171,19 @@ protected:
     for (std::size_t Peak : SizePeaks)
       if (Peak == 0)
         ++ZeroPeaks;
-      else if (Peak <= OriginalCapacity)
+      else if (Peak <= Buffer.originalCapacity())
         ++SufficientlySmallPeaks;
 
     const std::size_t Threshold = (SizePeaks.size() - ZeroPeaks) / 2 + 1;
     return SufficientlySmallPeaks > Threshold;
   }
 
-  void resetPeaks() noexcept
+  void resetPeaks(const RingBufferBase& Buffer) noexcept
   {
     for (std::size_t& SPV : SizePeaks)
       SPV = 0;
     CurrentPeakIndex = 0;
-    mayBePeak();
+    mayBePeak(Buffer);
   }
 
 private:
@@ -159,34 +193,32 @@ private:
   std::size_t CurrentPeakIndex = 0;
 
   std::chrono::time_point<std::chrono::system_clock> LastAccess;
+};
 
-  void markAccess() noexcept { LastAccess = std::chrono::system_clock::now(); }
-
-  /// Marks the current size as the peak of the current zone, if sufficient.
-  void mayBePeak() noexcept
+/// A usage tracking policy of \p RingBuffer that records nothing. Buffers
+/// with this policy keep the capacity they grew to until destroyed, but the
+/// operations do not pay for querying the clock and maintaining the peaks.
+class RingBufferNoTracking
+{
+public:
+  std::chrono::time_point<std::chrono::system_clock> lastAccess() const noexcept
   {
-    if (Size == 0 || Capacity <= OriginalCapacity)
-      return;
-
-    if (Size > SizePeaks[CurrentPeakIndex])
-      SizePeaks[CurrentPeakIndex] = Size;
+    return {};
   }
+  std::vector<std::size_t> peakStats() const { return {}; }
+  std::size_t maxPeak() const noexcept { return 0; }
 
-  /// "Commits" the previous peak and starts counting the size for the next peak
-  /// after the current size has reached zero.
-  void mayBeValley() noexcept
-  {
-    if (Size != 0 || Capacity <= OriginalCapacity)
-      return;
-    if (SizePeaks[CurrentPeakIndex] == 0)
-      return;
+protected:
+  RingBufferNoTracking(const RingBufferBase& /* Buffer */) {}
 
-    ++CurrentPeakIndex;
-    if (CurrentPeakIndex >= SizePeaks.size())
-      // If we reached the end of the measurement vector, restart from the
-      // start. This is a little ring buffer of itself. :)
-      CurrentPeakIndex = 0;
+  void markAccess() noexcept {}
+  void mayBePeak(const RingBufferBase& /* Buffer */) noexcept {}
+  void mayBeValley(const RingBufferBase& /* Buffer */) noexcept {}
+  bool shouldShrink(const RingBufferBase& /* Buffer */) const noexcept
+  {
+    return false;
   }
+  void resetPeaks(const RingBufferBase& /* Buffer */) noexcept {}
 };
 
 } // namespace detail
@@ -215,22 +247,34 @@ private:
 /// move elements to the left to position them at "start". This comes with its
 /// drawbacks, however: an access of a particular length into the storage may
 /// simply not yield a contiguous buffer, depending on the "origin point" of the
-/// ring.
+/// ring. A bulk access is therefore split into at most two contiguous parts,
+/// which are transferred with \p memcpy() if \p T is trivially copyable.
+///
+/// The capacity of the buffer is always a power of two (requests are rounded
+/// up), so the logical positions are mapped to the physical storage by
+/// masking.
 ///
 /// For these reasons, this implementation only supports pushing and popping
 /// from the backing data structure.
 ///
 /// \tparam T The element type to store. Ring storage works best if T is
 /// default-constructible and this construction is cheap.
-template <class T> class RingBuffer : public detail::RingBufferBase
+/// \tparam Tracking The policy recording the usage of the buffer, which decides
+/// when a grown buffer shrinks. Either \p detail::RingBufferUsageTracking or
+/// \p detail::RingBufferNoTracking.
+template <class T, class Tracking = detail::RingBufferUsageTracking>
+class RingBuffer
+  : public detail::RingBufferBase
+  , public Tracking
 {
   using StorageType = std::unique_ptr<T[]>;
   static constexpr bool NothrowAssignable = std::is_nothrow_assignable_v<T, T>;
+  static constexpr bool TriviallyCopyable = std::is_trivially_copyable_v<T>;
 
 public:
   RingBuffer(std::size_t Capacity)
-    : RingBufferBase(Capacity), StorageWithOriginalCapacity(new T[Capacity]),
-      Origin(physicalBegin()), End(physicalBegin())
+    : RingBufferBase(Capacity), Tracking(static_cast<RingBufferBase&>(*this)),
+      StorageWithOriginalCapacity(new T[this->Capacity])
   {}
 
   RingBuffer(std::initializer_list<T> Init) : RingBuffer(Init.size())
@@ -253,10 +297,7 @@ public:
     if (Size == Capacity)
       grow();
 
-    T* InsertPos = nextSlot();
-    *InsertPos = T{std::forward<Args>(Argv)...};
-
-    End = InsertPos + 1;
+    *translateIndex(Size) = T{std::forward<Args>(Argv)...};
     incSize();
   }
 
@@ -274,10 +315,8 @@ public:
     if (Size == Capacity)
       grow();
 
-    T* InsertPos = prevSlot();
-    *InsertPos = T{std::forward<Args>(Argv)...};
-
-    Origin = InsertPos;
+    Origin = (Origin - 1) & mask();
+    physicalBegin()[Origin] = T{std::forward<Args>(Argv)...};
     incSize();
   }
 
@@ -298,8 +337,9 @@ public:
 
   void clear() noexcept(NothrowAssignable)
   {
-    for (std::size_t I = 0; I < originalCapacity(); ++I)
-      StorageWithOriginalCapacity[I] = T{};
+    if constexpr (!std::is_trivially_destructible_v<T>)
+      for (std::size_t I = 0; I < originalCapacity(); ++I)
+        StorageWithOriginalCapacity[I] = T{};
     zeroSize();
     tryCleanup();
   }
@@ -330,11 +370,9 @@ public:
     if (empty())
       throw std::out_of_range{"Empty buffer."};
 
-    *Origin = T{};
+    physicalBegin()[Origin] = T{};
 
-    ++Origin;
-    if (Origin == physicalEnd())
-      Origin = physicalBegin();
+    Origin = (Origin + 1) & mask();
     decSize();
     tryCleanup();
   }
@@ -347,10 +385,6 @@ public:
 
     *translateIndex(Size - 1) = T{};
 
-    if (End == physicalBegin())
-      End = physicalEnd();
-    else
-      --End;
     decSize();
     tryCleanup();
   }
@@ -360,7 +394,7 @@ public:
   /// \see dropFront, peekFront
   std::vector<T> takeFront(std::size_t N)
   {
-    std::vector<T> V = peekFront(N);
+    std::vector<T> V = copyFront</* Move =*/true>(N);
     dropFront(V.size());
     return V;
   }
@@ -373,7 +407,7 @@ public:
     if (N > Size)
       N = Size;
 
-    Origin = translateIndex(N);
+    Origin = (Origin + N) & mask();
     subSize(N);
     tryCleanup();
   }
@@ -382,77 +416,21 @@ public:
   /// do not consume it from the buffer.
   ///
   /// \see takeFront, dropFront
-  std::vector<T> peekFront(std::size_t N)
+  std::vector<T> peekFront(std::size_t N) const
   {
-    if (N > Size)
-      N = Size;
-
-    std::vector<T> V;
-    V.reserve(N);
-
-    T* P = Origin;
-    while (N > 0)
-    {
-      V.emplace_back(std::move(*P));
-      ++P;
-      --N;
-
-      if (P == physicalEnd())
-        P = physicalBegin();
-    }
-
-    return V;
+    return copyFront</* Move =*/false>(N);
   }
 
   /// Push the contents of \p V to the end of the buffer.
   void putBack(std::vector<T> V) { putBack(V.data(), V.size()); }
 
   /// Push \p N elements starting at \p Ptr to the end of the buffer.
-  void putBack(T* Ptr, std::size_t N)
-  {
-    if (Size + N > Capacity)
-      grow(Size + N);
-
-    std::size_t C = 0;
-    T* P = nextSlot();
-    while (C != N)
-    {
-      *P = std::move(*Ptr);
-
-      ++Ptr;
-      ++P;
-      ++C;
-
-      if (P == physicalEnd())
-        P = physicalBegin();
-    }
-
-    addSize(N);
-    End = P;
-  }
+  void putBack(T* Ptr, std::size_t N) { putBackImpl</* Move =*/true>(Ptr, N); }
 
   /// Push \p N elements starting at \p Ptr to the end of the buffer.
   void putBack(const T* Ptr, std::size_t N)
   {
-    if (Size + N > Capacity)
-      grow(Size + N);
-
-    std::size_t C = 0;
-    T* P = nextSlot();
-    while (C != N)
-    {
-      *P = *Ptr;
-
-      ++Ptr;
-      ++P;
-      ++C;
-
-      if (P == physicalEnd())
-        P = physicalBegin();
-    }
-
-    addSize(N);
-    End = P;
+    putBackImpl</* Move =*/false>(Ptr, N);
   }
 
   /// Attempts to heuristically release associated resources if the buffer was
@@ -462,9 +440,9 @@ public:
     if (!empty())
       return;
 
-    if (shouldShrink())
+    if (this->shouldShrink(*this))
       shrink(originalCapacity());
-    Origin.get() = End.get() = physicalBegin();
+    Origin = 0;
   }
 
 private:
@@ -486,63 +464,108 @@ private:
   MEMBER_FN_NON_CONST_0(StorageType&, getStorage);
 
   T* physicalBegin() const noexcept { return getStorage().get(); }
-  T* physicalEnd() const noexcept { return (getStorage().get()) + Capacity; }
-
-  /// The \p Origin represents the logical \e Begin point of the buffer, the
-  /// place where the first element is (if there are any).
-  UniqueScalar<T*, nullptr> Origin;
-  /// The \p End represents the logical \e End point of the buffer. This points
-  /// to the empty space after the last actually placed elements.
-  UniqueScalar<T*, nullptr> End;
-
-  /// \returns the location where a back-insertion into the buffer should take
-  /// place, or \p nullptr if the buffer is full.
-  T* nextSlot() noexcept
-  {
-    T* P = End;
-    if (P >= physicalEnd())
-      // If we are over the physical end, start again from the beginning.
-      P = physicalBegin();
-    if (Size != 0 && P == Origin)
-      // The buffer is full.
-      return nullptr;
-    return P;
-  }
-
-  /// \returns the location where a front-insertion into the buffer should take
-  /// place, or \p nullptr if the buffer is full.
-  T* prevSlot() noexcept
-  {
-    T* P = Origin;
-    if (P == physicalBegin())
-      // We begun at the physical begin, so the slot we want is the one
-      // right before the end. However, the buffer may be full if the physical
-      // and logical ends meet up.
-      P = physicalEnd();
-    if (Size != 0 && P == End)
-      // The buffer is full.
-      return nullptr;
-
-    --P; // Go the previous location.
-    return P;
+
+  /// The \p Origin represents the physical index of the logical \e Begin point
+  /// of the buffer, the place where the first element is (if there are any).
+  /// The logical \e End is \p Size elements after it.
+  UniqueScalar<std::size_t, 0> Origin;
+
+  void incSize() noexcept
+  {
+    ++Size;
+    this->markAccess();
+    this->mayBePeak(*this);
+  }
+  void decSize() noexcept
+  {
+    assert(Size != 0);
+    --Size;
+    this->markAccess();
+    this->mayBeValley(*this);
+  }
+  void addSize(std::size_t N) noexcept
+  {
+    Size += N;
+    this->markAccess();
+    this->mayBePeak(*this);
+  }
+  void subSize(std::size_t N) noexcept
+  {
+    assert(N <= Size);
+    Size -= N;
+    this->markAccess();
+    this->mayBeValley(*this);
+  }
+  void zeroSize() noexcept
+  {
+    Size = 0;
+    this->mayBeValley(*this);
   }
 
   /// \returns the pointer that points to the \p Ith logical element in the
   /// storage. The element at this location may or may not be valid!
   T* translateIndex(std::size_t I) const noexcept
   {
-    return physicalBegin() + (((Origin - physicalBegin()) + I) % Capacity);
+    return physicalBegin() + ((Origin + I) & mask());
+  }
+
+  /// Transfers \p N elements from \p Src to the uninitialised \p Dest, either
+  /// by moving or by copying them.
+  template <bool Move, typename SrcTy>
+  static void transfer(T* Dest, SrcTy* Src, std::size_t N)
+  {
+    if constexpr (TriviallyCopyable)
+    {
+      if (N)
+        std::memcpy(Dest, Src, N * sizeof(T));
+    }
+    else if constexpr (Move)
+      std::move(Src, Src + N, Dest);
+    else
+      std::copy(Src, Src + N, Dest);
+  }
+
+  /// Appends \p N elements from \p Src to the end of \p V, either by moving
+  /// or by copying them.
+  template <bool Move>
+  static void transfer(std::vector<T>& V, T* Src, std::size_t N)
+  {
+    if constexpr (Move && !TriviallyCopyable)
+      V.insert(V.end(),
+               std::make_move_iterator(Src),
+               std::make_move_iterator(Src + N));
+    else
+      V.insert(V.end(), Src, Src + N);
   }
 
-  /// Compacts the elements to the left side of the buffer, making the physical
-  /// begin and the logical begin start at the beginning of the array.
-  void rotateToPhysical()
+  template <bool Move, typename SrcTy>
+  void putBackImpl(SrcTy* Ptr, std::size_t N)
   {
-    T* B = physicalBegin();
-    T* E = physicalEnd();
-    std::rotate(B, Origin.get(), E);
-    Origin = B;
-    E = B + Size;
+    if (Size + N > Capacity)
+      grow(Size + N);
+
+    const std::size_t Tail = (Origin + Size) & mask();
+    const std::size_t UntilPhysicalEnd = std::min(N, Capacity - Tail);
+    transfer<Move>(physicalBegin() + Tail, Ptr, UntilPhysicalEnd);
+    transfer<Move>(
+      physicalBegin(), Ptr + UntilPhysicalEnd, N - UntilPhysicalEnd);
+
+    addSize(N);
+  }
+
+  template <bool Move> std::vector<T> copyFront(std::size_t N) const
+  {
+    if (N > Size)
+      N = Size;
+
+    std::vector<T> V;
+    V.reserve(N);
+
+    const std::size_t UntilPhysicalEnd = std::min(N, Capacity - Origin);
+    transfer<Move>(V, physicalBegin() + Origin, UntilPhysicalEnd);
+    transfer<Move>(V, physicalBegin(), N - UntilPhysicalEnd);
+
+    return V;
   }
 
   /// Grows the size of the buffer to allow for twice as many elements as
@@ -550,8 +573,6 @@ private:
   /// non-zero.
   void grow(std::size_t NewCapacityAtLeast = 0)
   {
-    rotateToPhysical();
-
     std::size_t NewCapacity = Capacity;
     if (NewCapacityAtLeast == 0 || NewCapacityAtLeast < Capacity)
       NewCapacity = Capacity * 2;
@@ -562,25 +583,29 @@ private:
     if (NewCapacity <= Capacity)
       return;
 
+    // Compact the elements to the beginning of the new storage, making the
+    // physical begin and the logical begin the same.
     StorageType New{new T[NewCapacity]};
-    for (std::size_t I = 0; I < Size; ++I)
-      New[I] = std::move(getStorage()[I]);
+    const std::size_t UntilPhysicalEnd = std::min(Size, Capacity - Origin);
+    transfer<true>(New.get(), physicalBegin() + Origin, UntilPhysicalEnd);
+    transfer<true>(
+      New.get() + UntilPhysicalEnd, physicalBegin(), Size - UntilPhysicalEnd);
 
     if (UsingGrowingStorage)
       std::swap(GrowingStorage, New);
     else
     {
-      std::fill(StorageWithOriginalCapacity.get(),
-                StorageWithOriginalCapacity.get() + originalCapacity(),
-                T{});
+      if constexpr (!std::is_trivially_destructible_v<T>)
+        std::fill(StorageWithOriginalCapacity.get(),
+                  StorageWithOriginalCapacity.get() + originalCapacity(),
+                  T{});
 
       GrowingStorage = std::move(New);
       UsingGrowingStorage = true;
     }
 
     Capacity = NewCapacity;
-    Origin = physicalBegin();
-    End = Origin + Size;
+    Origin = 0;
   }
 
   /// Shrinks the buffer to be able to store exactly \p NewCapacity elements.
@@ -592,7 +617,7 @@ private:
     if (Capacity == NewCapacity)
       return;
 
-    resetPeaks();
+    this->resetPeaks(*this);
     if (NewCapacity <= originalCapacity())
     {
       UsingGrowingStorage = false;
@@ -0,0 +1,278 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace monomux
+{
+
+/// A generation-tagged reference to an object stored in a \p SlabPool.
+///
+/// Unlike a raw pointer, a handle can be checked for staleness: once the
+/// referenced object is erased from the pool, the handle no longer resolves,
+/// even if the storage slot had been reused for another object since.
+///
+/// \tparam Tag An arbitrary compile-time value to make otherwise identical
+/// handles distinct types, e.g. to store them in an \p std::variant.
+template <typename T, std::size_t Tag = 0> class PoolHandle
+{
+public:
+  using IndexTy = std::uint32_t;
+  using GenerationTy = std::uint32_t;
+  static constexpr IndexTy InvalidIndex = std::numeric_limits<IndexTy>::max();
+
+  /// Creates a handle that does not refer to anything.
+  PoolHandle() noexcept = default;
+  PoolHandle(IndexTy Index, GenerationTy Generation) noexcept
+    : Index(Index), Generation(Generation)
+  {}
+  /// Converts a handle of the same object with a different \p Tag.
+  template <std::size_t OtherTag>
+  explicit PoolHandle(PoolHandle<T, OtherTag> Other) noexcept
+    : Index(Other.index()), Generation(Other.generation())
+  {}
+
+  /// Retrieve the raw tag value.
+  static constexpr std::size_t kind() noexcept { return Tag; }
+
+  IndexTy index() const noexcept { return Index; }
+  GenerationTy generation() const noexcept { return Generation; }
+  /// \returns whether the handle was made to refer to an object. This does
+  /// \b NOT mean that the object is still alive!
+  bool valid() const noexcept { return Index != InvalidIndex; }
+  explicit operator bool() const noexcept { return valid(); }
+
+  bool operator==(PoolHandle RHS) const noexcept
+  {
+    return Index == RHS.Index && Generation == RHS.Generation;
+  }
+  bool operator!=(PoolHandle RHS) const noexcept { return !(*this == RHS); }
+
+private:
+  IndexTy Index = InvalidIndex;
+  GenerationTy Generation = 0;
+};
+
+/// An object pool that stores instances of \p T in fixed-size slabs of
+/// \p SlabSize elements each. Slabs are never freed or moved while the pool is
+/// alive, so erasing and re-creating objects reuses already allocated memory
+/// instead of hitting the general-purpose allocator, and the address of a live
+/// object is stable.
+///
+/// Objects are referred to by generation-tagged \p PoolHandle instances. Every
+/// erase bumps the generation of the slot, invalidating all handles to the
+/// erased object.
+template <typename T, std::size_t SlabSize = 64> class SlabPool
+{
+  static_assert(SlabSize > 0, "Slabs must hold at least one element!");
+
+  struct Slot
+  {
+    // (Storage must be the first member so a T* can be converted back to the
+    // Slot* it lives in.)
+    alignas(T) unsigned char Storage[sizeof(T)];
+    std::uint32_t Index;
+    std::uint32_t Generation;
+    /// The next free slot in the free list, if the current slot is free.
+    std::uint32_t NextFree;
+    bool Alive;
+
+    T* object() noexcept { return std::launder(reinterpret_cast<T*>(Storage)); }
+    const T* object() const noexcept
+    {
+      return std::launder(reinterpret_cast<const T*>(Storage));
+    }
+  };
+
+public:
+  using Handle = PoolHandle<T>;
+
+  /// Statistical counters of the allocation behaviour of the pool.
+  struct Statistics
+  {
+    /// The number of objects currently alive in the pool.
+    std::size_t Alive;
+    /// The number of slots (alive or free) in the pool.
+    std::size_t Capacity;
+    /// The number of slabs allocated from the system.
+    std::size_t Slabs;
+    /// The number of objects created in the pool over its lifetime.
+    std::size_t Constructions;
+    /// The number of \p Constructions that reused the slot of an erased object.
+    std::size_t Reuses;
+  };
+
+  SlabPool() = default;
+  SlabPool(const SlabPool&) = delete;
+  SlabPool& operator=(const SlabPool&) = delete;
+  /// Takes over the slabs of \p RHS, which is left empty. Handles and
+  /// addresses of the objects remain valid, but refer to the new pool.
+  SlabPool(SlabPool&& RHS) noexcept
+    : Slabs(std::move(RHS.Slabs)), FreeHead(RHS.FreeHead), Stats(RHS.Stats)
+  {
+    RHS.reset();
+  }
+  SlabPool& operator=(SlabPool&& RHS) noexcept
+  {
+    if (this == &RHS)
+      return *this;
+    clear();
+    Slabs = std::move(RHS.Slabs);
+    FreeHead = RHS.FreeHead;
+    Stats = RHS.Stats;
+    RHS.reset();
+    return *this;
+  }
+  ~SlabPool() { clear(); }
+
+  /// \returns the number of objects alive in the pool.
+  std::size_t size() const noexcept { return Stats.Alive; }
+  bool empty() const noexcept { return Stats.Alive == 0; }
+  const Statistics& statistics() const noexcept { return Stats; }
+
+  /// Constructs a new \p T from \p Args in the pool.
+  ///
+  /// \returns the handle to the created object.
+  template <typename... Args> Handle emplace(Args&&... Arg)
+  {
+    if (FreeHead == Handle::InvalidIndex)
+      allocateSlab();
+    else
+      ++Stats.Reuses;
+
+    Slot& S = slot(FreeHead);
+    new (S.Storage) T(std::forward<Args>(Arg)...);
+    FreeHead = S.NextFree;
+    S.Alive = true;
+    ++Stats.Alive;
+    ++Stats.Constructions;
+    return Handle{S.Index, S.Generation};
+  }
+
+  /// \returns the object referred to by \p H, or \p nullptr if the handle is
+  /// stale or invalid.
+  template <std::size_t Tag> T* get(PoolHandle<T, Tag> H) noexcept
+  {
+    Slot* S = resolve(H.index(), H.generation());
+    return S ? S->object() : nullptr;
+  }
+  /// \returns the object referred to by \p H, or \p nullptr if the handle is
+  /// stale or invalid.
+  template <std::size_t Tag> const T* get(PoolHandle<T, Tag> H) const noexcept
+  {
+    return const_cast<SlabPool*>(this)->get(H);
+  }
+
+  /// \returns the handle for the \p Object, which must be alive in the current
+  /// pool.
+  Handle handleOf(const T& Object) const noexcept
+  {
+    const Slot* S = reinterpret_cast<const Slot*>(&Object);
+    assert(S->Alive && "Object is not alive in the pool!");
+    assert(&slot(S->Index) == S && "Object is not from this pool!");
+    return Handle{S->Index, S->Generation};
+  }
+
+  /// Destroys the object referred to by \p H. Stale handles are ignored.
+  template <std::size_t Tag> void erase(PoolHandle<T, Tag> H) noexcept
+  {
+    Slot* S = resolve(H.index(), H.generation());
+    if (!S)
+      return;
+
+    S->object()->~T();
+    S->Alive = false;
+    ++S->Generation;
+    S->NextFree = FreeHead;
+    FreeHead = S->Index;
+    --Stats.Alive;
+  }
+
+  /// Destroys the \p Object, which must be alive in the current pool.
+  void erase(T& Object) noexcept { erase(handleOf(Object)); }
+
+  /// Destroys every alive object in the pool. The slabs are kept allocated.
+  void clear() noexcept
+  {
+    for (std::size_t I = 0; I < Stats.Capacity; ++I)
+    {
+      Slot& S = slot(I);
+      if (S.Alive)
+        erase(Handle{S.Index, S.Generation});
+    }
+  }
+
+private:
+  std::vector<std::unique_ptr<Slot[]>> Slabs;
+  std::uint32_t FreeHead = Handle::InvalidIndex;
+  Statistics Stats{};
+
+  Slot& slot(std::size_t Index) noexcept
+  {
+    return Slabs[Index / SlabSize][Index % SlabSize];
+  }
+  const Slot& slot(std::size_t Index) const noexcept
+  {
+    return Slabs[Index / SlabSize][Index % SlabSize];
+  }
+
+  Slot* resolve(std::uint32_t Index, std::uint32_t Generation) noexcept
+  {
+    if (Index >= Stats.Capacity)
+      return nullptr;
+    Slot& S = slot(Index);
+    if (!S.Alive || S.Generation != Generation)
+      return nullptr;
+    return &S;
+  }
+
+  /// Forgets every slab, without destroying the objects in them.
+  void reset() noexcept
+  {
+    Slabs.clear();
+    FreeHead = Handle::InvalidIndex;
+    Stats = Statistics{};
+  }
+
+  void allocateSlab()
+  {
+    std::uint32_t Base = static_cast<std::uint32_t>(Stats.Capacity);
+    auto& Slab = Slabs.emplace_back(std::make_unique<Slot[]>(SlabSize));
+    // Chain the new slots into the free list in increasing order.
+    for (std::size_t I = 0; I < SlabSize; ++I)
+    {
+      Slot& S = Slab[I];
+      S.Index = Base + static_cast<std::uint32_t>(I);
+      S.Generation = 0;
+      S.Alive = false;
+      S.NextFree = I + 1 < SlabSize ? S.Index + 1 : FreeHead;
+    }
+    FreeHead = Base;
+    Stats.Capacity += SlabSize;
+    ++Stats.Slabs;
+  }
+};
+
+} // namespace monomux
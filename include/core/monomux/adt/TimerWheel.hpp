@@ -0,0 +1,392 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace monomux
+{
+
+/// A hierarchical timing wheel that keeps callbacks to be fired at a later
+/// time.
+///
+/// Time is measured in \e ticks of a fixed resolution. Every level of the
+/// wheel is an array of \p SlotCount slots, each containing a list of timers.
+/// A slot on level \p N spans \p SlotCount^N ticks, so a timer is put into the
+/// slot of the level where its deadline is at, and once the time reaches the
+/// slot, the timers in it are \e cascaded down to the lower levels.
+///
+///   \code
+///
+///     Level 2:  [ 0 | 4096 | 8192 | ... ]       (4096 ticks per slot)
+///     Level 1:  [ 0 |   64 |  128 | ... ]       (  64 ticks per slot)
+///     Level 0:  [ 0 |    1 |    2 | ... | 63 ]  (   1 tick  per slot)
+///
+///   \endcode
+///
+/// Arming and cancelling a timer are constant operations. Finding the next
+/// deadline and advancing the wheel depend only on the number of levels, not
+/// on the number of timers or the amount of time passed, so any number of
+/// timers cost nothing as long as none of them are due.
+///
+/// \note Timers do not fire early, but might fire up to one tick late.
+/// Deadlines beyond the range of the wheel are kept in the top level and
+/// re-sorted every time the top level turns.
+class TimerWheel
+{
+  using Tick = std::uint64_t;
+
+  static constexpr std::uint32_t Nil =
+    std::numeric_limits<std::uint32_t>::max();
+
+public:
+  using Clock = std::chrono::steady_clock;
+  using Callback = std::function<void()>;
+
+  /// The number of bits of a tick count a level of the wheel distinguishes.
+  static constexpr std::size_t SlotBits = 6;
+  /// The number of slots on a level of the wheel.
+  static constexpr std::size_t SlotCount = 1ULL << SlotBits;
+  /// The number of levels of the wheel. With the default of \p 4, deadlines
+  /// up to \p 2^24 ticks are sorted directly.
+  static constexpr std::size_t LevelCount = 4;
+
+  static_assert(SlotCount == 64,
+                "Slot occupancy is stored in, and rotated as, a 64-bit mask!");
+
+  /// Identifies an armed timer. The handle stays safe to use after the timer
+  /// fired or was cancelled, but it will not be \p isArmed() anymore.
+  class Timer
+  {
+    friend class TimerWheel;
+    std::uint32_t Index = Nil;
+    std::uint32_t Generation = 0;
+
+  public:
+    Timer() = default;
+  };
+
+  /// Creates an empty wheel that measures time in \p Resolution steps from
+  /// \p Origin.
+  explicit TimerWheel(std::chrono::milliseconds Resolution,
+                      Clock::time_point Origin = Clock::now())
+    : Resolution(Resolution), Origin(Origin)
+  {
+    if (Resolution.count() <= 0)
+      throw std::invalid_argument{"Timer resolution must be positive."};
+    for (auto& Level : Slots)
+      Level.fill(Nil);
+  }
+
+  /// \returns the number of armed timers.
+  std::size_t size() const noexcept { return Count; }
+  bool empty() const noexcept { return Count == 0; }
+
+  /// Arms a timer that calls \p CB once, in the first \p advance() that
+  /// reaches \p Deadline. Deadlines in the past fire at the next \p advance().
+  ///
+  /// \note \p CB is allowed to arm and cancel timers, but if it throws, the
+  /// exception propagates out of \p advance().
+  Timer arm(Clock::time_point Deadline, Callback CB)
+  {
+    Tick At = toTick(Deadline, /* RoundUp =*/true);
+    if (At < Current)
+      At = Current;
+
+    std::uint32_t I = FreeList;
+    if (I != Nil)
+      FreeList = Nodes[I].Next;
+    else
+    {
+      if (Nodes.size() >= Nil)
+        throw std::length_error{"Too many timers."};
+      Nodes.emplace_back();
+      I = static_cast<std::uint32_t>(Nodes.size() - 1);
+    }
+
+    Node& N = Nodes[I];
+    N.Deadline = At;
+    N.CB = std::move(CB);
+    link(I);
+    ++Count;
+
+    Timer T;
+    T.Index = I;
+    T.Generation = N.Generation;
+    return T;
+  }
+
+  /// Disarms the timer \p T, if it is still armed.
+  ///
+  /// \returns whether the timer was armed.
+  bool cancel(Timer& T) noexcept
+  {
+    if (!isArmed(T))
+      return false;
+    unlink(T.Index);
+    release(T.Index);
+    T = Timer{};
+    return true;
+  }
+
+  /// \returns whether \p T is still waiting to fire.
+  bool isArmed(const Timer& T) const noexcept
+  {
+    return T.Index < Nodes.size() && Nodes[T.Index].Level != Released &&
+           Nodes[T.Index].Generation == T.Generation;
+  }
+
+  /// \returns the time \p advance() has to be called at to make progress, or
+  /// nothing if no timers are armed. This is either the deadline of a timer,
+  /// or the time some timers have to be sorted further down the wheel.
+  std::optional<Clock::time_point> nextExpiry() const noexcept
+  {
+    std::optional<Tick> T = nextTick();
+    if (!T)
+      return std::nullopt;
+    return Origin + Resolution * static_cast<Clock::rep>(*T);
+  }
+
+  /// Fires the callbacks of every timer which deadline is not after \p Now,
+  /// in the order of their deadlines.
+  ///
+  /// \returns the number of timers fired.
+  std::size_t advance(Clock::time_point Now)
+  {
+    const Tick Target = toTick(Now, /* RoundUp =*/false);
+    std::size_t Fired = 0;
+    while (Count)
+    {
+      std::optional<Tick> Next = nextTick();
+      if (!Next || *Next > Target)
+        break;
+      Current = *Next;
+
+      // Sort the slots starting at this tick down the wheel, top-down, as a
+      // timer might move down more than one level.
+      for (std::size_t Level = LevelCount - 1; Level > 0; --Level)
+        if ((Current & (span(Level) - 1)) == 0)
+          cascade(Level, (Current >> (SlotBits * Level)) & (SlotCount - 1));
+
+      // Detach the due slot, so the timers armed by the callbacks are not
+      // put into the list being fired.
+      const std::size_t Slot = Current & (SlotCount - 1);
+      FiringList = Slots[0][Slot];
+      Slots[0][Slot] = Nil;
+      Occupied[0] &= ~(std::uint64_t{1} << Slot);
+      for (std::uint32_t I = FiringList; I != Nil; I = Nodes[I].Next)
+        Nodes[I].Level = Firing;
+      ++Current;
+
+      while (FiringList != Nil)
+      {
+        const std::uint32_t I = FiringList;
+        unlink(I);
+        Callback CB = std::move(Nodes[I].CB);
+        release(I);
+        ++Fired;
+
+        try
+        {
+          CB();
+        }
+        catch (...)
+        {
+          // Keep the remaining timers of the slot to fire later.
+          while (FiringList != Nil)
+          {
+            const std::uint32_t J = FiringList;
+            unlink(J);
+            Nodes[J].Deadline = Current;
+            link(J);
+          }
+          throw;
+        }
+      }
+    }
+
+    if (Current <= Target)
+      Current = Target + 1;
+    return Fired;
+  }
+
+private:
+  /// The pseudo-level of timers that are being fired by \p advance().
+  static constexpr std::uint8_t Firing = LevelCount;
+  /// The pseudo-level of unused nodes.
+  static constexpr std::uint8_t Released = LevelCount + 1;
+
+  struct Node
+  {
+    /// The tick the timer is due at.
+    Tick Deadline = 0;
+    std::uint32_t Prev = Nil;
+    std::uint32_t Next = Nil;
+    /// Incremented when the node is released, so stale \p Timer handles do
+    /// not match it.
+    std::uint32_t Generation = 0;
+    std::uint8_t Level = Released;
+    std::uint8_t Slot = 0;
+    Callback CB;
+  };
+
+  Clock::duration Resolution;
+  Clock::time_point Origin;
+  /// Every tick before this was already processed by \p advance().
+  Tick Current = 0;
+  /// The number of armed timers.
+  std::size_t Count = 0;
+
+  /// The storage of the timers. Unused nodes are chained via \p Next from
+  /// \p FreeList.
+  std::vector<Node> Nodes;
+  std::uint32_t FreeList = Nil;
+  /// The head of the list of timers in every slot.
+  std::array<std::array<std::uint32_t, SlotCount>, LevelCount> Slots;
+  /// The set of non-empty slots on every level.
+  std::array<std::uint64_t, LevelCount> Occupied{};
+  /// The head of the list of timers being fired by \p advance().
+  std::uint32_t FiringList = Nil;
+
+  /// \returns the number of ticks a slot on \p Level spans.
+  static constexpr Tick span(std::size_t Level) noexcept
+  {
+    return Tick{1} << (SlotBits * Level);
+  }
+
+  Tick toTick(Clock::time_point T, bool RoundUp) const noexcept
+  {
+    if (T <= Origin)
+      return 0;
+    const Clock::duration D = T - Origin;
+    Tick Ticks = D / Resolution;
+    if (RoundUp && D % Resolution != Clock::duration::zero())
+      ++Ticks;
+    return Ticks;
+  }
+
+  std::uint32_t& headOf(const Node& N) noexcept
+  {
+    if (N.Level == Firing)
+      return FiringList;
+    return Slots[N.Level][N.Slot];
+  }
+
+  /// Puts the node \p I into the slot of its deadline, relative to
+  /// \p Current.
+  void link(std::uint32_t I) noexcept
+  {
+    Node& N = Nodes[I];
+    const Tick Delta = N.Deadline - Current;
+    std::size_t Level = 0;
+    while (Level + 1 < LevelCount && Delta >= span(Level + 1))
+      ++Level;
+    // Deadlines beyond the top level are parked in its farthest slot.
+    const Tick Placement =
+      Delta < span(LevelCount) ? N.Deadline : Current + span(LevelCount) - 1;
+    const std::size_t Slot =
+      (Placement >> (SlotBits * Level)) & (SlotCount - 1);
+
+    N.Level = static_cast<std::uint8_t>(Level);
+    N.Slot = static_cast<std::uint8_t>(Slot);
+    N.Prev = Nil;
+    N.Next = Slots[Level][Slot];
+    if (N.Next != Nil)
+      Nodes[N.Next].Prev = I;
+    Slots[Level][Slot] = I;
+    Occupied[Level] |= std::uint64_t{1} << Slot;
+  }
+
+  void unlink(std::uint32_t I) noexcept
+  {
+    Node& N = Nodes[I];
+    std::uint32_t& Head = headOf(N);
+    if (N.Prev != Nil)
+      Nodes[N.Prev].Next = N.Next;
+    else
+      Head = N.Next;
+    if (N.Next != Nil)
+      Nodes[N.Next].Prev = N.Prev;
+    if (N.Level < LevelCount && Head == Nil)
+      Occupied[N.Level] &= ~(std::uint64_t{1} << N.Slot);
+    N.Prev = Nil;
+    N.Next = Nil;
+  }
+
+  void release(std::uint32_t I) noexcept
+  {
+    Node& N = Nodes[I];
+    N.Level = Released;
+    N.CB = nullptr;
+    ++N.Generation;
+    N.Next = FreeList;
+    FreeList = I;
+    --Count;
+  }
+
+  /// Moves the timers of \p Slot on \p Level down the wheel.
+  void cascade(std::size_t Level, std::size_t Slot) noexcept
+  {
+    std::uint32_t I = Slots[Level][Slot];
+    Slots[Level][Slot] = Nil;
+    Occupied[Level] &= ~(std::uint64_t{1} << Slot);
+    while (I != Nil)
+    {
+      const std::uint32_t Next = Nodes[I].Next;
+      link(I);
+      I = Next;
+    }
+  }
+
+  /// \returns the first tick not before \p Current where a timer fires or a
+  /// slot has to be cascaded.
+  std::optional<Tick> nextTick() const noexcept
+  {
+    if (!Count)
+      return std::nullopt;
+
+    std::optional<Tick> Best;
+    for (std::size_t Level = 0; Level < LevelCount; ++Level)
+    {
+      if (!Occupied[Level])
+        continue;
+
+      // The first slot of the level that starts not before Current. Every
+      // timer on the level is within SlotCount slots from it.
+      const Tick First = (Current + span(Level) - 1) >> (SlotBits * Level);
+      const std::size_t Start = First & (SlotCount - 1);
+      std::uint64_t Rotated = Occupied[Level];
+      if (Start)
+        Rotated = (Rotated >> Start) | (Rotated << (SlotCount - Start));
+      const Tick At = (First + __builtin_ctzll(Rotated))
+                      << (SlotBits * Level);
+      if (!Best || At < *Best)
+        Best = At;
+    }
+    return Best;
+  }
+};
+
+} // namespace monomux
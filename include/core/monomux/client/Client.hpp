@@ -30,6 +30,7 @@
 #include "monomux/adt/UniqueScalar.hpp"
 #include "monomux/system/Event.hpp"
 #include "monomux/system/Process.hpp"
+#include "monomux/system/SignalFD.hpp"
 #include "monomux/system/Socket.hpp"
 
 #include "SessionData.hpp"
@@ -120,6 +121,17 @@ public:
   /// disassociate.
   void setInputFile(raw_fd FD);
 
+  /// Sets whether \p SIGWINCH, \p SIGTERM and \p SIGHUP are received
+  /// synchronously by \p loop() through a \p SignalFD. If set, \p SIGTERM and
+  /// \p SIGHUP exit the loop, and every signal fires the \p SignalCallback.
+  ///
+  /// \note The signals are blocked while \p loop() is running, so the signal
+  /// handlers registered for them will not fire during that time.
+  void setSynchronousSignals(bool SynchronousSignals) noexcept
+  {
+    this->SynchronousSignals = SynchronousSignals;
+  }
+
   /// Perform a handshake mechanism over the control socket.
   ///
   /// A successful handshake initialises the client to be fully \e capable of
@@ -163,11 +175,53 @@ public:
   std::optional<std::string> requestMakeSession(std::string Name,
                                                 Process::SpawnOptions Opts);
 
+  /// Sends a request of creating several new sessions to the server in one
+  /// message, as if by calling \p requestMakeSession() for each element of
+  /// \p Sessions, in order.
+  ///
+  /// \returns The actual name of each session that was created successfully,
+  /// in the order of the request, or \p nullopt, if communication failed.
+  std::optional<std::vector<std::optional<std::string>>>
+  requestMakeSessionBatch(
+    std::vector<std::pair<std::string, Process::SpawnOptions>> Sessions);
+
+  /// Sends a request to the server to deliver \p Signal to the processes of
+  /// the sessions named \p SessionNames. The client need not be attached to
+  /// them.
+  ///
+  /// \returns Whether the signal was delivered to each session, in the order
+  /// of the request, or \p nullopt, if communication failed.
+  std::optional<std::vector<bool>>
+  requestSignalSessions(int Signal, std::vector<std::string> SessionNames);
+
+  /// Sends a request to the server to terminate the sessions named
+  /// \p SessionNames.
+  ///
+  /// \returns Whether each session was found and asked to terminate, in the
+  /// order of the request, or \p nullopt, if communication failed.
+  std::optional<std::vector<bool>>
+  requestDestroySessions(std::vector<std::string> SessionNames);
+
+  /// The position in the output stream of a session a client had received
+  /// the output until.
+  struct ResumePoint
+  {
+    /// The token identifying the output stream, as given by the server.
+    std::uint64_t Token;
+    /// The offset of the first byte not yet received.
+    std::uint64_t Offset;
+  };
+
   /// Sends a request to the server to attach the client to the session
   /// identified by \p SessionName.
   ///
+  /// \param Resume If given, the output of the session is only sent from this
+  /// point on, if the server still has it. Otherwise, the recent output is
+  /// replayed.
+  ///
   /// \return whether the attachment succeeded.
-  bool requestAttach(std::string SessionName);
+  bool requestAttach(std::string SessionName,
+                     std::optional<ResumePoint> Resume = std::nullopt);
 
   /// \returns whether the client successfully attached to a session on the
   /// server.
@@ -183,6 +237,15 @@ public:
     return AttachedSession ? &*AttachedSession : nullptr;
   }
 
+  /// \returns the point in the output stream of the attached session the
+  /// client had received the output until, which can be given to a later
+  /// \p requestAttach() of a new connection to resume from there.
+  std::optional<ResumePoint> resumePoint() const noexcept { return Stream; }
+
+  /// Reads at most \p Bytes of the output of the session from the \e data
+  /// connection, keeping track of the \p resumePoint().
+  std::string receiveData(std::size_t Bytes);
+
   /// Sends \p Data to the server over the \e data connection.
   void sendData(std::string_view Data);
 
@@ -216,6 +279,13 @@ public:
   /// internal event handling \p loop() is ready for such.
   void setExternalEventProcessor(std::function<RawCallbackFn> Callback);
 
+  using SignalCallbackFn = void(Client& Client, SignalFD::Signal SigNum);
+
+  /// Sets the handler that is fired when \p loop() receives a signal.
+  ///
+  /// \see setSynchronousSignals()
+  void setSignalCallback(std::function<SignalCallbackFn> Callback);
+
 private:
   /// The control socket is used to communicate control commands with the
   /// server.
@@ -234,6 +304,8 @@ private:
 
   /// Information about the session the client attached to.
   std::optional<SessionData> AttachedSession;
+  /// \see resumePoint()
+  std::optional<ResumePoint> Stream;
 
   /// A callback object that is fired when the client's event handling loop is
   /// "in the mood" for processing externalia.
@@ -243,6 +315,16 @@ private:
   std::function<RawCallbackFn> DataHandler;
   /// The callback object fired when data becomes available on \p InputFile.
   std::function<RawCallbackFn> InputHandler;
+  /// The callback object fired when a signal is received by \p Signals.
+  std::function<SignalCallbackFn> SignalHandler;
+
+  /// \see setSynchronousSignals()
+  UniqueScalar<bool, false> SynchronousSignals;
+  /// Receives the signals while \p loop() is running, if
+  /// \p SynchronousSignals is set.
+  std::unique_ptr<SignalFD> Signals;
+  /// Handles the signals pending on \p Signals.
+  void signalCallback();
 
   /// Weak file handle for the stream that is considered the user-facing input
   /// of the client.
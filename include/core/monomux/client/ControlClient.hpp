@@ -17,6 +17,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #pragma once
+#include "monomux/control/Message.hpp"
+
 #include "Client.hpp"
 
 namespace monomux::client
@@ -57,6 +59,41 @@ public:
   /// and it did not produce a response that the client could understand.
   std::string requestStatistics();
 
+  /// Sends a request to the server to gather machine-readable metrics and
+  /// reply it back to this \p Client.
+  ///
+  /// \param Session If not empty, only the metrics of the named session and
+  /// the clients attached to it are requested.
+  ///
+  /// \throws std::runtime_error Thrown if communication with the server failed
+  /// and it did not produce a response that the client could understand.
+  monomux::message::response::Metrics requestMetrics(std::string Session);
+
+  /// Sends a request to the server to search the output retained for its
+  /// sessions, and reply the matches back to this \p Client.
+  ///
+  /// \throws std::runtime_error Thrown if communication with the server failed
+  /// and it did not produce a response that the client could understand.
+  monomux::message::response::Search
+  requestSearch(monomux::message::request::Search Request);
+
+  /// Sends a request to the server to dump its flight recorder and reply it
+  /// back to this \p Client.
+  ///
+  /// \returns the binary trace, decodable by \p trace::decode().
+  ///
+  /// \throws std::runtime_error Thrown if communication with the server failed
+  /// and it did not produce a response that the client could understand.
+  std::string requestTrace();
+
+  /// Sends a request to the server to report, and optionally change, the
+  /// severity limits of its log facilities.
+  ///
+  /// \throws std::runtime_error Thrown if communication with the server failed
+  /// and it did not produce a response that the client could understand.
+  monomux::message::response::LogLevel
+  requestLogLevel(monomux::message::request::LogLevel Request);
+
 private:
   Client& BackingClient;
 
@@ -103,6 +103,126 @@ struct Boolean
   bool Value{};
 };
 
+/// A snapshot of the fill state of a connection buffer.
+///
+/// \see BufferedChannel::BufferStatistics
+struct BufferMetrics
+{
+  MONOMUX_MESSAGE_BASE(BufferMetrics);
+
+  std::size_t Size{};
+  std::size_t Capacity{};
+  std::size_t Peak{};
+};
+
+/// The contents of a latency histogram, in nanoseconds.
+///
+/// \see LatencyHistogram
+struct LatencyMetrics
+{
+  MONOMUX_MESSAGE_BASE(LatencyMetrics);
+
+  /// The number of values recorded.
+  std::uint64_t Count{};
+  /// The sum of the values recorded.
+  std::uint64_t Sum{};
+  /// The largest value recorded.
+  std::uint64_t Max{};
+  /// The non-empty buckets of the histogram, as pairs of the bucket's index
+  /// and the number of values in the bucket.
+  std::vector<std::pair<std::size_t, std::uint64_t>> Buckets;
+};
+
+/// Counters and gauges about a session running on the server.
+struct SessionMetrics
+{
+  MONOMUX_MESSAGE_BASE(SessionMetrics);
+
+  /// \see server::SessionData::Name.
+  std::string Name;
+  /// The number of bytes of output read from the session.
+  std::uint64_t BytesIn{};
+  /// The number of bytes of client input relayed into the session.
+  std::uint64_t BytesOut{};
+  /// The number of buffer overflows on the session's connections.
+  std::uint64_t Overflows{};
+  /// The number of clients attached to the session.
+  std::size_t AttachedClients{};
+  /// The buffer of the output read from the session.
+  BufferMetrics Reader;
+  /// The buffer of the input pending to be written into the session.
+  BufferMetrics Writer;
+  /// The time between the server waking up for the session's output and
+  /// handing it to every attached client.
+  LatencyMetrics ReadToSend;
+};
+
+/// Counters and gauges about a client connected to the server.
+struct ClientMetrics
+{
+  MONOMUX_MESSAGE_BASE(ClientMetrics);
+
+  /// \see ClientID::ID.
+  std::size_t ID{};
+  /// The name of the session the client is attached to, if any.
+  std::string Session;
+  /// The number of bytes the client sent on its data connection.
+  std::uint64_t BytesIn{};
+  /// The number of bytes of session output relayed to the client.
+  std::uint64_t BytesOut{};
+  /// The number of buffer overflows on the client's connections.
+  std::uint64_t Overflows{};
+  /// The read buffer of the client's data connection.
+  BufferMetrics DataRead;
+  /// The write buffer of the client's data connection, containing the session
+  /// output not yet delivered.
+  BufferMetrics DataWrite;
+  /// The time between the server waking up for session output and handing
+  /// it to the client.
+  LatencyMetrics ReadToSend;
+  /// The time data spent in \p DataWrite before being sent.
+  LatencyMetrics WriteQueue;
+};
+
+/// The result of an operation requested for one of the sessions of a batch.
+struct SessionResult
+{
+  MONOMUX_MESSAGE_BASE(SessionResult);
+
+  /// The name of the session the operation was done on.
+  std::string Name;
+  /// Whether the operation succeeded for the session.
+  Boolean Success;
+};
+
+/// An occurrence of a searched pattern in the retained output of a session.
+struct SearchMatch
+{
+  MONOMUX_MESSAGE_BASE(SearchMatch);
+
+  /// The name of the session the match was found in.
+  std::string Session;
+  /// The offset of the match in the output stream of the session.
+  std::uint64_t Offset{};
+  /// The lines of the output around the match.
+  std::string Context;
+  /// The position of the match in \p Context.
+  std::size_t Position{};
+};
+
+/// The logging configuration of a facility on the server.
+struct FacilityLevel
+{
+  MONOMUX_MESSAGE_BASE(FacilityLevel);
+
+  /// \see log::Facility::name().
+  std::string Name;
+  /// The severity limit of the facility, as a \p log::Severity.
+  int Level{};
+  /// Whether the limit was set explicitly for the facility.
+  bool Explicit{};
+};
+
 namespace request
 {
 
@@ -156,6 +276,13 @@ struct Attach
   MONOMUX_MESSAGE(AttachRequest, Attach);
   /// The name of the session to attach to.
   std::string Name;
+  /// If non-zero, the client was previously attached to the session, and
+  /// requests to resume receiving its output. This is the stream token the
+  /// client was given by \p response::Attach.
+  std::uint64_t ResumeToken = 0;
+  /// The offset of the first byte of the output the client did not receive.
+  /// Only meaningful if \p ResumeToken is set.
+  std::uint64_t ResumeOffset = 0;
 };
 
 /// A request from a client to the server to detach some clients from an ongoing
@@ -189,6 +316,82 @@ struct Statistics
   MONOMUX_MESSAGE(StatisticsRequest, Statistics);
 };
 
+/// A request from a client to the server to respond with machine-readable
+/// metrics.
+struct Metrics
+{
+  MONOMUX_MESSAGE(MetricsRequest, Metrics);
+  /// If not empty, only the session with this name and the clients attached to
+  /// it are reported.
+  std::string Session;
+};
+
+/// A request from a client to the server to respond with the binary dump of
+/// its flight recorder.
+struct Trace
+{
+  MONOMUX_MESSAGE(TraceRequest, Trace);
+};
+
+/// A request from a client to the server to report, and optionally change,
+/// the severity limits of the log facilities.
+struct LogLevel
+{
+  MONOMUX_MESSAGE(LogLevelRequest, LogLevel);
+  /// Whether to change a limit. Otherwise, the limits are only reported.
+  bool Change{};
+  /// The facility to change the limit of. If empty, the default limit, used
+  /// by every facility without an explicit limit, is changed.
+  std::string Facility;
+  /// The new limit, as a \p log::Severity, or \p -1 to make \p Facility follow
+  /// the default limit again.
+  int Level{};
+};
+
+/// A request from the client to the server to initialise several new sessions
+/// in one go. Each element is handled as if it was sent as a
+/// \p request::MakeSession, in order.
+struct MakeSessionBatch
+{
+  MONOMUX_MESSAGE(MakeSessionBatchRequest, MakeSessionBatch);
+  std::vector<MakeSession> Sessions;
+};
+
+/// A request from the client to the server to deliver a process signal to
+/// each of the named sessions, irrespective of the client being attached to
+/// them.
+struct SignalSessionsBatch
+{
+  MONOMUX_MESSAGE(SignalSessionsBatchRequest, SignalSessionsBatch);
+  /// \see signal(7)
+  int SigNum{};
+  std::vector<std::string> Names;
+};
+
+/// A request from the client to the server to terminate each of the named
+/// sessions.
+struct DestroySessionsBatch
+{
+  MONOMUX_MESSAGE(DestroySessionsBatchRequest, DestroySessionsBatch);
+  std::vector<std::string> Names;
+};
+
+/// A request from the client to the server to find the occurrences of a
+/// literal pattern in the output retained for the sessions, without
+/// transferring the output itself.
+struct Search
+{
+  MONOMUX_MESSAGE(SearchRequest, Search);
+  /// The literal byte sequence to search for.
+  std::string Pattern;
+  /// If not empty, only the output of the named session is searched.
+  std::string Session;
+  /// The number of lines to report around the line of each match.
+  std::size_t Context{};
+  /// The maximum number of matches to report. \p 0 means the server's default.
+  std::size_t Limit{};
+};
+
 } // namespace request
 
 namespace response
@@ -239,6 +442,12 @@ struct Attach
   /// Information about the session the client attached to. Only meaningful if
   /// \p Success is \p true.
   SessionData Session;
+  /// The token identifying the output stream of the session, to be presented
+  /// in a later \p request::Attach to resume receiving it.
+  std::uint64_t StreamToken = 0;
+  /// The offset in the output stream of the first byte the server sends to
+  /// the client after the attach.
+  std::uint64_t Offset = 0;
 };
 
 /// The response to the \p request::Detach indicating receipt.
@@ -258,6 +467,98 @@ struct Statistics
   std::string Contents;
 };
 
+/// The response to the \p request::Metrics containing the counters and gauges
+/// of the server.
+struct Metrics
+{
+  MONOMUX_MESSAGE(MetricsResponse, Metrics);
+  /// The number of iterations the server's event loop made.
+  std::uint64_t LoopIterations{};
+  /// The number of clients the server kicked due to misbehaviour.
+  std::uint64_t ClientsKicked{};
+  /// The number of buffer overflows over all connections.
+  std::uint64_t Overflows{};
+  /// The number of clients connected, irrespective of the filter.
+  std::size_t ClientCount{};
+  /// The number of sessions running, irrespective of the filter.
+  std::size_t SessionCount{};
+  /// The number of buffers allocated for the channels of the server.
+  std::size_t ChannelBuffers{};
+  /// The number of bytes allocated for the buffers of the channels.
+  std::size_t ChannelBufferBytes{};
+  /// The number of released channel buffers kept for reuse.
+  std::size_t PooledBuffers{};
+  /// The number of bytes allocated for the released channel buffers.
+  std::size_t PooledBufferBytes{};
+  /// The time the server's event loop spent handling the events of an
+  /// iteration.
+  LatencyMetrics LoopIteration;
+
+  std::vector<SessionMetrics> Sessions;
+  std::vector<ClientMetrics> Clients;
+};
+
+/// The response to the \p request::Trace containing the flight recorder.
+struct Trace
+{
+  MONOMUX_MESSAGE(TraceResponse, Trace);
+  /// The binary trace, as created by \p trace::snapshot().
+  std::string Data;
+};
+
+/// The response to the \p request::LogLevel containing the log configuration
+/// of the server after the request was applied.
+struct LogLevel
+{
+  MONOMUX_MESSAGE(LogLevelResponse, LogLevel);
+  /// Whether the requested change was valid and applied.
+  bool Success{};
+  /// The default severity limit, as a \p log::Severity.
+  int DefaultLevel{};
+  std::vector<FacilityLevel> Facilities;
+};
+
+/// The response to the \p request::MakeSessionBatch, sent by the server.
+struct MakeSessionBatch
+{
+  MONOMUX_MESSAGE(MakeSessionBatchResponse, MakeSessionBatch);
+  /// The results for the requested sessions, in the order of the request.
+  /// The \p Name of a result \b MAY \b NOT be the same as the \e requested
+  /// one.
+  std::vector<SessionResult> Results;
+};
+
+/// The response to the \p request::SignalSessionsBatch, sent by the server.
+struct SignalSessionsBatch
+{
+  MONOMUX_MESSAGE(SignalSessionsBatchResponse, SignalSessionsBatch);
+  /// The results for the requested sessions, in the order of the request.
+  std::vector<SessionResult> Results;
+};
+
+/// The response to the \p request::DestroySessionsBatch, sent by the server.
+///
+/// \note A successful result means that the session was found and asked to
+/// terminate. The session is removed from the server once its process exited.
+struct DestroySessionsBatch
+{
+  MONOMUX_MESSAGE(DestroySessionsBatchResponse, DestroySessionsBatch);
+  /// The results for the requested sessions, in the order of the request.
+  std::vector<SessionResult> Results;
+};
+
+/// The response to the \p request::Search, sent by the server.
+struct Search
+{
+  MONOMUX_MESSAGE(SearchResponse, Search);
+  /// Whether the session requested to be searched exists.
+  monomux::message::Boolean Success;
+  /// The matches, ordered by session name, then offset.
+  std::vector<SearchMatch> Matches;
+  /// Whether there were more matches than the limit allowed to report.
+  Boolean Truncated;
+};
+
 } // namespace response
 
 namespace notification
@@ -318,6 +619,13 @@ struct Redraw
   unsigned short Columns{};
 };
 
+/// A message sent by the server on an otherwise idle control connection. It
+/// carries no information and is discarded by the client.
+struct Keepalive
+{
+  MONOMUX_MESSAGE(KeepaliveNotification, Keepalive);
+};
+
 } // namespace notification
 
 } // namespace monomux::message
@@ -92,6 +92,51 @@ enum class MessageKind : std::uint16_t
   StatisticsRequest,
   /// A response to the \p StatisticsRequest.
   StatisticsResponse,
+
+  /// A request to the server to respond with machine-readable counters and
+  /// gauges about the execution.
+  MetricsRequest,
+  /// A response to the \p MetricsRequest.
+  MetricsResponse,
+
+  /// A request to the server to respond with the contents of its flight
+  /// recorder.
+  TraceRequest,
+  /// A response to the \p TraceRequest.
+  TraceResponse,
+
+  /// A request to the server to report, and optionally change, the severity
+  /// limits of its logging.
+  LogLevelRequest,
+  /// A response to the \p LogLevelRequest.
+  LogLevelResponse,
+
+  /// A notification sent by the server to a client whose connection has been
+  /// quiet for a while, to keep the connection alive and detect dead peers.
+  KeepaliveNotification,
+
+  /// A request to the server to create several new sessions at once.
+  MakeSessionBatchRequest,
+  /// A response to the \p MakeSessionBatchRequest containing the results for
+  /// each of the requested sessions.
+  MakeSessionBatchResponse,
+
+  /// A request to the server to send a \p signal to several sessions.
+  SignalSessionsBatchRequest,
+  /// A response to the \p SignalSessionsBatchRequest containing the results
+  /// for each of the requested sessions.
+  SignalSessionsBatchResponse,
+
+  /// A request to the server to terminate several sessions.
+  DestroySessionsBatchRequest,
+  /// A response to the \p DestroySessionsBatchRequest containing the results
+  /// for each of the requested sessions.
+  DestroySessionsBatchResponse,
+
+  /// A request to the server to search the retained output of the sessions.
+  SearchRequest,
+  /// A response to the \p SearchRequest containing the matches found.
+  SearchResponse,
 };
 
 /// Helper class that contains the parsed \p MessageKind of a \p Message, and
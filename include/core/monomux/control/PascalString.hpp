@@ -43,10 +43,17 @@ std::string readPascalString(BufferedChannel& Channel);
 ///
 /// \note This operation \b MAY block. If the message fails to read, or the
 /// message is not the \e expected type, the message \b MAY be dropped and lost.
+/// Keepalive notifications are skipped over.
 template <typename T> std::optional<T> receiveMessage(BufferedChannel& Channel)
 {
-  std::string Data = readPascalString(Channel);
-  Message MsgBase = Message::unpack(Data);
+  std::string Data;
+  Message MsgBase;
+  do
+  {
+    Data = readPascalString(Channel);
+    MsgBase = Message::unpack(Data);
+  } while (T::Kind != MessageKind::KeepaliveNotification &&
+           MsgBase.Kind == MessageKind::KeepaliveNotification);
   if (MsgBase.Kind != T::Kind)
     return std::nullopt;
 
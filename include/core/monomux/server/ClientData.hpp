@@ -18,12 +18,15 @@
  */
 #pragma once
 #include <chrono>
-#include <memory>
 #include <optional>
 
+#include "monomux/adt/Histogram.hpp"
+#include "monomux/adt/TimerWheel.hpp"
 #include "monomux/control/Message.hpp"
 #include "monomux/system/Socket.hpp"
 
+#include "Metrics.hpp"
+
 namespace monomux::server
 {
 
@@ -33,7 +36,7 @@ class SessionData;
 class ClientData
 {
 public:
-  ClientData(std::unique_ptr<Socket> Connection);
+  ClientData(Socket&& Connection);
 
   std::size_t id() const noexcept { return ID; }
   /// Returns the most recent random-generated nonce for this client, and
@@ -54,8 +57,37 @@ public:
   }
   void activity() noexcept { LastActivity = std::chrono::system_clock::now(); }
 
+  /// \returns the counters of the data the client sent (\p BytesIn) and the
+  /// session output relayed to it (\p BytesOut).
+  TrafficCounters& traffic() noexcept { return Traffic; }
+  const TrafficCounters& traffic() const noexcept { return Traffic; }
+
+  /// \returns the distribution of the time, in nanoseconds, between the server
+  /// waking up for session output and handing the output to this client.
+  LatencyHistogram& readToSendLatency() noexcept { return ReadToSend; }
+  const LatencyHistogram& readToSendLatency() const noexcept
+  {
+    return ReadToSend;
+  }
+  /// \returns the distribution of the time, in nanoseconds, data spent in the
+  /// write buffer of the data connection before being sent to the client.
+  LatencyHistogram& writeQueueLatency() noexcept { return WriteQueue; }
+  const LatencyHistogram& writeQueueLatency() const noexcept
+  {
+    return WriteQueue;
+  }
+
+  /// \returns the timer that fires when the client might have become idle.
+  TimerWheel::Timer& idleTimer() noexcept { return IdleTimer; }
+  /// \returns the timer that retries flushing the connections of the client
+  /// after the client did not read the previously sent data.
+  TimerWheel::Timer& flushTimer() noexcept { return FlushTimer; }
+
   Socket& getControlSocket() noexcept { return *ControlConnection; }
-  Socket* getDataSocket() noexcept { return DataConnection.get(); }
+  Socket* getDataSocket() noexcept
+  {
+    return DataConnection ? &*DataConnection : nullptr;
+  }
 
   /// Releases the control socket of the other client and associates it as the
   /// data connection of the current client.
@@ -88,12 +120,22 @@ private:
   std::chrono::time_point<std::chrono::system_clock> Created;
   /// The timestamp when the client was most recently trasmitting \b data.
   std::chrono::time_point<std::chrono::system_clock> LastActivity;
+  TrafficCounters Traffic;
+  LatencyHistogram ReadToSend;
+  /// Fed by the data connection. As the connection refers to this member,
+  /// the \p ClientData must not be moved after a data connection is set.
+  LatencyHistogram WriteQueue;
+  TimerWheel::Timer IdleTimer;
+  TimerWheel::Timer FlushTimer;
 
   /// The control connection transcieves control information and commands.
-  std::unique_ptr<Socket> ControlConnection;
+  ///
+  /// \note The connections are stored in-place so they share the allocation
+  /// of the owning \p ClientData.
+  std::optional<Socket> ControlConnection;
 
   /// The data connection transcieves the actual program data.
-  std::unique_ptr<Socket> DataConnection;
+  std::optional<Socket> DataConnection;
 
   /// \e If the client is attached to a session, points to the data record of
   /// the session.
@@ -8,13 +8,20 @@ DISPATCH(DataSocketRequest, requestDataSocket)
 
 DISPATCH(SessionListRequest, requestSessionList)
 DISPATCH(MakeSessionRequest, requestMakeSession)
+DISPATCH(MakeSessionBatchRequest, requestMakeSessionBatch)
 DISPATCH(AttachRequest, requestAttach)
 DISPATCH(DetachRequest, requestDetach)
 
 DISPATCH(SignalRequest, signalSession)
+DISPATCH(SignalSessionsBatchRequest, signalSessionsBatch)
+DISPATCH(DestroySessionsBatchRequest, destroySessionsBatch)
 
 DISPATCH(RedrawNotification, redrawNotified)
 
 DISPATCH(StatisticsRequest, statisticsRequest)
+DISPATCH(MetricsRequest, metricsRequest)
+DISPATCH(SearchRequest, searchRequest)
+DISPATCH(TraceRequest, traceRequest)
+DISPATCH(LogLevelRequest, logLevelRequest)
 
 #undef DISPATCH
@@ -0,0 +1,37 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstdint>
+
+namespace monomux::server
+{
+
+/// Counters about the data relayed through a client or a session, exposed in
+/// the machine-readable metrics of the \p Server.
+struct TrafficCounters
+{
+  /// The number of bytes received from the entity.
+  std::uint64_t BytesIn{};
+  /// The number of bytes sent to the entity.
+  std::uint64_t BytesOut{};
+  /// The number of times a buffer of the entity's connection overflowed.
+  std::uint64_t Overflows{};
+};
+
+} // namespace monomux::server
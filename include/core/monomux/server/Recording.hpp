@@ -0,0 +1,216 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace monomux::server
+{
+
+namespace detail
+{
+
+/// An open file of a recording, shared with the background thread while it is
+/// being forced to the disk.
+struct RecordingFile;
+
+} // namespace detail
+
+/// Records the output of a session into an append-only log on disk, for later
+/// auditing with \p RecordingReader.
+///
+/// A recording is a sequence of \e segments, \p PREFIX.0.rec, \p PREFIX.1.rec,
+/// and so on, a new one started when the previous reached the size limit.
+/// Every segment starts with a magic string and the time the segment started,
+/// followed by records of
+///
+///   \code
+///
+///     [ delta time (varint) | length (varint) | bytes... ]
+///
+///   \endcode
+///
+/// where the time is in microseconds since the previous record, or the start of
+/// the segment, and the numbers are LEB128 encoded. Alongside every segment,
+/// \p PREFIX.N.idx contains a (time, offset) pair for every \p IndexSpacing
+/// bytes or \p IndexInterval time recorded, which allows a reader to seek to a
+/// point in time without decoding the segment from its start.
+///
+/// Records are collected in memory and written in batches, either when
+/// \p FlushSize is reached or the owner calls \p sync() periodically, which
+/// also has a background thread force the data to the disk, so the caller
+/// does not wait for the device. If the process crashes, the records not yet
+/// written are lost, but the files stay readable.
+class Recorder
+{
+public:
+  using Clock = std::chrono::system_clock;
+
+  /// The size after which a new segment is started.
+  static constexpr std::size_t SegmentSize = 64ULL << 20;
+  /// The number of bytes after which a new index entry is written.
+  static constexpr std::size_t IndexSpacing = 64ULL << 10;
+  /// The time after which a new index entry is written.
+  static constexpr std::chrono::seconds IndexInterval{10};
+  /// The number of bytes pending in memory that are written without waiting
+  /// for the next \p sync().
+  static constexpr std::size_t FlushSize = 64ULL << 10;
+  /// The interval at which the owner is expected to call \p sync().
+  static constexpr std::chrono::seconds SyncInterval{1};
+
+  /// Starts a new recording in \p Directory for the session \p Name, with its
+  /// first segment starting at \p Now.
+  ///
+  /// \param SegmentLimit The size after which a new segment is started.
+  ///
+  /// \throws std::system_error if the files could not be created.
+  Recorder(const std::string& Directory,
+           const std::string& Name,
+           Clock::time_point Now = Clock::now(),
+           std::size_t SegmentLimit = SegmentSize);
+  Recorder(const Recorder&) = delete;
+  Recorder(Recorder&&) = delete;
+  Recorder& operator=(const Recorder&) = delete;
+  Recorder& operator=(Recorder&&) = delete;
+  /// Writes the pending records to the disk.
+  ~Recorder() noexcept;
+
+  /// \returns the common path prefix of the files of the recording.
+  const std::string& prefix() const noexcept { return Prefix; }
+  /// \returns the number of bytes of output recorded.
+  std::uint64_t bytesRecorded() const noexcept { return Recorded; }
+  /// \returns the number of segments started.
+  std::size_t segmentCount() const noexcept { return Segment + 1; }
+
+  /// Records \p Data as output at \p Now.
+  ///
+  /// \throws std::system_error if writing the files failed.
+  void append(std::string_view Data, Clock::time_point Now = Clock::now());
+
+  /// Writes the pending records to the files, without waiting for them to
+  /// reach the disk.
+  ///
+  /// \throws std::system_error if writing the files failed.
+  void flush();
+
+  /// Writes the pending records, and requests everything written since the
+  /// previous call to be forced to the disk by a background thread.
+  ///
+  /// \throws std::system_error if writing the files failed, or forcing the
+  /// previously written data to the disk did.
+  void sync();
+
+private:
+  std::string Prefix;
+  std::size_t SegmentLimit;
+  std::size_t Segment = 0;
+  std::shared_ptr<detail::RecordingFile> Data;
+  std::shared_ptr<detail::RecordingFile> Index;
+  /// The records and index entries not yet written.
+  std::string PendingData;
+  std::string PendingIndex;
+  /// Whether data was written since the last \p sync() requested the files
+  /// to be forced to the disk.
+  bool Unsynced = false;
+  std::uint64_t Recorded = 0;
+
+  /// The size of the current segment, including \p PendingData.
+  std::uint64_t SegmentBytes = 0;
+  /// The time of the last record, in microseconds since the epoch.
+  std::uint64_t LastTime = 0;
+  /// The position of the last index entry of the segment.
+  std::uint64_t IndexedBytes = 0;
+  std::uint64_t IndexedTime = 0;
+
+  /// Finishes the current segment, if any, and starts segment \p N at the
+  /// time \p Now, in microseconds.
+  void openSegment(std::size_t N, std::uint64_t Now);
+};
+
+/// Reads a recording made by \p Recorder.
+class RecordingReader
+{
+public:
+  using Clock = Recorder::Clock;
+
+  struct Record
+  {
+    Clock::time_point Time;
+    std::string Data;
+  };
+
+  /// Opens the recording with \p Path, which is either the prefix of the
+  /// files of the recording, or any of the segment files.
+  ///
+  /// \param FailureReason If given, after an unsuccessful open, a
+  /// human-readable reason for the failure will be written to.
+  static std::optional<RecordingReader> open(std::string_view Path,
+                                             std::string* FailureReason);
+
+  const std::string& prefix() const noexcept { return Prefix; }
+  std::size_t segmentCount() const noexcept { return Segments.size(); }
+  /// \returns the time the recording started.
+  Clock::time_point begin() const noexcept;
+
+  /// Positions the reader to the first record at or after \p Time, using the
+  /// index to only decode the records close to it.
+  void seek(Clock::time_point Time);
+
+  /// \returns the next record, or \p nullopt if the end of the recording is
+  /// reached.
+  std::optional<Record> next();
+
+private:
+  struct Segment
+  {
+    std::string Path;
+    /// The start time of the segment, in microseconds since the epoch.
+    std::uint64_t Begin;
+  };
+
+  RecordingReader() = default;
+
+  std::string Prefix;
+  std::vector<Segment> Segments;
+  std::size_t Current = 0;
+  std::ifstream File;
+  /// The time of the last record read, in microseconds since the epoch.
+  std::uint64_t Time = 0;
+  /// Records before this time are skipped after a \p seek().
+  std::uint64_t SkipUntil = 0;
+
+  /// Opens segment \p N to be read from the record at \p Offset, which
+  /// follows a record at \p Time, or from the start of the segment if not
+  /// given.
+  ///
+  /// \returns whether the segment was readable.
+  bool openSegment(std::size_t N,
+                   std::optional<std::pair<std::uint64_t, std::uint64_t>>
+                     TimeAndOffset = std::nullopt);
+};
+
+} // namespace monomux::server
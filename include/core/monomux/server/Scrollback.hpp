@@ -0,0 +1,134 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "monomux/system/MagicRingBuffer.hpp"
+
+#include "SearchIndex.hpp"
+
+namespace monomux::server
+{
+
+/// The most recent output of a session, kept by the server so that it can be
+/// replayed to a client when it attaches, instead of the client seeing nothing
+/// until the session prints again.
+///
+/// The output is stored in a bounded \p MagicRingBuffer: the oldest bytes are
+/// discarded when the limit is reached, and the retained bytes are always one
+/// contiguous view, which is written to the client at once. The storage is
+/// only allocated when the first output arrives.
+///
+/// Every byte of the output has an \e offset: the number of bytes the session
+/// had output before it. Offsets increase monotonically over the lifetime of
+/// the session, irrespective of discarding, which allows a client to resume
+/// receiving the output from the point it stopped at, as long as that point is
+/// still retained.
+///
+/// The retained output is indexed by a \p SearchIndex, so it can be searched
+/// without scanning all of it.
+class Scrollback
+{
+public:
+  /// Creates a scrollback retaining at most \p Limit bytes. If \p 0, nothing
+  /// is retained.
+  explicit Scrollback(std::size_t Limit = 0) noexcept : Limit(Limit) {}
+
+  std::size_t limit() const noexcept { return Limit; }
+  /// Sets the number of bytes retained to \p Limit, discarding the contents.
+  void setLimit(std::size_t Limit);
+
+  /// \returns the number of bytes retained.
+  std::size_t size() const noexcept { return Buffer ? Buffer->size() : 0; }
+  bool empty() const noexcept { return size() == 0; }
+  /// \returns the number of bytes allocated for the storage.
+  std::size_t memory() const noexcept
+  {
+    return Buffer ? Buffer->capacity() : 0;
+  }
+  /// \returns the number of bytes the search index of the retained output
+  /// takes.
+  std::size_t indexMemory() const noexcept { return Index.memory(); }
+  /// \returns whether output was discarded because the limit was reached.
+  bool truncated() const noexcept { return Truncated; }
+
+  /// \returns the offset of the oldest byte retained.
+  std::uint64_t begin() const noexcept { return End - size(); }
+  /// \returns the offset the next byte appended will have, i.e. the number of
+  /// bytes appended in total.
+  std::uint64_t end() const noexcept { return End; }
+
+  /// Appends \p Data to the retained output, discarding the oldest bytes that
+  /// do not fit.
+  void append(std::string_view Data);
+
+  /// \returns a view of the retained output. The view is invalidated by any
+  /// modifying operation.
+  std::string_view contents() const noexcept
+  {
+    return Buffer ? Buffer->peek() : std::string_view{};
+  }
+
+  /// \returns the part of \p contents() to replay to a client. If output was
+  /// discarded, the first, partially retained line is skipped, so that the
+  /// client is not sent the tail of a line or of an escape sequence.
+  std::string_view replay() const noexcept;
+
+  /// \returns the offset from which the output is sent to a client that
+  /// attaches. This is \p Resume, if given and the output since is retained,
+  /// or the beginning of \p replay() otherwise.
+  std::uint64_t replayFrom(std::optional<std::uint64_t> Resume) const noexcept;
+
+  /// \returns a view of the retained output since \p Offset, which must be
+  /// between \p begin() and \p end(). The view is invalidated by any
+  /// modifying operation.
+  std::string_view since(std::uint64_t Offset) const noexcept
+  {
+    return contents().substr(Offset - begin());
+  }
+
+  /// \returns the offsets of at most \p MaxMatches occurrences of \p Pattern in
+  /// the retained output, in ascending order.
+  std::vector<std::uint64_t> find(std::string_view Pattern,
+                                  std::size_t MaxMatches) const;
+
+  /// \returns a view of the line of the retained output that contains
+  /// \p Offset, extended with at most \p Context lines before and after, but
+  /// no longer than \p MaxBytes around \p Offset. The view is invalidated by
+  /// any modifying operation.
+  std::string_view
+  lines(std::uint64_t Offset, std::size_t Context, std::size_t MaxBytes) const;
+
+  /// Discards the retained output and releases the storage. Offsets keep
+  /// increasing from \p end().
+  void clear() noexcept;
+
+private:
+  std::size_t Limit;
+  bool Truncated = false;
+  std::uint64_t End = 0;
+  std::optional<MagicRingBuffer> Buffer;
+  SearchIndex Index;
+};
+
+} // namespace monomux::server
@@ -0,0 +1,90 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace monomux::server
+{
+
+/// A sparse trigram index over a stream of output, used to find the parts of
+/// the retained output of a session that might contain a pattern without
+/// scanning all of it.
+///
+/// The stream is split into blocks of \p BlockSize bytes by offset, and every
+/// block has a Bloom filter of the trigrams (sequences of 3 bytes) that start
+/// in it. A pattern can only start in a block if its first trigram is in the
+/// filter of the block, and each of the others is in the filter of the block
+/// or the next one, so the other blocks are skipped.
+/// The filters take an eighth of the size of the output they cover, and are
+/// dropped when that output is discarded.
+class SearchIndex
+{
+public:
+  /// The number of bytes of output covered by a filter.
+  static constexpr std::size_t BlockSize = 4096;
+  /// The number of bits in a filter.
+  static constexpr std::size_t FilterBits = 4096;
+
+  /// Adds \p Data, which is the output at \p Offset onwards, to the index. If
+  /// the output is not contiguous with the previously added, the index is
+  /// cleared first.
+  void append(std::uint64_t Offset, std::string_view Data);
+
+  /// Drops the filters that only cover output before \p Offset.
+  void discardBefore(std::uint64_t Offset);
+
+  /// Drops every filter.
+  void clear() noexcept;
+
+  /// \returns the number of bytes the filters take.
+  std::size_t memory() const noexcept { return Blocks.size() * sizeof(Block); }
+
+  /// \returns the ascending, disjoint ranges of offsets, as <tt>[begin,
+  /// end)</tt> pairs, at which \p Pattern might start. Matches starting in a
+  /// range might extend past it.
+  std::vector<std::pair<std::uint64_t, std::uint64_t>>
+  candidates(std::string_view Pattern) const;
+
+private:
+  using Filter = std::array<std::uint64_t, FilterBits / 64>;
+  struct Block
+  {
+    std::uint64_t Begin;
+    Filter Trigrams;
+  };
+
+  /// The blocks of the indexed output, contiguous and in order.
+  std::deque<Block> Blocks;
+  /// The offset after the last byte indexed.
+  std::uint64_t End = 0;
+  /// The last bytes indexed, from which the next trigram is formed.
+  std::uint32_t Window = 0;
+  std::size_t WindowSize = 0;
+
+  static void insert(Filter& F, std::uint32_t Trigram) noexcept;
+  static bool contains(const Filter& F, std::uint32_t Trigram) noexcept;
+};
+
+} // namespace monomux::server
@@ -23,16 +23,25 @@
 #include <map>
 #include <memory>
 #include <optional>
+#include <queue>
+#include <string_view>
+#include <unordered_map>
 #include <variant>
+#include <vector>
 
 #include "monomux/adt/Atomic.hpp"
-#include "monomux/adt/SmallIndexMap.hpp"
-#include "monomux/adt/Tagged.hpp"
+#include "monomux/adt/Histogram.hpp"
+#include "monomux/adt/PagedIndexMap.hpp"
+#include "monomux/adt/SlabPool.hpp"
+#include "monomux/adt/TimerWheel.hpp"
 #include "monomux/system/Event.hpp"
 #include "monomux/system/Process.hpp"
+#include "monomux/system/SignalFD.hpp"
 #include "monomux/system/Socket.hpp"
 #include "monomux/system/fd.hpp"
 
+#include "SessionPool.hpp"
+
 #include "ClientData.hpp"
 #include "SessionData.hpp"
 
@@ -73,6 +82,47 @@ public:
                                ClientData& Client,
                                std::string_view RawMessage);
 
+  /// The default size of the queue of pending connections on the server
+  /// socket.
+  ///
+  /// \see setListenQueue()
+  static constexpr std::size_t ListenQueue = 16;
+  /// The number of pending connections \p loop() accepts at most when the
+  /// server socket is ready, before handling the other events.
+  static constexpr std::size_t AcceptBurst = 64;
+  /// The time the server stops accepting connections for, when it ran out of
+  /// file descriptors and could not reject the pending ones either.
+  static constexpr std::chrono::milliseconds AcceptRetryDelay{100};
+
+  /// The time after which a client that did not send data is sent a keepalive
+  /// message on its control connection.
+  static constexpr std::chrono::seconds KeepaliveInterval{60};
+  /// The time after which a client that did not establish a data connection
+  /// and did not send data is disconnected.
+  static constexpr std::chrono::hours ClientIdleTimeout{1};
+  /// The time after which a session that did not produce output is reported
+  /// inactive.
+  static constexpr std::chrono::minutes SessionInactivityTime{10};
+  /// The delay after which flushing a connection that did not accept any of
+  /// the pending data is retried.
+  static constexpr std::chrono::milliseconds FlushRetryDelay{20};
+  /// The default number of bytes of the recent output of each session that
+  /// is replayed to a client when it attaches.
+  ///
+  /// \see setScrollbackSize()
+  static constexpr std::size_t ScrollbackSize = 1ULL << 16; // 64 KiB
+  /// The time after which a session that was hung up by \p hangupSession()
+  /// but did not exit is killed.
+  static constexpr std::chrono::seconds HangupGracePeriod{5};
+  /// The number of matches reported for a search if the client did not ask
+  /// for a limit.
+  static constexpr std::size_t SearchMatchLimit = 100;
+  /// The most matches reported for a search, irrespective of the limit the
+  /// client asked for.
+  static constexpr std::size_t SearchMatchLimitMax = 10000;
+  /// The most bytes of context reported around a match.
+  static constexpr std::size_t SearchContextBytes = 1ULL << 10; // 1 KiB
+
   /// Create a new server that will listen on the associated socket.
   Server(Socket&& Sock);
 
@@ -93,7 +143,50 @@ public:
   /// session running under it terminated.
   void setExitIfNoMoreSessions(bool ExitIfNoMoreSessions);
 
-  /// Start actively listening and handling connections.
+  /// Sets the number of bytes the buffers of all connections of the server
+  /// may take together. If \p 0, the buffers are not limited beyond the
+  /// per-connection maximum.
+  ///
+  /// \see enforceBufferBudget()
+  void setMaxBufferMemory(std::size_t Bytes);
+
+  /// Sets the number of idle sessions kept spawned ahead of time for each
+  /// profile (program, arguments and environment) that sessions were recently
+  /// created with, which a new session of the same profile adopts, instead of
+  /// waiting for its program to start. If \p 0, no sessions are kept.
+  ///
+  /// \see SessionPool
+  void setWarmSessions(std::size_t PerProfile);
+
+  /// Sets the number of bytes of the recent output of each session created
+  /// from now on that is kept, and replayed to a client when it attaches.
+  /// If \p 0, no output is kept.
+  ///
+  /// \see Scrollback
+  void setScrollbackSize(std::size_t Bytes);
+
+  /// Sets the server to record the output of every session created from now
+  /// on into files in \p Directory.
+  ///
+  /// \see Recorder
+  void setRecordingDirectory(std::string Directory);
+
+  /// Sets the size of the queue of pending connections that \p loop() starts
+  /// \p listen()ing with, if the server's socket is not \p listening() yet.
+  void setListenQueue(std::size_t QueueSize);
+
+  /// Sets whether \p SIGCHLD, \p SIGTERM, \p SIGHUP and \p SIGINT are
+  /// received synchronously by \p loop() through a \p SignalFD. If set, the
+  /// termination signals \p interrupt() the loop, and the exit of children is
+  /// handled as if \p registerDeadChild() was called, without the need of
+  /// installing signal handlers.
+  ///
+  /// \note The signals are blocked while \p loop() is running, so the signal
+  /// handlers registered for them will not fire during that time.
+  void setSynchronousSignals(bool SynchronousSignals);
+
+  /// Start actively listening and handling connections. If the server's socket
+  /// is not \p listening() yet, \p listen() is called on it.
   ///
   /// \note This is a blocking call!
   void loop();
@@ -115,69 +208,258 @@ private:
     CT_None = 0,
     CT_ClientControl = 1,
     CT_ClientData = 2,
-    CT_Session = 4
+    CT_Session = 4,
+    CT_SessionProcess = 8
   };
 
-  using ClientControlConnection = Tagged<CT_ClientControl, ClientData>;
-  using ClientDataConnection = Tagged<CT_ClientData, ClientData>;
-  using SessionConnection = Tagged<CT_Session, SessionData>;
+  using ClientControlConnection = PoolHandle<ClientData, CT_ClientControl>;
+  using ClientDataConnection = PoolHandle<ClientData, CT_ClientData>;
+  using SessionConnection = PoolHandle<SessionData, CT_Session>;
+  /// The \p Process::pidFD() of the main process of a session.
+  using SessionProcess = PoolHandle<SessionData, CT_SessionProcess>;
   using LookupVariant = std::variant<std::monostate,
                                      ClientControlConnection,
                                      ClientDataConnection,
-                                     SessionConnection>;
+                                     SessionConnection,
+                                     SessionProcess>;
 
   Socket Sock;
   std::chrono::time_point<std::chrono::system_clock> WhenStarted;
 
-  static constexpr std::size_t FDLookupSize = 256;
   /// A quick lookup that associates a file descriptor to the data for the
   /// entity behind the file descriptor.
-  SmallIndexMap<LookupVariant,
-                FDLookupSize,
-                /* StoreInPlace =*/true,
-                /* IntrusiveDefaultSentinel =*/true>
-    FDLookup;
+  PagedIndexMap<LookupVariant> FDLookup;
+
+  /// The storage of the client information data structures.
+  SlabPool<ClientData> ClientStorage;
+  /// The storage of the session information data structures.
+  SlabPool<SessionData> SessionStorage;
 
   /// Map client IDs to the client information data structure.
-  ///
-  /// \note \p unique_ptr is used so changing the map's balancing does not
-  /// invalidate other references to the data.
-  std::map<std::size_t, std::unique_ptr<ClientData>> Clients;
+  std::map<std::size_t, PoolHandle<ClientData>> Clients;
 
   /// Map terminal \p Sessions running under the current shell to their names.
-  ///
-  /// \note \p unique_ptr is used so changing the map's balancing does not
-  /// invalidate other references to the data.
-  std::map<std::string, std::unique_ptr<SessionData>> Sessions;
+  std::map<std::string, PoolHandle<SessionData>> Sessions;
 
-  static constexpr std::size_t DeadChildrenVecSize = 8;
-  /// A list of process handles that were signalle
-  mutable std::array<Process::raw_handle, DeadChildrenVecSize> DeadChildren;
+  /// Allows constant-time lookup of \p Sessions by their name. The key is a
+  /// view into the name stored in the \p SessionData, which is kept stable by
+  /// the \p SessionStorage.
+  std::unordered_map<std::string_view, SessionData*> SessionsByName;
+
+  /// Allows looking up \p Sessions by the name their process was spawned with
+  /// for a session that adopted it from \p WarmSessions.
+  ///
+  /// \see SessionData::alias()
+  std::unordered_map<std::string_view, SessionData*> SessionsByAlias;
+
+  /// Allows constant-time lookup of \p Sessions by the PID of their process.
+  std::unordered_map<Process::raw_handle, SessionData*> SessionsByPID;
+
+  /// The smallest numeric default session name that \p makeDefaultSessionName
+  /// did not consider yet.
+  std::size_t NextDefaultSessionName = 1;
+  /// Numeric session names below \p NextDefaultSessionName that became free
+  /// again when their session was removed, ordered to hand out the smallest.
+  std::priority_queue<std::size_t, std::vector<std::size_t>, std::greater<>>
+    FreedDefaultSessionNames;
+
+  /// Set by \p registerDeadChild() when a subprocess of the server had died.
+  mutable Atomic<bool> ChildrenExited;
+  /// The number of sessions whose process could not be given a
+  /// \p Process::pidFD(), and has to be checked by \p reapDeadChildren().
+  std::size_t UnwatchedChildren = 0;
+
+  /// The number of iterations \p loop() made.
+  std::uint64_t LoopIterations = 0;
+  /// The number of clients kicked by the server because a connection
+  /// overflowed.
+  std::uint64_t ClientsKicked = 0;
+  /// The number of buffer overflows encountered over all connections.
+  std::uint64_t Overflows = 0;
+  /// The number of clients rejected because the server ran out of file
+  /// descriptors.
+  std::uint64_t ClientsRejected = 0;
+
+  /// \see setListenQueue()
+  std::size_t ListenQueueSize = ListenQueue;
+  /// \see setScrollbackSize()
+  std::size_t ScrollbackBytes = ScrollbackSize;
+  /// \see setRecordingDirectory()
+  std::optional<std::string> RecordingDirectory;
+  /// Writes the pending output of the recorded sessions, which is then forced
+  /// to the disk in the background.
+  void syncRecordings();
+  /// Arms the timer that calls \p syncRecordings() and then rearms itself.
+  void armRecordingSync();
+  /// The stream token given to the next session made. This is seeded from the
+  /// time the server was constructed, so a token of a session from a previous
+  /// server instance is not mistaken for one of the current.
+  std::uint64_t NextStreamToken;
+  /// A file descriptor held open so that it may be given up for \p accept()ing
+  /// a client that is then rejected, when the server had run out of them.
+  fd SpareFD;
+  /// Opens \p SpareFD, if it is not open.
+  void reserveSpareFD();
+  /// Accepts as many as \p AcceptBurst pending connections on the server's
+  /// socket.
+  void acceptClients();
+  /// Accepts and rejects a pending connection that could not be accepted
+  /// because the server ran out of file descriptors, by giving up
+  /// \p SpareFD for the duration. Otherwise, the connection would stay
+  /// pending, and the server's socket would be reported readable forever.
+  ///
+  /// \returns whether a connection was rejected.
+  bool rejectClientWithSpareFD();
+  /// Fires when the server should resume accepting connections.
+  TimerWheel::Timer AcceptRetryTimer;
+  /// Stops watching the server's socket until \p AcceptRetryDelay passes, and
+  /// then tries to \p reserveSpareFD() again. This is used when a pending
+  /// connection could neither be accepted nor rejected, as the socket would be
+  /// reported readable in every iteration of \p loop() in the meantime.
+  void pauseAccepting();
+
+  /// The time the current iteration of \p loop() returned from waiting for
+  /// events.
+  std::chrono::steady_clock::time_point WokenUp;
+  /// The distribution of the time, in nanoseconds, \p loop() spent handling
+  /// the events of an iteration, excluding the wait for the events.
+  LatencyHistogram LoopIterationTime;
+
+  /// \returns the time elapsed since \p WokenUp in nanoseconds, or nothing if
+  /// the server is not handling events from \p loop().
+  std::optional<std::uint64_t> nanosSinceWokenUp() const noexcept;
+
+  /// Gives the buffers of connections that did not see traffic recently back
+  /// to the shared pool. Connections with events release their buffers when
+  /// handled, but idle ones would keep them until the next event, so every
+  /// connection is visited by a timer once every
+  /// \p BufferedChannel::BufferIdleTime.
+  void releaseIdleBuffers();
+  /// Arms the timer that calls \p releaseIdleBuffers() and then rearms itself.
+  void armBufferSweep();
+
+  /// Arms the timer that checks whether \p Client became idle, after
+  /// \p KeepaliveInterval.
+  void armIdleTimer(ClientData& Client);
+  /// Sends a keepalive to, or disconnects, \p Client if it has been idle.
+  void idleCheck(ClientData& Client);
+  /// Arms the timer that checks whether \p Session became inactive, \p After
+  /// the given time.
+  void armInactivityTimer(SessionData& Session,
+                          TimerWheel::Clock::duration After);
+  /// Tries to flush the contents of the socket \p S of \p Client. If the
+  /// flushing made progress but did not finish, it is scheduled for the next
+  /// iteration of \p loop(). If it did not make any progress, the client is
+  /// not reading, and the flush is retried after \p FlushRetryDelay.
+  void flushAndReschedule(ClientData& Client, Socket& S);
+
+  /// \see setMaxBufferMemory()
+  std::size_t BufferBudget = 0;
+  /// The number of times a session was throttled due to \p BufferBudget.
+  std::uint64_t BudgetThrottles = 0;
+  /// The number of clients kicked due to \p BufferBudget.
+  std::uint64_t BudgetSheds = 0;
+  /// Whether any session was throttled. The sessions are only resumed when
+  /// the buffers are released, which might happen without any event, so the
+  /// server must wake up periodically.
+  bool HasThrottledSessions = false;
+  /// Wakes the server up while \p HasThrottledSessions.
+  TimerWheel::Timer BudgetTimer;
+  /// Keeps the memory of the buffers of the connections within
+  /// \p BufferBudget.
+  ///
+  /// When the usage reaches half of the budget, the pool of released buffers
+  /// is freed and the sessions whose output is piling up the most stop being
+  /// read, until the usage falls back. If the usage is over the budget, the
+  /// clients with the largest buffers are kicked.
+  void enforceBufferBudget();
+
+  /// The processes spawned ahead of time for new sessions.
+  SessionPool WarmSessions{0, "monomux-warm-"};
+  /// Refills \p WarmSessions after a session adopted a process, in the next
+  /// iteration of \p loop(), so the response to the client is not delayed.
+  TimerWheel::Timer WarmRefillTimer;
+  /// Arms the timer that refills \p WarmSessions, if it is not armed yet.
+  void armWarmRefill();
+  /// Adds the environment variables that let a client running inside the
+  /// session \p Name find it to \p Opts.
+  void addSessionEnvironment(Process::SpawnOptions& Opts,
+                             const std::string& Name) const;
+  /// Gives \p Session a process that runs the program of \p Opts, either by
+  /// adopting one from \p WarmSessions, or by spawning it.
+  ///
+  /// \note The session is not registered by this call.
+  ///
+  /// \returns whether the session has a process.
+  bool spawnSession(SessionData& Session, Process::SpawnOptions Opts);
+  /// Sends \p SIGHUP to the process of \p Session, as if its terminal was
+  /// closed, and kills the process if it did not exit after
+  /// \p HangupGracePeriod. The session is destroyed when its process exited.
+  ///
+  /// \returns whether the signal was sent.
+  bool hangupSession(SessionData& Session);
 
   mutable Atomic<bool> TerminateLoop;
   bool ExitIfNoMoreSessions;
   std::unique_ptr<EPoll> Poll;
 
+  /// \see setSynchronousSignals()
+  bool SynchronousSignals = false;
+  /// Receives the signals while \p loop() is running, if
+  /// \p SynchronousSignals is set.
+  std::unique_ptr<SignalFD> Signals;
+  /// Handles the signals pending on \p Signals.
+  void signalCallback();
+
+  /// Reaps the processes of the sessions without a \p Process::pidFD(), if
+  /// \p registerDeadChild() was called since the last time.
   void reapDeadChildren();
+  /// Destroys \p Session if its main process had terminated.
+  ///
+  /// \returns whether the session was destroyed.
+  bool reapSession(SessionData& Session);
   /// Sends a connection accpetance message to the client.
   void sendAcceptClient(ClientData& Client);
   /// Sends a rejection message to the client.
   void sendRejectClient(ClientData& Client, std::string Reason);
+  /// Sends a keepalive message to the client.
+  void sendKeepalive(ClientData& Client);
 
 public:
   /// Retrieve data about the client registered as \p ID.
   ClientData* getClient(std::size_t ID) noexcept;
+  /// Retrieve data about the client referred to by \p Handle, if it is still
+  /// alive.
+  ClientData* getClient(PoolHandle<ClientData> Handle) noexcept
+  {
+    return ClientStorage.get(Handle);
+  }
 
   /// Retrieve data about the session registered as \p Name.
   SessionData* getSession(std::string_view Name) noexcept;
 
-  /// Creates a new client on the server.
+  /// Retrieve data about the session which main process is \p PID.
+  SessionData* getSessionForProcess(Process::raw_handle PID) noexcept;
+
+  /// \returns the smallest positive number, formatted as a string, which is
+  /// not the name of a session, to be used as the name of a new session if the
+  /// user did not specify one.
+  std::string makeDefaultSessionName();
+  /// Gives back \p Name, if it is a numeric default session name, to be
+  /// handed out again by \p makeDefaultSessionName(). This is called when the
+  /// session named so was removed, or could not be created.
+  void releaseDefaultSessionName(std::string_view Name);
+
+  /// Creates a new client on the server. The callbacks of the server must only
+  /// be given clients and sessions created by \p makeClient() and
+  /// \p makeSession().
   ///
   /// \note Calling this function only manages the backing data structure and
   /// does \b NOT fire any associated callbacks!
   ClientData* makeClient(ClientData Client);
 
-  /// Regiters a new session to the server.
+  /// Regiters a new session to the server. If the session already has a
+  /// process, it is indexed for \p getSessionForProcess().
   ///
   /// \note Calling this function only manages the backing data structure and
   /// does \b NOT fire any associated callbacks!
@@ -198,10 +480,13 @@ public:
   /// call.
   void removeSession(SessionData& Session);
 
-  /// Adds the specified \p PID to the list of subprocesses of the server that
-  /// had died. This function is meaningful to be called from a signal handler.
-  /// The server's \p loop() will take care of destroying the session in its
-  /// normal iteration.
+  /// Notes that the subprocess \p PID of the server had died. This function is
+  /// meaningful to be called from a signal handler. The server's \p loop() will
+  /// take care of destroying the session in its normal iteration.
+  ///
+  /// \note The processes of sessions are normally watched by the \p loop()
+  /// through a \p Process::pidFD(), and this call is only needed for the
+  /// processes for which the system could not give one.
   void registerDeadChild(Process::raw_handle PID) const noexcept;
 
   /// The callback function that is fired when a new \p Client connected.
@@ -226,13 +511,20 @@ public:
   /// clients.
   void dataCallback(SessionData& Session);
   /// The callback function that is fired when a \p Client attaches to a
-  /// \p Session.
-  void clientAttachedCallback(ClientData& Client, SessionData& Session);
+  /// \p Session. The output of the session retained since \p ReplayFrom, or
+  /// the default replay if not given, is sent to the client.
+  void clientAttachedCallback(
+    ClientData& Client,
+    SessionData& Session,
+    std::optional<std::uint64_t> ReplayFrom = std::nullopt);
   /// The callback function that is fired when a \p Client had detached from a
   /// \p Session.
   void clientDetachedCallback(ClientData& Client, SessionData& Session);
   /// The callback function that is fired when a \p Session is destroyed.
   void destroyCallback(SessionData& Session);
+  /// The callback function that is fired when a \p Session did not produce
+  /// output for \p SessionInactivityTime.
+  void inactiveCallback(SessionData& Session);
 
   /// A special step during the handshake maneuvre is when a user client
   /// connects to the server again, and establishes itself as the data
@@ -246,6 +538,26 @@ public:
   /// connections handled. This data is not meant to be machine-readable!
   std::string statistics() const;
 
+  /// \returns the counters and gauges of the server and the connections
+  /// handled, in a machine-readable format. This is cheap enough to be
+  /// polled periodically.
+  ///
+  /// \note The latency histograms reported are reset by this call, so each
+  /// response contains the distribution since the previous one.
+  ///
+  /// \param Session If not empty, only the session named so and the clients
+  /// attached to it are reported.
+  monomux::message::response::Metrics metrics(std::string_view Session);
+
+  /// \returns the occurrences of the pattern of \p Request in the output
+  /// retained for the sessions, together with the lines around them. If the
+  /// request names a session, only that session is searched, and the
+  /// response is unsuccessful if no session is known by the name.
+  ///
+  /// \see Scrollback::find()
+  monomux::message::response::Search
+  search(const monomux::message::request::Search& Request);
+
 private:
   /// Maps \p MessageKind to handler functions.
   std::map<std::uint16_t, std::function<HandlerFunction>> Dispatch;
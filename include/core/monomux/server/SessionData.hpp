@@ -19,12 +19,22 @@
 #pragma once
 #include <cassert>
 #include <chrono>
+#include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "monomux/adt/Histogram.hpp"
+#include "monomux/adt/SlabPool.hpp"
+#include "monomux/adt/TimerWheel.hpp"
 #include "monomux/system/Process.hpp"
 
+#include "Metrics.hpp"
+#include "Recording.hpp"
+#include "Scrollback.hpp"
+
 namespace monomux::server
 {
 
@@ -39,6 +49,10 @@ public:
   {}
 
   const std::string& name() const noexcept { return Name; }
+  /// \returns the name the process of the session was spawned with, if it
+  /// differs from \p name() because the process was spawned ahead of time.
+  const std::string& alias() const noexcept { return Alias; }
+  void setAlias(std::string Alias) noexcept { this->Alias = std::move(Alias); }
   std::chrono::time_point<std::chrono::system_clock>
   whenCreated() const noexcept
   {
@@ -50,6 +64,20 @@ public:
   }
   void activity() noexcept { LastActivity = std::chrono::system_clock::now(); }
 
+  /// \returns the counters of the output read from the session
+  /// (\p BytesIn) and the input relayed into it (\p BytesOut).
+  TrafficCounters& traffic() noexcept { return Traffic; }
+  const TrafficCounters& traffic() const noexcept { return Traffic; }
+
+  /// \returns the distribution of the time, in nanoseconds, between the server
+  /// waking up for the session's output and handing it to every attached
+  /// client.
+  LatencyHistogram& readToSendLatency() noexcept { return ReadToSend; }
+  const LatencyHistogram& readToSendLatency() const noexcept
+  {
+    return ReadToSend;
+  }
+
   bool hasProcess() const noexcept { return MainProcess.has_value(); }
   void setProcess(Process&& Process) noexcept;
   Process& getProcess() noexcept
@@ -84,24 +112,62 @@ public:
     return &getProcess().getPty()->writer();
   }
 
-  const std::vector<ClientData*>& getAttachedClients() const noexcept
+  /// \returns whether the output of the session is not read because the
+  /// server is low on buffer memory.
+  bool isThrottled() const noexcept { return Throttled; }
+  void setThrottled(bool Throttled) noexcept { this->Throttled = Throttled; }
+
+  /// \returns the timer that fires when the session might have become
+  /// inactive.
+  TimerWheel::Timer& inactivityTimer() noexcept { return InactivityTimer; }
+
+  /// \returns the recent output of the session, replayed to attaching clients.
+  Scrollback& scrollback() noexcept { return History; }
+  const Scrollback& scrollback() const noexcept { return History; }
+
+  /// \returns the token identifying the output stream of this session, which
+  /// clients present to resume receiving it from an offset.
+  std::uint64_t streamToken() const noexcept { return StreamToken; }
+  void setStreamToken(std::uint64_t Token) noexcept { StreamToken = Token; }
+
+  /// \returns the recorder that saves the output of the session to disk, if
+  /// the session is recorded.
+  Recorder* recorder() noexcept { return Recording.get(); }
+  const Recorder* recorder() const noexcept { return Recording.get(); }
+  void setRecorder(std::unique_ptr<Recorder> Recorder) noexcept
+  {
+    Recording = std::move(Recorder);
+  }
+
+  const std::vector<PoolHandle<ClientData>>& getAttachedClients() const noexcept
   {
     return AttachedClients;
   }
   /// \returns the \p ClientData from all attached client which \p activity()
   /// field is the newest (most recently active client).
-  ClientData* getLatestClient() const;
-  void attachClient(ClientData& Client);
-  void removeClient(ClientData& Client) noexcept;
+  ///
+  /// \param Clients The pool the attached clients are stored in.
+  ClientData* getLatestClient(SlabPool<ClientData>& Clients) const;
+  void attachClient(PoolHandle<ClientData> Client);
+  void removeClient(PoolHandle<ClientData> Client) noexcept;
 
 private:
   /// A user-given identifier for the session.
   std::string Name;
+  /// \see alias()
+  std::string Alias;
   /// The timestamp when the session was spawned.
   std::chrono::time_point<std::chrono::system_clock> Created;
   /// The timestamp when the underlying program was most recently trasmitted
   /// data.
   std::chrono::time_point<std::chrono::system_clock> LastActivity;
+  TrafficCounters Traffic;
+  LatencyHistogram ReadToSend;
+  bool Throttled = false;
+  TimerWheel::Timer InactivityTimer;
+  Scrollback History;
+  std::uint64_t StreamToken = 0;
+  std::unique_ptr<Recorder> Recording;
 
   /// The process (if any) executing in the session.
   ///
@@ -111,7 +177,7 @@ private:
   std::optional<Process> MainProcess;
 
   /// The list of clients currently attached to this session.
-  std::vector<ClientData*> AttachedClients;
+  std::vector<PoolHandle<ClientData>> AttachedClients;
 };
 
 } // namespace monomux::server
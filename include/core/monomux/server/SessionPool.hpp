@@ -0,0 +1,141 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "monomux/system/Process.hpp"
+
+namespace monomux::server
+{
+
+/// Keeps processes spawned ahead of time for the sessions that will be created,
+/// so that a new session does not have to wait for its program to start up.
+///
+/// Processes are kept for the \e profiles, i.e. the program, arguments and
+/// environment, that sessions were recently created with. A profile is
+/// learnt when \p take() does not find a process for it, and \p refill()
+/// spawns the processes for it afterwards. The output of the idle processes is
+/// not read, it stays in their PTY until a session adopts them.
+class SessionPool
+{
+public:
+  /// The number of profiles processes are kept for. Learning a new profile
+  /// drops the processes of the least recently used one.
+  static constexpr std::size_t MaxProfiles = 4;
+
+  /// A process taken from the pool.
+  struct Adopted
+  {
+    Process Proc;
+    /// The session name the process was spawned with, which it knows itself
+    /// by, as the name of the session that adopts it was not known yet.
+    std::string Name;
+  };
+
+  /// The type of the function that \p refill() calls on the options of each
+  /// process before spawning it, with the session name the process will be
+  /// known by.
+  using PrepareFn = void(Process::SpawnOptions& Opts, const std::string& Name);
+
+  /// \param PerProfile The number of idle processes to keep for each profile.
+  /// \param NamePrefix The prefix of the session names generated for the
+  /// spawned processes.
+  SessionPool(std::size_t PerProfile, std::string NamePrefix);
+  ~SessionPool();
+  SessionPool(const SessionPool&) = delete;
+  SessionPool(SessionPool&&) = default;
+  SessionPool& operator=(const SessionPool&) = delete;
+  SessionPool& operator=(SessionPool&&) = default;
+
+  /// \returns whether \p Name starts with the prefix of the names generated
+  /// for the processes of the pool. As these names are looked up as aliases
+  /// of the sessions that adopt the processes, a session may not be named so.
+  bool isReservedName(std::string_view Name) const noexcept
+  {
+    return Name.substr(0, NamePrefix.size()) == NamePrefix;
+  }
+
+  /// \returns the number of idle processes kept for each profile.
+  std::size_t perProfile() const noexcept { return PerProfile; }
+  /// Sets the number of idle processes kept for each profile. If \p 0, the
+  /// pool is disabled and every process kept is dropped.
+  void setPerProfile(std::size_t PerProfile);
+
+  /// \returns an idle process that was spawned with \p Opts, if any, and marks
+  /// the profile of \p Opts as the most recently used one.
+  std::optional<Adopted> take(const Process::SpawnOptions& Opts);
+
+  /// \returns whether any profile has fewer idle processes than it should.
+  bool needsRefill() const noexcept;
+
+  /// Spawns processes until every profile has \p perProfile() idle ones. If
+  /// spawning for a profile fails, the profile is forgotten.
+  ///
+  /// \returns the number of processes spawned.
+  std::size_t refill(const std::function<PrepareFn>& Prepare);
+
+  /// Reaps the processes of the pool that exited, either while idle, or after
+  /// they were dropped.
+  void reapDead();
+
+  struct Statistics
+  {
+    std::size_t Profiles;
+    std::size_t Idle;
+    std::uint64_t Adoptions;
+    std::uint64_t Misses;
+  };
+  Statistics statistics() const noexcept;
+
+private:
+  struct Profile
+  {
+    /// \see key()
+    std::string Key;
+    /// The options the processes are spawned with, before \p PrepareFn.
+    Process::SpawnOptions Options;
+    std::deque<Adopted> Idle;
+  };
+
+  /// \returns the identity of the profile \p Opts belongs to.
+  static std::string key(const Process::SpawnOptions& Opts);
+
+  /// Hangs up \p P, which is kept until it exits to be reaped.
+  void drop(Process&& P);
+
+  std::size_t PerProfile;
+  std::string NamePrefix;
+  /// The number of processes spawned, used to generate their names.
+  std::size_t Spawned = 0;
+  /// The profiles, the most recently used first.
+  std::list<Profile> Profiles;
+  /// The processes that were dropped but did not exit yet.
+  std::vector<Process> Dropped;
+  std::uint64_t Adoptions = 0;
+  std::uint64_t Misses = 0;
+};
+
+} // namespace monomux::server
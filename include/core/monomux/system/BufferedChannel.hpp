@@ -18,11 +18,13 @@
  */
 #pragma once
 #include <cassert>
+#include <chrono>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <vector>
 
+#include "monomux/adt/Histogram.hpp"
 #include "monomux/adt/UniqueScalar.hpp"
 #include "monomux/system/Channel.hpp"
 
@@ -50,6 +52,11 @@ class BufferedChannelBuffer;
 /// read/write that many data. In some cases, reading \p N bytes might consume
 /// a larger amount from the kernel-backed data structure, in which case the
 /// tail end is dropped.
+///
+/// The buffers are only allocated when data first has to be stored in them.
+/// Buffers that stayed empty for \p BufferIdleTime are given back to a
+/// process-wide pool by \p tryFreeResources(), from which other channels
+/// take their buffers.
 class BufferedChannel : public Channel
 {
   using OpaqueBufferType = detail::BufferedChannelBuffer;
@@ -59,6 +66,35 @@ public:
   /// \p BufferedChannel.
   static constexpr std::size_t BufferSize = 1ULL << 14; // 16 KiB
 
+  /// The time after which an empty buffer is released from its channel.
+  static constexpr std::chrono::seconds BufferIdleTime{5};
+
+  /// The upper limit of the memory kept in the pool of released buffers.
+  /// Buffers released over this limit are freed.
+  static constexpr std::size_t BufferPoolMax = 1ULL << 22; // 4 MiB
+
+  /// Machine-readable information about the memory of the buffers of every
+  /// \p BufferedChannel in the process.
+  struct MemoryStatistics
+  {
+    /// The number of buffers held by channels.
+    std::size_t Buffers{};
+    /// The number of bytes allocated for the buffers held by channels.
+    std::size_t Bytes{};
+    /// The highest value \p Bytes ever had.
+    std::size_t PeakBytes{};
+    /// The number of released buffers kept in the pool.
+    std::size_t PooledBuffers{};
+    /// The number of bytes allocated for the buffers in the pool.
+    std::size_t PooledBytes{};
+  };
+
+  /// \returns the statistics about the buffer memory of all channels.
+  static MemoryStatistics memoryStatistics() noexcept;
+
+  /// Frees every buffer kept in the pool.
+  static void releasePool() noexcept;
+
   /// Thrown if the \p Buffer of a \p BufferedChannel exceeds a (reasonable)
   /// size limit.
   class OverflowError : public std::runtime_error
@@ -171,21 +207,62 @@ public:
   /// Attempts to automatically free auto-growing memory resources associated
   /// with the buffer(s), if it is possible and deemed meaningful. This is a
   /// heuristics-based call that does not always actually free resources.
+  ///
+  /// Buffers that are empty and were not used for \p BufferIdleTime are
+  /// released to the pool.
   void tryFreeResources();
 
   /// \returns statistical information, formatted to be human-readable, about
   /// the underlying buffer implementation.
   std::string statistics() const;
 
+  /// A machine-readable snapshot of the fill state of one of the buffers.
+  struct BufferStatistics
+  {
+    /// The number of bytes currently stored in the buffer.
+    std::size_t Size{};
+    /// The number of bytes the buffer can store without growing.
+    std::size_t Capacity{};
+    /// The largest size observed recently, if the buffer had grown.
+    std::size_t Peak{};
+  };
+
+  /// \returns the number of bytes allocated for the buffers of the channel.
+  std::size_t bufferMemory() const noexcept;
+
+  /// \returns the fill state of the read buffer, or an empty record if the
+  /// channel does not support reading or the buffer is not allocated.
+  BufferStatistics readBufferStatistics() const noexcept;
+  /// \returns the fill state of the write buffer, or an empty record if the
+  /// channel does not support writing or the buffer is not allocated.
+  BufferStatistics writeBufferStatistics() const noexcept;
+
+  /// Sets \p H to receive, in nanoseconds, the time data written to the
+  /// channel spent in the write buffer before it was flushed. Passing
+  /// \p nullptr stops the measurement.
+  ///
+  /// \note Only data that could not be sent immediately is measured, and the
+  /// histogram must outlive the channel or be unset.
+  void setWriteDelayHistogram(LatencyHistogram* H) noexcept;
+
 protected:
+  /// The buffers of the channel, if allocated.
   UniqueScalar<OpaqueBufferType*, nullptr> Read;
   UniqueScalar<OpaqueBufferType*, nullptr> Write;
 
+  /// The size of the buffers to allocate. If zero, the channel does not
+  /// support the direction.
+  UniqueScalar<std::size_t, 0> ReadBufferSize;
+  UniqueScalar<std::size_t, 0> WriteBufferSize;
+
+  /// \see setWriteDelayHistogram()
+  UniqueScalar<LatencyHistogram*, nullptr> WriteDelay;
+
   /// Creates the buffering structure for the object.
   /// \param ReadBufferSize If non-zero, the size of the read buffer. If zero,
-  /// a read buffer will not be created.
+  /// the channel does not support reading.
   /// \param WriteBufferSize If non-zero, the size of the write buffer. If zero,
-  /// a write buffer will not be created.
+  /// the channel does not support writing.
   BufferedChannel(fd Handle,
                   std::string Identifier,
                   bool NeedsCleanup,
@@ -193,6 +270,12 @@ protected:
                   std::size_t WriteBufferSize = BufferSize);
   BufferedChannel(BufferedChannel&&) noexcept = default;
   BufferedChannel& operator=(BufferedChannel&&) noexcept = default;
+
+private:
+  /// \returns the read buffer, allocating it if needed.
+  OpaqueBufferType& readBuffer();
+  /// \returns the write buffer, allocating it if needed.
+  OpaqueBufferType& writeBuffer();
 };
 
 using buffer_overflow = BufferedChannel::OverflowError;
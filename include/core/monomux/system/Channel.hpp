@@ -75,11 +75,15 @@ protected:
   Channel(Channel&&) noexcept = default;
   Channel& operator=(Channel&&) noexcept = default;
 
-  /// Implemented by subclases to actually perform reading from the system.
+  /// Implemented by subclases to actually perform reading from the system,
+  /// directly into the at least \p Bytes long \p Buffer.
   ///
   /// \param Continue Whether the read operation from the low-level resource
   /// might continue, because there is more data available.
-  virtual std::string readImpl(std::size_t Bytes, bool& Continue) = 0;
+  ///
+  /// \returns the number of bytes read into \p Buffer.
+  virtual std::size_t
+  readImpl(char* Buffer, std::size_t Bytes, bool& Continue) = 0;
   /// Implemented by subclases to actually perform writing to the system.
   ///
   /// \param Continue Whether the write operation to the low-level resource
@@ -22,6 +22,8 @@
 #include <utility>
 #include <vector>
 
+#include "monomux/system/fd.hpp"
+
 namespace monomux
 {
 
@@ -65,4 +67,23 @@ struct MonomuxSession
   static std::optional<MonomuxSession> loadFromEnv();
 };
 
+/// Allows handing over already bound and listening sockets to a newly started
+/// process through inherited file descriptors. The protocol is compatible with
+/// the \p LISTEN_FDS and \p LISTEN_PID variables of \p sd_listen_fds(3).
+struct ListenFDs
+{
+  /// The file descriptor number of the first passed socket.
+  static constexpr raw_fd Start = 3;
+
+  /// \returns the environment variables that announce a single passed socket
+  /// to the process \p PID.
+  static std::vector<std::pair<std::string, std::string>>
+  createEnvVars(int PID);
+
+  /// \returns the file descriptor of the socket passed to the current process,
+  /// if any. The variables are removed from the environment so they do not
+  /// leak into the children of the current process.
+  static std::optional<raw_fd> loadFromEnv();
+};
+
 } // namespace monomux
@@ -18,6 +18,7 @@
  */
 #pragma once
 #include <cassert>
+#include <chrono>
 #include <map>
 #include <optional>
 #include <vector>
@@ -26,7 +27,8 @@
 
 #include "monomux/adt/MemberFunctionHelper.hpp"
 #include "monomux/adt/POD.hpp"
-#include "monomux/adt/SmallIndexMap.hpp"
+#include "monomux/adt/PagedIndexMap.hpp"
+#include "monomux/adt/TimerWheel.hpp"
 #include "monomux/system/fd.hpp"
 
 namespace monomux
@@ -42,6 +44,10 @@ namespace monomux
 ///
 /// Using \p eventfd(2), this implementation is also capable of having events
 /// crafted by clients appear as if they were created by the kernel.
+///
+/// The structure also drives a \p TimerWheel with a \p timerfd_create(2)
+/// timer, which is set to the earliest deadline of the wheel, so \p wait()
+/// returns in time to fire the timers.
 class EPoll
 {
   friend class Listener;
@@ -58,6 +64,9 @@ class EPoll
   };
 
 public:
+  /// The precision of the timers of the event loop.
+  static constexpr std::chrono::milliseconds TimerResolution{10};
+
   /// Create a new \p epoll(7) structure associated with the current process.
   ///
   /// The structure is initialised to support at most \p EventCount events.
@@ -77,12 +86,17 @@ public:
   std::size_t getMaxEventCount() const noexcept { return Notifications.size(); }
 
   /// Blocks and waits until there is a notification that signalled the event
-  /// watcher.
+  /// watcher, or a timer expires. The callbacks of the expired \p timers() are
+  /// fired before waiting, so files they \p stop() listening on are not
+  /// reported.
   ///
   /// \return The number of events received, either from the system or by
   /// manual scheduling.
   std::size_t wait();
 
+  /// \returns the timers that are fired by \p wait().
+  TimerWheel& timers() noexcept { return Timers; }
+
   /// Retrieve the Nth event.
   const struct ::epoll_event& operator[](std::size_t Index) const
   {
@@ -112,7 +126,8 @@ public:
   /// (the file is available for writing) operations.
   void listen(raw_fd FD, bool Incoming, bool Outgoing);
 
-  /// Stop listening for changes of \p FD.
+  /// Stop listening for changes of \p FD. Events scheduled for \p FD that
+  /// were not yet reported are discarded.
   void stop(raw_fd FD);
 
   /// Stop listening on \b all associated file descriptors.
@@ -144,23 +159,24 @@ private:
   /// The file descriptor registered in the system for the manually scheduled
   /// event callbacks.
   fd ScheduleFD;
-  /// Contains the index in the \p Notifications vector, after a successful call
-  /// to \p wait(), where the \p ScheduleFD's notification was placed.
-  std::optional<std::size_t> ScheduleFDNotifiedAtIndex;
 
-  static const std::size_t FDLookupSize = 256;
+  /// The file descriptor registered in the system for expiring \p Timers.
+  fd TimerFD;
+  TimerWheel Timers;
+  /// The time \p TimerFD is set to expire at, if it is set.
+  std::optional<TimerWheel::Clock::time_point> TimerFDExpiry;
+
+  /// Sets \p TimerFD to the next expiry of \p Timers, if it changed.
+  void setTimerFD();
+
   /// Contains the events that were manually scheduled by the client before a
   /// call to \p wait(). After \p wait() is called, the events are moved to
   /// the \p ScheduledResult list to be accessed appropriately.
   std::vector<POD<struct ::epoll_event>> ScheduledWaiting;
-  /// Map file descriptor values to existing records in the \p ScheduledWaiting
-  /// vector. Used only to de-duplicate the same file descriptor being scheduled
-  /// more than once.
-  SmallIndexMap<decltype(ScheduledWaiting)::iterator,
-                FDLookupSize,
-                /* StoreInPlace =*/true,
-                /* IntrusiveDefaultSentinel =*/true>
-    ScheduledWaitingMap;
+  /// Map file descriptor values to the index of existing records in the
+  /// \p ScheduledWaiting vector. Used only to de-duplicate the same file
+  /// descriptor being scheduled more than once.
+  PagedIndexMap<std::size_t> ScheduledWaitingMap;
 
   bool isValidIndex(std::size_t I) const noexcept;
 };
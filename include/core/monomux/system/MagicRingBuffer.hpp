@@ -0,0 +1,115 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+#include "monomux/adt/RingBuffer.hpp"
+#include "monomux/adt/UniqueScalar.hpp"
+
+namespace monomux
+{
+
+/// A byte ring buffer whose storage is the same memory mapped twice,
+/// back-to-back, into the virtual address space. Writing past the end of the
+/// first mapping lands at the beginning of the storage, so both the stored
+/// and the free area of the buffer are always \b one contiguous region, which
+/// can be given to system calls like \p write() or \p read() directly, without
+/// linearising copies or splitting the access in two.
+///
+///   \code
+///
+///      +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
+///      | 4 |   |   | 0 | 1 | 2 | 3 |   | 4 |   |   | 0 | 1 | 2 | 3 |   |
+///      +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
+///                    ^                   ^
+///                    \- Logical begin    \- Logical end (through the mirror)
+///
+///      |<------------ storage ---------->|<----------- mirror ---------->|
+///
+///   \endcode
+///
+/// The storage is a \p memfd_create() file mapped with \p mmap(). Its size is
+/// a power of two number of pages. If the buffer has to grow, the contents are
+/// moved to a larger mapping. The heuristics of shrinking back to the original
+/// capacity are the same as for \p RingBuffer.
+///
+/// If the double mapping can not be created (e.g. due to resource limits), the
+/// buffer falls back to a single heap allocation which is compacted when the
+/// free space after the stored data is not enough. The views into the buffer
+/// are contiguous in this mode as well.
+class MagicRingBuffer
+  : public detail::RingBufferBase
+  , public detail::RingBufferUsageTracking
+{
+public:
+  /// Creates a buffer that can store at least \p Capacity bytes.
+  explicit MagicRingBuffer(std::size_t Capacity);
+  ~MagicRingBuffer();
+
+  MagicRingBuffer(const MagicRingBuffer&) = delete;
+  MagicRingBuffer& operator=(const MagicRingBuffer&) = delete;
+  MagicRingBuffer(MagicRingBuffer&&) noexcept = default;
+  MagicRingBuffer& operator=(MagicRingBuffer&&) noexcept = delete;
+
+  /// \returns whether the storage is mapped twice. Otherwise, the fallback
+  /// storage is used.
+  bool isDoubleMapped() const noexcept { return DoubleMapped; }
+
+  /// \returns a view of every byte stored in the buffer, as one contiguous
+  /// range. The view is invalidated by any modifying operation.
+  std::string_view peek() const noexcept { return {Storage + Head, Size}; }
+
+  /// \returns a pointer to a contiguous free area of at least \p N bytes after
+  /// the stored data, growing the buffer if needed. The bytes written into
+  /// the area become stored by calling \p commit().
+  char* reserve(std::size_t N);
+
+  /// Marks the first \p N bytes of the area returned by \p reserve() as stored.
+  void commit(std::size_t N) noexcept;
+
+  /// Copies \p N bytes from \p Ptr to the end of the buffer.
+  void putBack(const char* Ptr, std::size_t N);
+
+  /// Discards at most \p N bytes from the beginning of the buffer.
+  void dropFront(std::size_t N) noexcept;
+
+  /// Discards every byte stored in the buffer.
+  void clear() noexcept;
+
+  /// Attempts to heuristically release associated resources if the buffer was
+  /// not used for a while.
+  void tryCleanup();
+
+private:
+  /// The beginning of the storage.
+  UniqueScalar<char*, nullptr> Storage;
+  /// The offset of the logical \e Begin point of the buffer from \p Storage.
+  UniqueScalar<std::size_t, 0> Head;
+  UniqueScalar<bool, false> DoubleMapped;
+
+  /// Allocates the storage for \p Capacity bytes. The storage is not filled.
+  void allocate(std::size_t NewCapacity);
+  /// Releases the storage.
+  void deallocate() noexcept;
+  /// Moves the stored data to a new storage of \p NewCapacity bytes.
+  void reallocate(std::size_t NewCapacity);
+};
+
+} // namespace monomux
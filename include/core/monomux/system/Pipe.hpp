@@ -165,7 +165,8 @@ public:
 protected:
   Pipe(fd Handle, std::string Identifier, bool NeedsCleanup, Mode OpenMode);
 
-  std::string readImpl(std::size_t Bytes, bool& Continue) override;
+  std::size_t
+  readImpl(char* Buffer, std::size_t Bytes, bool& Continue) override;
   std::size_t writeImpl(std::string_view Buffer, bool& Continue) override;
 
 private:
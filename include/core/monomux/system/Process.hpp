@@ -27,6 +27,7 @@
 
 #include "monomux/system/CheckedPOSIX.hpp"
 #include "monomux/system/Pty.hpp"
+#include "monomux/system/fd.hpp"
 
 namespace monomux
 {
@@ -61,6 +62,13 @@ public:
   bool hasPty() const noexcept { return PTY.has_value(); }
   Pty* getPty() noexcept { return hasPty() ? &*PTY : nullptr; }
 
+  /// \returns a file descriptor referring to the process, which becomes
+  /// readable when the process terminates, or \p fd::Invalid if the system
+  /// does not support it.
+  ///
+  /// \see pidfd_open(2)
+  raw_fd pidFD() const noexcept { return PidFD.get(); }
+
   /// \returns Checks if the process had died, and if so, returns \p true.
   ///
   /// \note This call does not block. If the process died, the operating system
@@ -83,7 +91,9 @@ public:
   }
 
   /// Send the \p Signal to the underlying process.
-  void signal(int Signal);
+  ///
+  /// \returns whether the signal was sent.
+  bool signal(int Signal);
 
 private:
   raw_handle Handle = Invalid;
@@ -92,6 +102,8 @@ private:
   /// The \p Pty assocaited with the process, if \p SpawnOptions::CreatePTY was
   /// true.
   std::optional<Pty> PTY;
+  /// The \p pidFD() of the process, opened when the process is spawned.
+  fd PidFD;
 
 public:
   /// \returns the PID handle of the currently executing process.
@@ -102,7 +114,9 @@ public:
   static std::string thisProcessPath();
 
   /// Sends the \p Signal to the process identified by \p PID.
-  static void signal(raw_handle Handle, int Signal);
+  ///
+  /// \returns whether the signal was sent.
+  static bool signal(raw_handle Handle, int Signal);
 
   /// Replaces the current process (as if by calling the \p exec() family) in
   /// the system with the started one. This is a low-level operation that
@@ -112,14 +126,17 @@ public:
   [[noreturn]] static void exec(const SpawnOptions& Opts);
 
   /// Spawns a new process based on the specified \p Opts. This process calls
-  /// \p fork() internally, and then does an \p exec(). The spawned subprocess
-  /// will be meaningfully set up to be a clearly spawned process.
+  /// \p posix_spawn() internally, which does not duplicate the memory of the
+  /// current process, unlike \p fork(). The spawned subprocess will be
+  /// meaningfully set up to be a clearly spawned process, in a new session,
+  /// with the signal handling reset to the defaults.
   ///
   /// The spawned process will be the child of the current process. The call
   /// returns the PID of the child, and execution resumes normally in the
   /// parent.
   ///
-  /// \note This call does \b NOT return in the child!
+  /// \throws std::system_error if the process could not be created, including
+  /// if the program could not be executed.
   static Process spawn(const SpawnOptions& Opts);
 
   /// \p fork(): Ask the kernel to create an exact duplicate of the current
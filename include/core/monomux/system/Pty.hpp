@@ -19,6 +19,8 @@
 #pragma once
 #include <optional>
 
+#include <spawn.h>
+
 #include "monomux/adt/UniqueScalar.hpp"
 #include "monomux/system/Pipe.hpp"
 #include "monomux/system/fd.hpp"
@@ -88,13 +90,14 @@ public:
   /// file descriptor is closed.
   void setupParentSide();
 
-  /// Executes actions that configure the current PTY from a running child
-  /// process's standpoint, turning it into the controlling terminal of a
-  /// process. The master file descriptor is also closed.
+  /// Records the actions that configure the current PTY from a spawned child
+  /// process's standpoint into \p Actions, as \p login_tty() would: the slave
+  /// device becomes the controlling terminal and the standard streams of the
+  /// process, and the master file descriptor is closed.
   ///
-  /// Normally, after a call to this function, it is expected for the child
-  /// process to be replaced with another one.
-  void setupChildrenSide();
+  /// \note The spawned process must be a session leader, i.e. be created with
+  /// \p POSIX_SPAWN_SETSID, to acquire the controlling terminal.
+  void setupChildrenSide(::posix_spawn_file_actions_t& Actions) const;
 
   /// Sets the size of the pseudoterminal device to have the given dimensions.
   void setSize(unsigned short Rows, unsigned short Columns);
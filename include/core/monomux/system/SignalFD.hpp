@@ -0,0 +1,73 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <csignal>
+#include <initializer_list>
+#include <optional>
+
+#include <sys/signalfd.h>
+
+#include "monomux/adt/POD.hpp"
+#include "monomux/system/fd.hpp"
+
+namespace monomux
+{
+
+/// Receives signals synchronously, as data read from a \p signalfd(2) file
+/// descriptor, instead of interrupting the program with a signal handler.
+/// The file descriptor can be registered into an \p EPoll, so the signals are
+/// handled in the event loop like any other event.
+///
+/// While the object is alive, the received signals are \b blocked for the
+/// calling thread, which is a requirement of \p signalfd(2). Other threads of
+/// the process must also block them, otherwise the kernel might deliver the
+/// signal to such a thread. The previous signal mask is restored when the
+/// object is destroyed.
+///
+/// \note The signal mask is inherited by child processes, even through
+/// \p exec(). \p Process::exec() resets it.
+class SignalFD
+{
+public:
+  using Signal = int;
+
+  /// Blocks the \p Signals and creates a file descriptor to receive them.
+  explicit SignalFD(std::initializer_list<Signal> Signals);
+  ~SignalFD();
+
+  SignalFD(const SignalFD&) = delete;
+  SignalFD(SignalFD&&) = delete;
+  SignalFD& operator=(const SignalFD&) = delete;
+  SignalFD& operator=(SignalFD&&) = delete;
+
+  raw_fd raw() const noexcept { return Handle.get(); }
+
+  /// Reads the next pending signal.
+  ///
+  /// \returns the information about the signal, or \p nullopt if no signals
+  /// are pending.
+  std::optional<struct ::signalfd_siginfo> read();
+
+private:
+  fd Handle;
+  /// The signal mask before the construction of the object.
+  POD<::sigset_t> OriginalMask;
+};
+
+} // namespace monomux
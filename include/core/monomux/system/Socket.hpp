@@ -81,6 +81,14 @@ public:
   /// mode) already.
   static Socket wrap(fd&& FD, std::string Identifier);
 
+  /// Takes full ownership of an already bound socket \p FD that was created at
+  /// \p Path by another process and inherited by the current one. The socket
+  /// is managed as if it was created by \p create(): the file is removed on
+  /// exit. If the socket is already listening, \p listen() need not be called.
+  ///
+  /// \see ListenFDs
+  static Socket adopt(fd&& FD, std::string Path);
+
   /// Starts listening for incoming connection on the current socket by calling
   /// \p listen(). This is only valid if the current socket was created in full
   /// ownership mode, with the \p create() method.
@@ -88,10 +96,18 @@ public:
   /// \see listen(2)
   void listen(std::size_t QueueSize);
 
+  /// \returns whether the socket is accepting connections, either because
+  /// \p listen() was called or because it was \p adopt()ed in listening state.
+  bool listening() const noexcept { return Listening; }
+
   /// Accepts a new connection on the current serving socket. This operation
   /// \b MAY block. This call is only valid if the current socket was created in
   /// full ownership mode, and \p listen() had already been called for it.
   ///
+  /// The accepted socket is non-blocking and close-on-exec. If the current
+  /// socket is non-blocking and there is no pending connection, \p Error is set
+  /// to \p EAGAIN, which is not logged as a failure.
+  ///
   /// \param Error If non-null and the accepting of the client fails, the error
   /// code is returned in this parameter.
   /// \param Recoverable If non-null and the accepting of the client fails, but
@@ -115,7 +131,8 @@ public:
 protected:
   Socket(fd Handle, std::string Identifier, bool NeedsCleanup);
 
-  std::string readImpl(std::size_t Bytes, bool& Continue) override;
+  std::size_t
+  readImpl(char* Buffer, std::size_t Bytes, bool& Continue) override;
   std::size_t writeImpl(std::string_view Buffer, bool& Continue) override;
 
 private:
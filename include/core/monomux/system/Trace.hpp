@@ -0,0 +1,173 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MONOMUX_TRACE_USE_TSC
+#else
+#include <time.h>
+#endif
+
+#include "monomux/system/fd.hpp"
+
+/// The flight recorder is a per-thread, fixed-size ring of compact binary
+/// records that is always on. Recording an event is a handful of stores into
+/// thread-local memory, so the ring can stay enabled in production builds and
+/// be inspected after the fact: the crash handler dumps it, and a running
+/// server sends it over the control socket on request.
+namespace monomux::trace
+{
+
+/// The kinds of events the flight recorder knows about.
+///
+/// \note Only append to this list, as the numeric values are part of the
+/// serialised format.
+enum class EventID : std::uint16_t
+{
+  None = 0,
+  LoopWake,
+  ClientAccept,
+  ClientExit,
+  ClientKick,
+  ControlMessage,
+  ClientRead,
+  ClientSend,
+  SessionRead,
+  SessionWrite,
+  SessionCreate,
+  SessionDestroy,
+  ChildExit,
+  Overflow,
+  Flush,
+  Crash,
+
+  Last,
+};
+
+/// \returns a human-readable name of \p E.
+const char* eventName(EventID E) noexcept;
+
+/// A single entry in the flight recorder. The meaning of the payload fields
+/// depend on the event, but by convention they carry a file descriptor, a
+/// byte count and some identifier (client ID, PID, message kind) in order.
+struct Record
+{
+  /// The raw timestamp of the event, in the units of \p now().
+  std::uint64_t Tick;
+  std::uint16_t Event;
+  std::uint16_t Reserved;
+  std::uint32_t FD;
+  std::uint32_t Bytes;
+  std::uint32_t ID;
+};
+static_assert(sizeof(Record) == 24, "Record layout is part of the format!");
+
+/// \returns a cheap, monotonic raw timestamp. On x86 this is the time-stamp
+/// counter, which is converted to wall time by the decoder based on the
+/// calibration stored in the serialised trace.
+inline std::uint64_t now() noexcept
+{
+#ifdef MONOMUX_TRACE_USE_TSC
+  return __rdtsc();
+#else
+  ::timespec TS{};
+  ::clock_gettime(CLOCK_MONOTONIC, &TS);
+  return static_cast<std::uint64_t>(TS.tv_sec) * 1'000'000'000ULL +
+         static_cast<std::uint64_t>(TS.tv_nsec);
+#endif
+}
+
+/// The recording buffer of a single thread.
+struct Ring
+{
+  /// The number of records kept per thread. Must be a power of two.
+  static constexpr std::size_t Capacity = 4096;
+  static_assert((Capacity & (Capacity - 1)) == 0);
+
+  /// The kernel thread ID of the owning thread.
+  std::uint32_t ThreadID;
+  /// The number of records ever written into the ring. The next record goes
+  /// to \p Head modulo \p Capacity.
+  std::atomic<std::uint64_t> Head;
+  std::array<Record, Capacity> Records;
+};
+
+namespace detail
+{
+
+/// The ring of the current thread, or \p nullptr if the thread had not
+/// recorded anything yet.
+extern thread_local Ring* CurrentRing;
+
+/// Allocates and registers the ring for the current thread.
+Ring* registerThread() noexcept;
+
+} // namespace detail
+
+/// Appends an event to the current thread's flight recorder.
+inline void record(EventID E,
+                   std::uint32_t FD = 0,
+                   std::uint32_t Bytes = 0,
+                   std::uint32_t ID = 0) noexcept
+{
+  Ring* R = detail::CurrentRing;
+  if (!R)
+  {
+    R = detail::registerThread();
+    if (!R)
+      return;
+  }
+
+  std::uint64_t H = R->Head.load(std::memory_order_relaxed);
+  Record& Rec = R->Records[H & (Ring::Capacity - 1)];
+  Rec.Tick = now();
+  Rec.Event = static_cast<std::uint16_t>(E);
+  Rec.Reserved = 0;
+  Rec.FD = FD;
+  Rec.Bytes = Bytes;
+  Rec.ID = ID;
+  R->Head.store(H + 1, std::memory_order_release);
+}
+
+/// Serialises the contents of every thread's flight recorder into a binary
+/// buffer that can be decoded by \p decode().
+std::string snapshot();
+
+/// Writes the same binary format as \p snapshot() directly to \p FD.
+///
+/// \note This function does not allocate memory and only uses \p write(2), so
+/// it can be called from a signal handler, e.g., when the process crashes.
+///
+/// \returns whether the entire trace was written.
+bool writeSnapshot(fd::raw_fd FD) noexcept;
+
+/// Decodes a trace created by \p snapshot() into a human-readable timeline
+/// of events (ordered by time, across all threads) written to \p OS.
+///
+/// \returns whether \p Data was a well-formed trace.
+bool decode(std::string_view Data, std::ostream& OS);
+
+} // namespace monomux::trace
@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #pragma once
+#include <cstddef>
 #include <optional>
 #include <string>
 #include <vector>
@@ -24,6 +25,7 @@
 #include "monomux/client/Client.hpp"
 #include "monomux/system/Environment.hpp"
 #include "monomux/system/Process.hpp"
+#include "monomux/system/Socket.hpp"
 
 namespace monomux::client
 {
@@ -67,6 +69,34 @@ struct Options
   /// \note This is a control-mode flag.
   bool StatisticsRequest : 1;
 
+  /// Whether it was requested to gather machine-readable metrics from the
+  /// running server.
+  ///
+  /// \note This is a control-mode flag.
+  bool MetricsRequest : 1;
+
+  /// If set, the flight recorder of the running server is requested and saved
+  /// to this file. (\p - means the standard output.)
+  ///
+  /// \note This is a control-mode flag.
+  std::optional<std::string> TraceOutput;
+
+  /// If set, the severity limits of the logging of the running server are
+  /// reported, and changed according to this specification, which is either
+  /// \p list, \p LEVEL, or \p FACILITY=LEVEL.
+  ///
+  /// \note This is a control-mode flag.
+  std::optional<std::string> LogLevelSpec;
+
+  /// If set, the output retained by the running server for its sessions (or
+  /// only the session named \p SessionName) is searched for this pattern.
+  ///
+  /// \note This is a control-mode flag.
+  std::optional<std::string> SearchPattern;
+
+  /// The number of lines to show around the matches of \p SearchPattern.
+  std::size_t SearchContext = 0;
+
   /// The path to the server socket where the client should connect to.
   std::optional<std::string> SocketPath;
 
@@ -89,12 +119,28 @@ struct Options
 
 /// Attempt to establish connection to a Monomux Server specified in \p Opts.
 ///
-/// \param Block Whether to continue retrying the connection and block until
-/// success.
+/// \note If the server's socket is already listening but the server is still
+/// starting up, the connection is queued by the kernel and this call blocks
+/// until the server accepts it.
+///
 /// \param FailureReason If given, after an unsuccessful connection, a
 /// human-readable reason for the failure will be written to.
-std::optional<Client>
-connect(Options& Opts, bool Block, std::string* FailureReason);
+std::optional<Client> connect(Options& Opts, std::string* FailureReason);
+
+/// Binds and starts listening on the socket specified in \p Opts, for a server
+/// started by the client to take over. If the socket is bound already, e.g.
+/// because another client started a server at the same time and won the race,
+/// the client connects to that server instead, and stores the connection in
+/// \p Options::Connection.
+///
+/// \param ListenQueue The size of the queue of pending connections.
+/// \param FailureReason If given, after neither binding nor connecting
+/// succeeded, a human-readable reason for the failure will be written to.
+///
+/// \returns the listening socket, if the client should start the server.
+std::optional<Socket> listenForServer(Options& Opts,
+                                      std::size_t ListenQueue,
+                                      std::string* FailureReason);
 
 /// Attempts to make the \p Client fully featured with a \b Data connection,
 /// capable of actually exchanging user-specific information with the server.
@@ -100,6 +100,8 @@ private:
   /// Callback function fired when the client is ready to process events of the
   /// environment.
   static void clientEventReady(Terminal* Term, Client& Client);
+  /// Callback function fired when the client received a signal.
+  static void clientSignal(Terminal* Term, Client& Client, int SigNum);
 };
 
 } // namespace monomux::client
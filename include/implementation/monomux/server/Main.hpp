@@ -21,6 +21,8 @@
 #include <string>
 #include <vector>
 
+#include "monomux/system/Socket.hpp"
+
 namespace monomux::server
 {
 
@@ -45,13 +47,43 @@ struct Options
 
   /// The path of the server socket to start listening on.
   std::optional<std::string> SocketPath;
+
+  /// The number of bytes the buffers of all connections of the server may
+  /// take together.
+  std::optional<std::size_t> MaxBufferMemory;
+
+  /// The number of connections that may wait for being accepted by the
+  /// server.
+  std::optional<std::size_t> ListenQueue;
+
+  /// The number of sessions to keep started ahead of time for each recently
+  /// used program and environment.
+  std::optional<std::size_t> WarmSessions;
+
+  /// The number of bytes of the recent output of each session to keep for
+  /// attaching clients.
+  std::optional<std::size_t> ScrollbackSize;
+
+  /// The directory to record the output of every session into.
+  std::optional<std::string> RecordDirectory;
 };
 
 /// \p exec() into a server process that is created with the \p Opts options.
 [[noreturn]] void exec(const Options& Opts, const char* ArgV0);
 
+/// \p exec() into a server process that is created with the \p Opts options,
+/// and which will take over the already bound and listening \p Listener
+/// socket instead of creating one.
+///
+/// \see ListenFDs
+[[noreturn]] void
+exec(const Options& Opts, const char* ArgV0, const Socket& Listener);
+
 /// Executes the Monomux Server logic.
 ///
+/// If the process was given a listening socket by its parent (see
+/// \p ListenFDs), it is used instead of creating a new socket.
+///
 /// \returns \p ExitCode
 int main(Options& Opts);
 
@@ -147,4 +147,19 @@ void printBacktrace(std::ostream& OS, const Backtrace& Trace);
 /// formatting logic.
 void printBacktrace(std::ostream& OS, bool Prettify = true);
 
+/// Decides the directory \p dumpFlightRecorder() writes to, from the
+/// environment. Must be called before a dump is attempted, outside of signal
+/// handlers.
+void prepareFlightRecorderDump();
+
+/// Writes the contents of the flight recorder (see \p trace::snapshot()) to a
+/// new file in the temporary directory, named after the current process.
+///
+/// \note This function is async-signal-safe, and is meant to be called from
+/// the handler of a fatal signal.
+///
+/// \returns the path of the written file, or \p nullptr if the dump failed or
+/// was not prepared. The path is valid until the next call.
+const char* dumpFlightRecorder() noexcept;
+
 } // namespace monomux
@@ -16,8 +16,26 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <csignal>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
+#include <pthread.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "monomux/adt/BoundedQueue.hpp"
 #include "monomux/system/Time.hpp"
 
 #include "monomux/Log.hpp"
@@ -47,10 +65,293 @@ const char* Logger::levelName(Severity S) noexcept
   return SeverityName[S];
 }
 
-Logger::OutputBuffer::OutputBuffer(std::ostream& OS,
+/// Owns the interned \p Facility instances.
+class FacilityRegistry
+{
+public:
+  /// The registry is intentionally leaked, so logging keeps working during
+  /// static destruction.
+  static FacilityRegistry& get()
+  {
+    static auto* R = new FacilityRegistry{};
+    return *R;
+  }
+
+  Facility& intern(std::string_view Name)
+  {
+    std::lock_guard<std::mutex> L{Lock};
+    auto It = Lookup.find(Name);
+    if (It != Lookup.end())
+      return *It->second;
+
+    Facility& F = Storage.emplace_back(std::string{Name}, DefaultLimit);
+    Lookup.emplace(F.Name, &F);
+    return F;
+  }
+
+  bool setLimit(std::string_view Name, std::optional<Severity> Limit)
+  {
+    std::lock_guard<std::mutex> L{Lock};
+    auto It = Lookup.find(Name);
+    if (It == Lookup.end())
+      return false;
+
+    Facility& F = *It->second;
+    F.OwnLimit = Limit.has_value();
+    F.Limit.store(Limit.value_or(DefaultLimit), std::memory_order_relaxed);
+    return true;
+  }
+
+  void setDefaultLimit(Severity Limit)
+  {
+    std::lock_guard<std::mutex> L{Lock};
+    DefaultLimit = Limit;
+    for (Facility& F : Storage)
+      if (!F.OwnLimit)
+        F.Limit.store(Limit, std::memory_order_relaxed);
+  }
+
+  std::vector<const Facility*> all()
+  {
+    std::lock_guard<std::mutex> L{Lock};
+    std::vector<const Facility*> Ret;
+    Ret.reserve(Storage.size());
+    for (const Facility& F : Storage)
+      Ret.emplace_back(&F);
+    return Ret;
+  }
+
+private:
+  std::mutex Lock;
+  Severity DefaultLimit = Default;
+  /// (A deque, as elements must not move once references are handed out.)
+  std::deque<Facility> Storage;
+  std::unordered_map<std::string_view, Facility*> Lookup;
+};
+
+Facility& facility(std::string_view Name)
+{
+  return FacilityRegistry::get().intern(Name);
+}
+
+bool setFacilityLimit(std::string_view Name, std::optional<Severity> Limit)
+{
+  return FacilityRegistry::get().setLimit(Name, Limit);
+}
+
+std::vector<const Facility*> facilities()
+{
+  return FacilityRegistry::get().all();
+}
+
+/// Formats the beginning of a log line for a message of severity \p S.
+static std::string formatPrefix(Severity S, std::string_view Facility)
+{
+  std::ostringstream LogPrefix;
+  LogPrefix << '[' << formatTime(std::chrono::system_clock::now()) << ']';
+  if (std::string_view SN = SeverityName[S]; !SN.empty())
+    LogPrefix << '[' << SN << "] ";
+  if (!Facility.empty())
+    LogPrefix << Facility << ": ";
+  else
+    LogPrefix << "?: ";
+  return LogPrefix.str();
+}
+
+/// The backend of the asynchronous logging. Producers push complete,
+/// newline-terminated records into a lock-free queue, and a background thread
+/// pops them in batches and writes each batch with a single \p writev() call.
+class AsyncWriter
+{
+public:
+  AsyncWriter(int FD, std::size_t Capacity, DropPolicy Policy)
+    : FD(FD), Policy(Policy), Queue(Capacity), Thread([this] { run(); })
+  {}
+
+  /// Writes all the records still queued and stops the background thread.
+  ~AsyncWriter()
+  {
+    {
+      std::lock_guard<std::mutex> L{Lock};
+      Stopping.store(true);
+    }
+    Wakeup.notify_one();
+    Thread.join();
+  }
+
+  AsyncWriter(const AsyncWriter&) = delete;
+  AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+  std::uint64_t dropped() const noexcept { return Dropped.load(); }
+
+  void push(std::string Record) noexcept
+  {
+    Pending.fetch_add(1);
+    while (!Queue.tryPush(std::move(Record)))
+    {
+      if (Policy == DropPolicy::DropNewest)
+      {
+        Pending.fetch_sub(1);
+        Dropped.fetch_add(1);
+        return;
+      }
+      wake();
+      std::this_thread::yield();
+    }
+    wake();
+  }
+
+  /// Waits until the background thread had written every record pushed
+  /// before the call, or \p Timeout passes.
+  void flush(std::chrono::milliseconds Timeout) noexcept
+  {
+    auto Deadline = std::chrono::steady_clock::now() + Timeout;
+    while (Pending.load() > 0 && std::chrono::steady_clock::now() < Deadline)
+    {
+      wake();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+private:
+  /// The maximum number of records written by a single \p writev().
+  static constexpr std::size_t MaxBatch = std::min<std::size_t>(64, IOV_MAX);
+  /// The time the writer sleeps for if it did not get notified of new records.
+  static constexpr std::chrono::milliseconds IdleWait{100};
+
+  const int FD;
+  const DropPolicy Policy;
+  BoundedQueue<std::string> Queue;
+
+  /// The number of records pushed but not yet written.
+  std::atomic<std::size_t> Pending = 0;
+  std::atomic<std::uint64_t> Dropped = 0;
+  std::atomic<bool> Sleeping = false;
+  std::atomic<bool> Stopping = false;
+
+  std::mutex Lock;
+  std::condition_variable Wakeup;
+  std::thread Thread;
+
+  /// Notifies the writer thread if it is waiting for records.
+  ///
+  /// The writer announces \p Sleeping and checks the queue while holding
+  /// \p Lock, and only releases it by starting the wait. Notifying under the
+  /// lock thus cannot happen between the check and the wait, where it would
+  /// be lost. The fences pair with the one in \p run(), so either the writer
+  /// sees the pushed record, or the producer sees \p Sleeping.
+  void wake() noexcept
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!Sleeping.load())
+      return;
+    std::lock_guard<std::mutex> L{Lock};
+    Wakeup.notify_one();
+  }
+
+  void run();
+  void writeBatch(std::vector<std::string>& Batch) noexcept;
+};
+
+void AsyncWriter::run()
+{
+  // Signals are meant for the thread of the program. Blocking them here is
+  // also needed for the ones the program receives through a signalfd, which
+  // are only blocked in its own thread.
+  {
+    ::sigset_t All;
+    ::sigfillset(&All);
+    ::pthread_sigmask(SIG_BLOCK, &All, nullptr);
+  }
+
+  std::vector<std::string> Batch;
+  Batch.reserve(MaxBatch + 1);
+  std::uint64_t ReportedDropped = 0;
+
+  while (true)
+  {
+    std::string Record;
+    while (Batch.size() < MaxBatch && Queue.tryPop(Record))
+      Batch.emplace_back(std::move(Record));
+    std::size_t Popped = Batch.size();
+
+    if (std::uint64_t D = Dropped.load(); D != ReportedDropped)
+    {
+      std::ostringstream Msg;
+      Msg << formatPrefix(Warning, "log") << (D - ReportedDropped)
+          << " log record(s) dropped, the queue was full\n";
+      Batch.emplace_back(Msg.str());
+      ReportedDropped = D;
+    }
+
+    if (!Batch.empty())
+    {
+      writeBatch(Batch);
+      Batch.clear();
+      Pending.fetch_sub(Popped);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> L{Lock};
+    if (Stopping.load())
+      break;
+    Sleeping.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (Queue.sizeApprox() == 0)
+      Wakeup.wait_for(L, IdleWait);
+    Sleeping.store(false);
+  }
+}
+
+void AsyncWriter::writeBatch(std::vector<std::string>& Batch) noexcept
+{
+  std::array<::iovec, MaxBatch + 1> IOV{};
+  std::size_t Count = Batch.size();
+  for (std::size_t I = 0; I < Count; ++I)
+  {
+    IOV.at(I).iov_base = Batch.at(I).data();
+    IOV.at(I).iov_len = Batch.at(I).size();
+  }
+
+  ::iovec* Current = IOV.data();
+  while (Count)
+  {
+    ::ssize_t Written = ::writev(FD, Current, static_cast<int>(Count));
+    if (Written == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      // The output is broken, there is nothing sensible left to do with the
+      // records.
+      return;
+    }
+
+    // Skip the fully written buffers, and adjust the partially written one.
+    auto Remaining = static_cast<std::size_t>(Written);
+    while (Count && Remaining >= Current->iov_len)
+    {
+      Remaining -= Current->iov_len;
+      ++Current;
+      --Count;
+    }
+    if (Count)
+    {
+      Current->iov_base = static_cast<char*>(Current->iov_base) + Remaining;
+      Current->iov_len -= Remaining;
+    }
+  }
+}
+
+Logger::OutputBuffer::OutputBuffer(Logger& Owner,
                                    bool Discard,
+                                   Severity S,
                                    std::string_view Prefix)
-  : Discard(Discard), OS(&OS)
+  : Discard(Discard), S(S), Owner(&Owner)
 {
   if (!Discard)
     Buffer << Prefix;
@@ -59,7 +360,7 @@ Logger::OutputBuffer::OutputBuffer(std::ostream& OS,
 Logger::OutputBuffer::~OutputBuffer() noexcept(false)
 {
   if (!Discard)
-    (*OS) << Buffer.str() << std::endl;
+    Owner->emit(S, Buffer.str());
 }
 
 std::unique_ptr<Logger> Logger::Singleton;
@@ -91,21 +392,71 @@ std::size_t Logger::digits(std::size_t Number)
 
 Logger::Logger(Severity S, std::ostream& OS) : SeverityLimit(S), OS(&OS) {}
 
-Logger::OutputBuffer Logger::operator()(Severity S, std::string_view Facility)
+Logger::~Logger() { stopAsync(); }
+
+void Logger::setLimit(Severity Limit) noexcept
 {
-  std::ostringstream LogPrefix;
-  bool Discarding = S > getLimit();
-  if (!Discarding)
+  SeverityLimit = Limit;
+  if (this == Singleton.get())
+    FacilityRegistry::get().setDefaultLimit(Limit);
+}
+
+void Logger::startAsync(int FD, std::size_t Capacity, DropPolicy Policy)
+{
+  static std::once_flag AtForkRegistered;
+  std::call_once(AtForkRegistered, [] {
+    ::pthread_atfork(nullptr, nullptr, &Logger::forgetAsyncAfterFork);
+  });
+
+  stopAsync();
+  (*OS) << std::flush;
+  Async = std::make_unique<AsyncWriter>(FD, Capacity, Policy);
+}
+
+void Logger::stopAsync() noexcept { Async.reset(); }
+
+void Logger::forgetAsyncAfterFork() noexcept
+{
+  // The writer thread is not running in the child, so the writer can not be
+  // destroyed (that would wait for the thread) either. Leak it instead.
+  if (Singleton)
+    (void)Singleton->Async.release();
+}
+
+std::uint64_t Logger::droppedRecords() const noexcept
+{
+  return Async ? Async->dropped() : 0;
+}
+
+void Logger::emit(Severity S, std::string Line)
+{
+  if (!Async)
   {
-    LogPrefix << '[' << formatTime(std::chrono::system_clock::now()) << ']';
-    if (std::string_view SN = SeverityName[S]; !SN.empty())
-      LogPrefix << '[' << SN << "] ";
-    if (!Facility.empty())
-      LogPrefix << Facility << ": ";
-    else
-      LogPrefix << "?: ";
+    (*OS) << Line << std::endl;
+    return;
   }
-  return OutputBuffer{*OS, Discarding, LogPrefix.str()};
+
+  Line.push_back('\n');
+  Async->push(std::move(Line));
+  if (S <= Fatal)
+  {
+    // The process is likely about to die, give the writer a chance to put the
+    // message out.
+    static constexpr std::chrono::milliseconds FatalFlushTimeout{500};
+    Async->flush(FatalFlushTimeout);
+  }
+}
+
+Logger::OutputBuffer Logger::operator()(Severity S, std::string_view Facility)
+{
+  bool Discarding = S > getLimit();
+  return OutputBuffer{
+    *this, Discarding, S, Discarding ? "" : formatPrefix(S, Facility)};
+}
+
+Logger::OutputBuffer Logger::operator()(Severity S, const Facility& F)
+{
+  return OutputBuffer{*this, false, S, formatPrefix(S, F.name())};
 }
 
 } // namespace monomux::log
@@ -16,6 +16,7 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <csignal>
 #include <utility>
 
 #include "monomux/control/Message.hpp"
@@ -25,7 +26,7 @@
 #include "monomux/client/Client.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("client/Client")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "client/Client")
 
 namespace monomux::client
 {
@@ -227,6 +228,12 @@ void Client::loop()
   enableControlResponse();
   enableDataSocket();
   enableInputFile();
+  if (SynchronousSignals)
+  {
+    Signals = std::make_unique<SignalFD>(
+      std::initializer_list<SignalFD::Signal>{SIGWINCH, SIGTERM, SIGHUP});
+    Poll->listen(Signals->raw(), /* Incoming =*/true, /* Outgoing =*/false);
+  }
 
   while (!TerminateLoop.get().load())
   {
@@ -289,6 +296,14 @@ void Client::loop()
           controlCallback();
           continue;
         }
+        if (Signals && Event.FD == Signals->raw())
+        {
+          signalCallback();
+          if (Exit != None)
+            // (Exiting tears down the Poll.)
+            break;
+          continue;
+        }
       }
       catch (const buffer_overflow& BO)
       {
@@ -302,6 +317,7 @@ void Client::loop()
     }
   }
 
+  Signals.reset();
   disableInputFile();
   disableDataSocket();
   disableControlResponse();
@@ -386,6 +402,29 @@ void Client::setExternalEventProcessor(std::function<RawCallbackFn> Callback)
   ExternalEventProcessor = std::move(Callback);
 }
 
+void Client::setSignalCallback(std::function<SignalCallbackFn> Callback)
+{
+  SignalHandler = std::move(Callback);
+}
+
+void Client::signalCallback()
+{
+  while (std::optional<struct ::signalfd_siginfo> Info = Signals->read())
+  {
+    const auto SigNum = static_cast<SignalFD::Signal>(Info->ssi_signo);
+    MONOMUX_TRACE_LOG(LOG(trace) << "Received signal " << SigNum);
+    if (SignalHandler)
+      SignalHandler(*this, SigNum);
+
+    if (SigNum == SIGTERM)
+      exit(Terminated, 0, "");
+    else if (SigNum == SIGHUP)
+      exit(Hangup, 0, "");
+    if (Exit != None)
+      return;
+  }
+}
+
 void Client::exit(ExitReason E, int ECode, std::string Message)
 {
   if (Exit != None)
@@ -433,6 +472,25 @@ std::optional<std::vector<SessionData>> Client::requestSessionList()
   return R;
 }
 
+/// Converts the \p Opts of a session's program to the form transmitted to the
+/// server.
+static monomux::message::ProcessSpawnOptions
+toTransmittedOptions(Process::SpawnOptions& Opts)
+{
+  monomux::message::ProcessSpawnOptions R;
+  R.Program = std::move(Opts.Program);
+  R.Arguments = std::move(Opts.Arguments);
+  for (std::pair<const std::string, std::optional<std::string>>& E :
+       Opts.Environment)
+  {
+    if (!E.second)
+      R.UnsetEnvironment.emplace_back(E.first);
+    else
+      R.SetEnvironment.emplace_back(E.first, std::move(*E.second));
+  }
+  return R;
+}
+
 std::optional<std::string>
 Client::requestMakeSession(std::string Name, Process::SpawnOptions Opts)
 {
@@ -441,16 +499,7 @@ Client::requestMakeSession(std::string Name, Process::SpawnOptions Opts)
 
   request::MakeSession Msg;
   Msg.Name = std::move(Name);
-  Msg.SpawnOpts.Program = std::move(Opts.Program);
-  Msg.SpawnOpts.Arguments = std::move(Opts.Arguments);
-  for (std::pair<const std::string, std::optional<std::string>>& E :
-       Opts.Environment)
-  {
-    if (!E.second)
-      Msg.SpawnOpts.UnsetEnvironment.emplace_back(E.first);
-    else
-      Msg.SpawnOpts.SetEnvironment.emplace_back(E.first, std::move(*E.second));
-  }
+  Msg.SpawnOpts = toTransmittedOptions(Opts);
   sendMessage(ControlSocket, Msg);
 
   std::optional<response::MakeSession> Resp =
@@ -461,13 +510,98 @@ Client::requestMakeSession(std::string Name, Process::SpawnOptions Opts)
   return std::move(Resp->Name);
 }
 
-bool Client::requestAttach(std::string SessionName)
+std::optional<std::vector<std::optional<std::string>>>
+Client::requestMakeSessionBatch(
+  std::vector<std::pair<std::string, Process::SpawnOptions>> Sessions)
+{
+  using namespace monomux::message;
+  auto X = inhibitControlResponse();
+
+  request::MakeSessionBatch Msg;
+  Msg.Sessions.reserve(Sessions.size());
+  for (std::pair<std::string, Process::SpawnOptions>& S : Sessions)
+  {
+    request::MakeSession& Item = Msg.Sessions.emplace_back();
+    Item.Name = std::move(S.first);
+    Item.SpawnOpts = toTransmittedOptions(S.second);
+  }
+  sendMessage(ControlSocket, Msg);
+
+  std::optional<response::MakeSessionBatch> Resp =
+    receiveMessage<response::MakeSessionBatch>(ControlSocket);
+  if (!Resp)
+    return std::nullopt;
+
+  std::vector<std::optional<std::string>> R;
+  R.reserve(Resp->Results.size());
+  for (SessionResult& Result : Resp->Results)
+  {
+    if (Result.Success)
+      R.emplace_back(std::move(Result.Name));
+    else
+      R.emplace_back(std::nullopt);
+  }
+  return R;
+}
+
+std::optional<std::vector<bool>>
+Client::requestSignalSessions(int Signal, std::vector<std::string> SessionNames)
+{
+  using namespace monomux::message;
+  auto X = inhibitControlResponse();
+
+  request::SignalSessionsBatch Msg;
+  Msg.SigNum = Signal;
+  Msg.Names = std::move(SessionNames);
+  sendMessage(ControlSocket, Msg);
+
+  std::optional<response::SignalSessionsBatch> Resp =
+    receiveMessage<response::SignalSessionsBatch>(ControlSocket);
+  if (!Resp)
+    return std::nullopt;
+
+  std::vector<bool> R;
+  R.reserve(Resp->Results.size());
+  for (const SessionResult& Result : Resp->Results)
+    R.emplace_back(Result.Success);
+  return R;
+}
+
+std::optional<std::vector<bool>>
+Client::requestDestroySessions(std::vector<std::string> SessionNames)
+{
+  using namespace monomux::message;
+  auto X = inhibitControlResponse();
+
+  request::DestroySessionsBatch Msg;
+  Msg.Names = std::move(SessionNames);
+  sendMessage(ControlSocket, Msg);
+
+  std::optional<response::DestroySessionsBatch> Resp =
+    receiveMessage<response::DestroySessionsBatch>(ControlSocket);
+  if (!Resp)
+    return std::nullopt;
+
+  std::vector<bool> R;
+  R.reserve(Resp->Results.size());
+  for (const SessionResult& Result : Resp->Results)
+    R.emplace_back(Result.Success);
+  return R;
+}
+
+bool Client::requestAttach(std::string SessionName,
+                           std::optional<ResumePoint> Resume)
 {
   using namespace monomux::message;
   auto X = inhibitControlResponse();
 
   request::Attach Msg;
   Msg.Name = std::move(SessionName);
+  if (Resume)
+  {
+    Msg.ResumeToken = Resume->Token;
+    Msg.ResumeOffset = Resume->Offset;
+  }
   sendMessage(ControlSocket, Msg);
 
   std::optional<response::Attach> Resp =
@@ -485,11 +619,31 @@ bool Client::requestAttach(std::string SessionName)
     AttachedSession->Name = std::move(Resp->Session.Name);
     AttachedSession->Created =
       std::chrono::system_clock::from_time_t(std::move(Resp->Session.Created));
+
+    if (Resp->StreamToken)
+      Stream.emplace(ResumePoint{Resp->StreamToken, Resp->Offset});
+    else
+      Stream.reset();
   }
 
   return Attached;
 }
 
+std::string Client::receiveData(std::size_t Bytes)
+{
+  if (!DataSocket)
+  {
+    LOG(error)
+      << "Trying to receiveData() but the connection was not established";
+    return {};
+  }
+
+  std::string Data = DataSocket->read(Bytes);
+  if (Stream)
+    Stream->Offset += Data.size();
+  return Data;
+}
+
 void Client::sendData(std::string_view Data)
 {
   if (!DataSocket)
@@ -70,4 +70,64 @@ std::string ControlClient::requestStatistics()
   return std::move(Response)->Contents;
 }
 
+monomux::message::response::Metrics
+ControlClient::requestMetrics(std::string Session)
+{
+  using namespace monomux::message;
+
+  auto X = BackingClient.inhibitControlResponse();
+  sendMessage(BackingClient.getControlSocket(),
+              request::Metrics{std::move(Session)});
+  auto Response =
+    receiveMessage<response::Metrics>(BackingClient.getControlSocket());
+
+  if (!Response)
+    throw std::runtime_error{"Failed to receive a valid response!"};
+  return std::move(*Response);
+}
+
+monomux::message::response::Search
+ControlClient::requestSearch(monomux::message::request::Search Request)
+{
+  using namespace monomux::message;
+
+  auto X = BackingClient.inhibitControlResponse();
+  sendMessage(BackingClient.getControlSocket(), std::move(Request));
+  auto Response =
+    receiveMessage<response::Search>(BackingClient.getControlSocket());
+
+  if (!Response)
+    throw std::runtime_error{"Failed to receive a valid response!"};
+  return std::move(*Response);
+}
+
+std::string ControlClient::requestTrace()
+{
+  using namespace monomux::message;
+
+  auto X = BackingClient.inhibitControlResponse();
+  sendMessage(BackingClient.getControlSocket(), request::Trace{});
+  auto Response =
+    receiveMessage<response::Trace>(BackingClient.getControlSocket());
+
+  if (!Response)
+    throw std::runtime_error{"Failed to receive a valid response!"};
+  return std::move(Response)->Data;
+}
+
+monomux::message::response::LogLevel
+ControlClient::requestLogLevel(monomux::message::request::LogLevel Request)
+{
+  using namespace monomux::message;
+
+  auto X = BackingClient.inhibitControlResponse();
+  sendMessage(BackingClient.getControlSocket(), Request);
+  auto Response =
+    receiveMessage<response::LogLevel>(BackingClient.getControlSocket());
+
+  if (!Response)
+    throw std::runtime_error{"Failed to receive a valid response!"};
+  return std::move(*Response);
+}
+
 } // namespace monomux::client
@@ -21,7 +21,7 @@
 #include "monomux/control/Message.hpp"
 #include "monomux/unreachable.hpp"
 
-#define LOG(SEVERITY) monomux::log::SEVERITY("client/Dispatch")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "client/Dispatch")
 
 using namespace monomux::message;
 
@@ -16,10 +16,15 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+#include <cctype>
 #include <chrono>
+#include <fstream>
 #include <iostream>
+#include <system_error>
 #include <thread>
 
+#include "monomux/adt/Histogram.hpp"
 #include "monomux/adt/Lazy.hpp"
 #include "monomux/adt/ScopeGuard.hpp"
 #include "monomux/client/Client.hpp"
@@ -36,7 +41,7 @@
 #include "monomux/client/Main.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("client/Main")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "client/Main")
 
 namespace monomux::client
 {
@@ -44,7 +49,7 @@ namespace monomux::client
 Options::Options()
   : ClientMode(false), OnlyListSessions(false), InteractiveSessionMenu(false),
     DetachRequestLatest(false), DetachRequestAll(false),
-    StatisticsRequest(false)
+    StatisticsRequest(false), MetricsRequest(false)
 {}
 
 std::vector<std::string> Options::toArgv() const
@@ -73,6 +78,28 @@ std::vector<std::string> Options::toArgv() const
     Ret.emplace_back("--detach-all");
   if (StatisticsRequest)
     Ret.emplace_back("--statistics");
+  if (MetricsRequest)
+    Ret.emplace_back("--metrics");
+  if (TraceOutput.has_value())
+  {
+    Ret.emplace_back("--trace");
+    Ret.emplace_back(*TraceOutput);
+  }
+  if (LogLevelSpec.has_value())
+  {
+    Ret.emplace_back("--log-level");
+    Ret.emplace_back(*LogLevelSpec);
+  }
+  if (SearchPattern.has_value())
+  {
+    Ret.emplace_back("--search");
+    Ret.emplace_back(*SearchPattern);
+    if (SearchContext)
+    {
+      Ret.emplace_back("--context");
+      Ret.emplace_back(std::to_string(SearchContext));
+    }
+  }
 
   if (Program)
   {
@@ -102,33 +129,57 @@ std::vector<std::string> Options::toArgv() const
 
 bool Options::isControlMode() const noexcept
 {
-  return DetachRequestLatest || DetachRequestAll || StatisticsRequest;
+  return DetachRequestLatest || DetachRequestAll || StatisticsRequest ||
+         MetricsRequest || TraceOutput.has_value() ||
+         LogLevelSpec.has_value() || SearchPattern.has_value();
 }
 
-std::optional<Client>
-connect(Options& Opts, bool Block, std::string* FailureReason)
+std::optional<Client> connect(Options& Opts, std::string* FailureReason)
 {
-  auto C = Client::create(*Opts.SocketPath, FailureReason);
-  if (!Block)
-    return C;
+  return Client::create(*Opts.SocketPath, FailureReason);
+}
 
+std::optional<Socket> listenForServer(Options& Opts,
+                                      std::size_t ListenQueue,
+                                      std::string* FailureReason)
+{
+  // The winner of the race binds the socket before it starts listening, and
+  // connections are refused in between.
   static constexpr std::size_t MaxConnectTries = 16;
-  unsigned short ConnectCounter = 0;
-  while (!C)
+  static constexpr std::chrono::milliseconds ConnectRetryDelay{10};
+
+  try
+  {
+    Socket Listener = Socket::create(*Opts.SocketPath);
+    Listener.listen(ListenQueue);
+    return Listener;
+  }
+  catch (const std::system_error& SE)
+  {
+    if (FailureReason)
+      *FailureReason = SE.what();
+    if (SE.code() != std::errc::address_in_use)
+      return std::nullopt;
+  }
+
+  LOG(debug) << "Socket was bound by another process, connecting to it...";
+  for (std::size_t Try = 0; Try < MaxConnectTries; ++Try)
   {
-    ++ConnectCounter;
-    if (ConnectCounter == MaxConnectTries)
+    try
     {
-      if (FailureReason)
-        *FailureReason = "Connection failed after enough retries.";
+      Opts.Connection = connect(Opts, FailureReason);
       return std::nullopt;
     }
-
-    C = Client::create(*Opts.SocketPath, FailureReason);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    catch (const std::system_error& SE)
+    {
+      if (FailureReason)
+        *FailureReason = SE.what();
+      if (SE.code() != std::errc::connection_refused)
+        return std::nullopt;
+    }
+    std::this_thread::sleep_for(ConnectRetryDelay);
   }
-
-  return C;
+  return std::nullopt;
 }
 
 bool makeWholeWithData(Client& Client, std::string* FailureReason)
@@ -183,6 +234,7 @@ SessionSelectionResult selectSession(const std::string& ClientID,
                                      bool Interactive);
 ExitCode mainForControlClient(Options& Opts);
 ExitCode handleSessionCreateOrAttach(Options& Opts);
+bool reconnect(Options& Opts, Terminal& Term);
 int handleClientExitStatus(const Client& Client);
 
 void windowSizeChange(SignalHandling::Signal SigNum,
@@ -285,7 +337,12 @@ int main(Options& Opts)
     ScopeGuard TermIO{[&Term] { Term.engage(); },
                       [&Term] { Term.disengage(); }};
 
+    // The handlers above only serve outside of the loop.
+    Client.setSynchronousSignals(true);
     Client.loop();
+    while (Client.exitReason() == Client::Failed && reconnect(Opts, Term))
+      // (Client refers to the new connection, which replaced the old one.)
+      Client.loop();
   }
 
   LOG(trace) << "Client stopped...";
@@ -426,9 +483,297 @@ SessionSelectionResult selectSession(const std::string& ClientID,
   return {Sessions.at(UserChoice - 1).Name, SessionSelectionResult::Attach};
 }
 
+/// Prints the \p Metrics in a line-based "name{labels} value" format.
+void printMetrics(const monomux::message::response::Metrics& Metrics)
+{
+  using namespace monomux::message;
+
+  const auto PrintLatency = [](const std::string& Prefix,
+                               const std::string& Labels,
+                               const LatencyMetrics& LM) {
+    std::cout << Prefix << "_count" << Labels << ' ' << LM.Count << '\n'
+              << Prefix << "_sum" << Labels << ' ' << LM.Sum << '\n'
+              << Prefix << "_max" << Labels << ' ' << LM.Max << '\n';
+
+    std::string QuantileLabels = Labels.empty()
+                                   ? std::string{"{"}
+                                   : Labels.substr(0, Labels.size() - 1) + ',';
+    static constexpr std::pair<double, const char*> Quantiles[] = {
+      {0.5, "0.5"}, {0.9, "0.9"}, {0.99, "0.99"}};
+    for (const auto& Quantile : Quantiles)
+    {
+      // The values are the upper bounds of the bucket the quantile falls into.
+      auto Rank = static_cast<std::uint64_t>(Quantile.first * LM.Count);
+      Rank = std::max<std::uint64_t>(Rank, 1);
+      std::uint64_t Seen = 0;
+      std::uint64_t Value = 0;
+      for (const auto& Bucket : LM.Buckets)
+      {
+        Seen += Bucket.second;
+        if (Seen >= Rank)
+        {
+          Value = std::min(LatencyHistogram::bucketUpperBound(Bucket.first),
+                           LM.Max);
+          break;
+        }
+      }
+      std::cout << Prefix << QuantileLabels << "quantile=\"" << Quantile.second
+                << "\"} " << Value << '\n';
+    }
+  };
+
+  const auto PrintBuffer = [](const std::string& Prefix,
+                              const std::string& Labels,
+                              const BufferMetrics& BM) {
+    std::cout << Prefix << "_size" << Labels << ' ' << BM.Size << '\n'
+              << Prefix << "_capacity" << Labels << ' ' << BM.Capacity << '\n'
+              << Prefix << "_peak" << Labels << ' ' << BM.Peak << '\n';
+  };
+
+  std::cout << "monomux_loop_iterations " << Metrics.LoopIterations << '\n'
+            << "monomux_clients_kicked " << Metrics.ClientsKicked << '\n'
+            << "monomux_overflows " << Metrics.Overflows << '\n'
+            << "monomux_clients " << Metrics.ClientCount << '\n'
+            << "monomux_sessions " << Metrics.SessionCount << '\n'
+            << "monomux_channel_buffers " << Metrics.ChannelBuffers << '\n'
+            << "monomux_channel_buffer_bytes " << Metrics.ChannelBufferBytes
+            << '\n'
+            << "monomux_pooled_buffers " << Metrics.PooledBuffers << '\n'
+            << "monomux_pooled_buffer_bytes " << Metrics.PooledBufferBytes
+            << '\n';
+  PrintLatency("monomux_loop_iteration_ns", "", Metrics.LoopIteration);
+
+  for (const SessionMetrics& SM : Metrics.Sessions)
+  {
+    std::string Labels = "{session=\"" + SM.Name + "\"}";
+    std::cout << "monomux_session_bytes_in" << Labels << ' ' << SM.BytesIn
+              << '\n'
+              << "monomux_session_bytes_out" << Labels << ' ' << SM.BytesOut
+              << '\n'
+              << "monomux_session_overflows" << Labels << ' ' << SM.Overflows
+              << '\n'
+              << "monomux_session_attached_clients" << Labels << ' '
+              << SM.AttachedClients << '\n';
+    PrintBuffer("monomux_session_reader_buffer", Labels, SM.Reader);
+    PrintBuffer("monomux_session_writer_buffer", Labels, SM.Writer);
+    PrintLatency("monomux_session_read_to_send_ns", Labels, SM.ReadToSend);
+  }
+
+  for (const ClientMetrics& CM : Metrics.Clients)
+  {
+    std::string Labels = "{client=\"" + std::to_string(CM.ID) +
+                         "\",session=\"" + CM.Session + "\"}";
+    std::cout << "monomux_client_bytes_in" << Labels << ' ' << CM.BytesIn
+              << '\n'
+              << "monomux_client_bytes_out" << Labels << ' ' << CM.BytesOut
+              << '\n'
+              << "monomux_client_overflows" << Labels << ' ' << CM.Overflows
+              << '\n';
+    PrintBuffer("monomux_client_data_read_buffer", Labels, CM.DataRead);
+    PrintBuffer("monomux_client_data_write_buffer", Labels, CM.DataWrite);
+    PrintLatency("monomux_client_read_to_send_ns", Labels, CM.ReadToSend);
+    PrintLatency("monomux_client_write_queue_ns", Labels, CM.WriteQueue);
+  }
+  std::cout << std::flush;
+}
+
+/// \returns the bare, lowercase name of the severity \p S.
+std::string levelTag(int S)
+{
+  std::string_view Tag = log::Logger::levelName(static_cast<log::Severity>(S));
+  Tag.remove_prefix(std::min(Tag.find_first_not_of("!> "), Tag.size()));
+  std::string Ret{Tag.substr(0, Tag.find(' '))};
+  if (Ret.empty())
+    return "none";
+  std::transform(Ret.begin(), Ret.end(), Ret.begin(), [](char C) {
+    return static_cast<char>(std::tolower(C));
+  });
+  return Ret;
+}
+
+/// Parses the \p Name of a severity, or \p -1 for \p "default".
+std::optional<int> parseLogLevel(std::string_view Name)
+{
+  if (Name == "default")
+    return -1;
+  for (int S = log::Max; S <= log::Min; ++S)
+    if (levelTag(S) == Name)
+      return S;
+  return std::nullopt;
+}
+
+/// Handles \p --log-level.
+ExitCode logLevelForControlClient(Options& Opts)
+{
+  using namespace monomux::message;
+  request::LogLevel Req;
+  std::string_view Spec = *Opts.LogLevelSpec;
+  if (Spec != "list")
+  {
+    std::string_view Facility;
+    std::string_view Level = Spec;
+    if (auto Eq = Spec.rfind('='); Eq != std::string_view::npos)
+    {
+      Facility = Spec.substr(0, Eq);
+      Level = Spec.substr(Eq + 1);
+    }
+
+    std::optional<int> L = parseLogLevel(Level);
+    if (!L || (Facility.empty() && *L == -1))
+    {
+      std::cerr << "Invalid log level '" << Level << "'" << std::endl;
+      return EXIT_InvocationError;
+    }
+    Req.Change = true;
+    Req.Facility = Facility;
+    Req.Level = *L;
+  }
+
+  ControlClient CC{*Opts.Connection};
+  try
+  {
+    response::LogLevel Resp = CC.requestLogLevel(std::move(Req));
+    std::cout << "default: " << levelTag(Resp.DefaultLevel) << '\n';
+    for (const FacilityLevel& F : Resp.Facilities)
+      std::cout << F.Name << ": " << levelTag(F.Level)
+                << (F.Explicit ? "" : " (default)") << '\n';
+    std::cout << std::flush;
+
+    if (!Resp.Success)
+    {
+      std::cerr << "The server rejected the change: the facility is unknown "
+                   "or the level is invalid."
+                << std::endl;
+      return EXIT_SystemError;
+    }
+    return EXIT_Success;
+  }
+  catch (const std::runtime_error& Err)
+  {
+    std::cerr << Err.what() << std::endl;
+    return EXIT_SystemError;
+  }
+}
+
+/// Handles \p --search.
+ExitCode searchForControlClient(Options& Opts)
+{
+  using namespace monomux::message;
+  request::Search Req;
+  Req.Pattern = *Opts.SearchPattern;
+  Req.Session = Opts.SessionName.value_or("");
+  Req.Context = Opts.SearchContext;
+  if (Req.Pattern.empty())
+  {
+    std::cerr << "The search pattern must not be empty!" << std::endl;
+    return EXIT_InvocationError;
+  }
+
+  ControlClient CC{*Opts.Connection};
+  try
+  {
+    response::Search Resp = CC.requestSearch(std::move(Req));
+    if (!Resp.Success)
+    {
+      std::cerr << "The server rejected the search: session \""
+                << *Opts.SessionName << "\" does not exist." << std::endl;
+      return EXIT_InvocationError;
+    }
+    for (std::size_t I = 0; I < Resp.Matches.size(); ++I)
+    {
+      const SearchMatch& M = Resp.Matches.at(I);
+      if (Opts.SearchContext && I)
+        std::cout << "--\n";
+
+      // Like grep(1), the line of the match is marked with ':', and the lines
+      // around it with '-'. Terminals emit "\r\n", which is trimmed.
+      std::string_view Lines = M.Context;
+      std::size_t Pos = 0;
+      do
+      {
+        std::size_t NL = Lines.find('\n', Pos);
+        std::string_view Line = Lines.substr(Pos, NL - Pos);
+        const bool Matching =
+          M.Position >= Pos &&
+          (NL == std::string_view::npos || M.Position <= NL);
+        Pos = NL == std::string_view::npos ? Lines.size() : NL + 1;
+        if (!Line.empty() && Line.back() == '\r')
+          Line.remove_suffix(1);
+
+        const char Mark = Matching ? ':' : '-';
+        std::cout << M.Session << Mark << M.Offset << Mark << ' ' << Line
+                  << '\n';
+      } while (Pos < Lines.size());
+    }
+    std::cout << std::flush;
+
+    if (Resp.Truncated)
+      std::cerr << "(More matches were found than reported.)" << std::endl;
+    return Resp.Matches.empty() ? EXIT_Failure : EXIT_Success;
+  }
+  catch (const std::runtime_error& Err)
+  {
+    std::cerr << Err.what() << std::endl;
+    return EXIT_SystemError;
+  }
+}
+
 /// Handles operations through a \p ControlClient -only connection.
 ExitCode mainForControlClient(Options& Opts)
 {
+  if (Opts.LogLevelSpec)
+    return logLevelForControlClient(Opts);
+
+  if (Opts.SearchPattern)
+    return searchForControlClient(Opts);
+
+  if (Opts.TraceOutput)
+  {
+    ControlClient CC{*Opts.Connection};
+    try
+    {
+      std::string Trace = CC.requestTrace();
+      if (*Opts.TraceOutput == "-")
+      {
+        std::cout.write(Trace.data(),
+                        static_cast<std::streamsize>(Trace.size()));
+        std::cout << std::flush;
+        return EXIT_Success;
+      }
+
+      std::ofstream File{*Opts.TraceOutput,
+                         std::ios::binary | std::ios::trunc};
+      File.write(Trace.data(), static_cast<std::streamsize>(Trace.size()));
+      if (!File)
+      {
+        std::cerr << "Failed to write trace to '" << *Opts.TraceOutput << "'"
+                  << std::endl;
+        return EXIT_SystemError;
+      }
+      return EXIT_Success;
+    }
+    catch (const std::runtime_error& Err)
+    {
+      std::cerr << Err.what() << std::endl;
+      return EXIT_SystemError;
+    }
+  }
+
+  if (Opts.MetricsRequest)
+  {
+    ControlClient CC{*Opts.Connection};
+    try
+    {
+      printMetrics(CC.requestMetrics(Opts.SessionName.value_or("")));
+      return EXIT_Success;
+    }
+    catch (const std::runtime_error& Err)
+    {
+      std::cerr << Err.what() << std::endl;
+      return EXIT_SystemError;
+    }
+  }
+
   if (Opts.StatisticsRequest)
   {
     ControlClient CC{*Opts.Connection};
@@ -537,6 +882,45 @@ ExitCode handleSessionCreateOrAttach(Options& Opts)
   return EXIT_Success;
 }
 
+/// Attempts to establish a new connection in place of the lost
+/// \p Opts.Connection, and to reattach to the session the client was attached
+/// to, resuming the output from where the lost connection stopped, so no output
+/// is lost or repeated if the server still retains it.
+///
+/// \returns whether the client is attached again.
+bool reconnect(Options& Opts, Terminal& Term)
+{
+  static constexpr std::size_t MaxReconnectTries = 5;
+  const SessionData* Session = Opts.Connection->attachedSession();
+  if (!Session)
+    return false;
+  const std::string SessionName = Session->Name;
+  const std::optional<Client::ResumePoint> Resume =
+    Opts.Connection->resumePoint();
+
+  for (std::size_t Try = 0; Try < MaxReconnectTries; ++Try)
+  {
+    if (Try)
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    std::optional<Client> C = connect(Opts, nullptr);
+    if (!C || !makeWholeWithData(*C, nullptr) ||
+        !C->requestAttach(SessionName, Resume))
+      continue;
+
+    Term.releaseClient();
+    Opts.Connection.emplace(std::move(*C));
+    Client& Client = *Opts.Connection;
+    Term.setupClient(Client);
+    Client.setSynchronousSignals(true);
+
+    Terminal::Size S = Term.getSize();
+    Client.notifyWindowSize(S.Rows, S.Columns);
+    return true;
+  }
+  return false;
+}
+
 int handleClientExitStatus(const Client& Client)
 {
   std::cout << std::endl;
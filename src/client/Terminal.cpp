@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <cassert>
+#include <csignal>
 #include <functional>
 #include <sstream>
 
@@ -30,7 +31,7 @@
 #include "monomux/client/Terminal.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("client/Terminal")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "client/Terminal")
 
 namespace monomux::client
 {
@@ -133,7 +134,7 @@ void Terminal::clientOutput(Terminal* Term, Client& Client)
          "Terminal object registered as callback was moved.");
 
   static constexpr std::size_t ReadSize = BUFSIZ;
-  std::string Output = Client.getDataSocket()->read(ReadSize);
+  std::string Output = Client.receiveData(ReadSize);
   Term->output()->write(Output);
 
   while (Term->output()->hasBufferedWrite())
@@ -154,6 +155,18 @@ void Terminal::clientEventReady(Terminal* Term, Client& Client)
   }
 }
 
+void Terminal::clientSignal(Terminal* Term, Client& Client, int SigNum)
+{
+  assert(Term->MovedFromCheck &&
+         "Terminal object registered as callback was moved.");
+
+  if (SigNum == SIGWINCH)
+  {
+    Term->notifySizeChanged();
+    clientEventReady(Term, Client);
+  }
+}
+
 void Terminal::setupClient(Client& Client)
 {
   if (AssociatedClient)
@@ -169,6 +182,12 @@ void Terminal::setupClient(Client& Client)
   Client.setExternalEventProcessor(
     // NOLINTNEXTLINE(modernize-avoid-bind)
     std::bind(&Terminal::clientEventReady, this, std::placeholders::_1));
+  Client.setSignalCallback(
+    // NOLINTNEXTLINE(modernize-avoid-bind)
+    std::bind(&Terminal::clientSignal,
+              this,
+              std::placeholders::_1,
+              std::placeholders::_2));
 
   AssociatedClient = &Client;
 }
@@ -181,6 +200,7 @@ void Terminal::releaseClient()
   AssociatedClient->setDataCallback({});
   AssociatedClient->setInputCallback({});
   AssociatedClient->setExternalEventProcessor({});
+  AssociatedClient->setSignalCallback({});
   AssociatedClient->setInputFile(fd::Invalid);
 
   AssociatedClient = nullptr;
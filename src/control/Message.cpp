@@ -16,6 +16,8 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+#include <charconv>
 #include <cstring>
 #include <sstream>
 
@@ -23,7 +25,7 @@
 #include "monomux/control/PascalString.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("control/Message")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "control/Message")
 
 #define DECODE(NAME) std::optional<NAME> NAME::decode(std::string_view Buffer)
 #define ENCODE(NAME) std::string NAME::encode(const NAME& Object)
@@ -166,6 +168,66 @@ std::string_view takeUntilAndConsume(std::string_view& Data,
   return Match;
 }
 
+/// Formats \p Numbers into \p OS as a space-separated list.
+template <typename... Ts>
+void writeNumbers(std::ostream& OS, const Ts&... Numbers)
+{
+  bool First = true;
+  auto WriteOne = [&OS, &First](const auto& N) {
+    if (!First)
+      OS << ' ';
+    OS << N;
+    First = false;
+  };
+  (WriteOne(Numbers), ...);
+}
+
+/// Parses the space-separated list of integers in \p Data into the
+/// \p Numbers, in order.
+///
+/// \returns whether \p Data contained exactly as many well-formed numbers as
+/// requested.
+template <typename... Ts>
+bool readNumbers(std::string_view Data, Ts&... Numbers)
+{
+  bool Success = true;
+  auto ReadOne = [&Data, &Success](auto& N) {
+    if (!Success)
+      return;
+    std::string_view Token = Data.substr(0, Data.find(' '));
+    auto Result = std::from_chars(Token.data(), Token.data() + Token.size(), N);
+    if (Token.empty() || Result.ec != std::errc{} ||
+        Result.ptr != Token.data() + Token.size())
+    {
+      Success = false;
+      return;
+    }
+    Data.remove_prefix(std::min(Token.size() + 1, Data.size()));
+  };
+  (ReadOne(Numbers), ...);
+  return Success && Data.empty();
+}
+
+/// Parses the space-separated list of unsigned numbers in \p Data, of any
+/// length, into \p Numbers.
+///
+/// \returns whether every element of the list was a well-formed number.
+bool readNumberList(std::string_view Data, std::vector<std::uint64_t>& Numbers)
+{
+  while (!Data.empty())
+  {
+    std::uint64_t N;
+    std::string_view Token = Data.substr(0, Data.find(' '));
+    auto Result = std::from_chars(Token.data(), Token.data() + Token.size(), N);
+    if (Token.empty() || Result.ec != std::errc{} ||
+        Result.ptr != Token.data() + Token.size())
+      return false;
+    Numbers.emplace_back(N);
+    Data.remove_prefix(std::min(Token.size() + 1, Data.size()));
+  }
+  return true;
+}
+
 } // namespace
 
 #define CONSUME_OR_NONE(LITERAL)                                               \
@@ -397,6 +459,265 @@ DECODE_BASE(Boolean)
   return Ret;
 }
 
+ENCODE_BASE(BufferMetrics)
+{
+  std::ostringstream Buf;
+  Buf << "<BUF>";
+  writeNumbers(Buf, Object.Size, Object.Capacity, Object.Peak);
+  Buf << "</BUF>";
+  return Buf.str();
+}
+DECODE_BASE(BufferMetrics)
+{
+  BufferMetrics Ret;
+  HEADER_OR_NONE("<BUF>");
+
+  EXTRACT_OR_NONE(Numbers, "</BUF>");
+  if (!readNumbers(Numbers, Ret.Size, Ret.Capacity, Ret.Peak))
+    return std::nullopt;
+
+  Buffer = View;
+  return Ret;
+}
+
+ENCODE_BASE(LatencyMetrics)
+{
+  std::ostringstream Buf;
+  Buf << "<H>";
+  writeNumbers(Buf, Object.Count, Object.Sum, Object.Max);
+  for (const auto& Bucket : Object.Buckets)
+  {
+    Buf << ' ';
+    writeNumbers(Buf, Bucket.first, Bucket.second);
+  }
+  Buf << "</H>";
+  return Buf.str();
+}
+DECODE_BASE(LatencyMetrics)
+{
+  LatencyMetrics Ret;
+  HEADER_OR_NONE("<H>");
+
+  EXTRACT_OR_NONE(NumbersStr, "</H>");
+  std::vector<std::uint64_t> Numbers;
+  if (!readNumberList(NumbersStr, Numbers) || Numbers.size() < 3 ||
+      Numbers.size() % 2 != 1)
+    return std::nullopt;
+  Ret.Count = Numbers[0];
+  Ret.Sum = Numbers[1];
+  Ret.Max = Numbers[2];
+  Ret.Buckets.reserve((Numbers.size() - 3) / 2);
+  for (std::size_t I = 3; I < Numbers.size(); I += 2)
+    Ret.Buckets.emplace_back(Numbers[I], Numbers[I + 1]);
+
+  Buffer = View;
+  return Ret;
+}
+
+ENCODE_BASE(SessionMetrics)
+{
+  std::ostringstream Buf;
+  Buf << "<SM Size=\"" << Object.Name.size() << "\">" << Object.Name;
+  Buf << "<N>";
+  writeNumbers(Buf,
+               Object.BytesIn,
+               Object.BytesOut,
+               Object.Overflows,
+               Object.AttachedClients);
+  Buf << "</N>";
+  Buf << BufferMetrics::encode(Object.Reader);
+  Buf << BufferMetrics::encode(Object.Writer);
+  Buf << LatencyMetrics::encode(Object.ReadToSend);
+  Buf << "</SM>";
+  return Buf.str();
+}
+DECODE_BASE(SessionMetrics)
+{
+  SessionMetrics Ret;
+  HEADER_OR_NONE("<SM Size=\"");
+
+  EXTRACT_OR_NONE(NameSize, "\">");
+  if (std::size_t S = std::stoull(std::string{NameSize}))
+    Ret.Name = splice(View, S);
+
+  CONSUME_OR_NONE("<N>");
+  EXTRACT_OR_NONE(Numbers, "</N>");
+  if (!readNumbers(Numbers,
+                   Ret.BytesIn,
+                   Ret.BytesOut,
+                   Ret.Overflows,
+                   Ret.AttachedClients))
+    return std::nullopt;
+
+  auto Reader = BufferMetrics::decode(View);
+  if (!Reader)
+    return std::nullopt;
+  Ret.Reader = *Reader;
+  auto Writer = BufferMetrics::decode(View);
+  if (!Writer)
+    return std::nullopt;
+  Ret.Writer = *Writer;
+
+  auto ReadToSend = LatencyMetrics::decode(View);
+  if (!ReadToSend)
+    return std::nullopt;
+  Ret.ReadToSend = std::move(*ReadToSend);
+
+  BASE_FOOTER_OR_NONE("</SM>");
+  return Ret;
+}
+
+ENCODE_BASE(ClientMetrics)
+{
+  std::ostringstream Buf;
+  Buf << "<CM Size=\"" << Object.Session.size() << "\">" << Object.Session;
+  Buf << "<N>";
+  writeNumbers(
+    Buf, Object.ID, Object.BytesIn, Object.BytesOut, Object.Overflows);
+  Buf << "</N>";
+  Buf << BufferMetrics::encode(Object.DataRead);
+  Buf << BufferMetrics::encode(Object.DataWrite);
+  Buf << LatencyMetrics::encode(Object.ReadToSend);
+  Buf << LatencyMetrics::encode(Object.WriteQueue);
+  Buf << "</CM>";
+  return Buf.str();
+}
+DECODE_BASE(ClientMetrics)
+{
+  ClientMetrics Ret;
+  HEADER_OR_NONE("<CM Size=\"");
+
+  EXTRACT_OR_NONE(SessionSize, "\">");
+  if (std::size_t S = std::stoull(std::string{SessionSize}))
+    Ret.Session = splice(View, S);
+
+  CONSUME_OR_NONE("<N>");
+  EXTRACT_OR_NONE(Numbers, "</N>");
+  if (!readNumbers(Numbers, Ret.ID, Ret.BytesIn, Ret.BytesOut, Ret.Overflows))
+    return std::nullopt;
+
+  auto DataRead = BufferMetrics::decode(View);
+  if (!DataRead)
+    return std::nullopt;
+  Ret.DataRead = *DataRead;
+  auto DataWrite = BufferMetrics::decode(View);
+  if (!DataWrite)
+    return std::nullopt;
+  Ret.DataWrite = *DataWrite;
+
+  auto ReadToSend = LatencyMetrics::decode(View);
+  if (!ReadToSend)
+    return std::nullopt;
+  Ret.ReadToSend = std::move(*ReadToSend);
+  auto WriteQueue = LatencyMetrics::decode(View);
+  if (!WriteQueue)
+    return std::nullopt;
+  Ret.WriteQueue = std::move(*WriteQueue);
+
+  BASE_FOOTER_OR_NONE("</CM>");
+  return Ret;
+}
+
+ENCODE_BASE(FacilityLevel)
+{
+  std::ostringstream Buf;
+  Buf << "<F Size=\"" << Object.Name.size() << "\">" << Object.Name;
+  Buf << "<N>";
+  writeNumbers(Buf, Object.Level, static_cast<int>(Object.Explicit));
+  Buf << "</N>";
+  Buf << "</F>";
+  return Buf.str();
+}
+DECODE_BASE(FacilityLevel)
+{
+  FacilityLevel Ret;
+  HEADER_OR_NONE("<F Size=\"");
+
+  EXTRACT_OR_NONE(NameSize, "\">");
+  if (std::size_t S = std::stoull(std::string{NameSize}))
+    Ret.Name = splice(View, S);
+
+  CONSUME_OR_NONE("<N>");
+  EXTRACT_OR_NONE(Numbers, "</N>");
+  int Explicit = 0;
+  if (!readNumbers(Numbers, Ret.Level, Explicit))
+    return std::nullopt;
+  Ret.Explicit = Explicit;
+
+  BASE_FOOTER_OR_NONE("</F>");
+  return Ret;
+}
+
+ENCODE_BASE(SessionResult)
+{
+  std::ostringstream Buf;
+  Buf << "<RESULT>";
+  Buf << Boolean::encode(Object.Success);
+  Buf << "<NAME Size=\"" << Object.Name.size() << "\">" << Object.Name
+      << "</NAME>";
+  Buf << "</RESULT>";
+  return Buf.str();
+}
+DECODE_BASE(SessionResult)
+{
+  SessionResult Ret;
+  HEADER_OR_NONE("<RESULT>");
+
+  auto Success = Boolean::decode(View);
+  if (!Success)
+    return std::nullopt;
+  Ret.Success = *Success;
+
+  CONSUME_OR_NONE("<NAME Size=\"");
+  EXTRACT_OR_NONE(NameSize, "\">");
+  if (std::size_t S = std::stoull(std::string{NameSize}))
+    Ret.Name = splice(View, S);
+  CONSUME_OR_NONE("</NAME>");
+
+  BASE_FOOTER_OR_NONE("</RESULT>");
+  return Ret;
+}
+
+ENCODE_BASE(SearchMatch)
+{
+  std::ostringstream Buf;
+  Buf << "<MATCH>";
+  Buf << "<OFFSET>";
+  writeNumbers(Buf, Object.Offset, Object.Position);
+  Buf << "</OFFSET>";
+  Buf << "<NAME Size=\"" << Object.Session.size() << "\">" << Object.Session
+      << "</NAME>";
+  Buf << "<CONTEXT Size=\"" << Object.Context.size() << "\">"
+      << Object.Context << "</CONTEXT>";
+  Buf << "</MATCH>";
+  return Buf.str();
+}
+DECODE_BASE(SearchMatch)
+{
+  SearchMatch Ret;
+  HEADER_OR_NONE("<MATCH>");
+
+  CONSUME_OR_NONE("<OFFSET>");
+  EXTRACT_OR_NONE(Offset, "</OFFSET>");
+  if (!readNumbers(Offset, Ret.Offset, Ret.Position))
+    return std::nullopt;
+
+  CONSUME_OR_NONE("<NAME Size=\"");
+  EXTRACT_OR_NONE(NameSize, "\">");
+  if (std::size_t S = std::stoull(std::string{NameSize}))
+    Ret.Session = splice(View, S);
+  CONSUME_OR_NONE("</NAME>");
+
+  CONSUME_OR_NONE("<CONTEXT Size=\"");
+  EXTRACT_OR_NONE(ContextSize, "\">");
+  if (std::size_t S = std::stoull(std::string{ContextSize}))
+    Ret.Context = splice(View, S);
+  CONSUME_OR_NONE("</CONTEXT>");
+
+  BASE_FOOTER_OR_NONE("</MATCH>");
+  return Ret;
+}
+
 #undef BASE_FOOTER_OR_NONE
 #define FOOTER_OR_NONE(LITERAL)                                                \
   if (View != (LITERAL))                                                       \
@@ -491,6 +812,12 @@ ENCODE(Attach)
   std::ostringstream Buf;
   Buf << "<ATTACH>";
   Buf << "<NAME>" << Object.Name << "</NAME>";
+  if (Object.ResumeToken)
+  {
+    Buf << "<RESUME>";
+    writeNumbers(Buf, Object.ResumeToken, Object.ResumeOffset);
+    Buf << "</RESUME>";
+  }
   Buf << "</ATTACH>";
   return Buf.str();
 }
@@ -503,6 +830,13 @@ DECODE(Attach)
   EXTRACT_OR_NONE(Name, "</NAME>");
   Ret.Name = Name;
 
+  PEEK_AND_CONSUME("<RESUME>")
+  {
+    EXTRACT_OR_NONE(Numbers, "</RESUME>");
+    if (!readNumbers(Numbers, Ret.ResumeToken, Ret.ResumeOffset))
+      return std::nullopt;
+  }
+
   FOOTER_OR_NONE("</ATTACH>");
   return Ret;
 }
@@ -571,6 +905,227 @@ DECODE(Statistics)
   return std::nullopt;
 }
 
+ENCODE(Metrics)
+{
+  if (Object.Session.empty())
+    return "<SEND-METRICS />";
+
+  std::ostringstream Buf;
+  Buf << "<SEND-METRICS Size=\"" << Object.Session.size() << "\">"
+      << Object.Session << "</SEND-METRICS>";
+  return Buf.str();
+}
+DECODE(Metrics)
+{
+  if (Buffer == "<SEND-METRICS />")
+    return Metrics{};
+
+  Metrics Ret;
+  HEADER_OR_NONE("<SEND-METRICS Size=\"");
+
+  EXTRACT_OR_NONE(SessionSize, "\">");
+  if (std::size_t S = std::stoull(std::string{SessionSize}))
+    Ret.Session = splice(View, S);
+
+  FOOTER_OR_NONE("</SEND-METRICS>");
+  return Ret;
+}
+
+ENCODE(Trace)
+{
+  (void)Object;
+  return "<SEND-TRACE />";
+}
+DECODE(Trace)
+{
+  if (Buffer == "<SEND-TRACE />")
+    return Trace{};
+  return std::nullopt;
+}
+
+ENCODE(LogLevel)
+{
+  if (!Object.Change)
+    return "<LOG-LEVEL />";
+
+  std::ostringstream Buf;
+  Buf << "<LOG-LEVEL Size=\"" << Object.Facility.size() << "\">"
+      << Object.Facility;
+  Buf << "<N>" << Object.Level << "</N>";
+  Buf << "</LOG-LEVEL>";
+  return Buf.str();
+}
+DECODE(LogLevel)
+{
+  if (Buffer == "<LOG-LEVEL />")
+    return LogLevel{};
+
+  LogLevel Ret;
+  Ret.Change = true;
+  HEADER_OR_NONE("<LOG-LEVEL Size=\"");
+
+  EXTRACT_OR_NONE(FacilitySize, "\">");
+  if (std::size_t S = std::stoull(std::string{FacilitySize}))
+    Ret.Facility = splice(View, S);
+
+  CONSUME_OR_NONE("<N>");
+  EXTRACT_OR_NONE(Level, "</N>");
+  if (!readNumbers(Level, Ret.Level))
+    return std::nullopt;
+
+  FOOTER_OR_NONE("</LOG-LEVEL>");
+  return Ret;
+}
+
+ENCODE(MakeSessionBatch)
+{
+  std::ostringstream Buf;
+  Buf << "<MAKE-SESSIONS Count=\"" << Object.Sessions.size() << "\">";
+  for (const MakeSession& MS : Object.Sessions)
+  {
+    // (The elements are length-prefixed, as they are only decodable alone.)
+    std::string Item = MakeSession::encode(MS);
+    Buf << "<ITEM Size=\"" << Item.size() << "\">" << Item << "</ITEM>";
+  }
+  Buf << "</MAKE-SESSIONS>";
+  return Buf.str();
+}
+DECODE(MakeSessionBatch)
+{
+  MakeSessionBatch Ret;
+  HEADER_OR_NONE("<MAKE-SESSIONS Count=\"");
+
+  {
+    EXTRACT_OR_NONE(ListCount, "\">");
+    std::size_t ListC = std::stoull(std::string{ListCount});
+    Ret.Sessions.reserve(ListC);
+    for (std::size_t I = 0; I < ListC; ++I)
+    {
+      CONSUME_OR_NONE("<ITEM Size=\"");
+      EXTRACT_OR_NONE(ItemSize, "\">");
+      auto MS =
+        MakeSession::decode(splice(View, std::stoull(std::string{ItemSize})));
+      if (!MS)
+        return std::nullopt;
+      Ret.Sessions.emplace_back(*std::move(MS));
+      CONSUME_OR_NONE("</ITEM>");
+    }
+  }
+
+  FOOTER_OR_NONE("</MAKE-SESSIONS>");
+  return Ret;
+}
+
+ENCODE(SignalSessionsBatch)
+{
+  std::ostringstream Buf;
+  Buf << "<SIGNAL-SESSIONS Count=\"" << Object.Names.size() << "\">";
+  Buf << "<SIGNAL>" << Object.SigNum << "</SIGNAL>";
+  for (const std::string& Name : Object.Names)
+    Buf << "<NAME Size=\"" << Name.size() << "\">" << Name << "</NAME>";
+  Buf << "</SIGNAL-SESSIONS>";
+  return Buf.str();
+}
+DECODE(SignalSessionsBatch)
+{
+  SignalSessionsBatch Ret;
+  HEADER_OR_NONE("<SIGNAL-SESSIONS Count=\"");
+
+  EXTRACT_OR_NONE(ListCount, "\">");
+  CONSUME_OR_NONE("<SIGNAL>");
+  EXTRACT_OR_NONE(Signal, "</SIGNAL>");
+  if (!readNumbers(Signal, Ret.SigNum))
+    return std::nullopt;
+
+  {
+    std::size_t ListC = std::stoull(std::string{ListCount});
+    Ret.Names.resize(ListC);
+    for (std::size_t I = 0; I < ListC; ++I)
+    {
+      CONSUME_OR_NONE("<NAME Size=\"");
+      EXTRACT_OR_NONE(NameSize, "\">");
+      if (std::size_t S = std::stoull(std::string{NameSize}))
+        Ret.Names.at(I) = splice(View, S);
+      CONSUME_OR_NONE("</NAME>");
+    }
+  }
+
+  FOOTER_OR_NONE("</SIGNAL-SESSIONS>");
+  return Ret;
+}
+
+ENCODE(DestroySessionsBatch)
+{
+  std::ostringstream Buf;
+  Buf << "<DESTROY-SESSIONS Count=\"" << Object.Names.size() << "\">";
+  for (const std::string& Name : Object.Names)
+    Buf << "<NAME Size=\"" << Name.size() << "\">" << Name << "</NAME>";
+  Buf << "</DESTROY-SESSIONS>";
+  return Buf.str();
+}
+DECODE(DestroySessionsBatch)
+{
+  DestroySessionsBatch Ret;
+  HEADER_OR_NONE("<DESTROY-SESSIONS Count=\"");
+
+  {
+    EXTRACT_OR_NONE(ListCount, "\">");
+    std::size_t ListC = std::stoull(std::string{ListCount});
+    Ret.Names.resize(ListC);
+    for (std::size_t I = 0; I < ListC; ++I)
+    {
+      CONSUME_OR_NONE("<NAME Size=\"");
+      EXTRACT_OR_NONE(NameSize, "\">");
+      if (std::size_t S = std::stoull(std::string{NameSize}))
+        Ret.Names.at(I) = splice(View, S);
+      CONSUME_OR_NONE("</NAME>");
+    }
+  }
+
+  FOOTER_OR_NONE("</DESTROY-SESSIONS>");
+  return Ret;
+}
+
+ENCODE(Search)
+{
+  std::ostringstream Buf;
+  Buf << "<SEARCH>";
+  Buf << "<LIMITS>";
+  writeNumbers(Buf, Object.Context, Object.Limit);
+  Buf << "</LIMITS>";
+  Buf << "<PATTERN Size=\"" << Object.Pattern.size() << "\">"
+      << Object.Pattern << "</PATTERN>";
+  Buf << "<NAME Size=\"" << Object.Session.size() << "\">" << Object.Session
+      << "</NAME>";
+  Buf << "</SEARCH>";
+  return Buf.str();
+}
+DECODE(Search)
+{
+  Search Ret;
+  HEADER_OR_NONE("<SEARCH>");
+
+  CONSUME_OR_NONE("<LIMITS>");
+  EXTRACT_OR_NONE(Limits, "</LIMITS>");
+  if (!readNumbers(Limits, Ret.Context, Ret.Limit))
+    return std::nullopt;
+
+  CONSUME_OR_NONE("<PATTERN Size=\"");
+  EXTRACT_OR_NONE(PatternSize, "\">");
+  if (std::size_t S = std::stoull(std::string{PatternSize}))
+    Ret.Pattern = splice(View, S);
+  CONSUME_OR_NONE("</PATTERN>");
+
+  CONSUME_OR_NONE("<NAME Size=\"");
+  EXTRACT_OR_NONE(NameSize, "\">");
+  if (std::size_t S = std::stoull(std::string{NameSize}))
+    Ret.Session = splice(View, S);
+  CONSUME_OR_NONE("</NAME>");
+
+  FOOTER_OR_NONE("</SEARCH>");
+  return Ret;
+}
+
 } // namespace request
 
 namespace response
@@ -690,6 +1245,12 @@ ENCODE(Attach)
   Buf << monomux::message::Boolean::encode(Object.Success);
   if (Object.Success)
     Buf << monomux::message::SessionData::encode(Object.Session);
+  if (Object.Success && Object.StreamToken)
+  {
+    Buf << "<STREAM>";
+    writeNumbers(Buf, Object.StreamToken, Object.Offset);
+    Buf << "</STREAM>";
+  }
   Buf << "</ATTACH>";
   return Buf.str();
 }
@@ -709,6 +1270,13 @@ DECODE(Attach)
     if (!Session)
       return std::nullopt;
     Ret.Session = std::move(*Session);
+
+    PEEK_AND_CONSUME("<STREAM>")
+    {
+      EXTRACT_OR_NONE(Numbers, "</STREAM>");
+      if (!readNumbers(Numbers, Ret.StreamToken, Ret.Offset))
+        return std::nullopt;
+    }
   }
 
   FOOTER_OR_NONE("</ATTACH>");
@@ -753,6 +1321,294 @@ DECODE(Statistics)
   return Ret;
 }
 
+ENCODE(Metrics)
+{
+  std::ostringstream Buf;
+  Buf << "<METRICS>";
+  Buf << "<N>";
+  writeNumbers(Buf,
+               Object.LoopIterations,
+               Object.ClientsKicked,
+               Object.Overflows,
+               Object.ClientCount,
+               Object.SessionCount,
+               Object.ChannelBuffers,
+               Object.ChannelBufferBytes,
+               Object.PooledBuffers,
+               Object.PooledBufferBytes);
+  Buf << "</N>";
+  Buf << LatencyMetrics::encode(Object.LoopIteration);
+  Buf << "<SESSIONS Count=\"" << Object.Sessions.size() << "\">";
+  for (const SessionMetrics& SM : Object.Sessions)
+    Buf << SessionMetrics::encode(SM);
+  Buf << "</SESSIONS>";
+  Buf << "<CLIENTS Count=\"" << Object.Clients.size() << "\">";
+  for (const ClientMetrics& CM : Object.Clients)
+    Buf << ClientMetrics::encode(CM);
+  Buf << "</CLIENTS>";
+  Buf << "</METRICS>";
+  return Buf.str();
+}
+DECODE(Metrics)
+{
+  Metrics Ret;
+  HEADER_OR_NONE("<METRICS>");
+
+  CONSUME_OR_NONE("<N>");
+  EXTRACT_OR_NONE(Numbers, "</N>");
+  if (!readNumbers(Numbers,
+                   Ret.LoopIterations,
+                   Ret.ClientsKicked,
+                   Ret.Overflows,
+                   Ret.ClientCount,
+                   Ret.SessionCount,
+                   Ret.ChannelBuffers,
+                   Ret.ChannelBufferBytes,
+                   Ret.PooledBuffers,
+                   Ret.PooledBufferBytes))
+    return std::nullopt;
+
+  auto LoopIteration = LatencyMetrics::decode(View);
+  if (!LoopIteration)
+    return std::nullopt;
+  Ret.LoopIteration = std::move(*LoopIteration);
+
+  {
+    CONSUME_OR_NONE("<SESSIONS Count=\"");
+    EXTRACT_OR_NONE(SessionCount, "\">");
+    std::size_t SessionC = std::stoull(std::string{SessionCount});
+    Ret.Sessions.reserve(SessionC);
+    for (std::size_t I = 0; I < SessionC; ++I)
+    {
+      auto SM = SessionMetrics::decode(View);
+      if (!SM)
+        return std::nullopt;
+      Ret.Sessions.emplace_back(*std::move(SM));
+    }
+    CONSUME_OR_NONE("</SESSIONS>");
+  }
+
+  {
+    CONSUME_OR_NONE("<CLIENTS Count=\"");
+    EXTRACT_OR_NONE(ClientCount, "\">");
+    std::size_t ClientC = std::stoull(std::string{ClientCount});
+    Ret.Clients.reserve(ClientC);
+    for (std::size_t I = 0; I < ClientC; ++I)
+    {
+      auto CM = ClientMetrics::decode(View);
+      if (!CM)
+        return std::nullopt;
+      Ret.Clients.emplace_back(*std::move(CM));
+    }
+    CONSUME_OR_NONE("</CLIENTS>");
+  }
+
+  FOOTER_OR_NONE("</METRICS>");
+  return Ret;
+}
+
+ENCODE(Trace)
+{
+  std::ostringstream Buf;
+  Buf << "<TRACE Size=\"" << Object.Data.size() << "\">";
+  Buf << Object.Data;
+  Buf << "</TRACE>";
+  return Buf.str();
+}
+DECODE(Trace)
+{
+  Trace Ret;
+  HEADER_OR_NONE("<TRACE Size=\"");
+
+  {
+    EXTRACT_OR_NONE(SizeStr, "\">");
+    if (std::size_t Size = std::stoull(std::string{SizeStr}))
+      Ret.Data = splice(View, Size);
+  }
+
+  FOOTER_OR_NONE("</TRACE>");
+  return Ret;
+}
+
+ENCODE(LogLevel)
+{
+  std::ostringstream Buf;
+  Buf << "<LOG-LEVELS>";
+  Buf << "<N>";
+  writeNumbers(Buf, static_cast<int>(Object.Success), Object.DefaultLevel);
+  Buf << "</N>";
+  Buf << "<FACILITIES Count=\"" << Object.Facilities.size() << "\">";
+  for (const FacilityLevel& F : Object.Facilities)
+    Buf << FacilityLevel::encode(F);
+  Buf << "</FACILITIES>";
+  Buf << "</LOG-LEVELS>";
+  return Buf.str();
+}
+DECODE(LogLevel)
+{
+  LogLevel Ret;
+  HEADER_OR_NONE("<LOG-LEVELS>");
+
+  CONSUME_OR_NONE("<N>");
+  EXTRACT_OR_NONE(Numbers, "</N>");
+  int Success = 0;
+  if (!readNumbers(Numbers, Success, Ret.DefaultLevel))
+    return std::nullopt;
+  Ret.Success = Success;
+
+  CONSUME_OR_NONE("<FACILITIES Count=\"");
+  EXTRACT_OR_NONE(FacilityCount, "\">");
+  std::size_t FacilityC = std::stoull(std::string{FacilityCount});
+  Ret.Facilities.reserve(FacilityC);
+  for (std::size_t I = 0; I < FacilityC; ++I)
+  {
+    auto F = FacilityLevel::decode(View);
+    if (!F)
+      return std::nullopt;
+    Ret.Facilities.emplace_back(*std::move(F));
+  }
+  CONSUME_OR_NONE("</FACILITIES>");
+
+  FOOTER_OR_NONE("</LOG-LEVELS>");
+  return Ret;
+}
+
+ENCODE(MakeSessionBatch)
+{
+  std::ostringstream Buf;
+  Buf << "<MAKE-SESSIONS Count=\"" << Object.Results.size() << "\">";
+  for (const SessionResult& R : Object.Results)
+    Buf << SessionResult::encode(R);
+  Buf << "</MAKE-SESSIONS>";
+  return Buf.str();
+}
+DECODE(MakeSessionBatch)
+{
+  MakeSessionBatch Ret;
+  HEADER_OR_NONE("<MAKE-SESSIONS Count=\"");
+
+  {
+    EXTRACT_OR_NONE(ListCount, "\">");
+    std::size_t ListC = std::stoull(std::string{ListCount});
+    Ret.Results.reserve(ListC);
+    for (std::size_t I = 0; I < ListC; ++I)
+    {
+      auto R = SessionResult::decode(View);
+      if (!R)
+        return std::nullopt;
+      Ret.Results.emplace_back(*std::move(R));
+    }
+  }
+
+  FOOTER_OR_NONE("</MAKE-SESSIONS>");
+  return Ret;
+}
+
+ENCODE(SignalSessionsBatch)
+{
+  std::ostringstream Buf;
+  Buf << "<SIGNAL-SESSIONS Count=\"" << Object.Results.size() << "\">";
+  for (const SessionResult& R : Object.Results)
+    Buf << SessionResult::encode(R);
+  Buf << "</SIGNAL-SESSIONS>";
+  return Buf.str();
+}
+DECODE(SignalSessionsBatch)
+{
+  SignalSessionsBatch Ret;
+  HEADER_OR_NONE("<SIGNAL-SESSIONS Count=\"");
+
+  {
+    EXTRACT_OR_NONE(ListCount, "\">");
+    std::size_t ListC = std::stoull(std::string{ListCount});
+    Ret.Results.reserve(ListC);
+    for (std::size_t I = 0; I < ListC; ++I)
+    {
+      auto R = SessionResult::decode(View);
+      if (!R)
+        return std::nullopt;
+      Ret.Results.emplace_back(*std::move(R));
+    }
+  }
+
+  FOOTER_OR_NONE("</SIGNAL-SESSIONS>");
+  return Ret;
+}
+
+ENCODE(DestroySessionsBatch)
+{
+  std::ostringstream Buf;
+  Buf << "<DESTROY-SESSIONS Count=\"" << Object.Results.size() << "\">";
+  for (const SessionResult& R : Object.Results)
+    Buf << SessionResult::encode(R);
+  Buf << "</DESTROY-SESSIONS>";
+  return Buf.str();
+}
+DECODE(DestroySessionsBatch)
+{
+  DestroySessionsBatch Ret;
+  HEADER_OR_NONE("<DESTROY-SESSIONS Count=\"");
+
+  {
+    EXTRACT_OR_NONE(ListCount, "\">");
+    std::size_t ListC = std::stoull(std::string{ListCount});
+    Ret.Results.reserve(ListC);
+    for (std::size_t I = 0; I < ListC; ++I)
+    {
+      auto R = SessionResult::decode(View);
+      if (!R)
+        return std::nullopt;
+      Ret.Results.emplace_back(*std::move(R));
+    }
+  }
+
+  FOOTER_OR_NONE("</DESTROY-SESSIONS>");
+  return Ret;
+}
+
+ENCODE(Search)
+{
+  std::ostringstream Buf;
+  Buf << "<SEARCH Count=\"" << Object.Matches.size() << "\">";
+  Buf << Boolean::encode(Object.Success);
+  Buf << Boolean::encode(Object.Truncated);
+  for (const SearchMatch& M : Object.Matches)
+    Buf << SearchMatch::encode(M);
+  Buf << "</SEARCH>";
+  return Buf.str();
+}
+DECODE(Search)
+{
+  Search Ret;
+  HEADER_OR_NONE("<SEARCH Count=\"");
+
+  {
+    EXTRACT_OR_NONE(ListCount, "\">");
+    auto Success = Boolean::decode(View);
+    if (!Success)
+      return std::nullopt;
+    Ret.Success = *Success;
+
+    auto Truncated = Boolean::decode(View);
+    if (!Truncated)
+      return std::nullopt;
+    Ret.Truncated = *Truncated;
+
+    std::size_t ListC = std::stoull(std::string{ListCount});
+    Ret.Matches.reserve(ListC);
+    for (std::size_t I = 0; I < ListC; ++I)
+    {
+      auto M = SearchMatch::decode(View);
+      if (!M)
+        return std::nullopt;
+      Ret.Matches.emplace_back(*std::move(M));
+    }
+  }
+
+  FOOTER_OR_NONE("</SEARCH>");
+  return Ret;
+}
+
 } // namespace response
 
 namespace notification
@@ -880,6 +1736,18 @@ DECODE(Redraw)
   return Ret;
 }
 
+ENCODE(Keepalive)
+{
+  (void)Object;
+  return "<KEEPALIVE />";
+}
+DECODE(Keepalive)
+{
+  if (Buffer == "<KEEPALIVE />")
+    return Keepalive{};
+  return std::nullopt;
+}
+
 } // namespace notification
 
 } // namespace monomux::message
@@ -16,11 +16,14 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <charconv>
 #include <chrono>
 #include <cstdlib>
+#include <ctime>
 #include <iostream>
+#include <optional>
+#include <string_view>
 #include <system_error>
-#include <thread>
 
 #include <getopt.h>
 #include <unistd.h>
@@ -28,17 +31,21 @@
 #include "monomux/Version.hpp"
 #include "monomux/client/Main.hpp"
 #include "monomux/server/Main.hpp"
+#include "monomux/server/Recording.hpp"
+#include "monomux/server/Server.hpp"
 #include "monomux/system/CheckedPOSIX.hpp"
 #include "monomux/system/Crash.hpp"
 #include "monomux/system/Environment.hpp"
 #include "monomux/system/Process.hpp"
 #include "monomux/system/Signal.hpp"
+#include "monomux/system/Socket.hpp"
+#include "monomux/system/Trace.hpp"
 
 #include "Config.hpp"
 #include "ExitCode.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("main")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "main")
 
 using namespace monomux;
 
@@ -49,22 +56,34 @@ const char ShortOptions[] = "hvqVs:e:u:n:lidDNk";
 
 // clang-format off
 struct ::option LongOptions[] = {
-  {"help",        no_argument,       nullptr, 'h'},
-  {"verbose",     no_argument,       nullptr, 'v'},
-  {"quiet",       no_argument,       nullptr, 'q'},
-  {"server",      no_argument,       nullptr, 0},
-  {"socket",      required_argument, nullptr, 's'},
-  {"env",         required_argument, nullptr, 'e'},
-  {"unset",       required_argument, nullptr, 'u'},
-  {"name",        required_argument, nullptr, 'n'},
-  {"list",        no_argument,       nullptr, 'l'},
-  {"interactive", no_argument,       nullptr, 'i'},
-  {"detach",      no_argument,       nullptr, 'd'},
-  {"detach-all",  no_argument,       nullptr, 'D'},
-  {"statistics",  no_argument,       nullptr, 0},
-  {"no-daemon",   no_argument,       nullptr, 'N'},
-  {"keepalive",   no_argument,       nullptr, 'k'},
-  {nullptr,       0,                 nullptr, 0}
+  {"help",              no_argument,       nullptr, 'h'},
+  {"verbose",           no_argument,       nullptr, 'v'},
+  {"quiet",             no_argument,       nullptr, 'q'},
+  {"server",            no_argument,       nullptr, 0},
+  {"socket",            required_argument, nullptr, 's'},
+  {"env",               required_argument, nullptr, 'e'},
+  {"unset",             required_argument, nullptr, 'u'},
+  {"name",              required_argument, nullptr, 'n'},
+  {"list",              no_argument,       nullptr, 'l'},
+  {"interactive",       no_argument,       nullptr, 'i'},
+  {"detach",            no_argument,       nullptr, 'd'},
+  {"detach-all",        no_argument,       nullptr, 'D'},
+  {"statistics",        no_argument,       nullptr, 0},
+  {"metrics",           no_argument,       nullptr, 0},
+  {"trace",             required_argument, nullptr, 0},
+  {"log-level",         required_argument, nullptr, 0},
+  {"search",            required_argument, nullptr, 0},
+  {"context",           required_argument, nullptr, 0},
+  {"no-daemon",         no_argument,       nullptr, 'N'},
+  {"keepalive",         no_argument,       nullptr, 'k'},
+  {"max-buffer-memory", required_argument, nullptr, 0},
+  {"listen-queue",      required_argument, nullptr, 0},
+  {"warm-sessions",     required_argument, nullptr, 0},
+  {"scrollback",        required_argument, nullptr, 0},
+  {"record",            required_argument, nullptr, 0},
+  {"replay",            required_argument, nullptr, 0},
+  {"since",             required_argument, nullptr, 0},
+  {nullptr,             0,                 nullptr, 0}
 };
 // clang-format on
 
@@ -89,8 +108,23 @@ struct MainOptions
 
   /// \p -v and \p -q translated to \p Severity choice.
   log::Severity Severity;
+
+  /// \p --replay
+  std::optional<std::string> ReplayPath;
+  /// \p --since
+  std::optional<std::string> ReplaySince;
 };
 
+/// Parses a plain, non-negative decimal number.
+std::optional<std::size_t> parseNumber(std::string_view Str);
+
+/// Parses a number of bytes, optionally suffixed with \p K, \p M, or \p G.
+std::optional<std::size_t> parseByteSize(std::string_view Str);
+
+/// Writes the session output recorded at \p Path, starting from \p Since, if
+/// given, to the standard output.
+int replay(const std::string& Path, const std::optional<std::string>& Since);
+
 void printHelp();
 void printVersion();
 void printFeatures();
@@ -135,6 +169,73 @@ int main(int ArgC, char* ArgV[])
           {
             ClientOpts.StatisticsRequest = true;
           }
+          else if (Opt == "metrics")
+          {
+            ClientOpts.MetricsRequest = true;
+          }
+          else if (Opt == "trace")
+          {
+            ClientOpts.TraceOutput = optarg;
+          }
+          else if (Opt == "log-level")
+          {
+            ClientOpts.LogLevelSpec = optarg;
+          }
+          else if (Opt == "search")
+          {
+            ClientOpts.SearchPattern = optarg;
+          }
+          else if (Opt == "context")
+          {
+            std::optional<std::size_t> Context = parseNumber(optarg);
+            if (!Context)
+              ArgError() << "option '--context' expects a number, got \""
+                         << optarg << "\"\n";
+            else
+              ClientOpts.SearchContext = *Context;
+          }
+          else if (Opt == "max-buffer-memory")
+          {
+            ServerOpts.MaxBufferMemory = parseByteSize(optarg);
+            if (!ServerOpts.MaxBufferMemory || !*ServerOpts.MaxBufferMemory)
+              ArgError() << "option '--max-buffer-memory' expects a positive "
+                            "size, got \""
+                         << optarg << "\"\n";
+          }
+          else if (Opt == "listen-queue")
+          {
+            ServerOpts.ListenQueue = parseNumber(optarg);
+            if (!ServerOpts.ListenQueue || !*ServerOpts.ListenQueue)
+              ArgError() << "option '--listen-queue' expects a positive "
+                            "number, got \""
+                         << optarg << "\"\n";
+          }
+          else if (Opt == "warm-sessions")
+          {
+            ServerOpts.WarmSessions = parseNumber(optarg);
+            if (!ServerOpts.WarmSessions)
+              ArgError() << "option '--warm-sessions' expects a number, got \""
+                         << optarg << "\"\n";
+          }
+          else if (Opt == "scrollback")
+          {
+            ServerOpts.ScrollbackSize = parseByteSize(optarg);
+            if (!ServerOpts.ScrollbackSize)
+              ArgError() << "option '--scrollback' expects a size, got \""
+                         << optarg << "\"\n";
+          }
+          else if (Opt == "record")
+          {
+            ServerOpts.RecordDirectory = optarg;
+          }
+          else if (Opt == "replay")
+          {
+            MainOpts.ReplayPath = optarg;
+          }
+          else if (Opt == "since")
+          {
+            MainOpts.ReplaySince = optarg;
+          }
           else
           {
             ArgError() << "option '--" << Opt
@@ -284,6 +385,15 @@ int main(int ArgC, char* ArgV[])
       ArgError() << "option '-D/--detach-all' and '-d/--detach' are mutually "
                     "exclusive!\n";
 
+    if (MainOpts.ReplaySince && !MainOpts.ReplayPath)
+      ArgError() << "option '--since' is only meaningful with '--replay'\n";
+    if (MainOpts.ReplayPath && ServerOpts.ServerMode)
+      ArgError() << "option '--replay' and '--server' are mutually "
+                    "exclusive!\n";
+    if (MainOpts.ReplayPath && ::optind < ArgC)
+      ArgError() << "option '--replay' does not take positional argument \""
+                 << ArgV[::optind] << "\"\n";
+
     if (!ServerOpts.ServerMode)
       ClientOpts.ClientMode = true;
 
@@ -312,6 +422,9 @@ int main(int ArgC, char* ArgV[])
       return EXIT_InvocationError;
 
     log::Logger::get().setLimit(MainOpts.Severity);
+
+    if (MainOpts.ReplayPath)
+      return replay(*MainOpts.ReplayPath, MainOpts.ReplaySince);
   }
 
   // ------------------- Initialise the core helper libraries ------------------
@@ -324,6 +437,8 @@ int main(int ArgC, char* ArgV[])
     Sig.registerCallback(SIGSTKFLT, &coreDumped);
     Sig.registerObject(SignalHandling::ModuleObjName, "main");
     Sig.enable();
+
+    prepareFlightRecorderDump();
   }
 
   // --------------------- Set up some internal environment --------------------
@@ -363,7 +478,7 @@ int main(int ArgC, char* ArgV[])
     std::optional<client::Client> ToServer;
     try
     {
-      ToServer = client::connect(ClientOpts, false, &FailureReason);
+      ToServer = client::connect(ClientOpts, &FailureReason);
     }
     catch (...)
     {}
@@ -372,23 +487,45 @@ int main(int ArgC, char* ArgV[])
     {
       LOG(info) << "No running server found, starting one automatically...";
       ServerOpts.ServerMode = true;
-      Process::fork([] { /* Parent: noop. */ },
-                    [&ServerOpts, &ArgV] {
-                      // Perform the server restart in the child, so it gets
-                      // disowned when we eventually exit, and we can remain the
-                      // client.
-                      server::exec(ServerOpts, ArgV[0]);
-                    });
-
-      // Give some time for the server to spawn...
-      std::this_thread::sleep_for(std::chrono::seconds(1));
-
-      try
+
+      // Bind the socket and start listening here, and hand it over to the
+      // server. This way, our connection attempt is queued by the kernel until
+      // the server gets to accept it, without having to wait for it to start.
+      std::optional<Socket> Listener = client::listenForServer(
+        ClientOpts,
+        ServerOpts.ListenQueue.value_or(server::Server::ListenQueue),
+        &FailureReason);
+      if (ClientOpts.Connection)
+        // Another client started the server in the meantime.
+        ToServer.swap(ClientOpts.Connection);
+
+      if (Listener)
       {
-        ToServer = client::connect(ClientOpts, true, &FailureReason);
+        Process::fork([] { /* Parent: noop. */ },
+                      [&ServerOpts, &ArgV, &Listener] {
+                        // Perform the server restart in the child, so it gets
+                        // disowned when we eventually exit, and we can remain
+                        // the client.
+                        server::exec(ServerOpts, ArgV[0], *Listener);
+                      });
+
+        // The server owns the socket from now on. Our copy is closed without
+        // removing the file, so if the server fails to start, the pending
+        // connection is reset instead of hanging indefinitely.
+        {
+          fd ClientSideCopy = std::move(*Listener).release();
+        }
+        Listener.reset();
+
+        try
+        {
+          ToServer = client::connect(ClientOpts, &FailureReason);
+        }
+        catch (const std::system_error& SE)
+        {
+          FailureReason = SE.what();
+        }
       }
-      catch (...)
-      {}
     }
 
     if (!ToServer)
@@ -407,6 +544,96 @@ int main(int ArgC, char* ArgV[])
 namespace
 {
 
+std::optional<std::size_t> parseNumber(std::string_view Str)
+{
+  std::size_t Number = 0;
+  const char* End = Str.data() + Str.size();
+  auto Result = std::from_chars(Str.data(), End, Number);
+  if (Str.empty() || Result.ec != std::errc{} || Result.ptr != End)
+    return std::nullopt;
+  return Number;
+}
+
+std::optional<std::size_t> parseByteSize(std::string_view Str)
+{
+  std::size_t Multiplier = 1;
+  if (!Str.empty())
+    switch (Str.back())
+    {
+      case 'G':
+      case 'g':
+        Multiplier <<= 10;
+        [[fallthrough]];
+      case 'M':
+      case 'm':
+        Multiplier <<= 10;
+        [[fallthrough]];
+      case 'K':
+      case 'k':
+        Multiplier <<= 10;
+        Str.remove_suffix(1);
+        break;
+      default:
+        break;
+    }
+  std::optional<std::size_t> Number = parseNumber(Str);
+  if (!Number)
+    return std::nullopt;
+  return *Number * Multiplier;
+}
+
+int replay(const std::string& Path, const std::optional<std::string>& Since)
+{
+  using Clock = server::RecordingReader::Clock;
+
+  std::string FailureReason;
+  std::optional<server::RecordingReader> Reader =
+    server::RecordingReader::open(Path, &FailureReason);
+  if (!Reader)
+  {
+    std::cerr << "FATAL: Opening the recording failed:\n\t" << FailureReason
+              << std::endl;
+    return EXIT_Failure;
+  }
+
+  if (Since)
+  {
+    std::optional<Clock::time_point> At;
+    if (!Since->empty() && Since->front() == '+')
+    {
+      // "+SECONDS" since the start of the recording.
+      std::uint64_t Seconds;
+      const char* End = Since->data() + Since->size();
+      if (auto R = std::from_chars(Since->data() + 1, End, Seconds);
+          Since->size() > 1 && R.ec == std::errc{} && R.ptr == End)
+        At = Reader->begin() + std::chrono::seconds{Seconds};
+    }
+    else
+    {
+      std::tm Local{};
+      Local.tm_isdst = -1;
+      const char* End = ::strptime(Since->c_str(), "%Y-%m-%d %H:%M:%S", &Local);
+      if (End && !*End)
+        At = Clock::from_time_t(std::mktime(&Local));
+    }
+
+    if (!At)
+    {
+      std::cerr << "option '--since' expects '+SECONDS' or 'YYYY-MM-DD "
+                   "HH:MM:SS', got \""
+                << *Since << "\"" << std::endl;
+      return EXIT_InvocationError;
+    }
+    Reader->seek(*At);
+  }
+
+  while (std::optional<server::RecordingReader::Record> R = Reader->next())
+    std::cout.write(R->Data.data(),
+                    static_cast<std::streamsize>(R->Data.size()));
+  std::cout.flush();
+  return EXIT_Success;
+}
+
 void printHelp()
 {
   std::cout << R"EOF(Usage:
@@ -414,6 +641,7 @@ void printHelp()
     monomux [-vq...] [CLIENT OPTIONS...] [PROGRAM]
     monomux [-vq...] [CLIENT OPTIONS...] -- PROGRAM [ARGS...]
     monomux (-dD)
+    monomux --replay PATH [--since TIME]
     monomux (-V[V])
 
                  MonoMux -- Monophone Terminal Multiplexer
@@ -496,6 +724,36 @@ Client options:
                                   server. (The default behaviour is to
                                   automatically create a session or attach in
                                   this case.)
+    --metrics                   - Print the counters and gauges of the server
+                                  listening on the socket given to '--socket',
+                                  one metric per line, in a format suitable for
+                                  periodic scraping. If '--name' is given, only
+                                  that session and its clients are reported.
+    --trace FILE                - Save the flight recorder (a binary trace of
+                                  the most recent events) of the server
+                                  listening on the socket given to '--socket'
+                                  to FILE ('-' for the standard output). The
+                                  trace can be read with 'monomux-trace'.
+    --log-level SPEC            - Change the verbosity of the logging of the
+                                  server listening on the socket given to
+                                  '--socket', without restarting it. SPEC is
+                                  either 'LEVEL' to change every facility that
+                                  is not set explicitly, 'FACILITY=LEVEL' (e.g.,
+                                  'server/Server=trace') for one facility, or
+                                  'list' to only print the current levels.
+                                  LEVEL is one of 'none', 'fatal', 'error',
+                                  'warning', 'info', 'debug', 'trace', 'data',
+                                  or, for a FACILITY, 'default' to follow the
+                                  default.
+    --search PATTERN            - Search the output retained for the sessions
+                                  of the server listening on the socket given
+                                  to '--socket' for the literal PATTERN, and
+                                  print the line of each match, prefixed with
+                                  the session's name and the offset of the
+                                  match in the session's output. If '--name'
+                                  is given, only that session is searched.
+    --context N                 - Print N lines around the lines of the
+                                  matches of '--search'.
 
 
 In-session options:
@@ -512,6 +770,37 @@ Server options:
                                   the only session running in it had exited.
     -N, --no-daemon             - Do not daemonise (put the running server into
                                   the background) automatically. Implies '-k'.
+    --max-buffer-memory SIZE    - Limit the memory the buffers of all
+                                  connections may take together to SIZE bytes
+                                  (a 'K', 'M', or 'G' suffix may be given).
+                                  From half of it, the sessions whose output
+                                  piles up the most are paused, and over it,
+                                  the clients with the largest buffers are
+                                  disconnected.
+    --listen-queue N            - Allow N connections to wait for being
+                                  accepted by the server. (Defaults to 16.)
+    --warm-sessions N           - Keep N sessions started ahead of time for
+                                  each of the recently used programs and
+                                  environments, so new sessions of them are
+                                  available instantly. (Defaults to 0.)
+    --scrollback SIZE           - Keep the last SIZE bytes of the output of
+                                  each session (a 'K', 'M', or 'G' suffix may
+                                  be given), and show it to clients when they
+                                  attach. (Defaults to 64K, 0 disables.)
+    --record DIR                - Record the output of every session created
+                                  into files in DIR, for auditing. Recordings
+                                  are read with '--replay'.
+
+
+Replay options:
+    --replay PATH               - Print the output of a session recorded by a
+                                  server started with '--record', instead of
+                                  starting a client. PATH is any file of the
+                                  recording, or their common prefix.
+    --since TIME                - Only print the output recorded since TIME,
+                                  which is either '+SECONDS' after the start of
+                                  the recording, or 'YYYY-MM-DD HH:MM:SS' in
+                                  local time.
 )EOF";
   std::cout << std::endl;
 }
@@ -540,6 +829,10 @@ void coreDumped(SignalHandling::Signal SigNum,
   LOG(fatal) << "in '" << Module << "' - FATAL SIGNAL " << SigNum << " '"
              << SignalHandling::signalName(SigNum) << "' RECEIVED!";
 
+  trace::record(
+    trace::EventID::Crash, 0, 0, static_cast<std::uint32_t>(SigNum));
+  const char* TracePath = dumpFlightRecorder();
+
   Backtrace BT;
   BT.prettify();
 
@@ -553,6 +846,9 @@ void coreDumped(SignalHandling::Signal SigNum,
   std::cerr << "---------------------------------------------------------------"
                "-----------------------------------------------\n";
   printBacktrace(std::cerr, BT);
+  if (TracePath)
+    std::cerr << "\nFlight recorder trace saved to '" << TracePath
+              << "'.\nDecode it with 'monomux-trace'.\n";
   std::cerr << "- * - * - * - * - * - * - * - * - * - * - * - * - * - * - * - "
                "* - * - * - * - * - * - * - * - * - * - * - * -\n";
 }
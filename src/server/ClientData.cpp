@@ -25,8 +25,8 @@
 namespace monomux::server
 {
 
-ClientData::ClientData(std::unique_ptr<Socket> Connection)
-  : ID(Connection->raw()), Created(std::chrono::system_clock::now()),
+ClientData::ClientData(Socket&& Connection)
+  : ID(Connection.raw()), Created(std::chrono::system_clock::now()),
     ControlConnection(std::move(Connection)), AttachedSession(nullptr)
 {}
 
@@ -51,8 +51,9 @@ void ClientData::subjugateIntoDataSocket(ClientData& Other) noexcept
   assert(!DataConnection && "Current client already has a data connection!");
   assert(!Other.DataConnection &&
          "Other client already has a data connection!");
-  DataConnection.swap(Other.ControlConnection);
-  assert(!Other.ControlConnection && "Other client stayed alive");
+  DataConnection.emplace(std::move(*Other.ControlConnection));
+  Other.ControlConnection.reset();
+  DataConnection->setWriteDelayHistogram(&WriteQueue);
 }
 
 void ClientData::sendDetachReason(
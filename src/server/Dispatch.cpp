@@ -16,15 +16,18 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+#include <unordered_set>
+
 #include "monomux/control/Message.hpp"
 #include "monomux/control/PascalString.hpp"
-#include "monomux/system/Environment.hpp"
 #include "monomux/system/Process.hpp"
+#include "monomux/system/Trace.hpp"
 
 #include "monomux/server/Server.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("server/Dispatch")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "server/Dispatch")
 
 using namespace monomux::message;
 
@@ -73,6 +76,28 @@ void Server::sendRejectClient(ClientData& Client, std::string Reason)
     notification::Connection{{false}, std::move(Reason)});
 }
 
+void Server::sendKeepalive(ClientData& Client)
+{
+  sendMessageAndRescheduleIfOverflow(
+    *Poll, Client.getControlSocket(), notification::Keepalive{});
+}
+
+/// Converts the transmitted \p Opts of a session's program to the options
+/// the process is spawned with.
+static Process::SpawnOptions toSpawnOptions(ProcessSpawnOptions& Opts)
+{
+  Process::SpawnOptions SOpts;
+  SOpts.CreatePTY = true;
+  SOpts.Program = std::move(Opts.Program);
+  SOpts.Arguments = std::move(Opts.Arguments);
+  for (std::pair<std::string, std::string>& EnvVar : Opts.SetEnvironment)
+    SOpts.Environment.try_emplace(std::move(EnvVar.first),
+                                  std::move(EnvVar.second));
+  for (std::string& UnsetEnvVar : Opts.UnsetEnvironment)
+    SOpts.Environment.try_emplace(std::move(UnsetEnvVar), std::nullopt);
+  return SOpts;
+}
+
 #define HANDLER(NAME)                                                          \
   void Server::NAME(                                                           \
     Server& Server, ClientData& Client, std::string_view Message)
@@ -103,14 +128,14 @@ HANDLER(requestDataSocket)
   // In this function, Client is the message sender, so the connection that
   // wants to become the data socket.
 
-  auto MainIt = Server.Clients.find(Msg->Client.ID);
-  if (MainIt == Server.Clients.end())
+  ClientData* MainClientPtr = Server.getClient(Msg->Client.ID);
+  if (!MainClientPtr)
   {
     sendMessage(Client.getControlSocket(), Resp);
     return;
   }
 
-  ClientData& MainClient = *MainIt->second;
+  ClientData& MainClient = *MainClientPtr;
   if (MainClient.getDataSocket() != nullptr)
   {
     sendMessage(Client.getControlSocket(), Resp);
@@ -138,8 +163,8 @@ HANDLER(requestSessionList)
   {
     monomux::message::SessionData TransmitData;
     TransmitData.Name = SessionElem.first;
-    TransmitData.Created =
-      std::chrono::system_clock::to_time_t(SessionElem.second->whenCreated());
+    TransmitData.Created = std::chrono::system_clock::to_time_t(
+      Server.SessionStorage.get(SessionElem.second)->whenCreated());
 
     Resp.Sessions.emplace_back(std::move(TransmitData));
   }
@@ -161,51 +186,107 @@ HANDLER(requestMakeSession)
     sendMessage(Client.getControlSocket(), Resp);
     return;
   }
-  if (Msg->Name.empty())
+  if (Server.WarmSessions.isReservedName(Msg->Name))
+  {
+    LOG(debug) << "Session name \"" << Msg->Name << "\" is reserved";
+    sendMessage(Client.getControlSocket(), Resp);
+    return;
+  }
+  const bool DefaultName = Msg->Name.empty();
+  if (DefaultName)
   {
     // Generate a default session name, which will just be a numeric ID.
-    std::size_t SessionNum = 1;
-    while (Server.getSession(std::to_string(SessionNum)))
-      ++SessionNum;
-    Msg->Name = std::to_string(SessionNum);
+    Msg->Name = Server.makeDefaultSessionName();
   }
 
   LOG(info) << "Creating Session \"" << Msg->Name << "\"...";
   Resp.Name = Msg->Name;
-  auto S = std::make_unique<SessionData>(std::move(Msg->Name));
+  SessionData S{std::move(Msg->Name)};
+  if (!Server.spawnSession(S, toSpawnOptions(Msg->SpawnOpts)))
+  {
+    if (DefaultName)
+      Server.releaseDefaultSessionName(Resp.Name);
+    sendMessage(Client.getControlSocket(), Resp);
+    return;
+  }
 
-  Process::SpawnOptions SOpts;
-  SOpts.CreatePTY = true;
-  SOpts.Program = std::move(Msg->SpawnOpts.Program);
-  SOpts.Arguments = std::move(Msg->SpawnOpts.Arguments);
-  for (std::pair<std::string, std::string>& EnvVar :
-       Msg->SpawnOpts.SetEnvironment)
-    SOpts.Environment.try_emplace(std::move(EnvVar.first),
-                                  std::move(EnvVar.second));
-  for (std::string& UnsetEnvVar : Msg->SpawnOpts.UnsetEnvironment)
-    SOpts.Environment.try_emplace(std::move(UnsetEnvVar), std::nullopt);
+  SessionData* Session = Server.makeSession(std::move(S));
+  Server.createCallback(*Session);
+
+  Resp.Success = true;
+  sendMessage(Client.getControlSocket(), Resp);
+
+  if (Server.WarmSessions.needsRefill())
+    Server.armWarmRefill();
+}
 
+HANDLER(requestMakeSessionBatch)
+{
+  MSG(request::MakeSessionBatch);
+  response::MakeSessionBatch Resp;
+  Resp.Results.resize(Msg->Sessions.size());
+
+  // Every process is started before any of the sessions is registered, so the
+  // programs are already starting up in parallel while the server is busy
+  // with the rest of the batch.
+  std::vector<std::optional<SessionData>> Spawned(Msg->Sessions.size());
+  std::unordered_set<std::string> Claimed;
+  // Default names generated but not used by the batch are released only after
+  // it, as the rest of the batch would otherwise skip them as claimed.
+  std::vector<std::string> Unused;
+  for (std::size_t I = 0; I < Msg->Sessions.size(); ++I)
   {
-    // Inject the variables needed by the controlling client to detach from the
-    // session.
-    MonomuxSession MS;
-    MS.SessionName = Resp.Name;
-    MS.Socket = SocketPath::absolutise(Server.Sock.identifier());
-
-    for (std::pair<std::string, std::string> BuiltinEnvVar : MS.createEnvVars())
-      SOpts.Environment[std::move(BuiltinEnvVar.first)] =
-        std::move(BuiltinEnvVar.second);
+    request::MakeSession& Item = Msg->Sessions[I];
+    SessionResult& Result = Resp.Results[I];
+    Result.Success = false;
+
+    const bool DefaultName = Item.Name.empty();
+    if (DefaultName)
+      while (true)
+      {
+        Item.Name = Server.makeDefaultSessionName();
+        if (Claimed.find(Item.Name) == Claimed.end())
+          break;
+        Unused.emplace_back(std::move(Item.Name));
+      }
+    Result.Name = Item.Name;
+    if (Server.getSession(Item.Name) || !Claimed.insert(Item.Name).second)
+    {
+      LOG(debug) << "Session \"" << Item.Name << "\" already exists";
+      continue;
+    }
+    if (Server.WarmSessions.isReservedName(Item.Name))
+    {
+      LOG(debug) << "Session name \"" << Item.Name << "\" is reserved";
+      continue;
+    }
+
+    LOG(info) << "Creating Session \"" << Item.Name << "\"...";
+    SessionData S{std::move(Item.Name)};
+    if (!Server.spawnSession(S, toSpawnOptions(Item.SpawnOpts)))
+    {
+      if (DefaultName)
+        Unused.emplace_back(Result.Name);
+      continue;
+    }
+    Spawned[I].emplace(std::move(S));
   }
+  for (const std::string& Name : Unused)
+    Server.releaseDefaultSessionName(Name);
 
-  // TODO: How to detect process creation failing?
-  Process P = Process::spawn(SOpts);
-  S->setProcess(std::move(P));
-
-  auto InsertResult = Server.Sessions.try_emplace(Resp.Name, std::move(S));
-  Server.createCallback(*InsertResult.first->second);
+  for (std::size_t I = 0; I < Spawned.size(); ++I)
+  {
+    if (!Spawned[I])
+      continue;
+    SessionData* Session = Server.makeSession(*std::move(Spawned[I]));
+    Server.createCallback(*Session);
+    Resp.Results[I].Success = true;
+  }
 
-  Resp.Success = true;
   sendMessage(Client.getControlSocket(), Resp);
+
+  if (Server.WarmSessions.needsRefill())
+    Server.armWarmRefill();
 }
 
 HANDLER(requestAttach)
@@ -221,10 +302,22 @@ HANDLER(requestAttach)
     return;
   }
 
-  Server.clientAttachedCallback(Client, *S);
+  // A client reattaching after e.g. a network hiccup only needs the output
+  // it has not received yet, if that is still retained.
+  std::optional<std::uint64_t> Resume;
+  if (Msg->ResumeToken && Msg->ResumeToken == S->streamToken())
+    Resume = Msg->ResumeOffset;
+  std::uint64_t From = S->scrollback().replayFrom(Resume);
+  if (Resume && From != *Resume)
+    LOG(debug) << "Client \"" << Client.id() << "\": output of \"" << S->name()
+               << "\" since " << *Resume << " is no longer retained";
+
+  Server.clientAttachedCallback(Client, *S, From);
   Resp.Success = true;
   Resp.Session.Name = S->name();
   Resp.Session.Created = std::chrono::system_clock::to_time_t(S->whenCreated());
+  Resp.StreamToken = S->streamToken();
+  Resp.Offset = From;
   sendMessage(Client.getControlSocket(), Resp);
 }
 
@@ -238,21 +331,24 @@ HANDLER(requestDetach)
   if (!S)
     return;
 
-  std::vector<ClientData*> ClientsToDetach;
+  std::vector<PoolHandle<ClientData>> ClientsToDetach;
 
   switch (Msg->Mode)
   {
     case Detach::Latest:
-      if (ClientData* C = S->getLatestClient())
-        ClientsToDetach.emplace_back(C);
+      if (ClientData* C = S->getLatestClient(Server.ClientStorage))
+        ClientsToDetach.emplace_back(Server.ClientStorage.handleOf(*C));
       break;
     case Detach::All:
       ClientsToDetach = S->getAttachedClients();
       break;
   }
 
-  for (ClientData* C : ClientsToDetach)
+  for (PoolHandle<ClientData> H : ClientsToDetach)
   {
+    ClientData* C = Server.getClient(H);
+    if (!C)
+      continue;
     C->sendDetachReason(notification::Detached::DetachMode::Detach);
     Server.clientDetachedCallback(*C, *S);
   }
@@ -270,6 +366,49 @@ HANDLER(signalSession)
   S->getProcess().signal(Msg->SigNum);
 }
 
+HANDLER(signalSessionsBatch)
+{
+  MSG(request::SignalSessionsBatch);
+  response::SignalSessionsBatch Resp;
+  Resp.Results.resize(Msg->Names.size());
+
+  for (std::size_t I = 0; I < Msg->Names.size(); ++I)
+  {
+    SessionResult& Result = Resp.Results[I];
+    Result.Name = std::move(Msg->Names[I]);
+    Result.Success = false;
+
+    SessionData* S = Server.getSession(Result.Name);
+    if (!S || !S->hasProcess())
+      continue;
+    Result.Success = S->getProcess().signal(Msg->SigNum);
+    if (!Result.Success)
+      LOG(error) << "Session \"" << S->name()
+                 << "\": error when sending signal " << Msg->SigNum;
+  }
+
+  sendMessage(Client.getControlSocket(), Resp);
+}
+
+HANDLER(destroySessionsBatch)
+{
+  MSG(request::DestroySessionsBatch);
+  response::DestroySessionsBatch Resp;
+  Resp.Results.resize(Msg->Names.size());
+
+  for (std::size_t I = 0; I < Msg->Names.size(); ++I)
+  {
+    SessionResult& Result = Resp.Results[I];
+    Result.Name = std::move(Msg->Names[I]);
+    Result.Success = false;
+
+    if (SessionData* S = Server.getSession(Result.Name))
+      Result.Success = Server.hangupSession(*S);
+  }
+
+  sendMessage(Client.getControlSocket(), Resp);
+}
+
 HANDLER(redrawNotified)
 {
   (void)Server;
@@ -289,6 +428,63 @@ HANDLER(statisticsRequest)
               response::Statistics{Server.statistics()});
 }
 
+HANDLER(metricsRequest)
+{
+  MSG(request::Metrics);
+  sendMessage(Client.getControlSocket(), Server.metrics(Msg->Session));
+}
+
+HANDLER(searchRequest)
+{
+  MSG(request::Search);
+  sendMessage(Client.getControlSocket(), Server.search(*Msg));
+}
+
+HANDLER(traceRequest)
+{
+  (void)Server;
+  MSG(request::Trace);
+  sendMessage(Client.getControlSocket(), response::Trace{trace::snapshot()});
+}
+
+HANDLER(logLevelRequest)
+{
+  (void)Server;
+  MSG(request::LogLevel);
+
+  response::LogLevel Resp;
+  Resp.Success = true;
+  if (Msg->Change)
+  {
+    bool ValidLevel = Msg->Level >= log::Max && Msg->Level <= log::Min;
+    if (Msg->Facility.empty() && ValidLevel)
+      log::Logger::get().setLimit(static_cast<log::Severity>(Msg->Level));
+    else if (!Msg->Facility.empty() && ValidLevel)
+      Resp.Success = log::setFacilityLimit(
+        Msg->Facility, static_cast<log::Severity>(Msg->Level));
+    else if (!Msg->Facility.empty() && Msg->Level == -1)
+      Resp.Success = log::setFacilityLimit(Msg->Facility, std::nullopt);
+    else
+      Resp.Success = false;
+
+    if (Resp.Success)
+      LOG(info) << "Client \"" << Client.id() << "\" set log level of "
+                << (Msg->Facility.empty() ? "<default>" : Msg->Facility)
+                << " to " << Msg->Level;
+  }
+
+  Resp.DefaultLevel = log::Logger::get().getLimit();
+  for (const log::Facility* F : log::facilities())
+    Resp.Facilities.emplace_back(
+      FacilityLevel{std::string{F->name()}, F->limit(), F->hasOwnLimit()});
+  std::sort(Resp.Facilities.begin(),
+            Resp.Facilities.end(),
+            [](const FacilityLevel& L, const FacilityLevel& R) {
+              return L.Name < R.Name;
+            });
+  sendMessage(Client.getControlSocket(), Resp);
+}
+
 #undef HANDLER
 
 } // namespace monomux::server
@@ -18,8 +18,11 @@
  */
 #include <thread>
 
+#include <unistd.h>
+
 #include "monomux/adt/ScopeGuard.hpp"
 #include "monomux/server/Server.hpp"
+#include "monomux/system/CheckedPOSIX.hpp"
 #include "monomux/system/Environment.hpp"
 #include "monomux/system/Process.hpp"
 #include "monomux/system/Signal.hpp"
@@ -29,7 +32,7 @@
 #include "monomux/server/Main.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("server/Main")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "server/Main")
 
 namespace monomux::server
 {
@@ -53,6 +56,31 @@ std::vector<std::string> Options::toArgv() const
     Ret.emplace_back("--no-daemon");
   if (!ExitOnLastSessionTerminate)
     Ret.emplace_back("--keepalive");
+  if (MaxBufferMemory.has_value())
+  {
+    Ret.emplace_back("--max-buffer-memory");
+    Ret.emplace_back(std::to_string(*MaxBufferMemory));
+  }
+  if (ListenQueue.has_value())
+  {
+    Ret.emplace_back("--listen-queue");
+    Ret.emplace_back(std::to_string(*ListenQueue));
+  }
+  if (WarmSessions.has_value())
+  {
+    Ret.emplace_back("--warm-sessions");
+    Ret.emplace_back(std::to_string(*WarmSessions));
+  }
+  if (ScrollbackSize.has_value())
+  {
+    Ret.emplace_back("--scrollback");
+    Ret.emplace_back(std::to_string(*ScrollbackSize));
+  }
+  if (RecordDirectory.has_value())
+  {
+    Ret.emplace_back("--record");
+    Ret.emplace_back(*RecordDirectory);
+  }
 
   return Ret;
 }
@@ -69,6 +97,29 @@ std::vector<std::string> Options::toArgv() const
   unreachable("[[noreturn]]");
 }
 
+[[noreturn]] void
+exec(const Options& Opts, const char* ArgV0, const Socket& Listener)
+{
+  MONOMUX_TRACE_LOG(LOG(trace) << "exec() a new server with socket FD "
+                               << Listener.raw());
+
+  if (Listener.raw() != ListenFDs::Start)
+    CheckedPOSIXThrow(
+      [FD = Listener.raw()] { return ::dup2(FD, ListenFDs::Start); },
+      "dup2()",
+      -1);
+  fd::removeDescriptorFlag(ListenFDs::Start, FD_CLOEXEC);
+
+  Process::SpawnOptions SO;
+  SO.Program = ArgV0;
+  SO.Arguments = Opts.toArgv();
+  for (auto& E : ListenFDs::createEnvVars(::getpid()))
+    SO.Environment.emplace(std::move(E.first), std::move(E.second));
+
+  Process::exec(SO);
+  unreachable("[[noreturn]]");
+}
+
 namespace
 {
 
@@ -91,7 +142,10 @@ int main(Options& Opts)
   std::optional<Socket> ServerSock;
   try
   {
-    ServerSock.emplace(Socket::create(*Opts.SocketPath));
+    if (std::optional<raw_fd> Inherited = ListenFDs::loadFromEnv())
+      ServerSock.emplace(Socket::adopt(*Inherited, *Opts.SocketPath));
+    else
+      ServerSock.emplace(Socket::create(*Opts.SocketPath));
   }
   catch (const std::system_error& SE)
   {
@@ -105,6 +159,18 @@ int main(Options& Opts)
 
   Server S = Server(std::move(*ServerSock));
   S.setExitIfNoMoreSessions(Opts.ExitOnLastSessionTerminate);
+  if (Opts.MaxBufferMemory)
+    S.setMaxBufferMemory(*Opts.MaxBufferMemory);
+  if (Opts.ListenQueue)
+    S.setListenQueue(*Opts.ListenQueue);
+  if (Opts.WarmSessions)
+    S.setWarmSessions(*Opts.WarmSessions);
+  if (Opts.ScrollbackSize)
+    S.setScrollbackSize(*Opts.ScrollbackSize);
+  if (Opts.RecordDirectory)
+    S.setRecordingDirectory(*Opts.RecordDirectory);
+  // The handlers below only serve outside of the loop.
+  S.setSynchronousSignals(true);
   ScopeGuard Signal{[&S] {
                       SignalHandling& Sig = SignalHandling::get();
                       Sig.registerObject(SignalHandling::ModuleObjName,
@@ -146,6 +212,11 @@ int main(Options& Opts)
     CheckedPOSIXThrow(
       [] { return ::daemon(0, 0); }, "Backgrounding ourselves failed", -1);
 
+  // Do not let the event loop block on writing the log. (Threads do not
+  // survive daemon(), so this must happen after it.)
+  ScopeGuard AsyncLog{[] { log::Logger::get().startAsync(STDERR_FILENO); },
+                      [] { log::Logger::get().stopAsync(); }};
+
   ScopeGuard Server{[&S] { S.loop(); }, [&S] { S.shutdown(); }};
   LOG(info) << "Monomux Server stopped";
   return EXIT_Success;
@@ -0,0 +1,530 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "monomux/system/CheckedPOSIX.hpp"
+#include "monomux/system/fd.hpp"
+
+#include "monomux/server/Recording.hpp"
+
+#include "monomux/Log.hpp"
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "server/Recording")
+
+namespace monomux::server
+{
+
+namespace detail
+{
+
+struct RecordingFile
+{
+  explicit RecordingFile(fd&& FD) : FD(std::move(FD)) {}
+
+  fd FD;
+  /// Whether the file is waiting to be forced to the disk.
+  std::atomic<bool> Queued = false;
+  /// The error of the most recent failed \p fdatasync(), or \p 0.
+  std::atomic<int> Error = 0;
+};
+
+} // namespace detail
+
+namespace
+{
+
+constexpr char Magic[8] = {'M', 'M', 'X', 'R', 'E', 'C', '1', '\n'};
+
+struct SegmentHeader
+{
+  char Magic[8];
+  /// The time the segment started, in microseconds since the epoch.
+  std::uint64_t Begin;
+};
+static_assert(sizeof(SegmentHeader) == 16, "Header layout is the format!");
+
+struct IndexEntry
+{
+  /// The time of the record preceding the one at \p Offset, i.e., the time
+  /// the delta of that record is relative to.
+  std::uint64_t Time;
+  std::uint64_t Offset;
+};
+static_assert(sizeof(IndexEntry) == 16, "Index layout is the format!");
+
+std::uint64_t toMicros(Recorder::Clock::time_point T) noexcept
+{
+  return static_cast<std::uint64_t>(
+    std::chrono::duration_cast<std::chrono::microseconds>(T.time_since_epoch())
+      .count());
+}
+
+Recorder::Clock::time_point fromMicros(std::uint64_t T) noexcept
+{
+  return Recorder::Clock::time_point{
+    std::chrono::duration_cast<Recorder::Clock::duration>(
+      std::chrono::microseconds{T})};
+}
+
+void putVarint(std::string& Buffer, std::uint64_t N)
+{
+  static constexpr unsigned char More = 0x80;
+  while (N >= More)
+  {
+    Buffer.push_back(static_cast<char>((N & (More - 1)) | More));
+    N >>= 7;
+  }
+  Buffer.push_back(static_cast<char>(N));
+}
+
+bool getVarint(std::istream& IS, std::uint64_t& N)
+{
+  static constexpr unsigned char More = 0x80;
+  static constexpr unsigned MaxShift = 63;
+  N = 0;
+  for (unsigned Shift = 0; Shift <= MaxShift; Shift += 7)
+  {
+    int Ch = IS.get();
+    if (Ch == std::char_traits<char>::eof())
+      return false;
+    N |= static_cast<std::uint64_t>(Ch & (More - 1)) << Shift;
+    if (!(Ch & More))
+      return true;
+  }
+  return false;
+}
+
+/// \returns \p Name with the characters that are not safe in a file name
+/// replaced.
+std::string sanitiseFileName(std::string Name)
+{
+  std::replace(Name.begin(), Name.end(), '/', '_');
+  if (Name.empty() || Name.front() == '.')
+    Name.insert(Name.begin(), '_');
+  return Name;
+}
+
+std::string formatFileTime(Recorder::Clock::time_point T)
+{
+  std::time_t TT = Recorder::Clock::to_time_t(T);
+  std::tm Local{};
+  ::localtime_r(&TT, &Local);
+  char Buf[32];
+  std::size_t Len = std::strftime(Buf, sizeof(Buf), "%Y%m%d-%H%M%S", &Local);
+  return std::string{Buf, Len};
+}
+
+fd openForAppend(const std::string& Path)
+{
+  return CheckedPOSIXThrow(
+    [&Path] {
+      return ::open(Path.c_str(),
+                    O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC,
+                    S_IRUSR | S_IWUSR);
+    },
+    "open('" + Path + "')",
+    -1);
+}
+
+void writeAll(raw_fd FD, std::string_view Buffer)
+{
+  while (!Buffer.empty())
+  {
+    auto Written = CheckedPOSIX(
+      [FD, &Buffer] { return ::write(FD, Buffer.data(), Buffer.size()); }, -1);
+    if (!Written)
+    {
+      if (Written.getError() == std::errc::interrupted)
+        continue;
+      throw std::system_error{Written.getError(), "write()"};
+    }
+    Buffer.remove_prefix(Written.get());
+  }
+}
+
+/// The thread that forces the files of every recording to the disk, so the
+/// owners of the \p Recorder instances do not wait for the device.
+class BackgroundSync
+{
+public:
+  static BackgroundSync& get()
+  {
+    static BackgroundSync Singleton;
+    return Singleton;
+  }
+
+  /// Forces the files still queued to the disk and stops the thread.
+  ~BackgroundSync()
+  {
+    {
+      std::lock_guard<std::mutex> L{Lock};
+      Stopping = true;
+    }
+    Wakeup.notify_one();
+    Thread.join();
+  }
+
+  BackgroundSync(const BackgroundSync&) = delete;
+  BackgroundSync& operator=(const BackgroundSync&) = delete;
+
+  /// Queues \p File to be forced to the disk, if it is not queued already.
+  void request(std::shared_ptr<detail::RecordingFile> File)
+  {
+    if (File->Queued.exchange(true))
+      return;
+    {
+      std::lock_guard<std::mutex> L{Lock};
+      Queue.emplace_back(std::move(File));
+    }
+    Wakeup.notify_one();
+  }
+
+private:
+  BackgroundSync() : Thread([this] { run(); }) {}
+
+  std::mutex Lock;
+  std::condition_variable Wakeup;
+  std::vector<std::shared_ptr<detail::RecordingFile>> Queue;
+  bool Stopping = false;
+  std::thread Thread;
+
+  void run();
+};
+
+void BackgroundSync::run()
+{
+  // Signals are meant for the thread of the program.
+  {
+    ::sigset_t All;
+    ::sigfillset(&All);
+    ::pthread_sigmask(SIG_BLOCK, &All, nullptr);
+  }
+
+  std::vector<std::shared_ptr<detail::RecordingFile>> Batch;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> L{Lock};
+      Wakeup.wait(L, [this] { return Stopping || !Queue.empty(); });
+      if (Queue.empty())
+        break;
+      Batch.swap(Queue);
+    }
+
+    for (const std::shared_ptr<detail::RecordingFile>& File : Batch)
+    {
+      // (Data written after this point is synced by the next request.)
+      File->Queued.store(false);
+      auto Synced =
+        CheckedPOSIX([&File] { return ::fdatasync(File->FD); }, -1);
+      if (!Synced)
+        File->Error.store(Synced.getError().value());
+    }
+    // The files of finished segments and recordings are closed here.
+    Batch.clear();
+  }
+}
+
+} // namespace
+
+Recorder::Recorder(const std::string& Directory,
+                   const std::string& Name,
+                   Clock::time_point Now,
+                   std::size_t SegmentLimit)
+  : SegmentLimit(SegmentLimit)
+{
+  static constexpr unsigned MaxTries = 16;
+  const std::string Base =
+    Directory + '/' + sanitiseFileName(Name) + '-' + formatFileTime(Now);
+  for (unsigned Try = 0;; ++Try)
+  {
+    // (A session with the same name might have been recorded in the same
+    // second.)
+    Prefix = Try ? Base + '-' + std::to_string(Try) : Base;
+    try
+    {
+      openSegment(0, toMicros(Now));
+      break;
+    }
+    catch (const std::system_error& Err)
+    {
+      if (Err.code() != std::errc::file_exists || Try == MaxTries)
+        throw;
+    }
+  }
+
+  LOG(debug) << "Recording session \"" << Name << "\" to '" << Prefix << '\'';
+}
+
+Recorder::~Recorder() noexcept
+{
+  if (!Data)
+    return;
+  try
+  {
+    sync();
+  }
+  catch (const std::system_error& Err)
+  {
+    LOG(error) << "Recording '" << Prefix << "' lost data: " << Err.what();
+  }
+}
+
+void Recorder::openSegment(std::size_t N, std::uint64_t Now)
+{
+  const std::string Path = Prefix + '.' + std::to_string(N);
+  auto NewData =
+    std::make_shared<detail::RecordingFile>(openForAppend(Path + ".rec"));
+  auto NewIndex =
+    std::make_shared<detail::RecordingFile>(openForAppend(Path + ".idx"));
+  Data = std::move(NewData);
+  Index = std::move(NewIndex);
+  Segment = N;
+
+  SegmentHeader Header{};
+  std::memcpy(Header.Magic, Magic, sizeof(Magic));
+  Header.Begin = Now;
+  PendingData.append(reinterpret_cast<const char*>(&Header), sizeof(Header));
+
+  SegmentBytes = sizeof(Header);
+  LastTime = Now;
+  IndexedBytes = SegmentBytes;
+  IndexedTime = Now;
+}
+
+void Recorder::append(std::string_view Data, Clock::time_point Now)
+{
+  if (Data.empty())
+    return;
+  // (The wall clock might have been set back.)
+  const std::uint64_t T = std::max(toMicros(Now), LastTime);
+
+  if (SegmentBytes > sizeof(SegmentHeader) &&
+      SegmentBytes + Data.size() > SegmentLimit)
+  {
+    sync();
+    openSegment(Segment + 1, T);
+  }
+
+  if (SegmentBytes - IndexedBytes >= IndexSpacing ||
+      T - IndexedTime >=
+        static_cast<std::uint64_t>(
+          std::chrono::microseconds{IndexInterval}.count()))
+  {
+    IndexEntry Entry{LastTime, SegmentBytes};
+    PendingIndex.append(reinterpret_cast<const char*>(&Entry), sizeof(Entry));
+    IndexedBytes = SegmentBytes;
+    IndexedTime = T;
+  }
+
+  const std::size_t PendingBefore = PendingData.size();
+  putVarint(PendingData, T - LastTime);
+  putVarint(PendingData, Data.size());
+  PendingData.append(Data);
+  SegmentBytes += PendingData.size() - PendingBefore;
+  LastTime = T;
+  Recorded += Data.size();
+
+  if (PendingData.size() >= FlushSize)
+    flush();
+}
+
+void Recorder::flush()
+{
+  if (PendingData.empty() && PendingIndex.empty())
+    return;
+  // The index is written after the data, so it never points past it.
+  writeAll(Data->FD, PendingData);
+  PendingData.clear();
+  writeAll(Index->FD, PendingIndex);
+  PendingIndex.clear();
+  Unsynced = true;
+}
+
+void Recorder::sync()
+{
+  for (const detail::RecordingFile* File : {Data.get(), Index.get()})
+    if (int Error = File->Error.load())
+      throw std::system_error{
+        std::error_code{Error, std::system_category()}, "fdatasync()"};
+
+  flush();
+  if (!Unsynced)
+    return;
+  BackgroundSync::get().request(Data);
+  BackgroundSync::get().request(Index);
+  Unsynced = false;
+}
+
+std::optional<RecordingReader>
+RecordingReader::open(std::string_view Path, std::string* FailureReason)
+{
+  static constexpr std::string_view Extension = ".rec";
+  RecordingReader R;
+  R.Prefix = Path;
+  if (R.Prefix.size() > Extension.size() &&
+      R.Prefix.compare(
+        R.Prefix.size() - Extension.size(), Extension.size(), Extension) == 0)
+  {
+    // Given a segment, "PREFIX.N.rec".
+    R.Prefix.resize(R.Prefix.size() - Extension.size());
+    std::string::size_type Dot = R.Prefix.rfind('.');
+    if (Dot != std::string::npos && Dot + 1 < R.Prefix.size() &&
+        R.Prefix.find_first_not_of("0123456789", Dot + 1) == std::string::npos)
+      R.Prefix.resize(Dot);
+  }
+
+  for (std::size_t N = 0;; ++N)
+  {
+    std::string SegmentPath = R.Prefix + '.' + std::to_string(N) + ".rec";
+    std::ifstream File{SegmentPath, std::ios::binary};
+    if (!File)
+      break;
+
+    SegmentHeader Header{};
+    if (!File.read(reinterpret_cast<char*>(&Header), sizeof(Header)) ||
+        std::memcmp(Header.Magic, Magic, sizeof(Magic)) != 0)
+    {
+      if (N != 0)
+        // The last segment might have been started without any data written.
+        break;
+      if (FailureReason)
+        *FailureReason = "'" + SegmentPath + "' is not a Monomux recording";
+      return std::nullopt;
+    }
+    R.Segments.emplace_back(Segment{std::move(SegmentPath), Header.Begin});
+  }
+
+  if (R.Segments.empty())
+  {
+    if (FailureReason)
+      *FailureReason = "No recording found at '" + std::string{Path} + "'";
+    return std::nullopt;
+  }
+
+  R.openSegment(0);
+  return R;
+}
+
+RecordingReader::Clock::time_point RecordingReader::begin() const noexcept
+{
+  return fromMicros(Segments.front().Begin);
+}
+
+bool RecordingReader::openSegment(
+  std::size_t N,
+  std::optional<std::pair<std::uint64_t, std::uint64_t>> TimeAndOffset)
+{
+  Current = N;
+  File.close();
+  File.clear();
+  File.open(Segments.at(N).Path, std::ios::binary);
+  if (TimeAndOffset)
+  {
+    Time = TimeAndOffset->first;
+    File.seekg(static_cast<std::streamoff>(TimeAndOffset->second));
+  }
+  else
+  {
+    Time = Segments.at(N).Begin;
+    File.seekg(sizeof(SegmentHeader));
+  }
+  return static_cast<bool>(File);
+}
+
+void RecordingReader::seek(Clock::time_point Time)
+{
+  const std::uint64_t At = toMicros(Time);
+  SkipUntil = At;
+
+  // The records at the time might be at the end of the previous segment if
+  // the segment started at exactly that time, so look for the last segment,
+  // and the last index entry in it, that is strictly before.
+  auto SegIt = std::lower_bound(
+    Segments.begin(),
+    Segments.end(),
+    At,
+    [](const Segment& S, std::uint64_t T) { return S.Begin < T; });
+  const std::size_t N =
+    SegIt == Segments.begin() ? 0 : std::distance(Segments.begin(), SegIt) - 1;
+
+  std::vector<IndexEntry> Entries;
+  {
+    std::ifstream IndexFile{Prefix + '.' + std::to_string(N) + ".idx",
+                            std::ios::binary};
+    IndexEntry Entry{};
+    while (IndexFile.read(reinterpret_cast<char*>(&Entry), sizeof(Entry)))
+      Entries.emplace_back(Entry);
+  }
+  auto EntryIt = std::lower_bound(
+    Entries.begin(),
+    Entries.end(),
+    At,
+    [](const IndexEntry& E, std::uint64_t T) { return E.Time < T; });
+
+  std::optional<std::pair<std::uint64_t, std::uint64_t>> Start;
+  if (EntryIt != Entries.begin())
+  {
+    --EntryIt;
+    Start.emplace(EntryIt->Time, EntryIt->Offset);
+  }
+  if (!openSegment(N, Start))
+    Current = Segments.size();
+}
+
+std::optional<RecordingReader::Record> RecordingReader::next()
+{
+  while (Current < Segments.size())
+  {
+    std::uint64_t Delta;
+    std::uint64_t Length;
+    if (getVarint(File, Delta) && getVarint(File, Length) &&
+        Length <= Recorder::SegmentSize)
+    {
+      std::string Data(Length, '\0');
+      if (File.read(Data.data(), static_cast<std::streamsize>(Length)))
+      {
+        Time += Delta;
+        if (Time < SkipUntil)
+          continue;
+        return Record{fromMicros(Time), std::move(Data)};
+      }
+    }
+
+    // The end of the segment, or a record torn by a crash of the writer.
+    if (Current + 1 >= Segments.size() || !openSegment(Current + 1))
+      Current = Segments.size();
+  }
+  return std::nullopt;
+}
+
+} // namespace monomux::server
+
+#undef LOG
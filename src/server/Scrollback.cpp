@@ -0,0 +1,154 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+
+#include "monomux/server/Scrollback.hpp"
+
+namespace monomux::server
+{
+
+void Scrollback::setLimit(std::size_t Limit)
+{
+  clear();
+  this->Limit = Limit;
+}
+
+void Scrollback::append(std::string_view Data)
+{
+  End += Data.size();
+  if (!Limit || Data.empty())
+    return;
+  if (!Buffer)
+    Buffer.emplace(Limit);
+
+  if (Data.size() >= Limit)
+  {
+    Truncated = Truncated || !Buffer->empty() || Data.size() > Limit;
+    Buffer->clear();
+    Data.remove_prefix(Data.size() - Limit);
+  }
+  else if (std::size_t Size = Buffer->size(); Size + Data.size() > Limit)
+  {
+    // Making room first keeps the buffer from growing beyond the limit.
+    Truncated = true;
+    Buffer->dropFront(Size + Data.size() - Limit);
+  }
+  Buffer->putBack(Data.data(), Data.size());
+
+  // (Data was cut to the part that is retained, so only that is indexed.)
+  Index.append(End - Data.size(), Data);
+  Index.discardBefore(begin());
+}
+
+std::string_view Scrollback::replay() const noexcept
+{
+  std::string_view V = contents();
+  if (!Truncated)
+    return V;
+  if (auto Pos = V.find('\n'); Pos != std::string_view::npos)
+    V.remove_prefix(Pos + 1);
+  return V;
+}
+
+std::uint64_t
+Scrollback::replayFrom(std::optional<std::uint64_t> Resume) const noexcept
+{
+  if (Resume && *Resume >= begin() && *Resume <= end())
+    return *Resume;
+  return end() - replay().size();
+}
+
+std::vector<std::uint64_t> Scrollback::find(std::string_view Pattern,
+                                            std::size_t MaxMatches) const
+{
+  std::vector<std::uint64_t> Ret;
+  if (Pattern.empty() || !MaxMatches)
+    return Ret;
+
+  const std::string_view Text = contents();
+  const std::uint64_t Base = begin();
+  for (auto [From, To] : Index.candidates(Pattern))
+  {
+    From = std::max(From, Base);
+    To = std::min(To, End);
+    if (From >= To)
+      continue;
+
+    // A match starting in the range might extend past it.
+    std::string_view Range =
+      Text.substr(From - Base, To - From + Pattern.size() - 1);
+    for (std::size_t Pos = Range.find(Pattern);
+         Pos != std::string_view::npos && From + Pos < To;
+         Pos = Range.find(Pattern, Pos + 1))
+    {
+      Ret.emplace_back(From + Pos);
+      if (Ret.size() == MaxMatches)
+        return Ret;
+    }
+  }
+  return Ret;
+}
+
+std::string_view Scrollback::lines(std::uint64_t Offset,
+                                   std::size_t Context,
+                                   std::size_t MaxBytes) const
+{
+  const std::string_view Text = contents();
+  if (Offset < begin() || Offset >= End)
+    return {};
+  const std::size_t Pos = Offset - begin();
+
+  auto LineStart = [Text](std::size_t P) -> std::size_t {
+    if (P == 0)
+      return 0;
+    std::size_t NL = Text.rfind('\n', P - 1);
+    return NL == std::string_view::npos ? 0 : NL + 1;
+  };
+  std::size_t B = LineStart(Pos);
+  for (std::size_t I = 0; I < Context && B > 0; ++I)
+    B = LineStart(B - 1);
+
+  std::size_t E = Text.find('\n', Pos);
+  for (std::size_t I = 0; I < Context && E != std::string_view::npos; ++I)
+  {
+    std::size_t NL = Text.find('\n', E + 1);
+    if (NL == std::string_view::npos)
+      break;
+    E = NL;
+  }
+  if (E == std::string_view::npos)
+    E = Text.size();
+
+  if (E - B > MaxBytes)
+  {
+    // Lines without breaks (e.g., progress bars) are cut around the offset.
+    B = std::max(B, Pos - std::min(Pos, MaxBytes / 2));
+    E = std::min(E, B + MaxBytes);
+  }
+  return Text.substr(B, E - B);
+}
+
+void Scrollback::clear() noexcept
+{
+  Buffer.reset();
+  Index.clear();
+  Truncated = false;
+}
+
+} // namespace monomux::server
@@ -0,0 +1,146 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+
+#include "monomux/server/SearchIndex.hpp"
+
+namespace monomux::server
+{
+
+namespace
+{
+
+constexpr std::uint32_t TrigramMask = 0xFFFFFF;
+
+/// \returns the two bit positions in a filter for \p Trigram.
+std::pair<std::size_t, std::size_t> bitsOf(std::uint32_t Trigram) noexcept
+{
+  static constexpr std::uint32_t Multiplier = 0x9E3779B1; // Fibonacci hashing.
+  static constexpr unsigned Log2Bits = 12;
+  static_assert(SearchIndex::FilterBits == 1U << Log2Bits);
+  const std::uint32_t H = Trigram * Multiplier;
+  return {H >> (32 - Log2Bits), (H >> 8) & (SearchIndex::FilterBits - 1)};
+}
+
+} // namespace
+
+void SearchIndex::insert(Filter& F, std::uint32_t Trigram) noexcept
+{
+  auto [B1, B2] = bitsOf(Trigram);
+  F[B1 / 64] |= 1ULL << (B1 % 64);
+  F[B2 / 64] |= 1ULL << (B2 % 64);
+}
+
+bool SearchIndex::contains(const Filter& F, std::uint32_t Trigram) noexcept
+{
+  auto [B1, B2] = bitsOf(Trigram);
+  return (F[B1 / 64] & (1ULL << (B1 % 64))) &&
+         (F[B2 / 64] & (1ULL << (B2 % 64)));
+}
+
+void SearchIndex::append(std::uint64_t Offset, std::string_view Data)
+{
+  if (Offset != End)
+    clear();
+  End = Offset + Data.size();
+
+  for (char Ch : Data)
+  {
+    if (Blocks.empty() || Offset >= Blocks.back().Begin + BlockSize)
+      Blocks.emplace_back(Block{Offset - Offset % BlockSize, {}});
+
+    Window = ((Window << 8) | static_cast<unsigned char>(Ch)) & TrigramMask;
+    if (++WindowSize >= 3)
+    {
+      // The trigram starts 2 bytes earlier, which might be the previous block.
+      const std::uint64_t Start = Offset - 2;
+      Block& B = Start >= Blocks.back().Begin || Blocks.size() < 2
+                   ? Blocks.back()
+                   : Blocks[Blocks.size() - 2];
+      insert(B.Trigrams, Window);
+    }
+    ++Offset;
+  }
+}
+
+void SearchIndex::discardBefore(std::uint64_t Offset)
+{
+  while (!Blocks.empty() && Blocks.front().Begin + BlockSize <= Offset)
+    Blocks.pop_front();
+}
+
+void SearchIndex::clear() noexcept
+{
+  Blocks.clear();
+  Window = 0;
+  WindowSize = 0;
+}
+
+std::vector<std::pair<std::uint64_t, std::uint64_t>>
+SearchIndex::candidates(std::string_view Pattern) const
+{
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> Ret;
+  if (Blocks.empty() || Pattern.empty())
+    return Ret;
+  if (Pattern.size() < 3 || Pattern.size() > BlockSize + 2)
+  {
+    // Without trigrams, or with a match possibly spanning more than two
+    // blocks, the index cannot tell anything.
+    Ret.emplace_back(Blocks.front().Begin, End);
+    return Ret;
+  }
+
+  std::vector<std::uint32_t> Trigrams;
+  Trigrams.reserve(Pattern.size() - 2);
+  for (std::size_t I = 0; I + 2 < Pattern.size(); ++I)
+    Trigrams.emplace_back(
+      (static_cast<std::uint32_t>(static_cast<unsigned char>(Pattern[I]))
+       << 16) |
+      (static_cast<std::uint32_t>(static_cast<unsigned char>(Pattern[I + 1]))
+       << 8) |
+      static_cast<unsigned char>(Pattern[I + 2]));
+
+  for (std::size_t I = 0; I < Blocks.size(); ++I)
+  {
+    // A match starting in the block has its first trigram start in it, and
+    // the others either in it, or in the next one.
+    const Block& B = Blocks[I];
+    const Block* Next = I + 1 < Blocks.size() ? &Blocks[I + 1] : nullptr;
+    if (!contains(B.Trigrams, Trigrams.front()))
+      continue;
+    bool Candidate = true;
+    for (std::uint32_t T : Trigrams)
+      if (!contains(B.Trigrams, T) && (!Next || !contains(Next->Trigrams, T)))
+      {
+        Candidate = false;
+        break;
+      }
+    if (!Candidate)
+      continue;
+
+    const std::uint64_t To = std::min(B.Begin + BlockSize, End);
+    if (!Ret.empty() && Ret.back().second == B.Begin)
+      Ret.back().second = To;
+    else
+      Ret.emplace_back(B.Begin, To);
+  }
+  return Ret;
+}
+
+} // namespace monomux::server
@@ -16,29 +16,34 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
 #include <chrono>
+#include <csignal>
 #include <iomanip>
 #include <set>
-#include <thread>
 
 #include "monomux/adt/POD.hpp"
 #include "monomux/control/PascalString.hpp"
 #include "monomux/system/CheckedPOSIX.hpp"
+#include "monomux/system/Environment.hpp"
 #include "monomux/system/Time.hpp"
+#include "monomux/system/Trace.hpp"
 
 #include "monomux/server/Server.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("server/Server")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "server/Server")
 
 namespace monomux::server
 {
 
 Server::Server(Socket&& Sock)
-  : Sock(std::move(Sock)), ExitIfNoMoreSessions(false)
+  : Sock(std::move(Sock)),
+    NextStreamToken(static_cast<std::uint64_t>(
+      std::chrono::system_clock::now().time_since_epoch().count())),
+    ExitIfNoMoreSessions(false)
 {
   setUpDispatch();
-  DeadChildren.fill(Process::Invalid);
 }
 
 Server::~Server() = default;
@@ -54,77 +59,77 @@ void Server::setExitIfNoMoreSessions(bool ExitIfNoMoreSessions)
   this->ExitIfNoMoreSessions = ExitIfNoMoreSessions;
 }
 
+void Server::setMaxBufferMemory(std::size_t Bytes) { BufferBudget = Bytes; }
+
+void Server::setWarmSessions(std::size_t PerProfile)
+{
+  WarmSessions.setPerProfile(PerProfile);
+}
+
+void Server::setListenQueue(std::size_t QueueSize)
+{
+  ListenQueueSize = QueueSize;
+}
+
+void Server::setScrollbackSize(std::size_t Bytes) { ScrollbackBytes = Bytes; }
+
+void Server::setRecordingDirectory(std::string Directory)
+{
+  RecordingDirectory = std::move(Directory);
+}
+
+void Server::setSynchronousSignals(bool SynchronousSignals)
+{
+  this->SynchronousSignals = SynchronousSignals;
+}
+
+/// The period of waking up the server while sessions are throttled.
+static constexpr std::chrono::seconds BudgetRecheckInterval{1};
+
 /// Reschedules the overflown buffer identified by \p BO to the next iteration
 /// of \p Poll.
 static void rescheduleOverflow(EPoll& Poll, const buffer_overflow& BO)
 {
+  trace::record(trace::EventID::Overflow,
+                BO.fd(),
+                BO.readOverflow() ? BO.channel().readInBuffer()
+                                  : BO.channel().writeInBuffer());
   Poll.schedule(BO.fd(), BO.readOverflow(), BO.writeOverflow());
 }
 
-/// Tries to flush the contents of the socket, and if the flushing fails,
-/// schedules it for the next iteration of \p Poll.
-static void flushAndReschedule(EPoll& Poll, Socket& S)
-{
-  S.flushWrites();
-  if (S.hasBufferedWrite())
-    Poll.schedule(S.raw(), /* Incoming =*/false, /* Outgoing =*/true);
-}
-
 void Server::loop()
 {
-  static constexpr std::size_t ListenQueue = 16;
   static constexpr std::size_t EventQueue = 1 << 13;
 
   WhenStarted = std::chrono::system_clock::now();
-  Sock.listen(ListenQueue);
+  if (!Sock.listening())
+    Sock.listen(ListenQueueSize);
+  reserveSpareFD();
 
   fd::addStatusFlag(Sock.raw(), O_NONBLOCK);
   Poll = std::make_unique<EPoll>(EventQueue);
   Poll->listen(Sock.raw(), /* Incoming =*/true, /* Outgoing =*/false);
-
-  auto NewClient = [this]() -> bool {
-    std::error_code Error;
-    bool Recoverable;
-    std::optional<Socket> ClientSock = Sock.accept(&Error, &Recoverable);
-    if (!ClientSock)
-    {
-      if (Recoverable)
-        LOG(warn) << "accept() did not succeed: " << Error;
-      else
-        LOG(error) << "accept() did not succeed: " << Error
-                   << " (not recoverable)";
-
-      if (Recoverable)
-      {
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-        return true;
-      }
-      return false;
-    }
-
-    // A new client was accepted.
-    if (ClientData* ExistingClient = getClient(ClientSock->raw()))
-    {
-      // The client with the same socket FD is already known.
-      // TODO: What is the good way of handling this?
-      LOG(debug) << "Stale socket of gone client, " << ClientSock->raw()
-                 << " left behind?";
-      exitCallback(*ExistingClient);
-      removeClient(*ExistingClient);
-    }
-
-    ClientData* Client =
-      makeClient(ClientData{std::make_unique<Socket>(std::move(*ClientSock))});
-    acceptCallback(*Client);
-    return false;
-  };
+  armBufferSweep();
+  if (RecordingDirectory)
+    armRecordingSync();
+  if (SynchronousSignals)
+  {
+    Signals = std::make_unique<SignalFD>(
+      std::initializer_list<SignalFD::Signal>{
+        SIGCHLD, SIGTERM, SIGHUP, SIGINT});
+    Poll->listen(Signals->raw(), /* Incoming =*/true, /* Outgoing =*/false);
+  }
 
   while (!TerminateLoop.get().load())
   {
+    ++LoopIterations;
+
     // Process "external" events.
     reapDeadChildren();
 
     const std::size_t NumTriggeredFDs = Poll->wait();
+    WokenUp = std::chrono::steady_clock::now();
+    trace::record(trace::EventID::LoopWake, 0, NumTriggeredFDs);
     MONOMUX_TRACE_LOG(LOG(data) << NumTriggeredFDs << " events received!");
     for (std::size_t I = 0; I < NumTriggeredFDs; ++I)
     {
@@ -144,12 +149,15 @@ void Server::loop()
         continue;
       }
 
+      if (Signals && Event.FD == Signals->raw())
+      {
+        signalCallback();
+        continue;
+      }
       if (Event.FD == Sock.raw())
       {
         // Event occured on the main socket.
-        bool Retry = NewClient();
-        if (Retry)
-          --I;
+        acceptClients();
         continue;
       }
 
@@ -172,7 +180,15 @@ void Server::loop()
       {
         if (auto* Session = std::get_if<SessionConnection>(Entity))
         {
-          SessionData& S = **Session;
+          SessionData* SP = SessionStorage.get(*Session);
+          if (!SP)
+          {
+            LOG(error) << "\tSession for file descriptor " << Event.FD
+                       << " is gone (stale lookup entry)";
+            FDLookup.erase(Event.FD);
+            continue;
+          }
+          SessionData& S = *SP;
           if (Event.Incoming)
           {
             // First check for data coming from a session. This is the most
@@ -189,40 +205,72 @@ void Server::loop()
             }
             catch (const buffer_overflow& BO)
             {
+              ++S.traffic().Overflows;
+              ++Overflows;
               rescheduleOverflow(*Poll, BO);
             }
           }
           continue;
         }
+        if (auto* Process = std::get_if<SessionProcess>(Entity))
+        {
+          // The main process of a session terminated.
+          SessionData* SP = SessionStorage.get(*Process);
+          if (!SP || !reapSession(*SP))
+          {
+            // Stop watching, otherwise the event would fire again and again.
+            LOG(error) << "\tProcess for file descriptor " << Event.FD
+                       << " exited, but its session could not be reaped";
+            Poll->stop(Event.FD);
+            FDLookup.erase(Event.FD);
+          }
+          continue;
+        }
         if (auto* Data = std::get_if<ClientDataConnection>(Entity))
         {
-          ClientData& C = **Data;
-          auto ClientID = C.id();
+          ClientDataConnection Handle = *Data;
+          ClientData* CP = ClientStorage.get(Handle);
+          if (!CP)
+          {
+            LOG(error) << "\tClient for file descriptor " << Event.FD
+                       << " is gone (stale lookup entry)";
+            FDLookup.erase(Event.FD);
+            continue;
+          }
+          ClientData& C = *CP;
 
           if (Event.Incoming)
             // Second, try to see if the data is coming from a client, like
             // keypresses and such. We expect to see many of these, too.
             dataCallback(C);
           if (Event.Outgoing)
-            flushAndReschedule(*Poll, *C.getDataSocket());
+            flushAndReschedule(C, *C.getDataSocket());
 
-          if (Clients.find(ClientID) != Clients.end())
+          if (ClientStorage.get(Handle))
             C.getDataSocket()->tryFreeResources();
           continue;
         }
         if (auto* Control = std::get_if<ClientControlConnection>(Entity))
         {
-          ClientData& C = **Control;
-          auto ClientID = C.id();
+          ClientControlConnection Handle = *Control;
+          ClientData* CP = ClientStorage.get(Handle);
+          if (!CP)
+          {
+            LOG(error) << "\tClient for file descriptor " << Event.FD
+                       << " is gone (stale lookup entry)";
+            FDLookup.erase(Event.FD);
+            continue;
+          }
+          ClientData& C = *CP;
 
           if (Event.Incoming)
             // Lastly, check if the receive is happening on the control
             // connection, where messages are small and far inbetween.
             controlCallback(C);
           if (Event.Outgoing)
-            flushAndReschedule(*Poll, C.getControlSocket());
+            flushAndReschedule(C, C.getControlSocket());
 
-          if (Clients.find(ClientID) != Clients.end())
+          if (ClientStorage.get(Handle))
             C.getControlSocket().tryFreeResources();
           continue;
         }
@@ -230,6 +278,7 @@ void Server::loop()
       catch (const buffer_overflow& BO)
       {
         LOG(error) << "Generic handling error:\n\t" << BO.what();
+        ++Overflows;
         rescheduleOverflow(*Poll, BO);
       }
       catch (const std::system_error& Err)
@@ -239,9 +288,299 @@ void Server::loop()
         LOG(error) << "Generic handling error:\n\t" << Err.what();
       }
     }
+
+    enforceBufferBudget();
+    if (HasThrottledSessions && !Poll->timers().isArmed(BudgetTimer))
+      // The timer only wakes the loop up, which then rechecks the budget.
+      BudgetTimer = Poll->timers().arm(
+        TimerWheel::Clock::now() + BudgetRecheckInterval, [] {});
+    LoopIterationTime.record(*nanosSinceWokenUp());
+  }
+  WokenUp = {};
+
+  if (Signals)
+  {
+    Poll->stop(Signals->raw());
+    Signals.reset();
+  }
+}
+
+void Server::reserveSpareFD()
+{
+  if (SpareFD.has())
+    return;
+
+  auto MaybeFD = CheckedPOSIX(
+    [] { return ::open("/dev/null", O_RDONLY | O_CLOEXEC); }, -1);
+  if (!MaybeFD)
+  {
+    LOG(warn) << "Failed to reserve a spare file descriptor: "
+              << MaybeFD.getError().message();
+    return;
+  }
+  SpareFD = fd{MaybeFD.get()};
+}
+
+void Server::acceptClients()
+{
+  for (std::size_t N = 0; N < AcceptBurst; ++N)
+  {
+    std::error_code Error;
+    bool Recoverable = false;
+    std::optional<Socket> ClientSock = Sock.accept(&Error, &Recoverable);
+    if (!ClientSock)
+    {
+      if (Error == std::errc::resource_unavailable_try_again ||
+          Error == std::errc::operation_would_block)
+        // All pending connections were accepted.
+        return;
+      if (Error == std::errc::interrupted ||
+          Error == std::errc::connection_aborted)
+        continue;
+
+      if (Recoverable && rejectClientWithSpareFD())
+        continue;
+
+      LOG(error) << "accept() did not succeed: " << Error;
+      if (Recoverable)
+        pauseAccepting();
+      return;
+    }
+
+    // A new client was accepted.
+    if (ClientData* ExistingClient = getClient(ClientSock->raw()))
+    {
+      // The client with the same socket FD is already known.
+      // TODO: What is the good way of handling this?
+      LOG(debug) << "Stale socket of gone client, " << ClientSock->raw()
+                 << " left behind?";
+      exitCallback(*ExistingClient);
+      removeClient(*ExistingClient);
+    }
+
+    ClientData* Client = makeClient(ClientData{std::move(*ClientSock)});
+    acceptCallback(*Client);
+  }
+}
+
+bool Server::rejectClientWithSpareFD()
+{
+  if (!SpareFD.has())
+    return false;
+
+  fd::close(SpareFD.release());
+  bool Rejected = false;
+  if (std::optional<Socket> ClientSock = Sock.accept())
+  {
+    ++ClientsRejected;
+    LOG(warn) << "Rejecting client - out of file descriptors";
+    try
+    {
+      // The message is small enough to fit the empty socket buffer of a new
+      // connection, so it is written without having to wait for the client.
+      using namespace monomux::message;
+      sendMessage(*ClientSock,
+                  notification::Connection{
+                    {false}, "Not enough file descriptors left on server."});
+    }
+    catch (...)
+    {}
+    Rejected = true;
+  }
+  reserveSpareFD();
+  return Rejected;
+}
+
+void Server::pauseAccepting()
+{
+  if (Poll->timers().isArmed(AcceptRetryTimer))
+    return;
+
+  LOG(warn) << "Not accepting clients for " << AcceptRetryDelay.count()
+            << " ms - out of file descriptors";
+  Poll->stop(Sock.raw());
+  AcceptRetryTimer =
+    Poll->timers().arm(TimerWheel::Clock::now() + AcceptRetryDelay, [this] {
+      reserveSpareFD();
+      Poll->listen(Sock.raw(), /* Incoming =*/true, /* Outgoing =*/false);
+    });
+}
+
+void Server::signalCallback()
+{
+  while (std::optional<struct ::signalfd_siginfo> Info = Signals->read())
+  {
+    const auto SigNum = static_cast<SignalFD::Signal>(Info->ssi_signo);
+    MONOMUX_TRACE_LOG(LOG(trace) << "Received signal " << SigNum);
+    switch (SigNum)
+    {
+      case SIGCHLD:
+        registerDeadChild(static_cast<Process::raw_handle>(Info->ssi_pid));
+        break;
+      case SIGTERM:
+      case SIGHUP:
+      case SIGINT:
+        LOG(info) << "Received signal " << SigNum << ", shutting down";
+        interrupt();
+        break;
+      default:
+        break;
+    }
+  }
+  reapDeadChildren();
+}
+
+void Server::releaseIdleBuffers()
+{
+  for (const auto& E : Sessions)
+  {
+    SessionData& S = *SessionStorage.get(E.second);
+    if (Pipe* R = S.getReader())
+      R->tryFreeResources();
+    if (Pipe* W = S.getWriter())
+      W->tryFreeResources();
+  }
+  for (const auto& E : Clients)
+  {
+    ClientData& C = *ClientStorage.get(E.second);
+    C.getControlSocket().tryFreeResources();
+    if (Socket* DS = C.getDataSocket())
+      DS->tryFreeResources();
+  }
+}
+
+void Server::armWarmRefill()
+{
+  if (Poll->timers().isArmed(WarmRefillTimer))
+    return;
+  WarmRefillTimer = Poll->timers().arm(TimerWheel::Clock::now(), [this] {
+    std::size_t Spawned = WarmSessions.refill(
+      [this](Process::SpawnOptions& Opts, const std::string& Name) {
+        addSessionEnvironment(Opts, Name);
+      });
+    MONOMUX_TRACE_LOG(LOG(debug)
+                      << "Spawned " << Spawned << " idle session processes");
+    (void)Spawned;
+  });
+}
+
+void Server::addSessionEnvironment(Process::SpawnOptions& Opts,
+                                   const std::string& Name) const
+{
+  MonomuxSession MS;
+  MS.SessionName = Name;
+  MS.Socket = SocketPath::absolutise(Sock.identifier());
+
+  for (std::pair<std::string, std::string> BuiltinEnvVar : MS.createEnvVars())
+    Opts.Environment[std::move(BuiltinEnvVar.first)] =
+      std::move(BuiltinEnvVar.second);
+}
+
+bool Server::spawnSession(SessionData& Session, Process::SpawnOptions Opts)
+{
+  if (std::optional<SessionPool::Adopted> Warm = WarmSessions.take(Opts))
+  {
+    // The process knows itself by the name it was spawned with, which is
+    // kept as an alias for the controlling client to find the session.
+    LOG(debug) << "Adopting idle process " << Warm->Proc.raw() << " (\""
+               << Warm->Name << "\")";
+    Session.setProcess(std::move(Warm->Proc));
+    Session.setAlias(std::move(Warm->Name));
+    return true;
+  }
+
+  // Inject the variables needed by the controlling client to detach from
+  // the session.
+  addSessionEnvironment(Opts, Session.name());
+  try
+  {
+    Session.setProcess(Process::spawn(Opts));
+  }
+  catch (const std::system_error& Err)
+  {
+    LOG(error) << "Failed to spawn \"" << Opts.Program
+               << "\" for session: " << Err.what();
+    return false;
+  }
+  return true;
+}
+
+bool Server::hangupSession(SessionData& Session)
+{
+  if (!Session.hasProcess())
+    return false;
+
+  LOG(info) << "Hanging up Session \"" << Session.name() << '"';
+  if (!Session.getProcess().signal(SIGHUP))
+  {
+    LOG(error) << "Session \"" << Session.name() << "\": error when hanging up";
+    return false;
+  }
+
+  // (The timer is not cancelled on the exit of the session, as the handle of
+  // a destroyed session does not resolve anymore.)
+  Poll->timers().arm(
+    TimerWheel::Clock::now() + HangupGracePeriod,
+    [this, H = SessionStorage.handleOf(Session)] {
+      SessionData* S = SessionStorage.get(H);
+      if (!S)
+        return;
+      LOG(warn) << "Session \"" << S->name() << "\" did not exit after "
+                << HangupGracePeriod.count() << " seconds, killing...";
+      if (!S->getProcess().signal(SIGKILL))
+        LOG(error) << "Session \"" << S->name() << "\": error when killing";
+    });
+  return true;
+}
+
+void Server::armBufferSweep()
+{
+  Poll->timers().arm(TimerWheel::Clock::now() + BufferedChannel::BufferIdleTime,
+                     [this] {
+                       releaseIdleBuffers();
+                       armBufferSweep();
+                     });
+}
+
+void Server::syncRecordings()
+{
+  for (const auto& E : Sessions)
+  {
+    SessionData& S = *SessionStorage.get(E.second);
+    Recorder* R = S.recorder();
+    if (!R)
+      continue;
+    try
+    {
+      R->sync();
+    }
+    catch (const std::system_error& Err)
+    {
+      LOG(error) << "Session \"" << S.name()
+                 << "\": recording stopped: " << Err.what();
+      S.setRecorder(nullptr);
+    }
   }
 }
 
+void Server::armRecordingSync()
+{
+  Poll->timers().arm(TimerWheel::Clock::now() + Recorder::SyncInterval,
+                     [this] {
+                       syncRecordings();
+                       armRecordingSync();
+                     });
+}
+
+std::optional<std::uint64_t> Server::nanosSinceWokenUp() const noexcept
+{
+  if (WokenUp == std::chrono::steady_clock::time_point{})
+    return std::nullopt;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now() - WokenUp)
+    .count();
+}
+
 void Server::interrupt() const noexcept { TerminateLoop.get().store(true); }
 
 static void sendKickClient(ClientData& Client, std::string Reason)
@@ -259,12 +598,230 @@ static void sendKickClient(ClientData& Client, std::string Reason)
   {}
 }
 
+void Server::enforceBufferBudget()
+{
+  if (!BufferBudget)
+    return;
+
+  const auto Usage = [] {
+    BufferedChannel::MemoryStatistics BM = BufferedChannel::memoryStatistics();
+    return BM.Bytes + BM.PooledBytes;
+  };
+  // Buffers grow by doubling, so a single store can double the usage. Sessions
+  // are throttled from half of the budget so that this does not overshoot the
+  // budget, and resumed only below a quarter of it, so that they do not flap
+  // around a single threshold.
+  const std::size_t ThrottleAt = BufferBudget / 2;
+  const std::size_t ResumeAt = BufferBudget / 4;
+
+  std::size_t Used = Usage();
+  if (Used >= ThrottleAt)
+  {
+    BufferedChannel::releasePool();
+    Used = Usage();
+  }
+
+  if (Used < ResumeAt)
+  {
+    for (const auto& E : Sessions)
+    {
+      SessionData& S = *SessionStorage.get(E.second);
+      if (!S.isThrottled())
+        continue;
+
+      LOG(info) << "Session \"" << S.name() << "\" resumed";
+      S.setThrottled(false);
+      Poll->listen(
+        S.getIdentifyingFD(), /* Incoming =*/true, /* Outgoing =*/false);
+    }
+    HasThrottledSessions = false;
+    return;
+  }
+  if (Used < ThrottleAt)
+    return;
+
+  // Stop reading the sessions that have the most data held for them, until
+  // the throttled sessions account for the usage over the resume threshold.
+  std::vector<std::pair<std::size_t, SessionData*>> SessionLoads;
+  for (const auto& E : Sessions)
+  {
+    SessionData& S = *SessionStorage.get(E.second);
+    if (S.isThrottled() || !S.getReader())
+      continue;
+
+    std::size_t Load =
+      S.getReader()->bufferMemory() + S.getWriter()->bufferMemory();
+    for (PoolHandle<ClientData> H : S.getAttachedClients())
+      if (ClientData* C = ClientStorage.get(H))
+        if (Socket* DS = C->getDataSocket())
+          Load += DS->bufferMemory();
+    if (Load)
+      SessionLoads.emplace_back(Load, &S);
+  }
+  std::sort(SessionLoads.begin(),
+            SessionLoads.end(),
+            [](const auto& L, const auto& R) { return L.first > R.first; });
+  std::size_t ThrottledLoad = 0;
+  for (const auto& [Load, S] : SessionLoads)
+  {
+    if (ThrottledLoad >= Used - ResumeAt)
+      break;
+
+    LOG(warn) << "Session \"" << S->name() << "\" throttled, " << Load
+              << " bytes of buffers held for it";
+    S->setThrottled(true);
+    Poll->stop(S->getIdentifyingFD());
+    HasThrottledSessions = true;
+    ++BudgetThrottles;
+    ThrottledLoad += Load;
+  }
+
+  if (Used <= BufferBudget)
+    return;
+
+  // Over the budget, shed the clients with the largest buffers.
+  std::vector<std::pair<std::size_t, PoolHandle<ClientData>>> ClientLoads;
+  for (const auto& E : Clients)
+  {
+    ClientData& C = *ClientStorage.get(E.second);
+    std::size_t Load = C.getControlSocket().bufferMemory();
+    if (Socket* DS = C.getDataSocket())
+      Load += DS->bufferMemory();
+    if (Load)
+      ClientLoads.emplace_back(Load, E.second);
+  }
+  std::sort(ClientLoads.begin(),
+            ClientLoads.end(),
+            [](const auto& L, const auto& R) { return L.first > R.first; });
+  std::size_t ShedLoad = 0;
+  for (const auto& [Load, H] : ClientLoads)
+  {
+    if (Used - ShedLoad <= BufferBudget)
+      break;
+    ClientData* C = ClientStorage.get(H);
+    if (!C)
+      continue;
+
+    LOG(warn) << "Client \"" << C->id() << "\" kicked, " << Load
+              << " bytes of buffers held for it";
+    ++ClientsKicked;
+    ++BudgetSheds;
+    trace::record(trace::EventID::ClientKick,
+                  C->getControlSocket().raw(),
+                  Load,
+                  C->id());
+    sendKickClient(*C,
+                   "Server out of buffer memory, " + std::to_string(Load) +
+                     " bytes held for the connection");
+    exitCallback(*C);
+    ShedLoad += Load;
+  }
+  // (The buffers of the kicked clients went to the pool.)
+  BufferedChannel::releasePool();
+}
+
+void Server::armIdleTimer(ClientData& Client)
+{
+  Client.idleTimer() =
+    Poll->timers().arm(TimerWheel::Clock::now() + KeepaliveInterval,
+                       [this, H = ClientStorage.handleOf(Client)] {
+                         if (ClientData* C = ClientStorage.get(H))
+                           idleCheck(*C);
+                       });
+}
+
+void Server::idleCheck(ClientData& Client)
+{
+  const auto Idle =
+    std::chrono::system_clock::now() -
+    std::max(Client.whenCreated(), Client.lastActive());
+  if (!Client.getDataSocket() && Idle >= ClientIdleTimeout)
+  {
+    LOG(info) << "Client \"" << Client.id() << "\" idle, disconnecting";
+    ++ClientsKicked;
+    trace::record(trace::EventID::ClientKick,
+                  Client.getControlSocket().raw(),
+                  0,
+                  Client.id());
+    sendKickClient(Client, "Idle for too long");
+    exitCallback(Client);
+    return;
+  }
+
+  if (Idle >= KeepaliveInterval)
+  {
+    try
+    {
+      sendKeepalive(Client);
+    }
+    // A client that is gone will be noticed when its connection is read.
+    catch (const std::system_error& Err)
+    {
+      MONOMUX_TRACE_LOG(LOG(trace) << "Client \"" << Client.id()
+                                   << "\": keepalive failed: " << Err.what());
+    }
+  }
+  armIdleTimer(Client);
+}
+
+void Server::armInactivityTimer(SessionData& Session,
+                                TimerWheel::Clock::duration After)
+{
+  Session.inactivityTimer() = Poll->timers().arm(
+    TimerWheel::Clock::now() + After,
+    [this, H = SessionStorage.handleOf(Session)] {
+      SessionData* S = SessionStorage.get(H);
+      if (!S)
+        return;
+
+      // The timer is not moved on every output of the session, so check
+      // whether the session was really inactive for long enough.
+      const auto Quiet = std::chrono::system_clock::now() - S->lastActive();
+      if (Quiet >= SessionInactivityTime)
+        inactiveCallback(*S);
+      else
+        armInactivityTimer(*S, SessionInactivityTime - Quiet);
+    });
+}
+
+void Server::flushAndReschedule(ClientData& Client, Socket& S)
+{
+  const std::size_t Pending = S.writeInBuffer();
+  S.flushWrites();
+  trace::record(trace::EventID::Flush, S.raw(), S.writeInBuffer());
+  if (!S.hasBufferedWrite())
+    return;
+  if (S.writeInBuffer() < Pending)
+  {
+    Poll->schedule(S.raw(), /* Incoming =*/false, /* Outgoing =*/true);
+    return;
+  }
+
+  // The client is not reading. Instead of retrying in every iteration of the
+  // loop, give it some time.
+  if (Poll->timers().isArmed(Client.flushTimer()))
+    return;
+  Client.flushTimer() = Poll->timers().arm(
+    TimerWheel::Clock::now() + FlushRetryDelay,
+    [this, H = ClientStorage.handleOf(Client)] {
+      ClientData* C = ClientStorage.get(H);
+      if (!C)
+        return;
+      if (C->getControlSocket().hasBufferedWrite())
+        Poll->schedule(C->getControlSocket().raw(),
+                       /* Incoming =*/false,
+                       /* Outgoing =*/true);
+      if (Socket* DS = C->getDataSocket(); DS && DS->hasBufferedWrite())
+        Poll->schedule(DS->raw(), /* Incoming =*/false, /* Outgoing =*/true);
+    });
+}
+
 void Server::shutdown()
 {
   LOG(info) << "Detaching all clients...";
   while (!Clients.empty())
   {
-    ClientData& Client = *Clients.begin()->second;
+    ClientData& Client = *ClientStorage.get(Clients.begin()->second);
     try
     {
       Client.sendDetachReason(
@@ -282,7 +839,7 @@ void Server::shutdown()
   LOG(info) << "Terminating all sessions...";
   while (!Sessions.empty())
   {
-    SessionData& Session = *Sessions.begin()->second;
+    SessionData& Session = *SessionStorage.get(Sessions.begin()->second);
     removeSession(Session);
   }
 }
@@ -290,36 +847,108 @@ void Server::shutdown()
 ClientData* Server::getClient(std::size_t ID) noexcept
 {
   auto It = Clients.find(ID);
-  return It != Clients.end() ? It->second.get() : nullptr;
+  return It != Clients.end() ? ClientStorage.get(It->second) : nullptr;
 }
 
 SessionData* Server::getSession(std::string_view Name) noexcept
 {
-  auto It =
-    std::find_if(Sessions.begin(), Sessions.end(), [Name](const auto& Elem) {
-      return Elem.first == Name;
-    });
-  return It != Sessions.end() ? It->second.get() : nullptr;
+  auto It = SessionsByName.find(Name);
+  if (It != SessionsByName.end())
+    return It->second;
+  It = SessionsByAlias.find(Name);
+  return It != SessionsByAlias.end() ? It->second : nullptr;
+}
+
+SessionData* Server::getSessionForProcess(Process::raw_handle PID) noexcept
+{
+  auto It = SessionsByPID.find(PID);
+  return It != SessionsByPID.end() ? It->second : nullptr;
+}
+
+/// \returns the number represented by \p Name, if it is written in the format
+/// \p Server::makeDefaultSessionName() would generate.
+static std::optional<std::size_t>
+defaultSessionNameNumber(std::string_view Name) noexcept
+{
+  static constexpr std::size_t MaxDigits = 18;
+  if (Name.empty() || Name.size() > MaxDigits || Name.front() == '0')
+    return std::nullopt;
+
+  std::size_t N = 0;
+  for (char Ch : Name)
+  {
+    if (Ch < '0' || Ch > '9')
+      return std::nullopt;
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    N = N * 10 + static_cast<std::size_t>(Ch - '0');
+  }
+  return N;
+}
+
+std::string Server::makeDefaultSessionName()
+{
+  while (!FreedDefaultSessionNames.empty())
+  {
+    std::string Name = std::to_string(FreedDefaultSessionNames.top());
+    FreedDefaultSessionNames.pop();
+    // (The name might have been taken by an explicitly named session since.)
+    if (!getSession(Name))
+      return Name;
+  }
+
+  std::string Name = std::to_string(NextDefaultSessionName++);
+  while (getSession(Name))
+    Name = std::to_string(NextDefaultSessionName++);
+  return Name;
+}
+
+void Server::releaseDefaultSessionName(std::string_view Name)
+{
+  if (std::optional<std::size_t> N = defaultSessionNameNumber(Name);
+      N && *N < NextDefaultSessionName)
+    FreedDefaultSessionNames.push(*N);
 }
 
 ClientData* Server::makeClient(ClientData Client)
 {
   std::size_t CID = Client.id();
-  auto InsertRes =
-    Clients.try_emplace(CID, std::make_unique<ClientData>(std::move(Client)));
-  if (!InsertRes.second)
+  if (Clients.find(CID) != Clients.end())
     return nullptr;
-  return InsertRes.first->second.get();
+
+  PoolHandle<ClientData> H = ClientStorage.emplace(std::move(Client));
+  Clients.try_emplace(CID, H);
+  return ClientStorage.get(H);
 }
 
 SessionData* Server::makeSession(SessionData Session)
 {
-  std::string SN = Session.name();
-  auto InsertRes =
-    Sessions.try_emplace(SN, std::make_unique<SessionData>(std::move(Session)));
-  if (!InsertRes.second)
+  if (Sessions.find(Session.name()) != Sessions.end())
     return nullptr;
-  return InsertRes.first->second.get();
+
+  PoolHandle<SessionData> H = SessionStorage.emplace(std::move(Session));
+  SessionData* S = SessionStorage.get(H);
+  S->scrollback().setLimit(ScrollbackBytes);
+  S->setStreamToken(++NextStreamToken);
+  if (RecordingDirectory)
+  {
+    try
+    {
+      S->setRecorder(
+        std::make_unique<Recorder>(*RecordingDirectory, S->name()));
+    }
+    catch (const std::system_error& Err)
+    {
+      LOG(error) << "Session \"" << S->name()
+                 << "\": failed to start recording: " << Err.what();
+    }
+  }
+  Sessions.try_emplace(S->name(), H);
+  SessionsByName.try_emplace(S->name(), S);
+  if (!S->alias().empty())
+    SessionsByAlias.try_emplace(S->alias(), S);
+  if (S->hasProcess())
+    SessionsByPID.try_emplace(S->getProcess().raw(), S);
+  return S;
 }
 
 void Server::removeClient(ClientData& Client)
@@ -327,15 +956,34 @@ void Server::removeClient(ClientData& Client)
   std::size_t CID = Client.id();
   if (SessionData* S = Client.getAttachedSession())
     clientDetachedCallback(Client, *S);
+  if (Poll)
+  {
+    Poll->timers().cancel(Client.idleTimer());
+    Poll->timers().cancel(Client.flushTimer());
+  }
   Clients.erase(CID);
+  ClientStorage.erase(Client);
 }
 
 void Server::removeSession(SessionData& Session)
 {
-  for (ClientData* C : Session.getAttachedClients())
-    clientDetachedCallback(*C, Session);
-
+  // (Detaching modifies the list of attached clients.)
+  std::vector<PoolHandle<ClientData>> AttachedClients =
+    Session.getAttachedClients();
+  for (PoolHandle<ClientData> H : AttachedClients)
+    if (ClientData* C = ClientStorage.get(H))
+      clientDetachedCallback(*C, Session);
+
+  if (Session.hasProcess())
+    SessionsByPID.erase(Session.getProcess().raw());
+  SessionsByName.erase(Session.name());
+  if (!Session.alias().empty())
+    SessionsByAlias.erase(Session.alias());
+  releaseDefaultSessionName(Session.name());
+  if (Poll)
+    Poll->timers().cancel(Session.inactivityTimer());
   Sessions.erase(Session.name());
+  SessionStorage.erase(Session);
 
   if (Sessions.empty() && ExitIfNoMoreSessions)
     TerminateLoop.get().store(true);
@@ -343,18 +991,17 @@ void Server::removeSession(SessionData& Session)
 
 void Server::registerDeadChild(Process::raw_handle PID) const noexcept
 {
-  for (std::size_t I = 0; I < DeadChildrenVecSize; ++I)
-    if (DeadChildren.at(I) == Process::Invalid)
-    {
-      DeadChildren.at(I) = PID;
-      return;
-    }
+  // The sessions are checked by their process, so the PID itself need not be
+  // stored, and any number of exits are coalesced without losing any.
+  (void)PID;
+  ChildrenExited.get().store(true);
 }
 
 void Server::acceptCallback(ClientData& Client)
 {
   LOG(info) << "Client \"" << Client.id() << "\" connected";
   raw_fd FD = Client.getControlSocket().raw();
+  trace::record(trace::EventID::ClientAccept, FD, 0, Client.id());
 
   // (8 is a good guesstimate because FDLookup usually counts from 5 or 6, not
   // from 0.)
@@ -373,9 +1020,9 @@ void Server::acceptCallback(ClientData& Client)
     return;
   }
 
-  fd::setNonBlockingCloseOnExec(FD);
   Poll->listen(FD, /* Incoming =*/true, /* Outgoing =*/false);
-  FDLookup[FD] = ClientControlConnection{&Client};
+  FDLookup[FD] = ClientControlConnection{ClientStorage.handleOf(Client)};
+  armIdleTimer(Client);
 
   sendAcceptClient(Client);
 }
@@ -397,6 +1044,8 @@ void Server::controlCallback(ClientData& Client)
     LOG(trace) << "Client \"" << Client.id()
                << "\": error when reading CONTROL: "
                << "\n\t" << BO.what();
+    ++Client.traffic().Overflows;
+    ++Overflows;
     rescheduleOverflow(*Poll, BO);
     return;
   }
@@ -420,8 +1069,14 @@ void Server::controlCallback(ClientData& Client)
 
   if (Data.empty())
     return;
+  // (Clients only using the control connection are not idle either.)
+  Client.activity();
 
   Message MB = Message::unpack(Data);
+  trace::record(trace::EventID::ControlMessage,
+                ClientSock.raw(),
+                Data.size(),
+                static_cast<std::uint32_t>(MB.Kind));
   auto Action =
     Dispatch.find(static_cast<decltype(Dispatch)::key_type>(MB.Kind));
   if (Action == Dispatch.end())
@@ -443,6 +1098,8 @@ void Server::controlCallback(ClientData& Client)
     LOG(trace) << "Client \"" << Client.id()
                << "\": error when handling message"
                << "\n\t" << BO.what();
+    ++Client.traffic().Overflows;
+    ++Overflows;
     rescheduleOverflow(*Poll, BO);
   }
   catch (const std::system_error& Err)
@@ -469,6 +1126,13 @@ void Server::dataCallback(ClientData& Client)
   {
     LOG(error) << "Client \"" << Client.id() << "\": error when reading DATA: "
                << "\n\t" << BO.what();
+    ++Client.traffic().Overflows;
+    ++Overflows;
+    ++ClientsKicked;
+    trace::record(trace::EventID::ClientKick,
+                  DS.raw(),
+                  BO.channel().readInBuffer(),
+                  Client.id());
     sendKickClient(Client,
                    "Overflow when reading connection, " +
                      std::to_string(BO.channel().readInBuffer()) +
@@ -480,7 +1144,8 @@ void Server::dataCallback(ClientData& Client)
   {
     LOG(error) << "Client \"" << Client.id()
                << "\": error when reading DATA: " << Err.what();
-    return;
+    if (!DS.failed())
+      return;
   }
 
   if (DS.failed())
@@ -494,19 +1159,28 @@ void Server::dataCallback(ClientData& Client)
     Poll->schedule(DS.raw(), /* Incoming =*/true, /* Outgoing =*/false);
 
   Client.activity();
+  Client.traffic().BytesIn += Data.size();
+  trace::record(trace::EventID::ClientRead, DS.raw(), Data.size(), Client.id());
   MONOMUX_TRACE_LOG(LOG(data)
                     << "Client \"" << Client.id() << "\" data: " << Data);
 
   if (SessionData* S = Client.getAttachedSession())
     try
     {
+      // Data that could not be sent is buffered by the channel, so count it
+      // as relayed.
+      S->traffic().BytesOut += Data.size();
       S->getWriter()->write(Data);
+      trace::record(
+        trace::EventID::SessionWrite, S->getIdentifyingFD(), Data.size());
     }
     catch (const buffer_overflow& BO)
     {
       LOG(trace) << "Session \"" << S->name()
                  << "\" when relaying input from client \"" << Client.id()
                  << "\"\n\t" << BO.what();
+      ++S->traffic().Overflows;
+      ++Overflows;
       rescheduleOverflow(*Poll, BO);
     }
 }
@@ -514,6 +1188,10 @@ void Server::dataCallback(ClientData& Client)
 void Server::exitCallback(ClientData& Client)
 {
   LOG(info) << "Client \"" << Client.id() << "\" exited";
+  trace::record(trace::EventID::ClientExit,
+                Client.getControlSocket().raw(),
+                0,
+                Client.id());
 
   if (const auto* DS = Client.getDataSocket())
   {
@@ -533,10 +1211,26 @@ void Server::createCallback(SessionData& Session)
   if (Session.hasProcess() && Session.getProcess().hasPty())
   {
     raw_fd FD = Session.getIdentifyingFD();
+    trace::record(trace::EventID::SessionCreate,
+                  FD,
+                  0,
+                  Session.getProcess().raw());
 
     Poll->listen(FD, /* Incoming =*/true, /* Outgoing =*/false);
-    FDLookup[FD] = SessionConnection{&Session};
+    FDLookup[FD] = SessionConnection{SessionStorage.handleOf(Session)};
   }
+  if (Session.hasProcess())
+  {
+    raw_fd PidFD = Session.getProcess().pidFD();
+    if (PidFD != fd::Invalid)
+    {
+      Poll->listen(PidFD, /* Incoming =*/true, /* Outgoing =*/false);
+      FDLookup[PidFD] = SessionProcess{SessionStorage.handleOf(Session)};
+    }
+    else
+      ++UnwatchedChildren;
+  }
+  armInactivityTimer(Session, SessionInactivityTime);
 }
 
 void Server::dataCallback(SessionData& Session)
@@ -553,6 +1247,8 @@ void Server::dataCallback(SessionData& Session)
     LOG(error) << "Session \"" << Session.name()
                << "\": error when reading DATA: "
                << "\n\t" << BO.what();
+    ++Session.traffic().Overflows;
+    ++Overflows;
     rescheduleOverflow(*Poll, BO);
     return;
   }
@@ -569,14 +1265,43 @@ void Server::dataCallback(SessionData& Session)
                    /* Outgoing =*/false);
 
   Session.activity();
+  if (!Poll->timers().isArmed(Session.inactivityTimer()))
+    armInactivityTimer(Session, SessionInactivityTime);
+  Session.traffic().BytesIn += Data.size();
+  trace::record(
+    trace::EventID::SessionRead, Session.getIdentifyingFD(), Data.size());
   MONOMUX_TRACE_LOG(LOG(data)
                     << "Session \"" << Session.name() << "\" data: " << Data);
+  // The output is kept even if no client is attached, so the client that
+  // attaches later sees it.
+  Session.scrollback().append(Data);
+  if (Recorder* R = Session.recorder())
+  {
+    try
+    {
+      R->append(Data);
+    }
+    catch (const std::system_error& Err)
+    {
+      LOG(error) << "Session \"" << Session.name()
+                 << "\": recording stopped: " << Err.what();
+      Session.setRecorder(nullptr);
+    }
+  }
 
-  for (ClientData* C : Session.getAttachedClients())
+  // (Kicking a client modifies the list of attached clients.)
+  std::vector<PoolHandle<ClientData>> AttachedClients =
+    Session.getAttachedClients();
+  for (PoolHandle<ClientData> H : AttachedClients)
+  {
+    ClientData* C = ClientStorage.get(H);
+    if (!C)
+      continue;
     if (Socket* DS = C->getDataSocket())
     {
       try
       {
+        C->traffic().BytesOut += Data.size();
         DS->write(Data);
       }
       catch (const buffer_overflow& BO)
@@ -584,6 +1309,13 @@ void Server::dataCallback(SessionData& Session)
         // This is the part that can usually hang if there is too much data
         // coming from the session that can't be sent to the clients in a
         // timely manner.
+        ++C->traffic().Overflows;
+        ++Overflows;
+        ++ClientsKicked;
+        trace::record(trace::EventID::ClientKick,
+                      DS->raw(),
+                      BO.channel().writeInBuffer(),
+                      C->id());
         sendKickClient(*C,
                        "Overflow when sending, " +
                          std::to_string(BO.channel().writeInBuffer()) +
@@ -605,17 +1337,63 @@ void Server::dataCallback(SessionData& Session)
         }
       }
 
+      trace::record(
+        trace::EventID::ClientSend, DS->raw(), Data.size(), C->id());
+      if (auto Latency = nanosSinceWokenUp())
+        C->readToSendLatency().record(*Latency);
       if (DS->hasBufferedWrite())
         Poll->schedule(DS->raw(), /* Incoming =*/false, /* Outgoing =*/true);
     }
+  }
+
+  if (!AttachedClients.empty())
+    if (auto Latency = nanosSinceWokenUp())
+      Session.readToSendLatency().record(*Latency);
 }
 
-void Server::clientAttachedCallback(ClientData& Client, SessionData& Session)
+void Server::clientAttachedCallback(ClientData& Client,
+                                    SessionData& Session,
+                                    std::optional<std::uint64_t> ReplayFrom)
 {
   LOG(info) << "Client \"" << Client.id() << "\" attached to \""
             << Session.name() << '"';
   Client.attachToSession(Session);
-  Session.attachClient(Client);
+  Session.attachClient(ClientStorage.handleOf(Client));
+
+  // Replay the recent output, so the client does not start with an empty
+  // screen, or continues from where it had left off. The live output read
+  // later is sent after it, in order.
+  Socket* DS = Client.getDataSocket();
+  const Scrollback& SB = Session.scrollback();
+  std::string_view History =
+    SB.since(ReplayFrom ? *ReplayFrom : SB.replayFrom(std::nullopt));
+  if (!DS || History.empty())
+    return;
+  try
+  {
+    Client.traffic().BytesOut += History.size();
+    DS->write(History);
+  }
+  catch (const buffer_overflow& BO)
+  {
+    // (The client is not kicked here, as the caller might still use it.
+    // The overflow is reported again when the buffer is next written.)
+    ++Client.traffic().Overflows;
+    ++Overflows;
+    rescheduleOverflow(*Poll, BO);
+    return;
+  }
+  catch (const std::system_error& Err)
+  {
+    LOG(error) << "Client \"" << Client.id()
+               << "\": error when replaying the output of \""
+               << Session.name() << "\": " << Err.what();
+    return;
+  }
+  trace::record(
+    trace::EventID::ClientSend, DS->raw(), History.size(), Client.id());
+  if (DS->hasBufferedWrite())
+    Poll->schedule(DS->raw(), /* Incoming =*/false, /* Outgoing =*/true);
 }
 
 void Server::clientDetachedCallback(ClientData& Client, SessionData& Session)
@@ -625,7 +1403,7 @@ void Server::clientDetachedCallback(ClientData& Client, SessionData& Session)
   LOG(info) << "Client \"" << Client.id() << "\" detached from \""
             << Session.name() << '"';
   Client.detachSession();
-  Session.removeClient(Client);
+  Session.removeClient(ClientStorage.handleOf(Client));
 }
 
 void Server::destroyCallback(SessionData& Session)
@@ -634,14 +1412,38 @@ void Server::destroyCallback(SessionData& Session)
   if (Session.hasProcess() && Session.getProcess().hasPty())
   {
     raw_fd FD = Session.getProcess().getPty()->raw();
+    trace::record(trace::EventID::SessionDestroy,
+                  FD,
+                  0,
+                  Session.getProcess().raw());
 
     Poll->stop(FD);
     FDLookup.erase(FD);
   }
+  if (Session.hasProcess())
+  {
+    raw_fd PidFD = Session.getProcess().pidFD();
+    if (PidFD != fd::Invalid)
+    {
+      Poll->stop(PidFD);
+      FDLookup.erase(PidFD);
+    }
+    else
+      --UnwatchedChildren;
+  }
 
   removeSession(Session);
 }
 
+void Server::inactiveCallback(SessionData& Session)
+{
+  LOG(info) << "Session \"" << Session.name() << "\" inactive for "
+            << std::chrono::duration_cast<std::chrono::seconds>(
+                 std::chrono::system_clock::now() - Session.lastActive())
+                 .count()
+            << " seconds";
+}
+
 void Server::turnClientIntoDataOfOtherClient(ClientData& MainClient,
                                              ClientData& DataClient)
 {
@@ -651,43 +1453,53 @@ void Server::turnClientIntoDataOfOtherClient(ClientData& MainClient,
                     << MainClient.id() << '"');
   MainClient.subjugateIntoDataSocket(DataClient);
   FDLookup[MainClient.getDataSocket()->raw()] =
-    ClientDataConnection{&MainClient};
+    ClientDataConnection{ClientStorage.handleOf(MainClient)};
 
   // Remove the object from the owning data structure but do not fire the exit
   // handler!
+  Poll->timers().cancel(DataClient.idleTimer());
+  Poll->timers().cancel(DataClient.flushTimer());
   Clients.erase(DataClient.id());
+  ClientStorage.erase(DataClient);
 }
 
 void Server::reapDeadChildren()
 {
-  for (Process::raw_handle& PID : DeadChildren)
+  if (!ChildrenExited.get().exchange(false))
+    return;
+  WarmSessions.reapDead();
+  if (!UnwatchedChildren)
+    return;
+
+  // (Reaping destroys sessions, which modifies the list.)
+  std::vector<PoolHandle<SessionData>> Unwatched;
+  for (const auto& E : Sessions)
   {
-    if (PID == Process::Invalid)
-      continue;
+    SessionData& S = *SessionStorage.get(E.second);
+    if (S.hasProcess() && S.getProcess().pidFD() == fd::Invalid)
+      Unwatched.push_back(E.second);
+  }
+  for (PoolHandle<SessionData> H : Unwatched)
+    if (SessionData* S = SessionStorage.get(H))
+      reapSession(*S);
+}
 
-    auto SessionForProc =
-      std::find_if(Sessions.begin(), Sessions.end(), [PID](auto&& E) {
-        return E.second->hasProcess() && E.second->getProcess().raw() == PID;
-      });
-    if (SessionForProc == Sessions.end())
-      continue;
-    Process& Proc = SessionForProc->second->getProcess();
+bool Server::reapSession(SessionData& Session)
+{
+  Process& Proc = Session.getProcess();
+  if (!Proc.reapIfDead())
+    return false;
 
-    bool Dead = Proc.reapIfDead();
-    if (Dead)
-    {
-      LOG(debug) << "Child PID " << PID << " of Session \""
-                 << SessionForProc->second->name() << "\" exited with "
-                 << Proc.exitCode();
-
-      for (ClientData* AC : SessionForProc->second->getAttachedClients())
-        AC->sendDetachReason(monomux::message::notification::Detached::Exit,
-                             Proc.exitCode());
-      destroyCallback(*SessionForProc->second);
-    }
+  trace::record(trace::EventID::ChildExit, 0, Proc.exitCode(), Proc.raw());
+  LOG(debug) << "Child PID " << Proc.raw() << " of Session \""
+             << Session.name() << "\" exited with " << Proc.exitCode();
 
-    PID = Process::Invalid;
-  }
+  for (PoolHandle<ClientData> H : Session.getAttachedClients())
+    if (ClientData* AC = ClientStorage.get(H))
+      AC->sendDetachReason(monomux::message::notification::Detached::Exit,
+                           Proc.exitCode());
+  destroyCallback(Session);
+  return true;
 }
 
 std::string Server::statistics() const
@@ -729,8 +1541,25 @@ std::string Server::statistics() const
     return {IndentSize};
   };
 
+  /// Formats the summary of the latency histogram \p H in microseconds.
+  const auto Latency = [](const LatencyHistogram& H) -> std::string {
+    if (H.empty())
+      return "no samples";
+
+    static constexpr double NanosPerMicro = 1000.0;
+    static constexpr double Median = 0.5;
+    static constexpr double Tail = 0.99;
+    std::ostringstream Buf;
+    Buf << std::fixed << std::setprecision(1)
+        << "p50 = " << H.quantile(Median) / NanosPerMicro
+        << " us, p99 = " << H.quantile(Tail) / NanosPerMicro
+        << " us, max = " << H.max() / NanosPerMicro << " us (" << H.count()
+        << " samples)";
+    return Buf.str();
+  };
+
   const auto DumpOneClient =
-    [&Output, &AddIndent, &Indented, &Reindent, &IndentScope](
+    [&Output, &AddIndent, &Indented, &Reindent, &IndentScope, &Latency](
       const ClientData& C) {
       auto X = IndentScope();
       Output << "Client " << '\'' << C.id() << '\'' << '\n';
@@ -739,6 +1568,10 @@ std::string Server::statistics() const
                  << '\n';
       Indented() << "* LastActive        : " << formatTime(C.lastActive())
                  << '\n';
+      Indented() << "* Read-to-send      : " << Latency(C.readToSendLatency())
+                 << '\n';
+      Indented() << "* Write queueing    : " << Latency(C.writeQueueLatency())
+                 << '\n';
 
       auto& Cl = const_cast<ClientData&>(C);
       Indented() << "* Control Connection:" << '\n';
@@ -770,6 +1603,41 @@ std::string Server::statistics() const
              << '\n';
   Indented() << "* Open file descriptors in total : " << FDLookup.size()
              << '\n';
+  {
+    BufferedChannel::MemoryStatistics BM = BufferedChannel::memoryStatistics();
+    Indented() << "* Channel buffers: " << BM.Buffers << " holding "
+               << BM.Bytes << " bytes (at most " << BM.PeakBytes << "), "
+               << BM.PooledBuffers << " pooled (" << BM.PooledBytes
+               << " bytes)" << '\n';
+    if (BufferBudget)
+      Indented() << "* Buffer memory budget: " << BM.Bytes + BM.PooledBytes
+                 << " of " << BufferBudget << " bytes used, "
+                 << BudgetThrottles << " session throttles, " << BudgetSheds
+                 << " clients kicked" << '\n';
+  }
+  if (ClientsRejected)
+    Indented() << "* Clients rejected for lack of file descriptors: "
+               << ClientsRejected << '\n';
+  if (WarmSessions.perProfile())
+  {
+    SessionPool::Statistics WS = WarmSessions.statistics();
+    Indented() << "* Pre-warmed sessions: " << WS.Idle << " idle for "
+               << WS.Profiles << " profiles, " << WS.Adoptions << " adopted, "
+               << WS.Misses << " missed" << '\n';
+  }
+
+  const auto DumpPool = [&Indented](const char* Name, const auto& Stats) {
+    Indented() << "* " << Name << " pool: " << Stats.Alive << " alive, "
+               << Stats.Capacity << " slots in " << Stats.Slabs
+               << " slabs, " << Stats.Constructions << " allocations ("
+               << Stats.Reuses << " reused a slot)" << '\n';
+  };
+  DumpPool("Client ", ClientStorage.statistics());
+  DumpPool("Session", SessionStorage.statistics());
+  Indented() << "* Loop iterations: " << LoopIterations << ", handling "
+             << Latency(LoopIterationTime) << '\n';
+  if (const log::Logger* L = log::Logger::tryGet(); L && L->isAsync())
+    Indented() << "* Log records dropped: " << L->droppedRecords() << '\n';
 
   std::set<std::size_t> AlreadyDumpedAttachedClients;
   Output << '\n'
@@ -780,13 +1648,23 @@ std::string Server::statistics() const
   AddIndent(2);
   for (const auto& E : Sessions)
   {
-    const SessionData& S = *E.second;
+    const SessionData& S = *SessionStorage.get(E.second);
     auto X = IndentScope();
 
     Indented() << "# Session " << '\'' << S.name() << '\'' << '\n';
     AddIndent(2);
     Indented() << "* Created     : " << formatTime(S.whenCreated()) << '\n';
     Indented() << "* LastActive  : " << formatTime(S.lastActive()) << '\n';
+    Indented() << "* Read-to-send: " << Latency(S.readToSendLatency())
+               << '\n';
+    Indented() << "* Scrollback  : " << S.scrollback().size() << " of "
+               << S.scrollback().limit() << " bytes ("
+               << S.scrollback().memory() << " allocated, "
+               << S.scrollback().indexMemory() << " indexed)" << '\n';
+    if (const Recorder* R = S.recorder())
+      Indented() << "* Recording   : " << R->bytesRecorded() << " bytes in "
+                 << R->segmentCount() << " segment(s) at '" << R->prefix()
+                 << "'\n";
 
     if (S.hasProcess())
     {
@@ -818,8 +1696,11 @@ std::string Server::statistics() const
     Indented() << "* Attached client #: " << S.getAttachedClients().size()
                << '\n';
     AddIndent(4);
-    for (const ClientData* C : S.getAttachedClients())
+    for (PoolHandle<ClientData> H : S.getAttachedClients())
     {
+      const ClientData* C = ClientStorage.get(H);
+      if (!C)
+        continue;
       Indented() << '*' << ' ';
       DumpOneClient(*C);
       AlreadyDumpedAttachedClients.emplace(C->id());
@@ -834,7 +1715,7 @@ std::string Server::statistics() const
   AddIndent(2);
   for (const auto& E : Clients)
   {
-    const ClientData& C = *E.second;
+    const ClientData& C = *ClientStorage.get(E.second);
     if (AlreadyDumpedAttachedClients.find(C.id()) !=
         AlreadyDumpedAttachedClients.end())
       continue;
@@ -846,6 +1727,152 @@ std::string Server::statistics() const
   return Output.str();
 }
 
+monomux::message::response::Metrics
+Server::metrics(std::string_view Session)
+{
+  using namespace monomux::message;
+  const auto Buffer = [](const BufferedChannel::BufferStatistics& BS) {
+    return BufferMetrics{BS.Size, BS.Capacity, BS.Peak};
+  };
+  const auto TakeLatency = [](LatencyHistogram& H) {
+    LatencyMetrics LM;
+    LM.Count = H.count();
+    LM.Sum = H.sum();
+    LM.Max = H.max();
+    H.forEachBucket([&LM](std::size_t Index, std::uint64_t N) {
+      LM.Buckets.emplace_back(Index, N);
+    });
+    H.reset();
+    return LM;
+  };
+  const auto SessionRecord = [&Buffer, &TakeLatency](SessionData& S) {
+    SessionMetrics SM;
+    SM.Name = S.name();
+    SM.BytesIn = S.traffic().BytesIn;
+    SM.BytesOut = S.traffic().BytesOut;
+    SM.Overflows = S.traffic().Overflows;
+    SM.AttachedClients = S.getAttachedClients().size();
+    SM.ReadToSend = TakeLatency(S.readToSendLatency());
+    if (S.hasProcess() && S.getProcess().hasPty())
+    {
+      Process& P = S.getProcess();
+      SM.Reader = Buffer(P.getPty()->reader().readBufferStatistics());
+      SM.Writer = Buffer(P.getPty()->writer().writeBufferStatistics());
+    }
+    return SM;
+  };
+  const auto ClientRecord = [&Buffer, &TakeLatency](ClientData& C) {
+    ClientMetrics CM;
+    CM.ID = C.id();
+    if (const SessionData* S = C.getAttachedSession())
+      CM.Session = S->name();
+    CM.BytesIn = C.traffic().BytesIn;
+    CM.BytesOut = C.traffic().BytesOut;
+    CM.Overflows = C.traffic().Overflows;
+    CM.ReadToSend = TakeLatency(C.readToSendLatency());
+    CM.WriteQueue = TakeLatency(C.writeQueueLatency());
+    if (const auto* DS = C.getDataSocket())
+    {
+      CM.DataRead = Buffer(DS->readBufferStatistics());
+      CM.DataWrite = Buffer(DS->writeBufferStatistics());
+    }
+    return CM;
+  };
+
+  response::Metrics Ret;
+  Ret.LoopIterations = LoopIterations;
+  Ret.ClientsKicked = ClientsKicked;
+  Ret.Overflows = Overflows;
+  Ret.ClientCount = Clients.size();
+  Ret.SessionCount = Sessions.size();
+  {
+    BufferedChannel::MemoryStatistics BM = BufferedChannel::memoryStatistics();
+    Ret.ChannelBuffers = BM.Buffers;
+    Ret.ChannelBufferBytes = BM.Bytes;
+    Ret.PooledBuffers = BM.PooledBuffers;
+    Ret.PooledBufferBytes = BM.PooledBytes;
+  }
+  Ret.LoopIteration = TakeLatency(LoopIterationTime);
+
+  if (Session.empty())
+  {
+    Ret.Sessions.reserve(Sessions.size());
+    for (const auto& E : Sessions)
+      Ret.Sessions.emplace_back(SessionRecord(*SessionStorage.get(E.second)));
+    Ret.Clients.reserve(Clients.size());
+    for (const auto& E : Clients)
+      Ret.Clients.emplace_back(ClientRecord(*ClientStorage.get(E.second)));
+    return Ret;
+  }
+
+  auto It = SessionsByName.find(Session);
+  if (It == SessionsByName.end())
+    return Ret;
+  SessionData& S = *It->second;
+  Ret.Sessions.emplace_back(SessionRecord(S));
+  for (PoolHandle<ClientData> H : S.getAttachedClients())
+    if (ClientData* C = ClientStorage.get(H))
+      Ret.Clients.emplace_back(ClientRecord(*C));
+  return Ret;
+}
+
+monomux::message::response::Search
+Server::search(const monomux::message::request::Search& Request)
+{
+  using namespace monomux::message;
+  response::Search Ret;
+  const std::size_t Limit =
+    std::min(Request.Limit ? Request.Limit : SearchMatchLimit,
+             SearchMatchLimitMax);
+
+  SessionData* Requested = nullptr;
+  if (!Request.Session.empty())
+  {
+    Requested = getSession(Request.Session);
+    if (!Requested)
+      return Ret;
+  }
+  Ret.Success = true;
+  if (Request.Pattern.empty())
+    return Ret;
+
+  const auto SearchSession = [&Request, &Ret, Limit](const SessionData& S) {
+    // (Asking for one more match tells whether the limit cut the results.)
+    const std::size_t Remaining = Limit - Ret.Matches.size();
+    const Scrollback& SB = S.scrollback();
+    std::vector<std::uint64_t> Offsets =
+      SB.find(Request.Pattern, Remaining + 1);
+    if (Offsets.size() > Remaining)
+    {
+      Offsets.resize(Remaining);
+      Ret.Truncated = true;
+    }
+    for (std::uint64_t Offset : Offsets)
+    {
+      std::string_view Lines =
+        SB.lines(Offset, Request.Context, SearchContextBytes);
+      const std::uint64_t LinesBegin =
+        SB.begin() + (Lines.data() - SB.contents().data());
+      Ret.Matches.emplace_back(SearchMatch{
+        S.name(), Offset, std::string{Lines}, Offset - LinesBegin});
+    }
+  };
+
+  if (Requested)
+  {
+    SearchSession(*Requested);
+    return Ret;
+  }
+  for (const auto& E : Sessions)
+  {
+    if (const SessionData* S = SessionStorage.get(E.second))
+      SearchSession(*S);
+    if (Ret.Truncated)
+      break;
+  }
+  return Ret;
+}
+
 } // namespace monomux::server
 
 #undef LOG
@@ -25,7 +25,7 @@
 #include "monomux/server/SessionData.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("server/SessionData")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "server/SessionData")
 
 namespace monomux::server
 {
@@ -45,15 +45,16 @@ raw_fd SessionData::getIdentifyingFD() const noexcept
   return P.getPty()->raw().get();
 }
 
-ClientData* SessionData::getLatestClient() const
+ClientData* SessionData::getLatestClient(SlabPool<ClientData>& Clients) const
 {
   MONOMUX_TRACE_LOG(LOG(trace) << "Searching latest active client of \"" << Name
                                << "\"...");
   ClientData* R = nullptr;
   std::optional<decltype(std::declval<ClientData>().lastActive())> Time;
-  for (ClientData* C : AttachedClients)
+  for (PoolHandle<ClientData> H : AttachedClients)
   {
-    if (!C->getDataSocket())
+    ClientData* C = Clients.get(H);
+    if (!C || !C->getDataSocket())
       continue;
     MONOMUX_TRACE_LOG(LOG(data)
                       << "\tCandidate client \"" << C->id()
@@ -72,15 +73,15 @@ ClientData* SessionData::getLatestClient() const
   return R;
 }
 
-void SessionData::attachClient(ClientData& Client)
+void SessionData::attachClient(PoolHandle<ClientData> Client)
 {
-  AttachedClients.emplace_back(&Client);
+  AttachedClients.emplace_back(Client);
 }
 
-void SessionData::removeClient(ClientData& Client) noexcept
+void SessionData::removeClient(PoolHandle<ClientData> Client) noexcept
 {
   for (auto It = AttachedClients.begin(); It != AttachedClients.end(); ++It)
-    if (*It == &Client)
+    if (*It == Client)
     {
       It = AttachedClients.erase(It);
       break;
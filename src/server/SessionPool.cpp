@@ -0,0 +1,197 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <csignal>
+#include <system_error>
+
+#include "monomux/server/SessionPool.hpp"
+
+#include "monomux/Log.hpp"
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "server/SessionPool")
+
+namespace monomux::server
+{
+
+SessionPool::SessionPool(std::size_t PerProfile, std::string NamePrefix)
+  : PerProfile(PerProfile), NamePrefix(std::move(NamePrefix))
+{}
+
+SessionPool::~SessionPool()
+{
+  for (Profile& P : Profiles)
+    for (Adopted& A : P.Idle)
+      A.Proc.signal(SIGHUP);
+}
+
+void SessionPool::setPerProfile(std::size_t PerProfile)
+{
+  this->PerProfile = PerProfile;
+  for (Profile& P : Profiles)
+    while (P.Idle.size() > PerProfile)
+    {
+      drop(std::move(P.Idle.back().Proc));
+      P.Idle.pop_back();
+    }
+  if (!PerProfile)
+    Profiles.clear();
+}
+
+std::string SessionPool::key(const Process::SpawnOptions& Opts)
+{
+  // (The parts are separated by characters that may not appear in them.)
+  std::string Key = Opts.Program;
+  for (const std::string& Arg : Opts.Arguments)
+  {
+    Key.push_back('\0');
+    Key.append(Arg);
+  }
+  Key.push_back('\1');
+  for (const auto& E : Opts.Environment)
+  {
+    Key.append(E.first);
+    if (E.second)
+    {
+      Key.push_back('=');
+      Key.append(*E.second);
+    }
+    Key.push_back('\0');
+  }
+  return Key;
+}
+
+std::optional<SessionPool::Adopted>
+SessionPool::take(const Process::SpawnOptions& Opts)
+{
+  if (!PerProfile)
+    return std::nullopt;
+
+  std::string Key = key(Opts);
+  auto It = std::find_if(Profiles.begin(),
+                         Profiles.end(),
+                         [&Key](const Profile& P) { return P.Key == Key; });
+  if (It == Profiles.end())
+  {
+    ++Misses;
+    LOG(debug) << "Learnt a new profile for \"" << Opts.Program << '"';
+    Profiles.push_front(Profile{std::move(Key), Opts, {}});
+    while (Profiles.size() > MaxProfiles)
+    {
+      for (Adopted& A : Profiles.back().Idle)
+        drop(std::move(A.Proc));
+      Profiles.pop_back();
+    }
+    return std::nullopt;
+  }
+  Profiles.splice(Profiles.begin(), Profiles, It);
+
+  std::deque<Adopted>& Idle = Profiles.front().Idle;
+  while (!Idle.empty())
+  {
+    Adopted A = std::move(Idle.front());
+    Idle.pop_front();
+    if (A.Proc.reapIfDead())
+    {
+      LOG(debug) << "Idle process " << A.Proc.raw() << " of \""
+                 << Opts.Program << "\" had exited";
+      continue;
+    }
+
+    ++Adoptions;
+    return A;
+  }
+
+  ++Misses;
+  return std::nullopt;
+}
+
+bool SessionPool::needsRefill() const noexcept
+{
+  return std::any_of(Profiles.begin(), Profiles.end(), [this](const auto& P) {
+    return P.Idle.size() < PerProfile;
+  });
+}
+
+std::size_t SessionPool::refill(const std::function<PrepareFn>& Prepare)
+{
+  std::size_t Count = 0;
+  for (auto It = Profiles.begin(); It != Profiles.end();)
+  {
+    try
+    {
+      while (It->Idle.size() < PerProfile)
+      {
+        Adopted A;
+        A.Name = NamePrefix + std::to_string(++Spawned);
+        Process::SpawnOptions Opts = It->Options;
+        Prepare(Opts, A.Name);
+        A.Proc = Process::spawn(Opts);
+        It->Idle.emplace_back(std::move(A));
+        ++Count;
+      }
+      ++It;
+    }
+    catch (const std::system_error& Err)
+    {
+      LOG(warn) << "Failed to spawn an idle process for \""
+                << It->Options.Program << "\": " << Err.what();
+      for (Adopted& A : It->Idle)
+        drop(std::move(A.Proc));
+      It = Profiles.erase(It);
+    }
+  }
+  return Count;
+}
+
+void SessionPool::drop(Process&& P)
+{
+  // Closing the PTY hangs up the process, but only the foreground process
+  // group of the terminal. The process itself is sent the signal explicitly.
+  P.signal(SIGHUP);
+  Process& Kept = Dropped.emplace_back(std::move(P));
+  Kept.reapIfDead();
+}
+
+void SessionPool::reapDead()
+{
+  for (Profile& P : Profiles)
+    P.Idle.erase(std::remove_if(P.Idle.begin(),
+                                P.Idle.end(),
+                                [](Adopted& A) { return A.Proc.reapIfDead(); }),
+                 P.Idle.end());
+  Dropped.erase(
+    std::remove_if(Dropped.begin(),
+                   Dropped.end(),
+                   [](Process& P) { return P.dead() || P.reapIfDead(); }),
+    Dropped.end());
+}
+
+SessionPool::Statistics SessionPool::statistics() const noexcept
+{
+  Statistics S{};
+  S.Profiles = Profiles.size();
+  for (const Profile& P : Profiles)
+    S.Idle += P.Idle.size();
+  S.Adoptions = Adoptions;
+  S.Misses = Misses;
+  return S;
+}
+
+} // namespace monomux::server
+
+#undef LOG
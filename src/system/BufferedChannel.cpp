@@ -16,15 +16,21 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <tuple>
 
-#include "monomux/adt/RingBuffer.hpp"
+#include "monomux/system/MagicRingBuffer.hpp"
 #include "monomux/system/Time.hpp"
 
 #include "monomux/system/BufferedChannel.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("system/BufferedChannel")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "system/BufferedChannel")
 #define LOG_WITH_IDENTIFIER(SEVERITY) LOG(SEVERITY) << identifier() << ": "
 
 namespace monomux
@@ -33,10 +39,200 @@ namespace monomux
 namespace detail
 {
 
-class BufferedChannelBuffer : public RingBuffer<char>
+/// The number and total capacity of buffers held by channels.
+static std::atomic<std::size_t> HeldBuffers;
+static std::atomic<std::size_t> HeldBytes;
+/// The highest value of \p HeldBytes.
+static std::atomic<std::size_t> PeakHeldBytes;
+
+class BufferedChannelBuffer : public MagicRingBuffer
 {
 public:
-  BufferedChannelBuffer(std::size_t SizeHint) : RingBuffer(SizeHint) {}
+  BufferedChannelBuffer(std::size_t SizeHint) : MagicRingBuffer(SizeHint) {}
+
+  /// Updates the global statistics with the change of the capacity of the
+  /// buffer since the last call.
+  void account() noexcept
+  {
+    if (capacity() == AccountedCapacity)
+      return;
+    const std::size_t Delta = capacity() - AccountedCapacity;
+    const std::size_t Held = HeldBytes.fetch_add(Delta) + Delta;
+    AccountedCapacity = capacity();
+
+    std::size_t Peak = PeakHeldBytes.load();
+    while (Held > Peak && !PeakHeldBytes.compare_exchange_weak(Peak, Held))
+      ;
+  }
+  /// Removes the buffer from the global statistics.
+  void unaccount() noexcept
+  {
+    HeldBytes -= AccountedCapacity;
+    AccountedCapacity = 0;
+  }
+
+  void putBack(const char* Data, std::size_t N)
+  {
+    MagicRingBuffer::putBack(Data, N);
+    account();
+  }
+
+  void tryCleanup()
+  {
+    MagicRingBuffer::tryCleanup();
+    account();
+  }
+
+  /// Starts recording the time each store spends in the buffer into \p H,
+  /// when the last byte of the store is consumed. Data already in the buffer
+  /// is not measured.
+  void observe(LatencyHistogram* H)
+  {
+    DelayObserver = H;
+    MarkHead = 0;
+    MarkCount = 0;
+    Enqueued = size();
+    Dequeued = 0;
+  }
+
+  /// Stores \p Data and, if observed, remembers when it was stored.
+  void enqueue(const char* Data, std::size_t N)
+  {
+    putBack(Data, N);
+    if (!DelayObserver || !N)
+      return;
+    Enqueued += N;
+    if (MarkCount == Marks.size())
+    {
+      // Without room, the newest mark is extended over this store, which is
+      // then reported with the (longer) delay of that earlier store.
+      Marks[(MarkHead + MarkCount - 1) % Marks.size()].first = Enqueued;
+      return;
+    }
+    Marks[(MarkHead + MarkCount) % Marks.size()] = {
+      Enqueued, std::chrono::steady_clock::now()};
+    ++MarkCount;
+  }
+
+  /// Discards \p N elements from the front of the buffer and records the
+  /// queueing delay of every store that was fully consumed by it.
+  void dequeue(std::size_t N)
+  {
+    dropFront(N);
+    if (!DelayObserver || !N)
+      return;
+    Dequeued += N;
+    if (!MarkCount || Marks[MarkHead].first > Dequeued)
+      return;
+
+    auto Now = std::chrono::steady_clock::now();
+    while (MarkCount && Marks[MarkHead].first <= Dequeued)
+    {
+      DelayObserver->record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          Now - Marks[MarkHead].second)
+          .count());
+      MarkHead = (MarkHead + 1) % Marks.size();
+      --MarkCount;
+    }
+  }
+
+private:
+  std::size_t AccountedCapacity = 0;
+
+  LatencyHistogram* DelayObserver = nullptr;
+  /// The total number of bytes ever enqueued and dequeued while observed.
+  std::uint64_t Enqueued = 0;
+  std::uint64_t Dequeued = 0;
+  /// The value of \p Enqueued after each store, and the time of the store,
+  /// as a ring of \p MarkCount elements starting at \p MarkHead.
+  std::array<std::pair<std::uint64_t, std::chrono::steady_clock::time_point>,
+             32>
+    Marks;
+  std::size_t MarkHead = 0;
+  std::size_t MarkCount = 0;
+};
+
+/// Keeps the buffers released by idle channels for reuse, so their memory
+/// and mappings need not be set up again by the next channel.
+class BufferPool
+{
+public:
+  static BufferPool& get()
+  {
+    static BufferPool Singleton;
+    return Singleton;
+  }
+
+  /// \returns a buffer of at least \p Size capacity, either from the pool or
+  /// freshly allocated.
+  BufferedChannelBuffer* acquire(std::size_t Size)
+  {
+    std::unique_ptr<BufferedChannelBuffer> Buffer;
+    {
+      std::lock_guard<std::mutex> Lock{Mutex};
+      auto It = std::find_if(
+        Idle.begin(), Idle.end(), [Size](const auto& Buf) {
+          return Buf->capacity() >= Size && Buf->capacity() < 2 * Size;
+        });
+      if (It != Idle.end())
+      {
+        Buffer = std::move(*It);
+        *It = std::move(Idle.back());
+        Idle.pop_back();
+        IdleBytes -= Buffer->capacity();
+      }
+    }
+    if (!Buffer)
+      Buffer = std::make_unique<BufferedChannelBuffer>(Size);
+
+    ++HeldBuffers;
+    Buffer->account();
+    return Buffer.release();
+  }
+
+  /// Takes ownership of \p Buffer, keeping it for reuse if it is empty, has
+  /// not grown, and the pool has room for it.
+  void release(BufferedChannelBuffer* Buffer) noexcept
+  {
+    std::unique_ptr<BufferedChannelBuffer> Owner{Buffer};
+    --HeldBuffers;
+    Buffer->unaccount();
+    if (!Buffer->empty() || Buffer->capacity() != Buffer->originalCapacity())
+      return;
+
+    Buffer->observe(nullptr);
+    std::lock_guard<std::mutex> Lock{Mutex};
+    if (IdleBytes + Buffer->capacity() > BufferedChannel::BufferPoolMax)
+      return;
+    try
+    {
+      Idle.emplace_back(std::move(Owner));
+      IdleBytes += Buffer->capacity();
+    }
+    catch (const std::bad_alloc&)
+    {
+      // The buffer is freed by Owner if it could not be stored.
+    }
+  }
+
+  void clear() noexcept
+  {
+    std::lock_guard<std::mutex> Lock{Mutex};
+    Idle.clear();
+    IdleBytes = 0;
+  }
+
+  std::pair<std::size_t, std::size_t> pooled() const noexcept
+  {
+    std::lock_guard<std::mutex> Lock{Mutex};
+    return {Idle.size(), IdleBytes};
+  }
+
+private:
+  mutable std::mutex Mutex;
+  std::vector<std::unique_ptr<BufferedChannelBuffer>> Idle;
+  std::size_t IdleBytes = 0;
 };
 
 } // namespace detail
@@ -64,42 +260,72 @@ BufferedChannel::BufferedChannel(
   // NOLINTNEXTLINE(bugprone-easily-swappable-parameters)
   std::size_t ReadBufferSize,
   std::size_t WriteBufferSize)
-  : Channel(std::move(Handle), std::move(Identifier), NeedsCleanup)
-{
-  if (ReadBufferSize)
-    Read = new OpaqueBufferType(ReadBufferSize);
-  if (WriteBufferSize)
-    Write = new OpaqueBufferType(WriteBufferSize);
-}
+  : Channel(std::move(Handle), std::move(Identifier), NeedsCleanup),
+    ReadBufferSize(ReadBufferSize), WriteBufferSize(WriteBufferSize)
+{}
 
 BufferedChannel::~BufferedChannel()
 {
-  delete Read;
-  delete Write;
+  if (Read)
+    detail::BufferPool::get().release(Read);
+  if (Write)
+    detail::BufferPool::get().release(Write);
   Read = nullptr;
   Write = nullptr;
 }
 
+BufferedChannel::MemoryStatistics BufferedChannel::memoryStatistics() noexcept
+{
+  MemoryStatistics R;
+  R.Buffers = detail::HeldBuffers;
+  R.Bytes = detail::HeldBytes;
+  R.PeakBytes = detail::PeakHeldBytes;
+  std::tie(R.PooledBuffers, R.PooledBytes) = detail::BufferPool::get().pooled();
+  return R;
+}
+
+void BufferedChannel::releasePool() noexcept
+{
+  detail::BufferPool::get().clear();
+}
+
+BufferedChannel::OpaqueBufferType& BufferedChannel::readBuffer()
+{
+  if (!Read)
+    Read = detail::BufferPool::get().acquire(ReadBufferSize);
+  return *Read;
+}
+
+BufferedChannel::OpaqueBufferType& BufferedChannel::writeBuffer()
+{
+  if (!Write)
+  {
+    Write = detail::BufferPool::get().acquire(WriteBufferSize);
+    Write->observe(WriteDelay);
+  }
+  return *Write;
+}
+
 bool BufferedChannel::hasBufferedRead() const noexcept
 {
-  assert(Read && "Channel does not support reading");
-  return !Read->empty();
+  assert(ReadBufferSize && "Channel does not support reading");
+  return Read && !Read->empty();
 }
 bool BufferedChannel::hasBufferedWrite() const noexcept
 {
-  assert(Write && "Channel does not support writing");
-  return !Write->empty();
+  assert(WriteBufferSize && "Channel does not support writing");
+  return Write && !Write->empty();
 }
 
 std::size_t BufferedChannel::readInBuffer() const noexcept
 {
-  assert(Read && "Channel does not support reading");
-  return Read->size();
+  assert(ReadBufferSize && "Channel does not support reading");
+  return Read ? Read->size() : 0;
 }
 std::size_t BufferedChannel::writeInBuffer() const noexcept
 {
-  assert(Write && "Channel does not support writing");
-  return Write->size();
+  assert(WriteBufferSize && "Channel does not support writing");
+  return Write ? Write->size() : 0;
 }
 
 static void throwIfFailed(bool Failed)
@@ -126,7 +352,7 @@ static void throwIfNoWrite(bool Write)
 std::string BufferedChannel::read(std::size_t Bytes)
 {
   throwIfFailed(failed());
-  throwIfNoRead(Read);
+  throwIfNoRead(ReadBufferSize);
 
   std::string Return;
   Return.reserve(Bytes);
@@ -135,14 +361,14 @@ std::string BufferedChannel::read(std::size_t Bytes)
   if (std::size_t StoredBufferSize = readInBuffer())
   {
     std::size_t BytesFromBuffer = std::min(Bytes, StoredBufferSize);
-    std::vector<char> V = Read->takeFront(BytesFromBuffer);
-    Return.append(V.begin(), V.end());
+    Return.append(Read->peek().substr(0, BytesFromBuffer));
+    Read->dropFront(BytesFromBuffer);
 
     MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
                       << "read() "
-                      << "<- " << V.size() << " bytes buffer");
+                      << "<- " << BytesFromBuffer << " bytes buffer");
 
-    Bytes -= V.size();
+    Bytes -= BytesFromBuffer;
   }
   if (!Bytes)
     return Return;
@@ -154,15 +380,19 @@ std::string BufferedChannel::read(std::size_t Bytes)
     MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
                       << "(read) "
                       << "Request " << ChunkSize << " bytes...");
-    std::string Chunk = readImpl(ChunkSize, ContinueReading);
-    if (Chunk.empty())
+    // The chunk is read straight into the tail of the returned string.
+    const std::size_t Offset = Return.size();
+    Return.resize(Offset + ChunkSize);
+    const std::size_t ReadSize =
+      readImpl(Return.data() + Offset, ChunkSize, ContinueReading);
+    if (!ReadSize)
     {
+      Return.resize(Offset);
       MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace) << "(read) "
                                                    << "No more data!");
       break;
     }
 
-    const std::size_t ReadSize = Chunk.size();
     MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
                       << "(read) "
                       << "Received " << ReadSize << " bytes");
@@ -173,8 +403,6 @@ std::string BufferedChannel::read(std::size_t Bytes)
 
     // Serve at most the remaining byte count into the return value.
     const std::size_t BytesFromRead = std::min(Bytes, ReadSize);
-    Return.append(Chunk.begin(), Chunk.begin() + BytesFromRead);
-
     if (ReadSize > Bytes)
     {
       // Buffer anything that remained in the read chunk -- and thus already
@@ -183,14 +411,16 @@ std::string BufferedChannel::read(std::size_t Bytes)
       MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
                         << "(read) "
                         << "Buffering " << BytesToSave << " bytes");
-      Read->putBack(Chunk.data() + BytesFromRead, BytesToSave);
+      readBuffer().putBack(Return.data() + Offset + BytesFromRead,
+                           BytesToSave);
       ContinueReading = false;
     }
+    Return.resize(Offset + BytesFromRead);
 
     Bytes -= BytesFromRead;
   }
 
-  if (Read->size() > BufferSizeMax)
+  if (readInBuffer() > BufferSizeMax)
   {
     LOG_WITH_IDENTIFIER(trace) << "(read) "
                                << "Buffer overflow!";
@@ -205,7 +435,7 @@ std::string BufferedChannel::read(std::size_t Bytes)
 std::size_t BufferedChannel::write(std::string_view Data)
 {
   throwIfFailed(failed());
-  throwIfNoWrite(Write);
+  throwIfNoWrite(WriteBufferSize);
 
   MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
                     << "write(" << Data.size() << ")...");
@@ -226,7 +456,7 @@ std::size_t BufferedChannel::write(std::string_view Data)
     MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
                       << "(write) "
                       << "Buffering " << Data.size() << " bytes");
-    Write->putBack(Data.data(), Data.size());
+    writeBuffer().enqueue(Data.data(), Data.size());
     if (Write->size() > BufferSizeMax)
     {
       LOG_WITH_IDENTIFIER(trace) << "(write) "
@@ -270,10 +500,10 @@ std::size_t BufferedChannel::write(std::string_view Data)
     const std::size_t BytesToSave = Data.size();
     MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
                       << "Buffering " << BytesToSave << " bytes");
-    Write->putBack(Data.data(), BytesToSave);
+    writeBuffer().enqueue(Data.data(), BytesToSave);
   }
 
-  if (Write->size() > BufferSizeMax)
+  if (writeInBuffer() > BufferSizeMax)
   {
     LOG_WITH_IDENTIFIER(trace) << "(write) "
                                << "Buffer overflow!";
@@ -288,7 +518,7 @@ std::size_t BufferedChannel::write(std::string_view Data)
 std::size_t BufferedChannel::load(std::size_t Bytes)
 {
   throwIfFailed(failed());
-  throwIfNoRead(Read);
+  throwIfNoRead(ReadBufferSize);
 
   MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace) << "load(" << Bytes << ")...");
   const std::size_t ChunkSize = optimalReadSize();
@@ -299,15 +529,19 @@ std::size_t BufferedChannel::load(std::size_t Bytes)
     MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
                       << "(load) "
                       << "Request " << ChunkSize << " bytes...");
-    std::string Chunk = readImpl(ChunkSize, ContinueReading);
-    if (Chunk.empty())
+    // The chunk is read straight into the free space of the ring.
+    OpaqueBufferType& Buffer = readBuffer();
+    const std::size_t ReadSize =
+      readImpl(Buffer.reserve(ChunkSize), ChunkSize, ContinueReading);
+    Buffer.commit(ReadSize);
+    Buffer.account();
+    if (!ReadSize)
     {
       MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace) << "(load) "
                                                    << "No more data!");
       break;
     }
 
-    const std::size_t ReadSize = Chunk.size();
     ReadBytes += ReadSize;
     MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
                       << "(load) "
@@ -317,15 +551,10 @@ std::size_t BufferedChannel::load(std::size_t Bytes)
       // Assume no more data remaining.
       ContinueReading = false;
 
-    MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
-                      << "(load) "
-                      << "Storing " << ReadSize << " bytes");
-    Read->putBack(Chunk.data(), ReadSize);
-
     Bytes -= std::min(ReadSize, Bytes);
   }
 
-  if (Read->size() > BufferSizeMax)
+  if (readInBuffer() > BufferSizeMax)
   {
     LOG_WITH_IDENTIFIER(trace) << "(load) "
                                << "Buffer overflow!";
@@ -340,7 +569,7 @@ std::size_t BufferedChannel::load(std::size_t Bytes)
 std::size_t BufferedChannel::flushWrites()
 {
   throwIfFailed(failed());
-  throwIfNoWrite(Write);
+  throwIfNoWrite(WriteBufferSize);
   if (!hasBufferedWrite())
     return 0;
 
@@ -351,9 +580,9 @@ std::size_t BufferedChannel::flushWrites()
   bool ContinueWriting = true;
   while (ContinueWriting && hasBufferedWrite())
   {
-    std::vector<char> V = Write->peekFront(ChunkSize);
-    const std::size_t ChunkBytesSent =
-      writeImpl(std::string_view{V.data(), V.size()}, ContinueWriting);
+    // The buffered data is contiguous, so it is sent without copying.
+    std::string_view V = Write->peek().substr(0, ChunkSize);
+    const std::size_t ChunkBytesSent = writeImpl(V, ContinueWriting);
     BytesSent += ChunkBytesSent;
 
     MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
@@ -366,7 +595,7 @@ std::size_t BufferedChannel::flushWrites()
       // should be removed from the buffer!
       ContinueWriting = false;
 
-    Write->dropFront(ChunkBytesSent);
+    Write->dequeue(ChunkBytesSent);
   }
   MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace) << "flush() "
                                                << "-> " << BytesSent);
@@ -376,10 +605,48 @@ std::size_t BufferedChannel::flushWrites()
 
 void BufferedChannel::tryFreeResources()
 {
-  if (Read)
-    Read->tryCleanup();
+  const auto Now = std::chrono::system_clock::now();
+  const auto TryFree = [Now](UniqueScalar<OpaqueBufferType*, nullptr>& Buf) {
+    if (!Buf)
+      return;
+    Buf->tryCleanup();
+    if (Buf->empty() && Now - Buf->lastAccess() >= BufferIdleTime)
+    {
+      detail::BufferPool::get().release(Buf);
+      Buf = nullptr;
+    }
+  };
+
+  TryFree(Read);
+  TryFree(Write);
+}
+
+void BufferedChannel::setWriteDelayHistogram(LatencyHistogram* H) noexcept
+{
+  WriteDelay = H;
   if (Write)
-    Write->tryCleanup();
+    Write->observe(H);
+}
+
+std::size_t BufferedChannel::bufferMemory() const noexcept
+{
+  return (Read ? Read->capacity() : 0) + (Write ? Write->capacity() : 0);
+}
+
+BufferedChannel::BufferStatistics
+BufferedChannel::readBufferStatistics() const noexcept
+{
+  if (!Read)
+    return {};
+  return {Read->size(), Read->capacity(), Read->maxPeak()};
+}
+
+BufferedChannel::BufferStatistics
+BufferedChannel::writeBufferStatistics() const noexcept
+{
+  if (!Write)
+    return {};
+  return {Write->size(), Write->capacity(), Write->maxPeak()};
 }
 
 std::string BufferedChannel::statistics() const
@@ -404,22 +671,28 @@ std::string BufferedChannel::statistics() const
   };
 
   Output << "BufferedChannel " << '\'' << identifier() << '\'' << '\n';
-  if (Read)
+  if (ReadBufferSize)
   {
     Output << " <- "
            << "Read" << ':' << '\n'
            << "      "
            << "OptimalChunkSize = " << optimalReadSize() << ',' << ' ';
-    FormatOneBuffer(*Read);
+    if (Read)
+      FormatOneBuffer(*Read);
+    else
+      Output << "Buffer not allocated" << '\n';
   }
 
-  if (Write)
+  if (WriteBufferSize)
   {
     Output << " -> "
            << "Write" << ':' << '\n'
            << "      "
            << "OptimalChunkSize = " << optimalWriteSize() << ',' << ' ';
-    FormatOneBuffer(*Write);
+    if (Write)
+      FormatOneBuffer(*Write);
+    else
+      Output << "Buffer not allocated" << '\n';
   }
 
   return Output.str();
@@ -19,7 +19,7 @@
 #include "monomux/system/Channel.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("system/Channel")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "system/Channel")
 #define LOG_WITH_IDENTIFIER(SEVERITY) LOG(SEVERITY) << identifier() << ": "
 
 namespace monomux
@@ -49,7 +49,9 @@ std::string Channel::read(std::size_t Bytes)
   MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
                     << "Reading " << Bytes << " bytes...");
   bool Unused;
-  return readImpl(Bytes, Unused);
+  std::string Return(Bytes, '\0');
+  Return.resize(readImpl(Return.data(), Bytes, Unused));
+  return Return;
 }
 
 std::size_t Channel::write(std::string_view Buffer)
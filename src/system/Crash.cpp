@@ -18,28 +18,34 @@
  */
 #include <algorithm>
 #include <cassert>
+#include <climits>
+#include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <utility>
 #include <vector>
 
 #include <dlfcn.h>
 #include <execinfo.h>
+#include <unistd.h>
 
 #include "monomux/adt/POD.hpp"
 #include "monomux/system/CheckedPOSIX.hpp"
 #include "monomux/system/Pipe.hpp"
 #include "monomux/system/Process.hpp"
+#include "monomux/system/Trace.hpp"
 
 #include "monomux/system/Crash.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("system/Crash")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "system/Crash")
 
 namespace monomux
 {
@@ -136,8 +142,17 @@ bool Symboliser::check() const
   SO.StandardOutput.emplace(Pipe.getWrite()->raw());
   SO.StandardError.emplace(PipeErr.getWrite()->raw());
 
-  Process P = Process::spawn(SO);
-  P.wait();
+  std::optional<Process> P;
+  try
+  {
+    P.emplace(Process::spawn(SO));
+  }
+  catch (const std::system_error&)
+  {
+    // The symboliser is not installed.
+    return false;
+  }
+  P->wait();
 
   std::string Out = Pipe.getRead()->read(BinaryPipeCommunicationSize);
   return !Out.empty();
@@ -1077,6 +1092,63 @@ void printBacktrace(std::ostream& OS, bool Prettify)
   printBacktrace(OS, BT);
 }
 
+namespace
+{
+
+/// The path of the flight recorder dump. The part up to \p DumpPathPrefixSize
+/// is set by \p prepareFlightRecorderDump(), the rest is written in the signal
+/// handler, where nothing may be allocated.
+char DumpPath[PATH_MAX];
+std::size_t DumpPathPrefixSize = 0;
+
+} // namespace
+
+void prepareFlightRecorderDump()
+{
+  const char* TempDir = std::getenv("TMPDIR");
+  std::string Prefix = TempDir && *TempDir ? TempDir : "/tmp";
+  Prefix.append("/monomux-trace.");
+
+  // (Leave room for the process ID and the extension.)
+  if (Prefix.size() + 32 > sizeof(DumpPath))
+  {
+    LOG(warn) << "Temporary directory '" << Prefix
+              << "' is too long, flight recorder will not be dumped";
+    DumpPathPrefixSize = 0;
+    return;
+  }
+  std::copy(Prefix.begin(), Prefix.end(), DumpPath);
+  DumpPathPrefixSize = Prefix.size();
+}
+
+const char* dumpFlightRecorder() noexcept
+{
+  if (!DumpPathPrefixSize)
+    return nullptr;
+
+  // The process ID is only known here, as the server daemonises after the
+  // dump is prepared.
+  char Digits[24];
+  std::size_t DigitCount = 0;
+  for (auto PID = static_cast<unsigned long>(::getpid()); PID || !DigitCount;
+       PID /= 10)
+    Digits[DigitCount++] = static_cast<char>('0' + PID % 10);
+  char* End = DumpPath + DumpPathPrefixSize;
+  while (DigitCount)
+    *End++ = Digits[--DigitCount];
+  for (char C : {'.', 'b', 'i', 'n', '\0'})
+    *End++ = C;
+
+  fd::raw_fd FD = ::open(
+    DumpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW, 0600);
+  if (FD == fd::Invalid)
+    return nullptr;
+
+  bool Success = trace::writeSnapshot(FD);
+  ::close(FD);
+  return Success ? DumpPath : nullptr;
+}
+
 } // namespace monomux
 
 #undef LOG
@@ -23,6 +23,7 @@
 #include <libgen.h>
 #include <linux/limits.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "monomux/adt/POD.hpp"
 #include "monomux/system/CheckedPOSIX.hpp"
@@ -30,7 +31,7 @@
 #include "monomux/system/Environment.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("system/Environment")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "system/Environment")
 
 namespace monomux
 {
@@ -213,6 +214,38 @@ std::optional<MonomuxSession> MonomuxSession::loadFromEnv()
   return S;
 }
 
+std::vector<std::pair<std::string, std::string>>
+ListenFDs::createEnvVars(int PID)
+{
+  std::vector<std::pair<std::string, std::string>> R;
+  R.emplace_back(std::make_pair("LISTEN_PID", std::to_string(PID)));
+  R.emplace_back(std::make_pair("LISTEN_FDS", "1"));
+  return R;
+}
+
+std::optional<raw_fd> ListenFDs::loadFromEnv()
+{
+  std::string PID = getEnv("LISTEN_PID");
+  std::string Count = getEnv("LISTEN_FDS");
+  if (PID.empty() || Count.empty())
+    return std::nullopt;
+
+  CheckedPOSIX([] { return ::unsetenv("LISTEN_PID"); }, -1);
+  CheckedPOSIX([] { return ::unsetenv("LISTEN_FDS"); }, -1);
+
+  if (std::strtol(PID.c_str(), nullptr, 10) != ::getpid())
+  {
+    LOG(debug) << "Passed sockets are meant for PID " << PID << ", ignoring.";
+    return std::nullopt;
+  }
+  if (std::strtol(Count.c_str(), nullptr, 10) < 1)
+    return std::nullopt;
+
+  LOG(data) << "Listening socket passed in FD " << Start;
+  fd::addDescriptorFlag(Start, FD_CLOEXEC);
+  return Start;
+}
+
 } // namespace monomux
 
 #undef LOG
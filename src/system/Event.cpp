@@ -19,6 +19,7 @@
 #include <iomanip>
 
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <unistd.h>
 
 #include "monomux/adt/UniqueScalar.hpp"
@@ -27,13 +28,13 @@
 #include "monomux/system/Event.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("system/Event")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "system/Event")
 #define LOG_WITH_IDENTIFIER(SEVERITY) LOG(SEVERITY) << MasterFD << ": "
 
 namespace monomux
 {
 
-EPoll::EPoll(std::size_t EventCount)
+EPoll::EPoll(std::size_t EventCount) : Timers(TimerResolution)
 {
   Notifications.resize(EventCount);
   ScheduledResult.reserve(EventCount);
@@ -49,6 +50,15 @@ EPoll::EPoll(std::size_t EventCount)
     [] { return ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK); }, "eventfd()", -1);
   LOG_WITH_IDENTIFIER(debug) << "Created eventfd token at " << ScheduleFD;
   listen(ScheduleFD.get(), /* Incoming =*/true, /* Outgoing =*/false);
+
+  TimerFD = CheckedPOSIXThrow(
+    [] {
+      return ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    },
+    "timerfd_create()",
+    -1);
+  LOG_WITH_IDENTIFIER(debug) << "Created timerfd at " << TimerFD;
+  listen(TimerFD.get(), /* Incoming =*/true, /* Outgoing =*/false);
 }
 
 EPoll::~EPoll() { LOG_WITH_IDENTIFIER(debug) << "~EPoll"; }
@@ -56,7 +66,15 @@ EPoll::~EPoll() { LOG_WITH_IDENTIFIER(debug) << "~EPoll"; }
 std::size_t EPoll::wait()
 {
   ScheduledResult.clear();
-  ScheduleFDNotifiedAtIndex.reset();
+
+  // Timers are fired first, as their callbacks might stop listening on (and
+  // close) file descriptors, which must not be reported by this wait() any
+  // more. Events they schedule are reported by this wait().
+  if (std::size_t Fired = Timers.advance(TimerWheel::Clock::now()))
+    MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
+                      << "epoll_wait()"
+                      << " -> " << Fired << " timers");
+  setTimerFD();
 
   MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace) << "epoll_wait()...");
   auto MaybeFiredEventCount = CheckedPOSIX(
@@ -69,39 +87,39 @@ std::size_t EPoll::wait()
   {
     std::error_code EC = MaybeFiredEventCount.getError();
     if (EC == std::errc::interrupted /* EINTR */)
+    {
       // Interrupting epoll_wait() is not an issue.
+      NotificationCount = 0;
       return 0;
+    }
     throw std::system_error{EC, "epoll_wait()"};
   }
-  NotificationCount = MaybeFiredEventCount.get();
-  if (!ScheduledWaiting.empty())
-  {
-    // If there are scheduled results, the 'eventfd' will trigger and that
-    // will count as a nofication, but this would destroy our calculations.
-    --NotificationCount;
 
-    // Consume the scheduled event token.
-    POD<std::uint64_t> ScheduledCount;
-    CheckedPOSIX(
-      [Token = ScheduleFD.get(), &ScheduledCount] {
-        return ::read(Token, &ScheduledCount, sizeof(ScheduledCount));
-      },
-      -1);
-    if (ScheduledCount != ScheduledWaiting.size())
-      LOG_WITH_IDENTIFIER(debug) << "eventfd_read() -> " << ScheduledCount
-                                 << " != expected " << ScheduledWaiting.size();
-
-    // Save where the ScheduleFD was triggered at. The client should not be
-    // allowed to directly see that event.
-    for (std::size_t I = 0; I < NotificationCount + 1; ++I)
+  // Remove the notifications of the internal file descriptors from the result
+  // set. The client should not be allowed to directly see those events.
+  const std::size_t FiredEventCount = MaybeFiredEventCount.get();
+  NotificationCount = 0;
+  for (std::size_t I = 0; I < FiredEventCount; ++I)
+  {
+    const raw_fd FD = Notifications[I]->data.fd;
+    if (FD == ScheduleFD || FD == TimerFD)
     {
-      const struct ::epoll_event& E = **(Notifications.begin() + I);
-      if (E.data.fd == ScheduleFD)
-      {
-        ScheduleFDNotifiedAtIndex.emplace(I);
-        break;
-      }
+      // Consume the token, either the number of scheduled events or of timer
+      // expirations.
+      POD<std::uint64_t> Token;
+      CheckedPOSIX([FD, &Token] { return ::read(FD, &Token, sizeof(Token)); },
+                   -1);
+      if (FD == ScheduleFD && Token != ScheduledWaiting.size())
+        LOG_WITH_IDENTIFIER(debug)
+          << "eventfd_read() -> " << Token << " != expected "
+          << ScheduledWaiting.size();
+      if (FD == TimerFD)
+        TimerFDExpiry.reset();
+      continue;
     }
+    if (I != NotificationCount)
+      *Notifications[NotificationCount] = *Notifications[I];
+    ++NotificationCount;
   }
 
   MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
@@ -121,6 +139,34 @@ std::size_t EPoll::wait()
   return ScheduledResult.size() + NotificationCount;
 }
 
+void EPoll::setTimerFD()
+{
+  std::optional<TimerWheel::Clock::time_point> Expiry = Timers.nextExpiry();
+  if (Expiry == TimerFDExpiry)
+    return;
+
+  // An all-zero value disarms the timer.
+  POD<struct ::itimerspec> Spec;
+  if (Expiry)
+  {
+    auto Nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   Expiry->time_since_epoch())
+                   .count();
+    // The zero time would disarm the timer instead of firing it.
+    if (Nanos <= 0)
+      Nanos = 1;
+    Spec->it_value.tv_sec = Nanos / std::nano::den;
+    Spec->it_value.tv_nsec = Nanos % std::nano::den;
+  }
+  CheckedPOSIXThrow(
+    [this, &Spec] {
+      return ::timerfd_settime(TimerFD, TFD_TIMER_ABSTIME, &Spec, nullptr);
+    },
+    "timerfd_settime()",
+    -1);
+  TimerFDExpiry = Expiry;
+}
+
 void EPoll::schedule(raw_fd FD, bool Incoming, bool Outgoing)
 {
   auto SetupEvent = [=](struct ::epoll_event& E) {
@@ -131,8 +177,8 @@ void EPoll::schedule(raw_fd FD, bool Incoming, bool Outgoing)
       E.events |= EPOLLOUT;
   };
 
-  auto* MaybeIt = ScheduledWaitingMap.tryGet(FD);
-  if (!MaybeIt)
+  std::size_t* MaybeIndex = ScheduledWaitingMap.tryGet(FD);
+  if (!MaybeIndex)
   {
     CheckedPOSIX(
       [Token = ScheduleFD.get()] {
@@ -142,11 +188,11 @@ void EPoll::schedule(raw_fd FD, bool Incoming, bool Outgoing)
       -1);
 
     struct ::epoll_event& E = ScheduledWaiting.emplace_back();
-    ScheduledWaitingMap.set(FD, ScheduledWaiting.end() - 1);
+    ScheduledWaitingMap.set(FD, ScheduledWaiting.size() - 1);
     SetupEvent(E);
     return;
   }
-  SetupEvent(**MaybeIt);
+  SetupEvent(ScheduledWaiting[*MaybeIndex]);
 }
 
 bool EPoll::isValidIndex(std::size_t I) const noexcept
@@ -166,12 +212,7 @@ const struct ::epoll_event& EPoll::at(std::size_t Index) const
 
   // The rest of the buffer should be taken from the real system result set.
   Index -= ScheduledCount;
-  // Skipping (as if never existed) the position where the eventfd(2) trigger
-  // arrived.
-  if (!ScheduleFDNotifiedAtIndex.has_value() ||
-      Index < *ScheduleFDNotifiedAtIndex)
-    return *Notifications.at(Index);
-  return *Notifications.at(Index + 1);
+  return *Notifications.at(Index);
 }
 
 raw_fd EPoll::fdAt(std::size_t Index) noexcept
@@ -197,6 +238,20 @@ void EPoll::listen(raw_fd FD, bool Incoming, bool Outgoing)
 
 void EPoll::stop(raw_fd FD)
 {
+  // A scheduled event must not be reported for the file, which might get
+  // closed, and its number reused.
+  if (std::size_t* MaybeIndex = ScheduledWaitingMap.tryGet(FD))
+  {
+    const std::size_t Index = *MaybeIndex;
+    ScheduledWaitingMap.erase(FD);
+    if (Index != ScheduledWaiting.size() - 1)
+    {
+      *ScheduledWaiting[Index] = *ScheduledWaiting.back();
+      ScheduledWaitingMap.set(ScheduledWaiting[Index]->data.fd, Index);
+    }
+    ScheduledWaiting.pop_back();
+  }
+
   auto It = Listeners.find(FD);
   if (It == Listeners.end())
     return;
@@ -0,0 +1,228 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "monomux/system/fd.hpp"
+
+#include "monomux/system/MagicRingBuffer.hpp"
+
+#include "monomux/Log.hpp"
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "system/MagicRingBuffer")
+
+namespace monomux
+{
+
+namespace
+{
+
+std::size_t pageSize() noexcept
+{
+  static const std::size_t PageSize = [] {
+    long Size = ::sysconf(_SC_PAGESIZE);
+    return Size > 0 ? static_cast<std::size_t>(Size) : 4096;
+  }();
+  return PageSize;
+}
+
+/// Maps a new anonymous file of \p Size bytes twice, consecutively, into the
+/// memory.
+///
+/// \returns the beginning of the first mapping, or \p nullptr if the mapping
+/// could not be created.
+char* mapTwice(std::size_t Size) noexcept
+{
+  fd File = ::memfd_create("monomux-ring", MFD_CLOEXEC);
+  if (!File.has())
+  {
+    LOG(debug) << "memfd_create(): " << std::strerror(errno);
+    return nullptr;
+  }
+  if (::ftruncate(File, static_cast<off_t>(Size)) == -1)
+  {
+    LOG(debug) << "ftruncate(): " << std::strerror(errno);
+    return nullptr;
+  }
+
+  // Reserve a contiguous range of addresses for both mappings first, so the
+  // second one can not collide with an unrelated mapping.
+  void* Reservation = ::mmap(
+    nullptr, 2 * Size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (Reservation == MAP_FAILED)
+  {
+    LOG(debug) << "mmap(): " << std::strerror(errno);
+    return nullptr;
+  }
+
+  char* Base = static_cast<char*>(Reservation);
+  for (char* Mirror : {Base, Base + Size})
+    if (::mmap(Mirror,
+               Size,
+               PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_FIXED,
+               File,
+               0) == MAP_FAILED)
+    {
+      LOG(debug) << "mmap(): " << std::strerror(errno);
+      ::munmap(Base, 2 * Size);
+      return nullptr;
+    }
+
+  // The mappings keep the file alive, the descriptor is not needed anymore.
+  return Base;
+}
+
+} // namespace
+
+MagicRingBuffer::MagicRingBuffer(std::size_t Capacity)
+  : RingBufferBase(std::max(Capacity, pageSize())),
+    RingBufferUsageTracking(static_cast<RingBufferBase&>(*this))
+{
+  allocate(this->Capacity);
+}
+
+MagicRingBuffer::~MagicRingBuffer() { deallocate(); }
+
+char* MagicRingBuffer::reserve(std::size_t N)
+{
+  if (Size + N > Capacity)
+  {
+    std::size_t NewCapacity = Capacity;
+    while (NewCapacity < Size + N)
+      NewCapacity *= 2;
+    reallocate(NewCapacity);
+  }
+  else if (!DoubleMapped && Head + Size + N > Capacity)
+  {
+    // Compact the data to the beginning of the fallback storage.
+    std::memmove(Storage, Storage + Head, Size);
+    Head = 0;
+  }
+
+  return Storage + Head + Size;
+}
+
+void MagicRingBuffer::commit(std::size_t N) noexcept
+{
+  assert(Size + N <= Capacity && "commit() more than reserve()d!");
+  Size += N;
+  markAccess();
+  mayBePeak(*this);
+}
+
+void MagicRingBuffer::putBack(const char* Ptr, std::size_t N)
+{
+  if (!N)
+    return;
+  std::memcpy(reserve(N), Ptr, N);
+  commit(N);
+}
+
+void MagicRingBuffer::dropFront(std::size_t N) noexcept
+{
+  if (N > Size)
+    N = Size;
+
+  Head = Head + N;
+  if (DoubleMapped && Head >= Capacity)
+    // Continue from the first mapping of the same location.
+    Head = Head - Capacity;
+  Size -= N;
+  markAccess();
+  mayBeValley(*this);
+  if (empty())
+    Head = 0;
+}
+
+void MagicRingBuffer::clear() noexcept
+{
+  Size = 0;
+  Head = 0;
+  mayBeValley(*this);
+}
+
+void MagicRingBuffer::tryCleanup()
+{
+  if (!empty())
+    return;
+
+  if (shouldShrink(*this))
+  {
+    resetPeaks(*this);
+    reallocate(originalCapacity());
+  }
+  Head = 0;
+}
+
+void MagicRingBuffer::allocate(std::size_t NewCapacity)
+{
+  if (char* Base = mapTwice(NewCapacity))
+  {
+    Storage = Base;
+    DoubleMapped = true;
+  }
+  else
+  {
+    Storage = new char[NewCapacity];
+    DoubleMapped = false;
+  }
+  Capacity = NewCapacity;
+}
+
+void MagicRingBuffer::deallocate() noexcept
+{
+  if (!Storage)
+    return;
+
+  if (DoubleMapped)
+    ::munmap(Storage, 2 * Capacity);
+  else
+    delete[] Storage.get();
+  Storage = nullptr;
+}
+
+void MagicRingBuffer::reallocate(std::size_t NewCapacity)
+{
+  if (NewCapacity == Capacity)
+    return;
+  assert(Size <= NewCapacity && "Reallocation would lose data!");
+
+  char* OldStorage = Storage;
+  const std::size_t OldHead = Head;
+  const std::size_t OldCapacity = Capacity;
+  const bool OldDoubleMapped = DoubleMapped;
+
+  allocate(NewCapacity);
+  if (Size)
+    std::memcpy(Storage, OldStorage + OldHead, Size);
+  Head = 0;
+
+  if (OldDoubleMapped)
+    ::munmap(OldStorage, 2 * OldCapacity);
+  else
+    delete[] OldStorage;
+}
+
+} // namespace monomux
+
+#undef LOG
@@ -28,7 +28,7 @@
 #include "monomux/system/Pipe.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("system/Pipe")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "system/Pipe")
 #define LOG_WITH_IDENTIFIER(SEVERITY) LOG(SEVERITY) << identifier() << ": "
 
 namespace monomux
@@ -193,21 +193,17 @@ void Pipe::setNonblocking()
   Nonblock = true;
 }
 
-static std::string read(raw_fd FD, std::size_t Bytes, bool* Success)
+static std::size_t
+read(raw_fd FD, char* Buffer, std::size_t Bytes, bool* Success)
 {
-  static constexpr std::size_t BufferSize = BUFSIZ;
-  std::string Return;
-  Return.reserve(Bytes);
-
-  std::size_t RemainingBytes = Bytes;
+  std::size_t BytesRead = 0;
 
   bool ContinueReading = true;
-  while (ContinueReading && RemainingBytes > 0 && RemainingBytes <= Bytes)
+  while (ContinueReading && BytesRead < Bytes)
   {
-    POD<char[BufferSize]> RawBuffer;
     auto ReadBytes = CheckedPOSIX(
-      [FD, ReadSize = std::min(BufferSize, RemainingBytes), &RawBuffer] {
-        return ::read(FD, &RawBuffer, ReadSize);
+      [FD, Into = Buffer + BytesRead, ReadSize = Bytes - BytesRead] {
+        return ::read(FD, Into, ReadSize);
       },
       -1);
     if (!ReadBytes)
@@ -236,18 +232,14 @@ static std::string read(raw_fd FD, std::size_t Bytes, bool* Success)
       break;
     }
 
-    std::size_t BytesToAppendFromCurrentRead =
-      std::min(static_cast<std::size_t>(ReadBytes.get()), RemainingBytes);
-    Return.append(RawBuffer, BytesToAppendFromCurrentRead);
-
-    RemainingBytes -= BytesToAppendFromCurrentRead;
+    BytesRead += ReadBytes.get();
   }
 
-  if (!ContinueReading && Return.empty() && Success)
+  if (!ContinueReading && !BytesRead && Success)
     *Success = false;
   else if (Success)
     *Success = true;
-  return Return;
+  return BytesRead;
 }
 
 static std::size_t write(raw_fd FD, std::string_view Buffer, bool* Success)
@@ -303,7 +295,7 @@ static std::size_t write(raw_fd FD, std::string_view Buffer, bool* Success)
   return BytesSent;
 }
 
-std::string Pipe::readImpl(std::size_t Bytes, bool& Continue)
+std::size_t Pipe::readImpl(char* Buffer, std::size_t Bytes, bool& Continue)
 {
   if (failed())
     throw std::system_error{std::make_error_code(std::errc::io_error),
@@ -314,14 +306,14 @@ std::string Pipe::readImpl(std::size_t Bytes, bool& Continue)
       "Not readable."};
 
   bool Success;
-  std::string Data = monomux::read(Handle, Bytes, &Success);
+  std::size_t BytesRead = monomux::read(Handle, Buffer, Bytes, &Success);
   if (!Success)
   {
     setFailed();
     Continue = false;
   }
 
-  return Data;
+  return BytesRead;
 }
 
 std::size_t Pipe::writeImpl(std::string_view Buffer, bool& Continue)
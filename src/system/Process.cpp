@@ -18,10 +18,14 @@
  */
 #include <csignal>
 #include <cstdio>
-#include <cstring>
 #include <iomanip>
+#include <string_view>
+#include <system_error>
 
 #include <linux/limits.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -33,69 +37,123 @@
 #include "monomux/system/Process.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("system/Process")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "system/Process")
 
 namespace monomux
 {
 
-static void allocCopyString(const std::string& Source,
-                            char* DestinationStringArray[],
-                            std::size_t Index)
+namespace
 {
-  DestinationStringArray[Index] =
-    reinterpret_cast<char*>(std::calloc(Source.size() + 1, 1));
-  std::strncpy(
-    DestinationStringArray[Index], Source.c_str(), Source.size() + 1);
-}
 
-Process::raw_handle Process::thisProcess()
+/// The argument and environment vectors of a program to be executed, built in
+/// full before the new process is created, so that the new process does not
+/// need to allocate or modify its environment before \p execve().
+struct ExecVectors
 {
-  return CheckedPOSIXThrow([] { return ::getpid(); }, "getpid()", -1);
+  ExecVectors(const Process::SpawnOptions& Opts);
+
+  /// The path of the program found in the \p PATH of the environment.
+  std::string Path;
+  std::vector<char*> Argv;
+  std::vector<char*> Envp;
+
+private:
+  /// The storage for the variables set by the \p SpawnOptions, as the
+  /// inherited ones are not copied.
+  std::vector<std::string> SetVariables;
+};
+
+/// \returns the path of the executable \p Program, searched in the
+/// directories listed in \p SearchPath, as \p execvp() would.
+std::string findProgram(const std::string& Program, std::string_view SearchPath)
+{
+  if (Program.empty() || Program.find('/') != std::string::npos)
+    return Program;
+
+  while (true)
+  {
+    std::size_t Colon = SearchPath.find(':');
+    std::string Candidate{SearchPath.substr(0, Colon)};
+    if (Candidate.empty())
+      Candidate = ".";
+    Candidate.push_back('/');
+    Candidate.append(Program);
+
+    POD<struct ::stat> Stat;
+    if (::stat(Candidate.c_str(), &Stat) == 0 && S_ISREG(Stat->st_mode) &&
+        ::access(Candidate.c_str(), X_OK) == 0)
+      return Candidate;
+
+    if (Colon == std::string_view::npos)
+      break;
+    SearchPath.remove_prefix(Colon + 1);
+  }
+
+  // Let the execution fail with the usual error.
+  return Program;
 }
 
-std::string Process::thisProcessPath()
+ExecVectors::ExecVectors(const Process::SpawnOptions& Opts)
 {
-  POD<char[PATH_MAX]> Binary;
-  CheckedPOSIXThrow(
-    [&Binary] { return ::readlink("/proc/self/exe", Binary, PATH_MAX); },
-    "readlink(\"/proc/self/exe\")",
-    -1);
-  return {Binary};
+  // (The exec() family does not modify the strings, the const_cast is safe.)
+  Argv.reserve(Opts.Arguments.size() + 2);
+  Argv.emplace_back(const_cast<char*>(Opts.Program.c_str()));
+  for (const std::string& Arg : Opts.Arguments)
+    Argv.emplace_back(const_cast<char*>(Arg.c_str()));
+  Argv.emplace_back(nullptr);
+
+  std::string_view SearchPath = "/bin:/usr/bin";
+  auto AddVariable = [&SearchPath, this](char* Variable) {
+    static constexpr std::string_view PathPrefix = "PATH=";
+    std::string_view V = Variable;
+    if (V.substr(0, PathPrefix.size()) == PathPrefix)
+      SearchPath = V.substr(PathPrefix.size());
+    Envp.emplace_back(Variable);
+  };
+
+  // Inherit the variables of the current process, unless they are set or
+  // unset by the options.
+  for (char** Inherited = ::environ; Inherited && *Inherited; ++Inherited)
+  {
+    std::string_view V = *Inherited;
+    if (Opts.Environment.find(std::string{V.substr(0, V.find('='))}) !=
+        Opts.Environment.end())
+      continue;
+    AddVariable(*Inherited);
+  }
+
+  SetVariables.reserve(Opts.Environment.size());
+  for (const auto& E : Opts.Environment)
+  {
+    if (!E.second.has_value())
+      continue;
+    std::string& Variable = SetVariables.emplace_back(E.first);
+    Variable.push_back('=');
+    Variable.append(*E.second);
+    AddVariable(Variable.data());
+  }
+  Envp.emplace_back(nullptr);
+
+  Path = findProgram(Opts.Program, SearchPath);
 }
 
-[[noreturn]] void Process::exec(const SpawnOptions& Opts)
+/// Logs the \p Opts of a process about to be executed from \p Caller.
+void logOptions(const Process::SpawnOptions& Opts, const char* Caller)
 {
-  LOG(debug) << "----- Process::exec() "
+  LOG(debug) << "----- Process::" << Caller << "() "
              << "was called -----";
-
-  char** NewArgv = new char*[Opts.Arguments.size() + 2];
-  allocCopyString(Opts.Program, NewArgv, 0);
   LOG(debug) << "        Program: " << Opts.Program;
-  NewArgv[Opts.Arguments.size() + 1] = nullptr;
   for (std::size_t I = 0; I < Opts.Arguments.size(); ++I)
-  {
-    allocCopyString(Opts.Arguments[I], NewArgv, I + 1);
     LOG(debug) << "        Arg "
                << std::setw(log::Logger::digits(Opts.Arguments.size())) << I
                << ": " << Opts.Arguments[I];
-  }
 
   for (const auto& E : Opts.Environment)
   {
     if (!E.second.has_value())
-    {
       LOG(debug) << "        Env unset: " << E.first;
-      CheckedPOSIX([&K = E.first] { return ::unsetenv(K.c_str()); }, -1);
-    }
     else
-    {
       LOG(debug) << "        Env   set: " << E.first << " = " << *E.second;
-      CheckedPOSIX(
-        [&K = E.first, &V = E.second] {
-          return ::setenv(K.c_str(), V->c_str(), 1);
-        },
-        -1);
-    }
   }
 
   if (Opts.CreatePTY)
@@ -110,8 +168,61 @@ std::string Process::thisProcessPath()
       LOG(debug) << "       stderr: " << *Opts.StandardError;
   }
 
-  LOG(debug) << "----- Process::exec() "
+  LOG(debug) << "----- Process::" << Caller << "() "
              << "firing... -----";
+}
+
+/// The \p posix_spawn() family returns the error instead of setting
+/// \p errno, which is turned into an exception by this function.
+void checkSpawn(int Error, const char* What)
+{
+  if (Error != 0)
+    throw std::system_error{std::error_code{Error, std::system_category()},
+                            What};
+}
+
+/// Owns the attributes and the file actions of a \p posix_spawn() call.
+struct SpawnRequest
+{
+  SpawnRequest()
+  {
+    checkSpawn(::posix_spawnattr_init(&Attributes), "posix_spawnattr_init()");
+    checkSpawn(::posix_spawn_file_actions_init(&Actions),
+               "posix_spawn_file_actions_init()");
+  }
+  ~SpawnRequest()
+  {
+    ::posix_spawn_file_actions_destroy(&Actions);
+    ::posix_spawnattr_destroy(&Attributes);
+  }
+  SpawnRequest(const SpawnRequest&) = delete;
+  SpawnRequest& operator=(const SpawnRequest&) = delete;
+
+  POD<::posix_spawnattr_t> Attributes;
+  POD<::posix_spawn_file_actions_t> Actions;
+};
+
+} // namespace
+
+Process::raw_handle Process::thisProcess()
+{
+  return CheckedPOSIXThrow([] { return ::getpid(); }, "getpid()", -1);
+}
+
+std::string Process::thisProcessPath()
+{
+  POD<char[PATH_MAX]> Binary;
+  CheckedPOSIXThrow(
+    [&Binary] { return ::readlink("/proc/self/exe", Binary, PATH_MAX); },
+    "readlink(\"/proc/self/exe\")",
+    -1);
+  return {Binary};
+}
+
+[[noreturn]] void Process::exec(const SpawnOptions& Opts)
+{
+  ExecVectors Exec{Opts};
+  logOptions(Opts, "exec");
 
   if (!Opts.CreatePTY)
   {
@@ -133,8 +244,17 @@ std::string Process::thisProcessPath()
       ReplaceFD(fd::fileno(stdout), *Opts.StandardOutput);
   }
 
-  auto ExecSuccessful =
-    CheckedPOSIX([NewArgv] { return ::execvp(NewArgv[0], NewArgv); }, -1);
+  // The signal mask survives exec(). Signals blocked by the caller, e.g. for a
+  // SignalFD, must not stay blocked for the new program.
+  POD<::sigset_t> Unblocked;
+  ::sigemptyset(&Unblocked);
+  ::sigprocmask(SIG_SETMASK, &Unblocked, nullptr);
+
+  auto ExecSuccessful = CheckedPOSIX(
+    [&Exec] {
+      return ::execve(Exec.Path.c_str(), Exec.Argv.data(), Exec.Envp.data());
+    },
+    -1);
   if (!ExecSuccessful)
   {
     MONOMUX_TRACE_LOG(LOG(fatal)
@@ -151,31 +271,89 @@ Process Process::spawn(const SpawnOptions& Opts)
   if (Opts.CreatePTY)
     PTY.emplace(Pty{});
 
-  raw_handle ForkResult =
-    CheckedPOSIXThrow([] { return ::fork(); }, "fork() failed in spawn()", -1);
-  if (ForkResult != 0)
+  ExecVectors Exec{Opts};
+  logOptions(Opts, "spawn");
+
+  // posix_spawn() creates the child with clone(CLONE_VM | CLONE_VFORK), so the
+  // page tables of the (potentially large) current process are not copied,
+  // and everything the child does before execve() is described up front.
+  SpawnRequest Request;
+  checkSpawn(
+    ::posix_spawnattr_setflags(&Request.Attributes,
+                               POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGMASK |
+                                 POSIX_SPAWN_SETSIGDEF),
+    "posix_spawnattr_setflags()");
   {
-    // We are in the parent.
-    Process P;
-    P.Handle = ForkResult;
-    MONOMUX_TRACE_LOG(LOG(debug) << "PID " << P.Handle << " spawned.");
-
-    if (PTY)
-    {
-      PTY->setupParentSide();
-      P.PTY = std::move(PTY);
-    }
-
-    return P;
+    // Signals blocked by the caller, e.g. for a SignalFD, must not stay
+    // blocked for the new program, and neither should the signals ignored
+    // by the caller stay ignored.
+    POD<::sigset_t> Signals;
+    ::sigemptyset(&Signals);
+    checkSpawn(::posix_spawnattr_setsigmask(&Request.Attributes, &Signals),
+               "posix_spawnattr_setsigmask()");
+    ::sigfillset(&Signals);
+    checkSpawn(::posix_spawnattr_setsigdefault(&Request.Attributes, &Signals),
+               "posix_spawnattr_setsigdefault()");
+  }
+
+  if (PTY)
+    PTY->setupChildrenSide(Request.Actions);
+  else
+  {
+    // Replaces the "Original" file descriptor with the new "With" one.
+    auto ReplaceFD = [&Actions = Request.Actions](raw_fd Original,
+                                                   raw_fd With) {
+      if (With == fd::Invalid)
+        checkSpawn(::posix_spawn_file_actions_addclose(&Actions, Original),
+                   "posix_spawn_file_actions_addclose()");
+      else
+      {
+        checkSpawn(::posix_spawn_file_actions_adddup2(&Actions, With, Original),
+                   "posix_spawn_file_actions_adddup2()");
+        checkSpawn(::posix_spawn_file_actions_addclose(&Actions, With),
+                   "posix_spawn_file_actions_addclose()");
+      }
+    };
+    if (Opts.StandardInput)
+      ReplaceFD(fd::fileno(stdin), *Opts.StandardInput);
+    if (Opts.StandardError)
+      ReplaceFD(fd::fileno(stderr), *Opts.StandardError);
+    if (Opts.StandardOutput)
+      ReplaceFD(fd::fileno(stdout), *Opts.StandardOutput);
   }
 
-  // We are in the child.
-  CheckedPOSIXThrow([] { return ::setsid(); }, "setsid()", -1);
+  Process P;
+  checkSpawn(::posix_spawn(&P.Handle,
+                           Exec.Path.c_str(),
+                           &Request.Actions,
+                           &Request.Attributes,
+                           Exec.Argv.data(),
+                           Exec.Envp.data()),
+             "posix_spawn() failed in spawn()");
+  MONOMUX_TRACE_LOG(LOG(debug) << "PID " << P.Handle << " spawned.");
+
+#ifdef SYS_pidfd_open
+  // (The child cannot be reaped by anyone else between the spawn and this
+  // call, so the PID still refers to it.)
+  auto PidFD = CheckedPOSIX(
+    [PID = P.Handle] {
+      return static_cast<raw_fd>(::syscall(SYS_pidfd_open, PID, 0));
+    },
+    -1);
+  if (PidFD)
+    P.PidFD = fd{PidFD.get()};
+  else
+    LOG(debug) << "pidfd_open(" << P.Handle
+               << ") failed: " << PidFD.getError().message();
+#endif /* SYS_pidfd_open */
+
   if (PTY)
-    PTY->setupChildrenSide();
+  {
+    PTY->setupParentSide();
+    P.PTY = std::move(PTY);
+  }
 
-  Process::exec(Opts);
-  unreachable("Process::exec() should've replaced the process.");
+  return P;
 }
 
 static std::pair<bool, int> reapAndGetExitCode(Process::raw_handle PID,
@@ -240,17 +418,24 @@ void Process::wait()
 }
 
 // NOLINTNEXTLINE(readability-make-member-function-const)
-void Process::signal(int Signal) { signal(Handle, Signal); }
+bool Process::signal(int Signal) { return signal(Handle, Signal); }
 
-void Process::signal(raw_handle Handle, int Signal)
+bool Process::signal(raw_handle Handle, int Signal)
 {
   if (Handle == Invalid)
-    return;
+    return false;
 
   MONOMUX_TRACE_LOG(LOG(trace)
                     << "Sending signal " << Signal << " to PID " << Handle);
-  CheckedPOSIX([PGroup = -Handle, Signal] { return ::kill(PGroup, Signal); },
-               -1);
+  auto Kill = CheckedPOSIX(
+    [PGroup = -Handle, Signal] { return ::kill(PGroup, Signal); }, -1);
+  if (!Kill)
+  {
+    LOG(debug) << "Sending signal " << Signal << " to PID " << Handle
+               << " failed: " << Kill.getError().message();
+    return false;
+  }
+  return true;
 }
 
 } // namespace monomux
@@ -17,11 +17,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <sstream>
+#include <system_error>
 
+#include <fcntl.h>
 #include <linux/limits.h>
 #include <pty.h>
 #include <unistd.h>
-#include <utmp.h>
 
 #include "monomux/adt/POD.hpp"
 #include "monomux/system/CheckedPOSIX.hpp"
@@ -29,7 +30,7 @@
 #include "monomux/system/Pty.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("system/Pty")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "system/Pty")
 #define LOG_WITH_IDENTIFIER(SEVERITY) LOG(SEVERITY) << name() << ": "
 
 namespace monomux
@@ -79,20 +80,37 @@ void Pty::setupParentSide()
     Pipe::weakWrap(Master.get(), Pipe::Write, OutName.str()));
 }
 
-void Pty::setupChildrenSide()
+void Pty::setupChildrenSide(::posix_spawn_file_actions_t& Actions) const
 {
   MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
                     << Slave << " - Set up as child...");
 
-  // Closes PTM, the pseudoterminal multiplexer master (PTMX).
-  raw_fd PTM = Master.release();
-  fd::close(PTM);
-
-  CheckedPOSIXThrow(
-    [this] { return ::login_tty(Slave); }, "login_tty in child", -1);
+  auto Check = [](int Error, const char* What) {
+    // (The posix_spawn() family returns the error instead of setting errno.)
+    if (Error != 0)
+      throw std::system_error{std::error_code{Error, std::system_category()},
+                              What};
+  };
 
-  // Generally the PTY children are exec()ing away, so we can safely just NOT
-  // set up the Pipe data structures here, right?
+  // Closes PTM, the pseudoterminal multiplexer master (PTMX).
+  Check(::posix_spawn_file_actions_addclose(&Actions, Master),
+        "posix_spawn_file_actions_addclose(PTM)");
+
+  // A session leader without a controlling terminal acquires the terminal it
+  // opens, which stands in for the TIOCSCTTY of login_tty(). The opened
+  // device is then made the standard streams.
+  Check(::posix_spawn_file_actions_addopen(
+          &Actions, STDIN_FILENO, Name.c_str(), O_RDWR, 0),
+        "posix_spawn_file_actions_addopen(PTS)");
+  Check(
+    ::posix_spawn_file_actions_adddup2(&Actions, STDIN_FILENO, STDOUT_FILENO),
+    "posix_spawn_file_actions_adddup2(PTS, stdout)");
+  Check(
+    ::posix_spawn_file_actions_adddup2(&Actions, STDIN_FILENO, STDERR_FILENO),
+    "posix_spawn_file_actions_adddup2(PTS, stderr)");
+  if (Slave > STDERR_FILENO)
+    Check(::posix_spawn_file_actions_addclose(&Actions, Slave),
+          "posix_spawn_file_actions_addclose(PTS)");
 }
 
 void Pty::setSize(unsigned short Rows, unsigned short Columns)
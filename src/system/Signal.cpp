@@ -27,7 +27,7 @@
 #include "monomux/system/Signal.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("system/Signal")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "system/Signal")
 
 namespace monomux
 {
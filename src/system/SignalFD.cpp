@@ -0,0 +1,95 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <csignal>
+#include <system_error>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "monomux/system/CheckedPOSIX.hpp"
+
+#include "monomux/system/SignalFD.hpp"
+
+#include "monomux/Log.hpp"
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "system/SignalFD")
+
+namespace monomux
+{
+
+SignalFD::SignalFD(std::initializer_list<Signal> Signals)
+{
+  POD<::sigset_t> Mask;
+  ::sigemptyset(&Mask);
+  for (Signal S : Signals)
+    ::sigaddset(&Mask, S);
+
+  // (pthread_sigmask() returns the error code instead of setting errno.)
+  if (int Error = ::pthread_sigmask(SIG_BLOCK, &Mask, &OriginalMask))
+    throw std::system_error{Error, std::system_category(), "pthread_sigmask()"};
+
+  try
+  {
+    Handle = CheckedPOSIXThrow(
+      [&Mask] { return ::signalfd(-1, &Mask, SFD_NONBLOCK | SFD_CLOEXEC); },
+      "signalfd()",
+      -1);
+  }
+  catch (...)
+  {
+    ::pthread_sigmask(SIG_SETMASK, &OriginalMask, nullptr);
+    throw;
+  }
+  LOG(debug) << "Created signalfd at " << Handle;
+}
+
+SignalFD::~SignalFD()
+{
+  // Signals that arrived but were not read are pending, and would be delivered
+  // when unblocked. Discard them, the owner is not interested anymore.
+  try
+  {
+    while (read())
+      ;
+  }
+  catch (const std::system_error&)
+  {}
+  ::pthread_sigmask(SIG_SETMASK, &OriginalMask, nullptr);
+}
+
+std::optional<struct ::signalfd_siginfo> SignalFD::read()
+{
+  POD<struct ::signalfd_siginfo> Info;
+  auto ReadBytes = CheckedPOSIX(
+    [this, &Info] { return ::read(Handle, &Info, sizeof(Info)); }, -1);
+  if (!ReadBytes)
+  {
+    std::error_code EC = ReadBytes.getError();
+    if (EC == std::errc::resource_unavailable_try_again ||
+        EC == std::errc::operation_would_block)
+      return std::nullopt;
+    throw std::system_error{EC, "read(signalfd)"};
+  }
+  if (static_cast<std::size_t>(ReadBytes.get()) != sizeof(Info))
+    return std::nullopt;
+  return *Info;
+}
+
+} // namespace monomux
+
+#undef LOG
@@ -27,7 +27,7 @@
 #include "monomux/system/Socket.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("system/Socket")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "system/Socket")
 #define LOG_WITH_IDENTIFIER(SEVERITY) LOG(SEVERITY) << identifier() << ": "
 
 namespace monomux
@@ -117,6 +117,27 @@ Socket Socket::wrap(fd&& FD, std::string Identifier)
   return S;
 }
 
+Socket Socket::adopt(fd&& FD, std::string Path)
+{
+  POD<int> AcceptsConnections;
+  POD<::socklen_t> OptLen;
+  *OptLen = sizeof(int);
+  CheckedPOSIXThrow(
+    [&FD, &AcceptsConnections, &OptLen] {
+      return ::getsockopt(
+        FD, SOL_SOCKET, SO_ACCEPTCONN, &AcceptsConnections, &OptLen);
+    },
+    "getsockopt(SO_ACCEPTCONN)",
+    -1);
+
+  LOG(debug) << "Adopted FD " << FD.get() << " as '" << Path << '\'';
+
+  Socket S{std::move(FD), std::move(Path), true};
+  S.Owning = true;
+  S.Listening = (*AcceptsConnections != 0);
+  return S;
+}
+
 Socket::~Socket() noexcept
 {
   if (needsCleanup())
@@ -158,9 +179,12 @@ std::optional<Socket> Socket::accept(std::error_code* Error, bool* Recoverable)
 
   auto MaybeClient = CheckedPOSIX(
     [this, &SocketAddr, &SocketAddrLen] {
-      return ::accept(raw(),
-                      reinterpret_cast<struct ::sockaddr*>(&SocketAddr),
-                      &SocketAddrLen);
+      // The accepted socket is created non-blocking and close-on-exec
+      // immediately, without additional fcntl() calls.
+      return ::accept4(raw(),
+                       reinterpret_cast<struct ::sockaddr*>(&SocketAddr),
+                       &SocketAddrLen,
+                       SOCK_NONBLOCK | SOCK_CLOEXEC);
     },
     -1);
   if (!MaybeClient)
@@ -179,7 +203,13 @@ std::optional<Socket> Socket::accept(std::error_code* Error, bool* Recoverable)
       ConsiderRecoverable = true;
     }
     else if (EC == std::errc::resource_unavailable_try_again /* EAGAIN */ ||
-             EC == std::errc::interrupted /* EINTR */ ||
+             EC == std::errc::operation_would_block /* EWOULDBLOCK */)
+    {
+      // A non-blocking socket had no more pending connections.
+      MONOMUX_TRACE_LOG(LOG_WITH_IDENTIFIER(trace)
+                        << "No more clients to accept");
+    }
+    else if (EC == std::errc::interrupted /* EINTR */ ||
              EC == std::errc::connection_aborted /* ECONNABORTED */ ||
              static_cast<int>(EC) != 0)
     {
@@ -200,20 +230,11 @@ std::optional<Socket> Socket::accept(std::error_code* Error, bool* Recoverable)
   return Socket::wrap(MaybeClient.get(), std::move(ClientPath));
 }
 
-std::string Socket::readImpl(std::size_t Bytes, bool& Continue)
+std::size_t Socket::readImpl(char* Buffer, std::size_t Bytes, bool& Continue)
 {
-  static constexpr std::size_t BufferSize = BUFSIZ;
-
-  std::string Return;
-  Return.reserve(Bytes);
-
-  POD<char[BufferSize]> RawBuffer;
-  if (Bytes > BufferSize)
-    Bytes = BufferSize;
-
   auto ReadBytes = CheckedPOSIX(
-    [FD = Handle.get(), Bytes, &RawBuffer] {
-      return ::recv(FD, &RawBuffer, Bytes, 0);
+    [FD = Handle.get(), Buffer, Bytes] {
+      return ::recv(FD, Buffer, Bytes, 0);
     },
     -1);
   if (!ReadBytes)
@@ -223,14 +244,14 @@ std::string Socket::readImpl(std::size_t Bytes, bool& Continue)
     {
       // Not an error, continue.
       Continue = true;
-      return {};
+      return 0;
     }
     if (EC == std::errc::operation_would_block /* EWOULDBLOCK */ ||
         EC == std::errc::resource_unavailable_try_again /* EAGAIN */)
     {
       // No more data left in the stream.
       Continue = false;
-      return {};
+      return 0;
     }
 
     LOG_WITH_IDENTIFIER(error) << "Read error";
@@ -239,7 +260,6 @@ std::string Socket::readImpl(std::size_t Bytes, bool& Continue)
     throw std::system_error{std::make_error_code(EC)};
   }
 
-  Return.append(RawBuffer, ReadBytes.get());
   Continue = true;
   if (ReadBytes.get() == 0)
   {
@@ -247,7 +267,7 @@ std::string Socket::readImpl(std::size_t Bytes, bool& Continue)
     setFailed();
     Continue = false;
   }
-  return Return;
+  return ReadBytes.get();
 }
 
 std::size_t Socket::writeImpl(std::string_view Buffer, bool& Continue)
@@ -0,0 +1,340 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "monomux/system/Trace.hpp"
+
+namespace monomux::trace
+{
+
+const char* eventName(EventID E) noexcept
+{
+  switch (E)
+  {
+    case EventID::None:
+      return "None";
+    case EventID::LoopWake:
+      return "LoopWake";
+    case EventID::ClientAccept:
+      return "ClientAccept";
+    case EventID::ClientExit:
+      return "ClientExit";
+    case EventID::ClientKick:
+      return "ClientKick";
+    case EventID::ControlMessage:
+      return "ControlMessage";
+    case EventID::ClientRead:
+      return "ClientRead";
+    case EventID::ClientSend:
+      return "ClientSend";
+    case EventID::SessionRead:
+      return "SessionRead";
+    case EventID::SessionWrite:
+      return "SessionWrite";
+    case EventID::SessionCreate:
+      return "SessionCreate";
+    case EventID::SessionDestroy:
+      return "SessionDestroy";
+    case EventID::ChildExit:
+      return "ChildExit";
+    case EventID::Overflow:
+      return "Overflow";
+    case EventID::Flush:
+      return "Flush";
+    case EventID::Crash:
+      return "Crash";
+    case EventID::Last:
+      break;
+  }
+  return "<unknown>";
+}
+
+namespace
+{
+
+constexpr char Magic[8] = {'M', 'N', 'M', 'X', 'T', 'R', 'C', '1'};
+constexpr std::uint32_t FormatVersion = 1;
+
+/// The number of threads that may own a ring. Rings are never freed (a dead
+/// thread's history is still interesting), so this bounds the memory use.
+constexpr std::size_t MaxThreads = 64;
+
+struct FileHeader
+{
+  char Magic[8];
+  std::uint32_t Version;
+  std::uint32_t RecordSize;
+  /// The raw timestamp and monotonic clock (in nanoseconds) at the time the
+  /// first ring was created, and at the time the snapshot was taken. These
+  /// two pairs allow converting the raw ticks to time.
+  std::uint64_t BaseTick, BaseNanos, SnapTick, SnapNanos;
+  std::uint32_t RingCount;
+  std::uint32_t Reserved;
+};
+
+struct RingHeader
+{
+  std::uint32_t ThreadID;
+  std::uint32_t Count;
+  std::uint64_t Head;
+};
+
+std::uint64_t monotonicNanos() noexcept
+{
+  ::timespec TS{};
+  ::clock_gettime(CLOCK_MONOTONIC, &TS);
+  return static_cast<std::uint64_t>(TS.tv_sec) * 1'000'000'000ULL +
+         static_cast<std::uint64_t>(TS.tv_nsec);
+}
+
+struct Registry
+{
+  std::mutex Lock;
+  std::atomic<std::size_t> Count = 0;
+  std::array<std::atomic<Ring*>, MaxThreads> Rings{};
+  std::uint64_t BaseTick = 0;
+  std::uint64_t BaseNanos = 0;
+};
+
+/// The registry is intentionally leaked, so the rings remain accessible to
+/// the crash handler even during static destruction.
+Registry& registry() noexcept
+{
+  static auto* R = new Registry{};
+  return *R;
+}
+
+/// Serialises the registered rings through \p Sink, which is called with
+/// \p (const void*, std::size_t) and returns whether the write succeeded.
+template <typename Sink> bool serialise(Sink&& Write) noexcept
+{
+  Registry& Reg = registry();
+  FileHeader H{};
+  std::memcpy(H.Magic, Magic, sizeof(Magic));
+  H.Version = FormatVersion;
+  H.RecordSize = sizeof(Record);
+  H.BaseTick = Reg.BaseTick;
+  H.BaseNanos = Reg.BaseNanos;
+  H.SnapTick = now();
+  H.SnapNanos = monotonicNanos();
+  H.RingCount =
+    static_cast<std::uint32_t>(Reg.Count.load(std::memory_order_acquire));
+  if (!Write(&H, sizeof(H)))
+    return false;
+
+  for (std::size_t I = 0; I < H.RingCount; ++I)
+  {
+    const Ring* R = Reg.Rings.at(I).load(std::memory_order_acquire);
+    RingHeader RH{};
+    std::uint64_t Head = 0;
+    if (R)
+    {
+      Head = R->Head.load(std::memory_order_acquire);
+      RH.ThreadID = R->ThreadID;
+    }
+    RH.Head = Head;
+    RH.Count = static_cast<std::uint32_t>(
+      std::min<std::uint64_t>(Head, Ring::Capacity));
+    if (!Write(&RH, sizeof(RH)))
+      return false;
+    if (!RH.Count)
+      continue;
+
+    // Emit the records oldest first, which is at most two contiguous chunks.
+    std::size_t Begin = (Head - RH.Count) & (Ring::Capacity - 1);
+    std::size_t First = std::min<std::size_t>(RH.Count, Ring::Capacity - Begin);
+    if (!Write(R->Records.data() + Begin, First * sizeof(Record)))
+      return false;
+    if (First < RH.Count &&
+        !Write(R->Records.data(), (RH.Count - First) * sizeof(Record)))
+      return false;
+  }
+  return true;
+}
+
+} // namespace
+
+namespace detail
+{
+
+thread_local Ring* CurrentRing = nullptr;
+
+Ring* registerThread() noexcept
+{
+  static thread_local bool Exhausted = false;
+  if (Exhausted)
+    return nullptr;
+
+  Registry& Reg = registry();
+  std::lock_guard<std::mutex> Guard{Reg.Lock};
+  std::size_t Index = Reg.Count.load(std::memory_order_relaxed);
+  if (Index >= MaxThreads)
+  {
+    Exhausted = true;
+    return nullptr;
+  }
+  if (Index == 0)
+  {
+    Reg.BaseTick = now();
+    Reg.BaseNanos = monotonicNanos();
+  }
+
+  auto* R = new (std::nothrow) Ring{};
+  if (!R)
+  {
+    Exhausted = true;
+    return nullptr;
+  }
+  R->ThreadID = static_cast<std::uint32_t>(::syscall(SYS_gettid));
+  Reg.Rings.at(Index).store(R, std::memory_order_release);
+  Reg.Count.store(Index + 1, std::memory_order_release);
+  CurrentRing = R;
+  return R;
+}
+
+} // namespace detail
+
+std::string snapshot()
+{
+  std::string Result;
+  serialise([&Result](const void* Data, std::size_t Size) {
+    Result.append(reinterpret_cast<const char*>(Data), Size);
+    return true;
+  });
+  return Result;
+}
+
+bool writeSnapshot(fd::raw_fd FD) noexcept
+{
+  return serialise([FD](const void* Data, std::size_t Size) {
+    const auto* Ptr = reinterpret_cast<const char*>(Data);
+    while (Size)
+    {
+      auto Written = ::write(FD, Ptr, Size);
+      if (Written == -1 && errno == EINTR)
+        continue;
+      if (Written <= 0)
+        return false;
+      Ptr += Written;
+      Size -= static_cast<std::size_t>(Written);
+    }
+    return true;
+  });
+}
+
+bool decode(std::string_view Data, std::ostream& OS)
+{
+  auto Take = [&Data](void* Into, std::size_t Size) {
+    if (Data.size() < Size)
+      return false;
+    std::memcpy(Into, Data.data(), Size);
+    Data.remove_prefix(Size);
+    return true;
+  };
+
+  FileHeader H{};
+  if (!Take(&H, sizeof(H)) || std::memcmp(H.Magic, Magic, sizeof(Magic)) != 0)
+  {
+    OS << "Not a Monomux trace.\n";
+    return false;
+  }
+  if (H.Version != FormatVersion || H.RecordSize != sizeof(Record))
+  {
+    OS << "Unsupported trace version " << H.Version << " (record size "
+       << H.RecordSize << ").\n";
+    return false;
+  }
+
+  // Convert raw ticks to nanoseconds relative to the snapshot.
+  long double NanosPerTick = 1.0L;
+  if (H.SnapTick > H.BaseTick && H.SnapNanos > H.BaseNanos)
+    NanosPerTick = static_cast<long double>(H.SnapNanos - H.BaseNanos) /
+                   static_cast<long double>(H.SnapTick - H.BaseTick);
+  auto ToNanos = [&H, NanosPerTick](std::uint64_t Tick) -> long double {
+    return (static_cast<long double>(Tick) -
+            static_cast<long double>(H.SnapTick)) *
+           NanosPerTick;
+  };
+
+  struct Entry
+  {
+    long double Nanos;
+    std::uint32_t ThreadID;
+    Record Rec;
+  };
+  std::vector<Entry> Entries;
+
+  OS << "Trace of " << H.RingCount << " thread(s).\n";
+  for (std::uint32_t I = 0; I < H.RingCount; ++I)
+  {
+    RingHeader RH{};
+    if (!Take(&RH, sizeof(RH)))
+    {
+      OS << "Truncated trace.\n";
+      return false;
+    }
+    OS << "  Thread " << RH.ThreadID << ": " << RH.Head << " events, "
+       << RH.Count << " retained.\n";
+
+    for (std::uint32_t J = 0; J < RH.Count; ++J)
+    {
+      Entry E{};
+      if (!Take(&E.Rec, sizeof(Record)))
+      {
+        OS << "Truncated trace.\n";
+        return false;
+      }
+      E.Nanos = ToNanos(E.Rec.Tick);
+      E.ThreadID = RH.ThreadID;
+      Entries.emplace_back(E);
+    }
+  }
+
+  std::stable_sort(
+    Entries.begin(), Entries.end(), [](const Entry& L, const Entry& R) {
+      return L.Nanos < R.Nanos;
+    });
+
+  OS << "Time (ms, relative to the dump)  Thread  Event  Payload\n";
+  const auto Flags = OS.flags();
+  for (const Entry& E : Entries)
+  {
+    OS << std::fixed << std::setprecision(6) << std::setw(16)
+       << static_cast<double>(E.Nanos / 1'000'000.0L) << "  " << std::setw(6)
+       << E.ThreadID << "  " << std::left << std::setw(15)
+       << eventName(static_cast<EventID>(E.Rec.Event)) << std::right
+       << " fd=" << E.Rec.FD << " bytes=" << E.Rec.Bytes << " id=" << E.Rec.ID
+       << '\n';
+  }
+  OS.flags(Flags);
+  return true;
+}
+
+} // namespace monomux::trace
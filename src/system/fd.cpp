@@ -25,7 +25,7 @@
 #include "monomux/system/fd.hpp"
 
 #include "monomux/Log.hpp"
-#define LOG(SEVERITY) monomux::log::SEVERITY("system/fd")
+#define LOG(SEVERITY) MONOMUX_LOG(SEVERITY, "system/fd")
 
 namespace monomux
 {
@@ -0,0 +1,60 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "monomux/system/Trace.hpp"
+
+/// A small offline tool that decodes the binary flight recorder traces saved
+/// by a crashing Monomux process or fetched with 'monomux --trace FILE'.
+int main(int ArgC, char* ArgV[])
+{
+  if (ArgC != 2 || std::string{ArgV[1]} == "-h" ||
+      std::string{ArgV[1]} == "--help")
+  {
+    std::cerr << "Usage: " << ArgV[0] << " FILE\n\n"
+              << "Decode a Monomux flight recorder trace into a timeline of "
+                 "events.\n"
+              << "If FILE is '-', the trace is read from the standard input.\n";
+    return ArgC == 2 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  std::string Path = ArgV[1];
+  std::string Data;
+  if (Path == "-")
+    Data.assign(std::istreambuf_iterator<char>{std::cin},
+                std::istreambuf_iterator<char>{});
+  else
+  {
+    std::ifstream File{Path, std::ios::binary};
+    if (!File)
+    {
+      std::cerr << ArgV[0] << ": failed to open '" << Path << "'\n";
+      return EXIT_FAILURE;
+    }
+    Data.assign(std::istreambuf_iterator<char>{File},
+                std::istreambuf_iterator<char>{});
+  }
+
+  return monomux::trace::decode(Data, std::cout) ? EXIT_SUCCESS
+                                                 : EXIT_FAILURE;
+}
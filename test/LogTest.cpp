@@ -0,0 +1,136 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gtest/gtest.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
+
+#include "monomux/Log.hpp"
+
+using namespace monomux;
+
+namespace
+{
+
+std::string readAll(int FD)
+{
+  std::string Ret;
+  char Buf[256]; // NOLINT(readability-magic-numbers)
+  ::ssize_t N;
+  while ((N = ::read(FD, Buf, sizeof(Buf))) > 0)
+    Ret.append(Buf, static_cast<std::size_t>(N));
+  return Ret;
+}
+
+} // namespace
+
+TEST(Logger, SynchronousOutput)
+{
+  std::ostringstream OS;
+  log::Logger L{log::Info, OS};
+  L(log::Info, "test") << "Hello " << 1;
+  L(log::Debug, "test") << "Filtered";
+
+  EXPECT_NE(OS.str().find("test: Hello 1\n"), std::string::npos);
+  EXPECT_EQ(OS.str().find("Filtered"), std::string::npos);
+}
+
+TEST(Logger, AsyncOutputKeepsOrder)
+{
+  int Pipe[2];
+  ASSERT_EQ(::pipe(Pipe), 0);
+
+  std::ostringstream OS;
+  log::Logger L{log::Info, OS};
+  L.startAsync(Pipe[1], 16, log::DropPolicy::Block);
+  EXPECT_TRUE(L.isAsync());
+  for (int I = 0; I < 100; ++I) // NOLINT(readability-magic-numbers)
+    L(log::Info, "test") << "Line " << I;
+  L.stopAsync();
+  EXPECT_FALSE(L.isAsync());
+  ::close(Pipe[1]);
+
+  std::string Out = readAll(Pipe[0]);
+  ::close(Pipe[0]);
+  EXPECT_TRUE(OS.str().empty());
+
+  std::size_t Pos = 0;
+  for (int I = 0; I < 100; ++I) // NOLINT(readability-magic-numbers)
+  {
+    std::size_t Next = Out.find("test: Line " + std::to_string(I) + '\n', Pos);
+    ASSERT_NE(Next, std::string::npos) << I;
+    Pos = Next;
+  }
+  EXPECT_EQ(L.droppedRecords(), 0);
+}
+
+TEST(Logger, DisabledLevelsDoNotEvaluate)
+{
+  std::ostringstream OS;
+  log::Logger::get().setOutput(OS);
+  int Evaluated = 0;
+  auto Count = [&Evaluated] { return ++Evaluated; };
+
+  MONOMUX_LOG(data, "test/Log") << Count();
+  EXPECT_EQ(Evaluated, 0);
+  EXPECT_TRUE(OS.str().empty());
+
+  log::setFacilityLimit("test/Log", log::Data);
+  MONOMUX_LOG(data, "test/Log") << Count();
+  MONOMUX_LOG(data, "test/Other") << Count();
+  EXPECT_EQ(Evaluated, 1);
+  EXPECT_NE(OS.str().find("test/Log: 1\n"), std::string::npos);
+
+  log::setFacilityLimit("test/Log", std::nullopt);
+  MONOMUX_LOG(data, "test/Log") << Count();
+  EXPECT_EQ(Evaluated, 1);
+
+  log::Logger::get().setOutput(std::clog);
+}
+
+TEST(Logger, FacilitiesFollowDefaultLimit)
+{
+  log::Logger& L = log::Logger::get();
+  log::Severity Original = L.getLimit();
+  const log::Facility& Follows = log::facility("test/Follows");
+  const log::Facility& Own = log::facility("test/Own");
+  log::setFacilityLimit("test/Own", log::Error);
+  EXPECT_EQ(&Follows, &log::facility("test/Follows"));
+
+  L.setLimit(log::Trace);
+  EXPECT_EQ(Follows.limit(), log::Trace);
+  EXPECT_FALSE(Follows.hasOwnLimit());
+  EXPECT_EQ(Own.limit(), log::Error);
+  EXPECT_TRUE(Own.hasOwnLimit());
+
+  L.setLimit(Original);
+  EXPECT_EQ(Follows.limit(), Original);
+}
+
+TEST(Logger, UnknownFacilityIsNotCreated)
+{
+  auto Count = [] { return log::facilities().size(); };
+  std::size_t Before = Count();
+  EXPECT_FALSE(log::setFacilityLimit("test/Misspelt", log::Trace));
+  EXPECT_FALSE(log::setFacilityLimit("test/Misspelt", std::nullopt));
+  EXPECT_EQ(Count(), Before);
+}
@@ -0,0 +1,98 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "monomux/adt/BoundedQueue.hpp"
+
+using namespace monomux;
+
+TEST(BoundedQueue, FIFOAndCapacity)
+{
+  BoundedQueue<int> Q{3};
+  EXPECT_EQ(Q.capacity(), 4);
+
+  for (int I = 0; I < 4; ++I)
+    EXPECT_TRUE(Q.tryPush(int{I}));
+  EXPECT_FALSE(Q.tryPush(4));
+  EXPECT_EQ(Q.sizeApprox(), 4);
+
+  int V = -1;
+  for (int I = 0; I < 4; ++I)
+  {
+    ASSERT_TRUE(Q.tryPop(V));
+    EXPECT_EQ(V, I);
+  }
+  EXPECT_FALSE(Q.tryPop(V));
+  EXPECT_EQ(V, 3);
+
+  // Wrap around.
+  EXPECT_TRUE(Q.tryPush(5)); // NOLINT(readability-magic-numbers)
+  ASSERT_TRUE(Q.tryPop(V));
+  EXPECT_EQ(V, 5);
+}
+
+TEST(BoundedQueue, FailedPushKeepsValue)
+{
+  BoundedQueue<std::string> Q{2};
+  EXPECT_TRUE(Q.tryPush("A"));
+  EXPECT_TRUE(Q.tryPush("B"));
+
+  std::string C = "C";
+  EXPECT_FALSE(Q.tryPush(std::move(C)));
+  EXPECT_EQ(C, "C"); // NOLINT(bugprone-use-after-move)
+}
+
+TEST(BoundedQueue, ConcurrentProducers)
+{
+  static constexpr std::size_t Producers = 4;
+  static constexpr std::size_t PerProducer = 2000;
+  BoundedQueue<std::size_t> Q{256}; // NOLINT(readability-magic-numbers)
+
+  std::vector<std::thread> Threads;
+  for (std::size_t P = 0; P < Producers; ++P)
+    Threads.emplace_back([&Q, P] {
+      for (std::size_t I = 0; I < PerProducer; ++I)
+        while (!Q.tryPush(P * PerProducer + I))
+          std::this_thread::yield();
+    });
+
+  // Every element must arrive exactly once, and the elements of a single
+  // producer in order.
+  std::vector<std::size_t> Last(Producers, 0);
+  std::vector<bool> Seen(Producers * PerProducer, false);
+  for (std::size_t Received = 0; Received < Producers * PerProducer;)
+  {
+    std::size_t V;
+    if (!Q.tryPop(V))
+      continue;
+    ++Received;
+
+    ASSERT_FALSE(Seen.at(V));
+    Seen.at(V) = true;
+    std::size_t P = V / PerProducer;
+    EXPECT_GE(V % PerProducer, Last.at(P));
+    Last.at(P) = V % PerProducer;
+  }
+
+  for (std::thread& T : Threads)
+    T.join();
+}
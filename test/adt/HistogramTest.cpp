@@ -0,0 +1,90 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gtest/gtest.h>
+
+#include "monomux/adt/Histogram.hpp"
+
+using namespace monomux;
+
+TEST(LogLinearHistogram, BucketsAreContiguous)
+{
+  using H = LogLinearHistogram<2, 10>;
+  for (std::size_t I = 0; I < H::BucketCount; ++I)
+  {
+    EXPECT_EQ(H::bucketIndex(H::bucketLowerBound(I)), I);
+    EXPECT_EQ(H::bucketIndex(H::bucketUpperBound(I)), I);
+    if (I + 1 < H::BucketCount)
+    {
+      EXPECT_EQ(H::bucketUpperBound(I) + 1, H::bucketLowerBound(I + 1));
+    }
+  }
+  EXPECT_EQ(H::bucketUpperBound(H::BucketCount - 1), H::MaxValue);
+  EXPECT_EQ(H::bucketIndex(H::MaxValue + 1), H::BucketCount - 1);
+}
+
+TEST(LogLinearHistogram, SmallValuesAreExact)
+{
+  LogLinearHistogram<3, 20> H;
+  for (unsigned V = 0; V < 8; ++V)
+    EXPECT_EQ(H.bucketLowerBound(H.bucketIndex(V)), V);
+
+  H.record(1);
+  H.record(2);
+  H.record(2);
+  H.record(7);
+  EXPECT_EQ(H.count(), 4);
+  EXPECT_EQ(H.sum(), 12);
+  EXPECT_EQ(H.max(), 7);
+  EXPECT_EQ(H.quantile(0.5), 2);
+  EXPECT_EQ(H.quantile(1.0), 7);
+}
+
+TEST(LogLinearHistogram, QuantilesWithinRelativeError)
+{
+  LatencyHistogram H;
+  for (std::uint64_t V = 1; V <= 100000; ++V) // NOLINT
+    H.record(V * 1000);                       // NOLINT
+
+  const auto Near = [](std::uint64_t Actual, std::uint64_t Expected) {
+    EXPECT_GE(Actual, Expected);
+    EXPECT_LE(Actual, Expected + Expected / 8);
+  };
+  Near(H.quantile(0.5), 50000 * 1000);  // NOLINT
+  Near(H.quantile(0.99), 99000 * 1000); // NOLINT
+  EXPECT_EQ(H.quantile(1.0), H.max());
+}
+
+TEST(LogLinearHistogram, Reset)
+{
+  LatencyHistogram H;
+  H.record(1);
+  H.record(1ULL << 40); // Clamped.
+  EXPECT_EQ(H.count(), 2);
+  EXPECT_EQ(H.bucket(LatencyHistogram::BucketCount - 1), 1);
+
+  std::size_t NonEmpty = 0;
+  H.forEachBucket([&NonEmpty](std::size_t, auto) { ++NonEmpty; });
+  EXPECT_EQ(NonEmpty, 2);
+
+  H.reset();
+  EXPECT_TRUE(H.empty());
+  EXPECT_EQ(H.max(), 0);
+  EXPECT_EQ(H.quantile(0.5), 0);
+  EXPECT_EQ(H.bucket(LatencyHistogram::BucketCount - 1), 0);
+}
@@ -0,0 +1,104 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "monomux/adt/PagedIndexMap.hpp"
+
+using namespace monomux;
+
+static constexpr std::size_t Magic4 = 4;
+static constexpr std::size_t Magic5 = 5;
+static constexpr std::size_t Magic64 = 64;
+static constexpr std::size_t Magic50000 = 50000;
+
+TEST(PagedIndexMap, SetGetErase)
+{
+  PagedIndexMap<int, Magic4> M;
+  ASSERT_TRUE(M.empty());
+  EXPECT_EQ(M.pageCount(), 0);
+  EXPECT_EQ(M.tryGet(0), nullptr);
+  EXPECT_THROW(M.get(Magic50000), std::out_of_range);
+
+  M[0] = 1;
+  M[1] = 0; // The default value is a valid mapped element.
+  M.set(Magic5, 2);
+  ASSERT_EQ(M.size(), 3);
+  EXPECT_EQ(M.pageCount(), 2);
+  EXPECT_TRUE(M.contains(1));
+  EXPECT_FALSE(M.contains(2));
+  EXPECT_EQ(M.get(0), 1);
+  EXPECT_EQ(M.get(1), 0);
+  EXPECT_EQ(*M.tryGet(Magic5), 2);
+
+  M.set(Magic50000, 3);
+  EXPECT_EQ(M.size(), 4);
+  EXPECT_EQ(M.pageCount(), 3);
+  EXPECT_EQ(M.get(Magic50000), 3);
+
+  M.erase(Magic50000);
+  M.erase(Magic50000);
+  EXPECT_EQ(M.size(), 3);
+  EXPECT_EQ(M.pageCount(), 2);
+  EXPECT_EQ(M.tryGet(Magic50000), nullptr);
+
+  M.erase(Magic5);
+  EXPECT_EQ(M.pageCount(), 1);
+  M.erase(0);
+  EXPECT_EQ(M.size(), 1);
+  EXPECT_EQ(M.pageCount(), 1);
+}
+
+TEST(PagedIndexMap, ClearKeepsPages)
+{
+  PagedIndexMap<std::string, Magic4> M;
+  M[1] = "foo";
+  M[Magic64] = "bar";
+  EXPECT_EQ(M.pageCount(), 2);
+
+  M.clear();
+  EXPECT_TRUE(M.empty());
+  EXPECT_EQ(M.pageCount(), 2);
+  EXPECT_EQ(M.tryGet(1), nullptr);
+  EXPECT_EQ(M[1], "");
+  EXPECT_EQ(M.size(), 1);
+}
+
+TEST(PagedIndexMap, ForEachInKeyOrder)
+{
+  PagedIndexMap<int, Magic4> M;
+  for (std::size_t K : {Magic64, Magic5, std::size_t{0}, Magic50000})
+    M[K] = static_cast<int>(K);
+
+  std::vector<std::pair<std::size_t, int>> Seen;
+  M.forEach([&Seen](std::size_t K, int& V) {
+    Seen.emplace_back(K, V);
+    V = -V;
+  });
+
+  ASSERT_EQ(Seen.size(), 4);
+  EXPECT_EQ(Seen[0].first, 0);
+  EXPECT_EQ(Seen[1].first, Magic5);
+  EXPECT_EQ(Seen[2].first, Magic64);
+  EXPECT_EQ(Seen[3].first, Magic50000);
+  EXPECT_EQ(M.get(Magic64), -static_cast<int>(Magic64));
+}
@@ -17,6 +17,9 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <string>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "monomux/adt/RingBuffer.hpp"
@@ -247,3 +250,72 @@ TEST(RingBuffer, PeekAndDrop)
   EXPECT_EQ(RB[0], 3);
   EXPECT_EQ(RB[1], 4);
 }
+
+TEST(RingBuffer, CapacityIsPowerOfTwo)
+{
+  RingBuffer<int> RB(static_cast<std::size_t>(5));
+  EXPECT_EQ(RB.capacity(), 8);
+  EXPECT_EQ(RB.originalCapacity(), 8);
+
+  RingBuffer<int> Three = {1, 2, 3};
+  EXPECT_EQ(Three.capacity(), 4);
+  EXPECT_EQ(Three[2], 3);
+}
+
+TEST(RingBuffer, BulkAccessOverPhysicalEnd)
+{
+  RingBuffer<char> RB(static_cast<std::size_t>(8));
+  RB.putBack(std::vector<char>{'x', 'x', 'x', 'x', 'x', 'x'});
+  RB.dropFront(5);
+  // [-, -, -, -, -, *x, -, -]
+
+  RB.putBack(std::vector<char>{'a', 'b', 'c', 'd', 'e'});
+  // [c, d, e, -, -, *x, a, b]
+  EXPECT_EQ(RB.capacity(), 8);
+  EXPECT_EQ(RB.size(), 6);
+  EXPECT_EQ(RB.back(), 'e');
+
+  std::vector<char> V = RB.peekFront(4);
+  EXPECT_EQ(std::string(V.begin(), V.end()), "xabc");
+  EXPECT_EQ(RB.size(), 6);
+
+  V = RB.takeFront(6);
+  EXPECT_EQ(std::string(V.begin(), V.end()), "xabcde");
+  EXPECT_TRUE(RB.empty());
+}
+
+TEST(RingBuffer, GrowWhileWrapped)
+{
+  RingBuffer<std::string> RB(static_cast<std::size_t>(4));
+  RB.putBack(std::vector<std::string>{"0", "1", "2"});
+  RB.dropFront(2);
+  RB.putBack(std::vector<std::string>{"3", "4", "5"});
+  // [4, 5, *2, 3]
+  EXPECT_EQ(RB.capacity(), 4);
+
+  std::vector<std::string> V = RB.peekFront(2);
+  EXPECT_EQ(V[0], "2");
+  EXPECT_EQ(V[1], "3");
+  // Peeking must not move the elements out of the buffer.
+  EXPECT_EQ(RB[0], "2");
+
+  RB.push_back("6");
+  // [*2, 3, 4, 5, 6, -, -, -]
+  EXPECT_EQ(RB.capacity(), 8);
+  V = RB.takeFront(5);
+  EXPECT_EQ(V, (std::vector<std::string>{"2", "3", "4", "5", "6"}));
+}
+
+TEST(RingBuffer, NoTracking)
+{
+  RingBuffer<int, detail::RingBufferNoTracking> RB = {1, 2};
+  RB.putBack({3, 4, 5});
+  EXPECT_EQ(RB.capacity(), 8);
+  EXPECT_EQ(RB.maxPeak(), 0);
+  EXPECT_TRUE(RB.peakStats().empty());
+
+  std::vector<int> V = RB.takeFront(5);
+  EXPECT_EQ(V, (std::vector<int>{1, 2, 3, 4, 5}));
+  // Without tracking, a grown buffer is never shrunk automatically.
+  EXPECT_EQ(RB.capacity(), 8);
+}
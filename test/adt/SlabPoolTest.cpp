@@ -0,0 +1,151 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include "monomux/adt/SlabPool.hpp"
+
+using namespace monomux;
+
+TEST(SlabPool, EmplaceGetErase)
+{
+  SlabPool<std::string, 4> P;
+  EXPECT_TRUE(P.empty());
+
+  auto H1 = P.emplace("Hello");
+  auto H2 = P.emplace(3, 'x');
+  EXPECT_EQ(P.size(), 2);
+  ASSERT_NE(P.get(H1), nullptr);
+  ASSERT_NE(P.get(H2), nullptr);
+  EXPECT_EQ(*P.get(H1), "Hello");
+  EXPECT_EQ(*P.get(H2), "xxx");
+
+  P.erase(H1);
+  EXPECT_EQ(P.size(), 1);
+  EXPECT_EQ(P.get(H1), nullptr);
+  EXPECT_EQ(*P.get(H2), "xxx");
+
+  // Erasing a stale handle is a no-op.
+  P.erase(H1);
+  EXPECT_EQ(P.size(), 1);
+}
+
+TEST(SlabPool, StaleHandleAfterReuse)
+{
+  SlabPool<int, 4> P;
+  auto H1 = P.emplace(1);
+  P.erase(H1);
+
+  auto H2 = P.emplace(2);
+  // The slot is reused, but the old handle must not resolve to the new object.
+  EXPECT_EQ(H1.index(), H2.index());
+  EXPECT_NE(H1, H2);
+  EXPECT_EQ(P.get(H1), nullptr);
+  ASSERT_NE(P.get(H2), nullptr);
+  EXPECT_EQ(*P.get(H2), 2);
+
+  EXPECT_EQ(P.statistics().Constructions, 2);
+  EXPECT_EQ(P.statistics().Reuses, 1);
+  EXPECT_EQ(P.statistics().Slabs, 1);
+}
+
+TEST(SlabPool, GrowsInSlabsWithStableAddresses)
+{
+  SlabPool<int, 4> P;
+  std::vector<PoolHandle<int>> Handles;
+  std::vector<int*> Addresses;
+  for (int I = 0; I < 10; ++I)
+  {
+    Handles.emplace_back(P.emplace(I));
+    Addresses.emplace_back(P.get(Handles.back()));
+  }
+
+  EXPECT_EQ(P.size(), 10);
+  EXPECT_EQ(P.statistics().Slabs, 3);
+  EXPECT_EQ(P.statistics().Capacity, 12);
+  for (int I = 0; I < 10; ++I)
+  {
+    EXPECT_EQ(P.get(Handles[I]), Addresses[I]);
+    EXPECT_EQ(*Addresses[I], I);
+    EXPECT_EQ(P.handleOf(*Addresses[I]), Handles[I]);
+  }
+}
+
+TEST(SlabPool, TaggedHandles)
+{
+  SlabPool<int> P;
+  auto H = P.emplace(4);
+  PoolHandle<int, 2> Tagged{H};
+  EXPECT_EQ(Tagged.kind(), 2);
+  ASSERT_NE(P.get(Tagged), nullptr);
+  EXPECT_EQ(*P.get(Tagged), 4);
+
+  P.erase(Tagged);
+  EXPECT_EQ(P.get(H), nullptr);
+  EXPECT_TRUE(P.empty());
+}
+
+TEST(SlabPool, ClearDestroysObjects)
+{
+  SlabPool<std::string, 2> P;
+  auto H1 = P.emplace("A");
+  auto H2 = P.emplace("B");
+  auto H3 = P.emplace("C");
+  P.clear();
+  EXPECT_TRUE(P.empty());
+  EXPECT_EQ(P.get(H1), nullptr);
+  EXPECT_EQ(P.get(H2), nullptr);
+  EXPECT_EQ(P.get(H3), nullptr);
+  EXPECT_EQ(P.statistics().Slabs, 2);
+}
+
+TEST(SlabPool, MoveTransfersObjects)
+{
+  auto Counter = std::make_shared<int>(0);
+  SlabPool<std::shared_ptr<int>, 2> P;
+  auto H1 = P.emplace(Counter);
+  auto H2 = P.emplace(Counter);
+  auto H3 = P.emplace(Counter);
+  const std::shared_ptr<int>* Address = P.get(H3);
+  EXPECT_EQ(Counter.use_count(), 4);
+
+  SlabPool<std::shared_ptr<int>, 2> Q{std::move(P)};
+  EXPECT_TRUE(P.empty()); // NOLINT(bugprone-use-after-move)
+  EXPECT_EQ(P.statistics().Capacity, 0);
+  EXPECT_EQ(P.get(H1), nullptr);
+  EXPECT_EQ(Q.size(), 3);
+  EXPECT_EQ(Q.get(H3), Address);
+  EXPECT_EQ(Counter.use_count(), 4);
+
+  // The moved-from pool is usable again.
+  auto H4 = P.emplace(Counter);
+  EXPECT_EQ(Counter.use_count(), 5);
+
+  // Assignment destroys the objects of the destination.
+  Q = std::move(P);
+  EXPECT_EQ(Counter.use_count(), 2);
+  EXPECT_EQ(Q.size(), 1);
+  EXPECT_NE(Q.get(H4), nullptr);
+  EXPECT_EQ(Q.get(H2), nullptr);
+
+  Q = SlabPool<std::shared_ptr<int>, 2>{};
+  EXPECT_EQ(Counter.use_count(), 1);
+}
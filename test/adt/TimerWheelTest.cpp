@@ -0,0 +1,177 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "monomux/adt/TimerWheel.hpp"
+
+using namespace monomux;
+using namespace std::chrono_literals;
+
+using Clock = TimerWheel::Clock;
+
+static const Clock::time_point Epoch{};
+
+TEST(TimerWheel, FiresInDeadlineOrder)
+{
+  TimerWheel W{1ms, Epoch};
+  std::vector<int> Order;
+  W.arm(Epoch + 30ms, [&Order] { Order.push_back(3); });
+  W.arm(Epoch + 10ms, [&Order] { Order.push_back(1); });
+  W.arm(Epoch + 20ms, [&Order] { Order.push_back(2); });
+  ASSERT_EQ(W.size(), 3);
+  EXPECT_EQ(W.nextExpiry(), Epoch + 10ms);
+
+  EXPECT_EQ(W.advance(Epoch + 9ms), 0);
+  EXPECT_TRUE(Order.empty());
+  EXPECT_EQ(W.advance(Epoch + 20ms), 2);
+  EXPECT_EQ(Order, (std::vector<int>{1, 2}));
+  EXPECT_EQ(W.advance(Epoch + 1h), 1);
+  EXPECT_EQ(Order, (std::vector<int>{1, 2, 3}));
+  EXPECT_TRUE(W.empty());
+  EXPECT_EQ(W.nextExpiry(), std::nullopt);
+}
+
+TEST(TimerWheel, Cancel)
+{
+  TimerWheel W{1ms, Epoch};
+  int Fired = 0;
+  TimerWheel::Timer T = W.arm(Epoch + 5ms, [&Fired] { ++Fired; });
+  TimerWheel::Timer U = W.arm(Epoch + 5ms, [&Fired] { ++Fired; });
+  EXPECT_TRUE(W.isArmed(T));
+  EXPECT_TRUE(W.cancel(T));
+  EXPECT_FALSE(W.isArmed(T));
+  EXPECT_FALSE(W.cancel(T));
+
+  // The node of the cancelled timer is reused, but the old handle must not
+  // match it.
+  TimerWheel::Timer Stale = U;
+  EXPECT_TRUE(W.cancel(U));
+  TimerWheel::Timer V = W.arm(Epoch + 5ms, [&Fired] { Fired += 10; });
+  EXPECT_FALSE(W.isArmed(Stale));
+  EXPECT_FALSE(W.cancel(Stale));
+  EXPECT_TRUE(W.isArmed(V));
+
+  W.advance(Epoch + 1s);
+  EXPECT_EQ(Fired, 10);
+  EXPECT_FALSE(W.isArmed(V));
+}
+
+TEST(TimerWheel, NeverFiresEarly)
+{
+  TimerWheel W{10ms, Epoch};
+  bool Fired = false;
+  W.arm(Epoch + 15ms, [&Fired] { Fired = true; });
+  EXPECT_EQ(W.nextExpiry(), Epoch + 20ms);
+  W.advance(Epoch + 19ms);
+  EXPECT_FALSE(Fired);
+  W.advance(Epoch + 20ms);
+  EXPECT_TRUE(Fired);
+}
+
+TEST(TimerWheel, CascadesOverLevels)
+{
+  TimerWheel W{1ms, Epoch};
+  std::mt19937_64 Rng{0};
+  std::uniform_int_distribution<std::int64_t> Delay{0, 20'000'000};
+  static constexpr int TimerCount = 2000;
+
+  Clock::time_point Now = Epoch;
+  std::vector<std::pair<Clock::time_point, Clock::time_point>> Fires;
+  for (int I = 0; I < TimerCount; ++I)
+  {
+    // Arm some at odd offsets into the wheel's timeline.
+    if (I % 100 == 0) // NOLINT(readability-magic-numbers)
+    {
+      Now += std::chrono::milliseconds{Delay(Rng) / 100};
+      W.advance(Now);
+    }
+    const Clock::time_point At = Now + std::chrono::milliseconds{Delay(Rng)};
+    W.arm(At, [&Fires, &Now, At] { Fires.emplace_back(At, Now); });
+  }
+  for (const auto& [At, FiredAt] : Fires)
+    EXPECT_LE(At, FiredAt);
+  const std::size_t FiredWhileArming = Fires.size();
+  Fires.clear();
+
+  // Step from deadline to deadline: every timer must fire at the step that
+  // reaches it.
+  while (!W.empty())
+  {
+    std::optional<Clock::time_point> Next = W.nextExpiry();
+    ASSERT_TRUE(Next.has_value());
+    ASSERT_GE(*Next, Now);
+    Now = *Next;
+    W.advance(Now);
+  }
+  EXPECT_EQ(FiredWhileArming + Fires.size(), TimerCount);
+  for (const auto& [At, FiredAt] : Fires)
+    EXPECT_EQ(At, FiredAt);
+}
+
+TEST(TimerWheel, ArmFromCallback)
+{
+  TimerWheel W{1ms, Epoch};
+  int Count = 0;
+  std::function<void()> Rearm = [&] {
+    if (++Count < 3)
+      W.arm(Epoch, Rearm); // In the past: fires at the next advance().
+  };
+  W.arm(Epoch + 1ms, Rearm);
+
+  W.advance(Epoch + 1ms);
+  EXPECT_EQ(Count, 1);
+  W.advance(Epoch + 2ms);
+  EXPECT_EQ(Count, 2);
+  W.advance(Epoch + 3ms);
+  EXPECT_EQ(Count, 3);
+  EXPECT_TRUE(W.empty());
+
+  // A timer 64 ticks away lands in the slot being fired, but must wait.
+  bool Late = false;
+  W.arm(Epoch + 10ms, [&] { W.arm(Epoch + 74ms, [&Late] { Late = true; }); });
+  W.advance(Epoch + 10ms);
+  EXPECT_FALSE(Late);
+  W.advance(Epoch + 73ms);
+  EXPECT_FALSE(Late);
+  W.advance(Epoch + 74ms);
+  EXPECT_TRUE(Late);
+}
+
+TEST(TimerWheel, BeyondRange)
+{
+  TimerWheel W{1ms, Epoch};
+  bool Fired = false;
+  const auto Far = Epoch + std::chrono::hours{24 * 30};
+  W.arm(Far, [&Fired] { Fired = true; });
+
+  Clock::time_point Now = Epoch;
+  while (!Fired)
+  {
+    Now = *W.nextExpiry();
+    ASSERT_LE(Now, Far);
+    W.advance(Now);
+  }
+  EXPECT_EQ(Now, Far);
+}
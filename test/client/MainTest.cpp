@@ -0,0 +1,71 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "monomux/control/Message.hpp"
+#include "monomux/control/PascalString.hpp"
+#include "monomux/system/Socket.hpp"
+
+#include "monomux/client/Main.hpp"
+
+using namespace monomux;
+using namespace monomux::client;
+
+static std::string socketPath(const char* Name)
+{
+  return "/tmp/monomux-test-" + std::to_string(::getpid()) + '-' + Name;
+}
+
+TEST(ClientMain, ListensOnAFreeSocket)
+{
+  Options Opts;
+  Opts.SocketPath = socketPath("free");
+  std::string FailureReason;
+  std::optional<Socket> Listener = listenForServer(Opts, 4, &FailureReason);
+  ASSERT_TRUE(Listener) << FailureReason;
+  EXPECT_TRUE(Listener->listening());
+  EXPECT_FALSE(Opts.Connection);
+}
+
+TEST(ClientMain, ConnectsToTheServerThatBoundFirst)
+{
+  Options Opts;
+  Opts.SocketPath = socketPath("race");
+
+  // Another client bound the socket between the failed connection attempt of
+  // this one and its own bind.
+  Socket Winner = Socket::create(*Opts.SocketPath);
+  Winner.listen(4);
+  std::thread Server{[&Winner] {
+    std::optional<Socket> Client = Winner.accept();
+    ASSERT_TRUE(Client);
+    using namespace monomux::message;
+    sendMessage(*Client, notification::Connection{{true}, {}});
+  }};
+
+  std::string FailureReason;
+  std::optional<Socket> Listener = listenForServer(Opts, 4, &FailureReason);
+  Server.join();
+  EXPECT_FALSE(Listener);
+  EXPECT_TRUE(Opts.Connection) << FailureReason;
+}
@@ -280,6 +280,43 @@ TEST(ControlMessageSerialisation, AttachResponse)
   }
 }
 
+TEST(ControlMessageSerialisation, AttachResume)
+{
+  monomux::message::request::Attach Req;
+  Req.Name = "Foo";
+  Req.ResumeToken = 42;
+  Req.ResumeOffset = 1024;
+
+  EXPECT_EQ(encode(Req),
+            "<ATTACH><NAME>Foo</NAME><RESUME>42 1024</RESUME></ATTACH>");
+  {
+    auto Decode = codec(Req);
+    EXPECT_EQ(Decode.Name, "Foo");
+    EXPECT_EQ(Decode.ResumeToken, 42);
+    EXPECT_EQ(Decode.ResumeOffset, 1024);
+  }
+
+  monomux::message::response::Attach Resp;
+  Resp.Success = true;
+  Resp.Session.Name = "Foo";
+  Resp.StreamToken = 42;
+  Resp.Offset = 512;
+  {
+    auto Decode = codec(Resp);
+    EXPECT_TRUE(Decode.Success);
+    EXPECT_EQ(Decode.Session.Name, "Foo");
+    EXPECT_EQ(Decode.StreamToken, 42);
+    EXPECT_EQ(Decode.Offset, 512);
+  }
+
+  Resp.StreamToken = 0;
+  {
+    auto Decode = codec(Resp);
+    EXPECT_EQ(Decode.StreamToken, 0);
+    EXPECT_EQ(Decode.Offset, 0);
+  }
+}
+
 TEST(ControlMessageSerialisation, DetachRequest)
 {
   using namespace monomux::message::request;
@@ -357,6 +394,13 @@ TEST(ControlMessageSerialisation, RedrawNotification)
   }
 }
 
+TEST(ControlMessageSerialisation, KeepaliveNotification)
+{
+  monomux::message::notification::Keepalive Obj;
+  EXPECT_EQ(encode(Obj), "<KEEPALIVE />");
+  EXPECT_TRUE(monomux::message::notification::Keepalive::decode(encode(Obj)));
+}
+
 TEST(ControlMessageSerialisation, StatisticsRequest)
 {
   monomux::message::request::Statistics Obj;
@@ -374,3 +418,315 @@ TEST(ControlMessageSerialisation, StatisticsResponse)
     EXPECT_EQ(Decode.Contents, Obj.Contents);
   }
 }
+
+TEST(ControlMessageSerialisation, MetricsRequest)
+{
+  monomux::message::request::Metrics Obj;
+  EXPECT_EQ(encode(Obj), "<SEND-METRICS />");
+  EXPECT_TRUE(codec(Obj).Session.empty());
+
+  Obj.Session = "Foo";
+  EXPECT_EQ(encode(Obj), "<SEND-METRICS Size=\"3\">Foo</SEND-METRICS>");
+  EXPECT_EQ(codec(Obj).Session, Obj.Session);
+}
+
+TEST(ControlMessageSerialisation, MetricsResponse)
+{
+  using monomux::message::BufferMetrics;
+  using monomux::message::ClientMetrics;
+  using monomux::message::SessionMetrics;
+  monomux::message::response::Metrics Obj;
+  Obj.LoopIterations = 100; // NOLINT(readability-magic-numbers)
+  Obj.ClientsKicked = 1;
+  Obj.Overflows = 2;
+  Obj.ClientCount = 3;
+  Obj.SessionCount = 1;
+  Obj.ChannelBuffers = 4;
+  Obj.ChannelBufferBytes = 32768; // NOLINT(readability-magic-numbers)
+
+  {
+    auto Decode = codec(Obj);
+    EXPECT_EQ(encode(Obj),
+              "<METRICS><N>100 1 2 3 1 4 32768 0 0</N><H>0 0 0</H>"
+              "<SESSIONS Count=\"0\"></SESSIONS>"
+              "<CLIENTS Count=\"0\"></CLIENTS></METRICS>");
+    EXPECT_EQ(Decode.LoopIterations, Obj.LoopIterations);
+    EXPECT_EQ(Decode.ClientsKicked, Obj.ClientsKicked);
+    EXPECT_EQ(Decode.Overflows, Obj.Overflows);
+    EXPECT_EQ(Decode.ClientCount, Obj.ClientCount);
+    EXPECT_EQ(Decode.SessionCount, Obj.SessionCount);
+    EXPECT_EQ(Decode.ChannelBuffers, Obj.ChannelBuffers);
+    EXPECT_EQ(Decode.ChannelBufferBytes, Obj.ChannelBufferBytes);
+    EXPECT_EQ(Decode.PooledBuffers, Obj.PooledBuffers);
+  }
+
+  SessionMetrics SM;
+  SM.Name = "<S>";
+  SM.BytesIn = 4096; // NOLINT(readability-magic-numbers)
+  SM.BytesOut = 8;   // NOLINT(readability-magic-numbers)
+  SM.AttachedClients = 1;
+  SM.Reader = BufferMetrics{0, 16384, 0}; // NOLINT(readability-magic-numbers)
+  SM.Writer = BufferMetrics{1, 16384, 2}; // NOLINT(readability-magic-numbers)
+  Obj.Sessions.emplace_back(SM);
+
+  ClientMetrics CM;
+  CM.ID = 7; // NOLINT(readability-magic-numbers)
+  CM.Session = SM.Name;
+  CM.BytesIn = 8;     // NOLINT(readability-magic-numbers)
+  CM.BytesOut = 4096; // NOLINT(readability-magic-numbers)
+  CM.Overflows = 2;
+  CM.WriteQueue.Count = 3;
+  CM.WriteQueue.Sum = 30;  // NOLINT(readability-magic-numbers)
+  CM.WriteQueue.Max = 12;  // NOLINT(readability-magic-numbers)
+  CM.WriteQueue.Buckets = {{8, 2}, {10, 1}}; // NOLINT
+  Obj.Clients.emplace_back(CM);
+  Obj.Clients.emplace_back(ClientMetrics{});
+  Obj.LoopIteration.Count = 1;
+  Obj.LoopIteration.Sum = 5; // NOLINT(readability-magic-numbers)
+  Obj.LoopIteration.Max = 5; // NOLINT(readability-magic-numbers)
+  Obj.LoopIteration.Buckets = {{5, 1}}; // NOLINT
+
+  {
+    auto Decode = codec(Obj);
+    EXPECT_EQ(encode(Obj),
+              "<METRICS><N>100 1 2 3 1 4 32768 0 0</N><H>1 5 5 5 1</H>"
+              "<SESSIONS Count=\"1\">"
+              "<SM Size=\"3\"><S><N>4096 8 0 1</N>"
+              "<BUF>0 16384 0</BUF><BUF>1 16384 2</BUF><H>0 0 0</H></SM>"
+              "</SESSIONS>"
+              "<CLIENTS Count=\"2\">"
+              "<CM Size=\"3\"><S><N>7 8 4096 2</N>"
+              "<BUF>0 0 0</BUF><BUF>0 0 0</BUF>"
+              "<H>0 0 0</H><H>3 30 12 8 2 10 1</H></CM>"
+              "<CM Size=\"0\"><N>0 0 0 0</N>"
+              "<BUF>0 0 0</BUF><BUF>0 0 0</BUF><H>0 0 0</H><H>0 0 0</H></CM>"
+              "</CLIENTS></METRICS>");
+    ASSERT_EQ(Decode.Sessions.size(), 1);
+    EXPECT_EQ(Decode.Sessions.at(0).Name, SM.Name);
+    EXPECT_EQ(Decode.Sessions.at(0).BytesIn, SM.BytesIn);
+    EXPECT_EQ(Decode.Sessions.at(0).BytesOut, SM.BytesOut);
+    EXPECT_EQ(Decode.Sessions.at(0).AttachedClients, SM.AttachedClients);
+    EXPECT_EQ(Decode.Sessions.at(0).Reader.Capacity, SM.Reader.Capacity);
+    EXPECT_EQ(Decode.Sessions.at(0).Writer.Size, SM.Writer.Size);
+    EXPECT_EQ(Decode.Sessions.at(0).Writer.Peak, SM.Writer.Peak);
+
+    ASSERT_EQ(Decode.Clients.size(), 2);
+    EXPECT_EQ(Decode.Clients.at(0).ID, CM.ID);
+    EXPECT_EQ(Decode.Clients.at(0).Session, CM.Session);
+    EXPECT_EQ(Decode.Clients.at(0).BytesIn, CM.BytesIn);
+    EXPECT_EQ(Decode.Clients.at(0).BytesOut, CM.BytesOut);
+    EXPECT_EQ(Decode.Clients.at(0).Overflows, CM.Overflows);
+    EXPECT_TRUE(Decode.Clients.at(1).Session.empty());
+    EXPECT_EQ(Decode.Clients.at(0).ReadToSend.Count, 0);
+    EXPECT_EQ(Decode.Clients.at(0).WriteQueue.Count, CM.WriteQueue.Count);
+    EXPECT_EQ(Decode.Clients.at(0).WriteQueue.Sum, CM.WriteQueue.Sum);
+    EXPECT_EQ(Decode.Clients.at(0).WriteQueue.Max, CM.WriteQueue.Max);
+    EXPECT_EQ(Decode.Clients.at(0).WriteQueue.Buckets, CM.WriteQueue.Buckets);
+    EXPECT_EQ(Decode.LoopIteration.Buckets, Obj.LoopIteration.Buckets);
+  }
+}
+
+TEST(ControlMessageSerialisation, TraceRequest)
+{
+  monomux::message::request::Trace Obj;
+  EXPECT_EQ(encode(Obj), "<SEND-TRACE />");
+  codec(Obj);
+}
+
+TEST(ControlMessageSerialisation, TraceResponse)
+{
+  monomux::message::response::Trace Obj;
+  EXPECT_EQ(encode(Obj), "<TRACE Size=\"0\"></TRACE>");
+  EXPECT_TRUE(codec(Obj).Data.empty());
+
+  Obj.Data = std::string{"MNMX\0\1</TRACE>", 14};
+  EXPECT_EQ(codec(Obj).Data, Obj.Data);
+}
+
+TEST(ControlMessageSerialisation, LogLevelRequest)
+{
+  monomux::message::request::LogLevel Obj;
+  EXPECT_EQ(encode(Obj), "<LOG-LEVEL />");
+  EXPECT_FALSE(codec(Obj).Change);
+
+  Obj.Change = true;
+  Obj.Facility = "server/Server";
+  Obj.Level = -1;
+  EXPECT_EQ(encode(Obj),
+            "<LOG-LEVEL Size=\"13\">server/Server<N>-1</N></LOG-LEVEL>");
+  auto Decode = codec(Obj);
+  EXPECT_TRUE(Decode.Change);
+  EXPECT_EQ(Decode.Facility, Obj.Facility);
+  EXPECT_EQ(Decode.Level, Obj.Level);
+
+  Obj.Facility.clear();
+  Obj.Level = 5; // NOLINT(readability-magic-numbers)
+  EXPECT_EQ(encode(Obj), "<LOG-LEVEL Size=\"0\"><N>5</N></LOG-LEVEL>");
+  EXPECT_EQ(codec(Obj).Level, Obj.Level);
+}
+
+TEST(ControlMessageSerialisation, LogLevelResponse)
+{
+  using monomux::message::FacilityLevel;
+  monomux::message::response::LogLevel Obj;
+  Obj.Success = true;
+  Obj.DefaultLevel = 4; // NOLINT(readability-magic-numbers)
+  EXPECT_EQ(encode(Obj),
+            "<LOG-LEVELS><N>1 4</N><FACILITIES Count=\"0\"></FACILITIES>"
+            "</LOG-LEVELS>");
+
+  Obj.Facilities.emplace_back(FacilityLevel{"a/B", 6, true});
+  Obj.Facilities.emplace_back(FacilityLevel{"c", 4, false});
+  EXPECT_EQ(encode(Obj),
+            "<LOG-LEVELS><N>1 4</N><FACILITIES Count=\"2\">"
+            "<F Size=\"3\">a/B<N>6 1</N></F><F Size=\"1\">c<N>4 0</N></F>"
+            "</FACILITIES></LOG-LEVELS>");
+  auto Decode = codec(Obj);
+  EXPECT_TRUE(Decode.Success);
+  EXPECT_EQ(Decode.DefaultLevel, Obj.DefaultLevel);
+  ASSERT_EQ(Decode.Facilities.size(), 2);
+  EXPECT_EQ(Decode.Facilities.at(0).Name, "a/B");
+  EXPECT_EQ(Decode.Facilities.at(0).Level, 6);
+  EXPECT_TRUE(Decode.Facilities.at(0).Explicit);
+  EXPECT_EQ(Decode.Facilities.at(1).Name, "c");
+  EXPECT_FALSE(Decode.Facilities.at(1).Explicit);
+}
+
+TEST(ControlMessageSerialisation, MakeSessionBatchRequest)
+{
+  monomux::message::request::MakeSessionBatch Obj;
+  EXPECT_EQ(encode(Obj), "<MAKE-SESSIONS Count=\"0\"></MAKE-SESSIONS>");
+  EXPECT_TRUE(codec(Obj).Sessions.empty());
+
+  auto& First = Obj.Sessions.emplace_back();
+  First.Name = "a";
+  First.SpawnOpts.Program = "/bin/sh";
+  auto& Second = Obj.Sessions.emplace_back();
+  Second.SpawnOpts.Program = "</ITEM>";
+  Second.SpawnOpts.Arguments.emplace_back("-c");
+  auto Decode = codec(Obj);
+  ASSERT_EQ(Decode.Sessions.size(), 2);
+  EXPECT_EQ(Decode.Sessions.at(0).Name, "a");
+  EXPECT_EQ(Decode.Sessions.at(0).SpawnOpts.Program, "/bin/sh");
+  EXPECT_TRUE(Decode.Sessions.at(1).Name.empty());
+  EXPECT_EQ(Decode.Sessions.at(1).SpawnOpts.Program, "</ITEM>");
+  ASSERT_EQ(Decode.Sessions.at(1).SpawnOpts.Arguments.size(), 1);
+  EXPECT_EQ(Decode.Sessions.at(1).SpawnOpts.Arguments.at(0), "-c");
+}
+
+TEST(ControlMessageSerialisation, MakeSessionBatchResponse)
+{
+  using monomux::message::SessionResult;
+  monomux::message::response::MakeSessionBatch Obj;
+  Obj.Results.emplace_back(SessionResult{"a", {true}});
+  Obj.Results.emplace_back(SessionResult{"", {false}});
+  EXPECT_EQ(encode(Obj),
+            "<MAKE-SESSIONS Count=\"2\">"
+            "<RESULT><TRUE /><NAME Size=\"1\">a</NAME></RESULT>"
+            "<RESULT><FALSE /><NAME Size=\"0\"></NAME></RESULT>"
+            "</MAKE-SESSIONS>");
+  auto Decode = codec(Obj);
+  ASSERT_EQ(Decode.Results.size(), 2);
+  EXPECT_EQ(Decode.Results.at(0).Name, "a");
+  EXPECT_TRUE(Decode.Results.at(0).Success);
+  EXPECT_TRUE(Decode.Results.at(1).Name.empty());
+  EXPECT_FALSE(Decode.Results.at(1).Success);
+}
+
+TEST(ControlMessageSerialisation, SignalSessionsBatchRequest)
+{
+  monomux::message::request::SignalSessionsBatch Obj;
+  Obj.SigNum = 15; // NOLINT(readability-magic-numbers)
+  Obj.Names = {"a", "</NAME>"};
+  EXPECT_EQ(encode(Obj),
+            "<SIGNAL-SESSIONS Count=\"2\"><SIGNAL>15</SIGNAL>"
+            "<NAME Size=\"1\">a</NAME><NAME Size=\"7\"></NAME></NAME>"
+            "</SIGNAL-SESSIONS>");
+  auto Decode = codec(Obj);
+  EXPECT_EQ(Decode.SigNum, Obj.SigNum);
+  EXPECT_EQ(Decode.Names, Obj.Names);
+}
+
+TEST(ControlMessageSerialisation, SignalSessionsBatchResponse)
+{
+  using monomux::message::SessionResult;
+  monomux::message::response::SignalSessionsBatch Obj;
+  EXPECT_EQ(encode(Obj), "<SIGNAL-SESSIONS Count=\"0\"></SIGNAL-SESSIONS>");
+  EXPECT_TRUE(codec(Obj).Results.empty());
+
+  Obj.Results.emplace_back(SessionResult{"b", {true}});
+  auto Decode = codec(Obj);
+  ASSERT_EQ(Decode.Results.size(), 1);
+  EXPECT_EQ(Decode.Results.at(0).Name, "b");
+  EXPECT_TRUE(Decode.Results.at(0).Success);
+}
+
+TEST(ControlMessageSerialisation, DestroySessionsBatchRequest)
+{
+  monomux::message::request::DestroySessionsBatch Obj;
+  EXPECT_EQ(encode(Obj), "<DESTROY-SESSIONS Count=\"0\"></DESTROY-SESSIONS>");
+  EXPECT_TRUE(codec(Obj).Names.empty());
+
+  Obj.Names = {"1", "", "foo"};
+  EXPECT_EQ(codec(Obj).Names, Obj.Names);
+}
+
+TEST(ControlMessageSerialisation, DestroySessionsBatchResponse)
+{
+  using monomux::message::SessionResult;
+  monomux::message::response::DestroySessionsBatch Obj;
+  Obj.Results.emplace_back(SessionResult{"1", {false}});
+  Obj.Results.emplace_back(SessionResult{"foo", {true}});
+  auto Decode = codec(Obj);
+  ASSERT_EQ(Decode.Results.size(), 2);
+  EXPECT_EQ(Decode.Results.at(0).Name, "1");
+  EXPECT_FALSE(Decode.Results.at(0).Success);
+  EXPECT_EQ(Decode.Results.at(1).Name, "foo");
+  EXPECT_TRUE(Decode.Results.at(1).Success);
+}
+
+TEST(ControlMessageSerialisation, SearchRequest)
+{
+  monomux::message::request::Search Obj;
+  Obj.Pattern = "</PATTERN> error";
+  auto Decode = codec(Obj);
+  EXPECT_EQ(Decode.Pattern, Obj.Pattern);
+  EXPECT_TRUE(Decode.Session.empty());
+  EXPECT_EQ(Decode.Context, 0);
+  EXPECT_EQ(Decode.Limit, 0);
+
+  Obj.Session = "foo";
+  Obj.Context = 2;
+  Obj.Limit = 50;
+  Decode = codec(Obj);
+  EXPECT_EQ(Decode.Pattern, Obj.Pattern);
+  EXPECT_EQ(Decode.Session, "foo");
+  EXPECT_EQ(Decode.Context, 2);
+  EXPECT_EQ(Decode.Limit, 50);
+}
+
+TEST(ControlMessageSerialisation, SearchResponse)
+{
+  using monomux::message::SearchMatch;
+  monomux::message::response::Search Obj;
+  EXPECT_FALSE(codec(Obj).Success);
+  EXPECT_TRUE(codec(Obj).Matches.empty());
+  EXPECT_FALSE(codec(Obj).Truncated);
+
+  Obj.Success = true;
+
+  Obj.Matches.emplace_back(SearchMatch{"foo", 4, "make: error\r\n", 6});
+  Obj.Matches.emplace_back(SearchMatch{"bar", 1ULL << 40, "", 0});
+  Obj.Truncated = true;
+  auto Decode = codec(Obj);
+  ASSERT_EQ(Decode.Matches.size(), 2);
+  EXPECT_EQ(Decode.Matches.at(0).Session, "foo");
+  EXPECT_EQ(Decode.Matches.at(0).Offset, 4);
+  EXPECT_EQ(Decode.Matches.at(0).Context, "make: error\r\n");
+  EXPECT_EQ(Decode.Matches.at(0).Position, 6);
+  EXPECT_EQ(Decode.Matches.at(1).Session, "bar");
+  EXPECT_EQ(Decode.Matches.at(1).Offset, 1ULL << 40);
+  EXPECT_TRUE(Decode.Matches.at(1).Context.empty());
+  EXPECT_TRUE(Decode.Success);
+  EXPECT_TRUE(Decode.Truncated);
+}
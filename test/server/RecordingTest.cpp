@@ -0,0 +1,191 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "monomux/server/Recording.hpp"
+
+using namespace monomux::server;
+using Clock = Recorder::Clock;
+
+namespace
+{
+
+class RecordingTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    std::string Template =
+      (std::filesystem::temp_directory_path() / "monomux-rec-XXXXXX").string();
+    ASSERT_NE(::mkdtemp(Template.data()), nullptr);
+    Directory = Template;
+  }
+  void TearDown() override { std::filesystem::remove_all(Directory); }
+
+  std::string Directory;
+  const Clock::time_point Start = Clock::from_time_t(1'600'000'000);
+};
+
+std::string chunk(std::size_t I)
+{
+  return "Chunk " + std::to_string(I) + std::string(40, '.') + '\n';
+}
+
+} // namespace
+
+TEST_F(RecordingTest, RoundTrip)
+{
+  std::string Prefix;
+  {
+    Recorder R{Directory, "my/session", Start};
+    Prefix = R.prefix();
+    R.append("Hello", Start);
+    R.append("", Start + std::chrono::milliseconds(10));
+    R.append("World", Start + std::chrono::milliseconds(1500));
+    EXPECT_EQ(R.bytesRecorded(), 10);
+  }
+  EXPECT_EQ(Prefix.find('/', Directory.size() + 1), std::string::npos);
+
+  std::string Reason;
+  std::optional<RecordingReader> Reader =
+    RecordingReader::open(Prefix, &Reason);
+  ASSERT_TRUE(Reader) << Reason;
+  EXPECT_EQ(Reader->begin(), Start);
+
+  auto R1 = Reader->next();
+  ASSERT_TRUE(R1);
+  EXPECT_EQ(R1->Data, "Hello");
+  EXPECT_EQ(R1->Time, Start);
+  auto R2 = Reader->next();
+  ASSERT_TRUE(R2);
+  EXPECT_EQ(R2->Data, "World");
+  EXPECT_EQ(R2->Time, Start + std::chrono::milliseconds(1500));
+  EXPECT_FALSE(Reader->next());
+}
+
+TEST_F(RecordingTest, RotatesBySize)
+{
+  static constexpr std::size_t Chunks = 100;
+  static constexpr std::size_t SegmentLimit = 1024;
+  std::string Prefix;
+  std::size_t Segments;
+  {
+    Recorder R{Directory, "rotate", Start, SegmentLimit};
+    Prefix = R.prefix();
+    for (std::size_t I = 0; I < Chunks; ++I)
+      R.append(chunk(I), Start + std::chrono::seconds(I));
+    Segments = R.segmentCount();
+  }
+  EXPECT_GT(Segments, 1);
+  for (std::size_t I = 0; I < Segments; ++I)
+    EXPECT_LE(
+      std::filesystem::file_size(Prefix + '.' + std::to_string(I) + ".rec"),
+      SegmentLimit);
+
+  // Opening any of the segments opens the entire recording.
+  std::optional<RecordingReader> Reader =
+    RecordingReader::open(Prefix + ".1.rec", nullptr);
+  ASSERT_TRUE(Reader);
+  EXPECT_EQ(Reader->segmentCount(), Segments);
+  for (std::size_t I = 0; I < Chunks; ++I)
+  {
+    auto Rec = Reader->next();
+    ASSERT_TRUE(Rec) << I;
+    EXPECT_EQ(Rec->Data, chunk(I));
+    EXPECT_EQ(Rec->Time, Start + std::chrono::seconds(I));
+  }
+  EXPECT_FALSE(Reader->next());
+}
+
+TEST_F(RecordingTest, SeekToTime)
+{
+  static constexpr std::size_t Chunks = 5000;
+  static constexpr std::size_t SegmentLimit = 64 << 10;
+  std::string Prefix;
+  {
+    Recorder R{Directory, "seek", Start, SegmentLimit};
+    Prefix = R.prefix();
+    for (std::size_t I = 0; I < Chunks; ++I)
+      R.append(chunk(I), Start + std::chrono::seconds(I));
+  }
+
+  std::optional<RecordingReader> Reader =
+    RecordingReader::open(Prefix, nullptr);
+  ASSERT_TRUE(Reader);
+  ASSERT_GT(Reader->segmentCount(), 1);
+
+  for (std::size_t I : {0, 1, 9, 10, 11, 1234, 2500, 4999})
+  {
+    Reader->seek(Start + std::chrono::seconds(I));
+    auto Rec = Reader->next();
+    ASSERT_TRUE(Rec) << I;
+    EXPECT_EQ(Rec->Data, chunk(I));
+    EXPECT_EQ(Rec->Time, Start + std::chrono::seconds(I));
+  }
+
+  Reader->seek(Start + std::chrono::milliseconds(2500));
+  EXPECT_EQ(Reader->next()->Data, chunk(3));
+
+  Reader->seek(Start - std::chrono::hours(1));
+  EXPECT_EQ(Reader->next()->Data, chunk(0));
+
+  Reader->seek(Start + std::chrono::seconds(Chunks));
+  EXPECT_FALSE(Reader->next());
+}
+
+TEST_F(RecordingTest, TornRecordEndsSegment)
+{
+  std::string Prefix;
+  {
+    Recorder R{Directory, "torn", Start};
+    Prefix = R.prefix();
+    R.append("Complete", Start);
+  }
+  {
+    // A record of 100 bytes, of which only 2 were written.
+    std::ofstream File{Prefix + ".0.rec", std::ios::binary | std::ios::app};
+    File << '\x01' << '\x64' << "ab";
+  }
+
+  std::optional<RecordingReader> Reader =
+    RecordingReader::open(Prefix, nullptr);
+  ASSERT_TRUE(Reader);
+  EXPECT_EQ(Reader->next()->Data, "Complete");
+  EXPECT_FALSE(Reader->next());
+}
+
+TEST_F(RecordingTest, OpenFailure)
+{
+  std::string Reason;
+  EXPECT_FALSE(RecordingReader::open(Directory + "/nothing", &Reason));
+  EXPECT_NE(Reason.find("No recording"), std::string::npos);
+
+  {
+    std::ofstream File{Directory + "/garbage.0.rec"};
+    File << "Not a recording at all";
+  }
+  EXPECT_FALSE(RecordingReader::open(Directory + "/garbage", &Reason));
+  EXPECT_NE(Reason.find("not a Monomux recording"), std::string::npos);
+}
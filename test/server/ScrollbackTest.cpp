@@ -0,0 +1,166 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "monomux/server/Scrollback.hpp"
+
+using namespace monomux::server;
+
+TEST(Scrollback, DisabledRetainsNothing)
+{
+  Scrollback S;
+  S.append("Hello");
+  EXPECT_TRUE(S.empty());
+  EXPECT_EQ(S.memory(), 0);
+  EXPECT_TRUE(S.replay().empty());
+}
+
+TEST(Scrollback, RetainsWithinLimit)
+{
+  Scrollback S{16};
+  EXPECT_EQ(S.memory(), 0);
+  S.append("abc\n");
+  S.append("def");
+  EXPECT_EQ(S.contents(), "abc\ndef");
+  EXPECT_FALSE(S.truncated());
+  EXPECT_EQ(S.replay(), "abc\ndef");
+  EXPECT_GT(S.memory(), 0);
+}
+
+TEST(Scrollback, DiscardsOldestOutput)
+{
+  Scrollback S{8};
+  S.append("12345\n");
+  S.append("6789");
+  EXPECT_EQ(S.contents(), "345\n6789");
+  EXPECT_TRUE(S.truncated());
+  // The partially discarded first line is not replayed.
+  EXPECT_EQ(S.replay(), "6789");
+
+  S.append("abcdefghijkl");
+  EXPECT_EQ(S.contents(), "efghijkl");
+  // Without a line boundary, everything retained is replayed.
+  EXPECT_EQ(S.replay(), "efghijkl");
+}
+
+TEST(Scrollback, StaysBoundedAndContiguousOverWrapping)
+{
+  static constexpr std::size_t Limit = 4096;
+  Scrollback S{Limit};
+  const std::size_t Memory = (S.append("x"), S.memory());
+
+  std::string Expected = "x";
+  for (int I = 0; I < 1000; ++I) // NOLINT(readability-magic-numbers)
+  {
+    std::string Line = "Line " + std::to_string(I) + '\n';
+    S.append(Line);
+    Expected += Line;
+  }
+  Expected.erase(0, Expected.size() - Limit);
+
+  EXPECT_EQ(S.size(), Limit);
+  EXPECT_EQ(S.memory(), Memory);
+  EXPECT_EQ(S.contents(), Expected);
+  EXPECT_EQ(S.replay().back(), '\n');
+  EXPECT_EQ(S.replay().substr(0, 5), "Line ");
+}
+
+TEST(Scrollback, SetLimitDiscards)
+{
+  Scrollback S{16};
+  S.append("abc");
+  S.setLimit(32);
+  EXPECT_TRUE(S.empty());
+  EXPECT_EQ(S.memory(), 0);
+  EXPECT_EQ(S.limit(), 32);
+}
+
+TEST(Scrollback, OffsetsSurviveDiscarding)
+{
+  Scrollback S{8};
+  EXPECT_EQ(S.begin(), 0);
+  EXPECT_EQ(S.end(), 0);
+
+  S.append("12345\n");
+  S.append("6789");
+  EXPECT_EQ(S.begin(), 2);
+  EXPECT_EQ(S.end(), 10);
+  EXPECT_EQ(S.since(6), "6789");
+  EXPECT_EQ(S.since(S.end()), "");
+
+  S.clear();
+  S.append("ab");
+  EXPECT_EQ(S.begin(), 10);
+  EXPECT_EQ(S.end(), 12);
+  EXPECT_EQ(S.since(11), "b");
+}
+
+TEST(Scrollback, ReplayFromResumePoint)
+{
+  Scrollback S{8};
+  S.append("12345\n");
+  S.append("6789");
+
+  // A fresh client gets the replay.
+  EXPECT_EQ(S.replayFrom(std::nullopt), 6);
+  // A resuming client only gets what it has missed...
+  EXPECT_EQ(S.replayFrom(8), 8);
+  EXPECT_EQ(S.since(S.replayFrom(8)), "89");
+  EXPECT_EQ(S.replayFrom(10), 10);
+  // ... unless that is no longer (or not yet) retained.
+  EXPECT_EQ(S.replayFrom(1), 6);
+  EXPECT_EQ(S.replayFrom(11), 6);
+}
+
+TEST(Scrollback, FindsInRetainedOutput)
+{
+  Scrollback S{1 << 16};
+  S.append("make: building\r\n");
+  S.append("error: foo\r\nok\r\nerr");
+  S.append("or: bar\r\n");
+  EXPECT_EQ(S.find("error", 10), (std::vector<std::uint64_t>{16, 32}));
+  EXPECT_EQ(S.find("error", 1), (std::vector<std::uint64_t>{16}));
+  EXPECT_TRUE(S.find("missing", 10).empty());
+  EXPECT_EQ(S.find("r", 100).size(), 7);
+
+  EXPECT_EQ(S.lines(32, 0, 1024), "error: bar\r");
+  EXPECT_EQ(S.lines(34, 1, 1024), "ok\r\nerror: bar\r");
+  EXPECT_EQ(S.lines(0, 5, 1024), S.contents().substr(0, S.size() - 1));
+  // An overly long line is cut around the match.
+  EXPECT_EQ(S.lines(20, 0, 4), "ror:");
+}
+
+TEST(Scrollback, FindsOnlyInRetainedOutput)
+{
+  Scrollback S{8000};
+  std::string Chunk(1000, '.');
+  S.append("needle");
+  for (int I = 0; I < 8; ++I)
+    S.append(Chunk);
+  S.append("needle");
+  EXPECT_EQ(S.find("needle", 10), (std::vector<std::uint64_t>{8006}));
+  EXPECT_EQ(S.lines(8006, 0, 16), "........needle");
+  EXPECT_GT(S.indexMemory(), 0);
+
+  S.clear();
+  EXPECT_TRUE(S.find("needle", 10).empty());
+  EXPECT_EQ(S.indexMemory(), 0);
+}
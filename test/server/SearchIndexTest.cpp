@@ -0,0 +1,106 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "monomux/server/SearchIndex.hpp"
+
+using namespace monomux::server;
+
+namespace
+{
+
+constexpr std::uint64_t BS = SearchIndex::BlockSize;
+
+} // namespace
+
+TEST(SearchIndex, EmptyHasNoCandidates)
+{
+  SearchIndex I;
+  EXPECT_TRUE(I.candidates("abc").empty());
+  EXPECT_EQ(I.memory(), 0);
+}
+
+TEST(SearchIndex, NarrowsToTheBlocksOfTheMatch)
+{
+  SearchIndex I;
+  std::string Filler(BS, ' ');
+  I.append(0, Filler);
+  I.append(BS, Filler);
+  I.append(2 * BS, "Segmentation fault");
+  I.append(2 * BS + 18, Filler);
+
+  auto C = I.candidates("Segmentation");
+  ASSERT_EQ(C.size(), 1);
+  EXPECT_EQ(C.front().first, 2 * BS);
+  EXPECT_EQ(C.front().second, 3 * BS);
+
+  EXPECT_TRUE(I.candidates("Segfault").empty());
+}
+
+TEST(SearchIndex, FindsMatchesAcrossBlockBoundaries)
+{
+  SearchIndex I;
+  std::string Filler(BS - 3, ' ');
+  I.append(0, Filler);
+  I.append(BS - 3, "needle");
+  I.append(BS + 3, Filler);
+
+  // The match starts in the first block, but most of it is in the second.
+  auto C = I.candidates("needle");
+  ASSERT_FALSE(C.empty());
+  EXPECT_EQ(C.front().first, 0);
+  EXPECT_GE(C.front().second, BS);
+}
+
+TEST(SearchIndex, ShortPatternsAreNotFiltered)
+{
+  SearchIndex I;
+  I.append(100, "abcdef");
+  auto C = I.candidates("zz");
+  ASSERT_EQ(C.size(), 1);
+  EXPECT_EQ(C.front().first, 0);
+  EXPECT_EQ(C.front().second, 106);
+}
+
+TEST(SearchIndex, DiscardingBoundsMemory)
+{
+  SearchIndex I;
+  std::string Filler(BS, 'x');
+  for (std::uint64_t B = 0; B < 16; ++B)
+  {
+    I.append(B * BS, Filler);
+    I.discardBefore(B * BS > 2 * BS ? B * BS - 2 * BS : 0);
+  }
+  EXPECT_LE(I.memory(), 3 * (SearchIndex::FilterBits / 8 + 8));
+  auto C = I.candidates("xxx");
+  ASSERT_EQ(C.size(), 1);
+  EXPECT_EQ(C.front().first, 13 * BS);
+  EXPECT_EQ(C.front().second, 16 * BS);
+}
+
+TEST(SearchIndex, DiscontiguousAppendClears)
+{
+  SearchIndex I;
+  I.append(0, "needle");
+  I.append(100, "hay");
+  EXPECT_TRUE(I.candidates("needle").empty());
+  EXPECT_FALSE(I.candidates("hay").empty());
+}
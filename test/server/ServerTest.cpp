@@ -0,0 +1,302 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "monomux/client/Client.hpp"
+#include "monomux/client/ControlClient.hpp"
+#include "monomux/system/BufferedChannel.hpp"
+#include "monomux/system/Socket.hpp"
+
+#include "monomux/server/Server.hpp"
+
+using namespace monomux;
+using namespace monomux::client;
+using namespace monomux::server;
+
+namespace
+{
+
+/// Runs the \p loop() of a \p Server on a separate thread for the lifetime of
+/// the object.
+struct RunningServer
+{
+  std::string Path;
+  Server S;
+  std::thread Thread;
+  void (*PipeHandler)(int);
+
+  RunningServer(std::string Path, std::size_t ListenQueue = Server::ListenQueue)
+    : Path(Path), S(listeningSocket(Path, ListenQueue))
+  {
+    // The server writes to clients that might have gone away, as in the real
+    // server's main().
+    PipeHandler = std::signal(SIGPIPE, SIG_IGN);
+    Thread = std::thread{[this] { S.loop(); }};
+  }
+
+  /// Creates the socket of the server listening already, so clients may
+  /// connect before the loop starts.
+  static Socket listeningSocket(const std::string& Path,
+                                std::size_t ListenQueue)
+  {
+    Socket Sock = Socket::create(Path);
+    Sock.listen(ListenQueue);
+    return Sock;
+  }
+
+  ~RunningServer()
+  {
+    S.interrupt();
+    // Wake the loop up so it notices the interrupt. The connection is kept
+    // open until the loop exits, as the server writes to it when accepting.
+    std::optional<Socket> Wakeup;
+    try
+    {
+      Wakeup.emplace(Socket::connect(Path));
+    }
+    catch (...)
+    {}
+    Thread.join();
+    S.shutdown();
+    // Do not leave the buffers of the many connections to other tests.
+    BufferedChannel::releasePool();
+    (void)std::signal(SIGPIPE, PipeHandler);
+  }
+};
+
+/// Restores the limit on the number of open files when destroyed.
+struct FileLimitGuard
+{
+  struct ::rlimit Original;
+
+  FileLimitGuard() { ::getrlimit(RLIMIT_NOFILE, &Original); }
+  ~FileLimitGuard() { ::setrlimit(RLIMIT_NOFILE, &Original); }
+
+  void lower(::rlim_t Files)
+  {
+    struct ::rlimit Limit = Original;
+    Limit.rlim_cur = Files;
+    ASSERT_EQ(::setrlimit(RLIMIT_NOFILE, &Limit), 0);
+  }
+};
+
+std::string socketPath(const char* Name)
+{
+  return "/tmp/monomux-test-" + std::to_string(::getpid()) + '-' + Name;
+}
+
+/// Creates a socket which is not yet connected, so connecting it later does
+/// not need a new file descriptor.
+int unconnectedSocket()
+{
+  return ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+}
+
+bool connectTo(int FD, const std::string& Path)
+{
+  struct ::sockaddr_un Address;
+  std::memset(&Address, 0, sizeof(Address));
+  Address.sun_family = AF_UNIX;
+  std::strncpy(Address.sun_path, Path.c_str(), sizeof(Address.sun_path) - 1);
+  return ::connect(FD,
+                   reinterpret_cast<struct ::sockaddr*>(&Address),
+                   sizeof(Address)) == 0;
+}
+
+/// \returns the file descriptors of the current process open to \p /dev/null.
+std::set<int> devNullFDs()
+{
+  std::set<int> FDs;
+  for (int FD = 0; FD < 1024; ++FD)
+  {
+    std::string Link = "/proc/self/fd/" + std::to_string(FD);
+    char Target[32] = {0};
+    if (::readlink(Link.c_str(), Target, sizeof(Target) - 1) > 0 &&
+        std::string{Target} == "/dev/null")
+      FDs.insert(FD);
+  }
+  return FDs;
+}
+
+/// Waits until the server behind \p C reports at least \p Count clients.
+bool waitForClients(Client& C, std::size_t Count)
+{
+  ControlClient CC{C};
+  for (int Try = 0; Try < 500; ++Try)
+  {
+    if (CC.requestMetrics("").ClientCount >= Count)
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+Process::SpawnOptions sleeper()
+{
+  Process::SpawnOptions SO;
+  SO.Program = "/bin/sleep";
+  SO.Arguments = {"30"};
+  return SO;
+}
+
+/// Waits until the server behind \p C has no session named \p Name.
+bool waitForSessionGone(Client& C, const std::string& Name)
+{
+  for (int Try = 0; Try < 500; ++Try)
+  {
+    std::optional<std::vector<client::SessionData>> L =
+      C.requestSessionList();
+    if (L && std::none_of(L->begin(), L->end(), [&Name](const auto& S) {
+          return S.Name == Name;
+        }))
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+} // namespace
+
+TEST(Server, AcceptsEveryPendingClientInBursts)
+{
+  static constexpr std::size_t Pending = 3 * Server::AcceptBurst;
+  RunningServer RS{socketPath("burst"), 4 * Server::AcceptBurst};
+  std::optional<Client> C = Client::create(RS.Path, nullptr);
+  ASSERT_TRUE(C);
+
+  std::vector<int> FDs;
+  for (std::size_t I = 0; I < Pending; ++I)
+  {
+    FDs.push_back(unconnectedSocket());
+    ASSERT_TRUE(connectTo(FDs.back(), RS.Path));
+  }
+  EXPECT_TRUE(waitForClients(*C, 1 + Pending));
+
+  for (int FD : FDs)
+    ::close(FD);
+}
+
+TEST(Server, PausesAcceptingWhenOutOfFileDescriptors)
+{
+  const std::set<int> NullsBefore = devNullFDs();
+  RunningServer RS{socketPath("emfile")};
+  std::optional<Client> C = Client::create(RS.Path, nullptr);
+  ASSERT_TRUE(C);
+  ControlClient CC{*C};
+
+  // The server is running, so it has reserved its spare file descriptor.
+  int SpareFD = -1;
+  for (int FD : devNullFDs())
+    if (NullsBefore.find(FD) == NullsBefore.end())
+      SpareFD = FD;
+  ASSERT_NE(SpareFD, -1);
+
+  // Occupy every file descriptor below the spare one, and then prevent
+  // opening any more. When the spare is given up, its number is still over
+  // the limit, so the server can neither accept nor reject a client.
+  std::vector<int> Fillers;
+  while (true)
+  {
+    int FD = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    ASSERT_NE(FD, -1);
+    if (FD > SpareFD)
+    {
+      ::close(FD);
+      break;
+    }
+    Fillers.push_back(FD);
+  }
+  int Pending = unconnectedSocket();
+  ASSERT_NE(Pending, -1);
+
+  {
+    FileLimitGuard Limit;
+    Limit.lower(static_cast<::rlim_t>(SpareFD));
+    ASSERT_TRUE(connectTo(Pending, RS.Path));
+
+    std::uint64_t IterationsBefore = CC.requestMetrics("").LoopIterations;
+    std::this_thread::sleep_for(5 * Server::AcceptRetryDelay);
+    auto Metrics = CC.requestMetrics("");
+    EXPECT_EQ(Metrics.ClientCount, 1);
+    // The server retries periodically, instead of spinning on the socket.
+    EXPECT_LT(Metrics.LoopIterations - IterationsBefore, 100);
+  }
+
+  // Once file descriptors are available again, the client is accepted.
+  EXPECT_TRUE(waitForClients(*C, 2));
+
+  ::close(Pending);
+  for (int FD : Fillers)
+    ::close(FD);
+}
+
+TEST(Server, RejectsTheNamesOfIdleProcesses)
+{
+  RunningServer RS{socketPath("reserved")};
+  std::optional<Client> C = Client::create(RS.Path, nullptr);
+  ASSERT_TRUE(C);
+
+  // The sessions adopting idle processes are also known by these names.
+  EXPECT_FALSE(C->requestMakeSession("monomux-warm-1", sleeper()));
+  auto Batch = C->requestMakeSessionBatch(
+    {{"monomux-warm-2", sleeper()}, {"user", sleeper()}});
+  ASSERT_TRUE(Batch);
+  ASSERT_EQ(Batch->size(), 2);
+  EXPECT_FALSE(Batch->at(0));
+  EXPECT_EQ(Batch->at(1), "user");
+}
+
+TEST(Server, DefaultNameIsReusedAfterFailedSpawn)
+{
+  RunningServer RS{socketPath("names")};
+  std::optional<Client> C = Client::create(RS.Path, nullptr);
+  ASSERT_TRUE(C);
+  Process::SpawnOptions Missing;
+  Missing.Program = "/nonexistent/monomux-test-program";
+
+  EXPECT_EQ(C->requestMakeSession("", sleeper()), "1");
+  EXPECT_EQ(C->requestMakeSession("", sleeper()), "2");
+  ASSERT_TRUE(C->requestDestroySessions({"1"}));
+  ASSERT_TRUE(waitForSessionGone(*C, "1"));
+
+  // The name freed by the removed session is taken, and then given back by
+  // the failed spawns.
+  EXPECT_FALSE(C->requestMakeSession("", Missing));
+  auto Batch = C->requestMakeSessionBatch({{"", Missing}, {"", Missing}});
+  ASSERT_TRUE(Batch);
+  EXPECT_FALSE(Batch->at(0));
+  EXPECT_FALSE(Batch->at(1));
+  EXPECT_EQ(C->requestMakeSession("", sleeper()), "1");
+  EXPECT_EQ(C->requestMakeSession("", sleeper()), "3");
+}
@@ -0,0 +1,121 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string>
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "monomux/server/SessionPool.hpp"
+
+using namespace monomux;
+using namespace monomux::server;
+
+static Process::SpawnOptions options(std::string Program,
+                                     std::string Variable = "")
+{
+  Process::SpawnOptions SO;
+  SO.Program = std::move(Program);
+  SO.CreatePTY = true;
+  if (!Variable.empty())
+    SO.Environment[std::move(Variable)] = "1";
+  return SO;
+}
+
+static void prepare(Process::SpawnOptions& Opts, const std::string& Name)
+{
+  Opts.Environment["TEST_SESSION"] = Name;
+}
+
+TEST(SessionPool, DisabledPoolDoesNotLearn)
+{
+  SessionPool P{0, "warm-"};
+  EXPECT_FALSE(P.take(options("/bin/cat")));
+  EXPECT_FALSE(P.needsRefill());
+  EXPECT_EQ(P.refill(prepare), 0);
+  EXPECT_EQ(P.statistics().Profiles, 0);
+}
+
+TEST(SessionPool, AdoptsAfterLearningProfile)
+{
+  SessionPool P{2, "warm-"};
+  EXPECT_FALSE(P.take(options("/bin/cat")));
+  EXPECT_TRUE(P.needsRefill());
+  EXPECT_EQ(P.refill(prepare), 2);
+  EXPECT_FALSE(P.needsRefill());
+
+  // A different environment is a different profile.
+  EXPECT_FALSE(P.take(options("/bin/cat", "OTHER")));
+
+  std::optional<SessionPool::Adopted> A = P.take(options("/bin/cat"));
+  ASSERT_TRUE(A);
+  EXPECT_EQ(A->Name, "warm-1");
+  EXPECT_TRUE(A->Proc.hasPty());
+  EXPECT_FALSE(A->Proc.reapIfDead());
+
+  SessionPool::Statistics S = P.statistics();
+  EXPECT_EQ(S.Profiles, 2);
+  EXPECT_EQ(S.Idle, 1);
+  EXPECT_EQ(S.Adoptions, 1);
+  EXPECT_EQ(S.Misses, 2);
+
+  EXPECT_EQ(P.refill(prepare), 3);
+  P.setPerProfile(0);
+  EXPECT_EQ(P.statistics().Profiles, 0);
+  EXPECT_EQ(P.statistics().Idle, 0);
+}
+
+TEST(SessionPool, ForgetsLeastRecentlyUsedProfile)
+{
+  SessionPool P{1, "warm-"};
+  for (std::size_t I = 0; I <= SessionPool::MaxProfiles; ++I)
+    EXPECT_FALSE(P.take(options("/bin/cat", "V" + std::to_string(I))));
+  EXPECT_EQ(P.statistics().Profiles, SessionPool::MaxProfiles);
+
+  P.refill(prepare);
+  // The first profile had been forgotten, and is learnt again.
+  EXPECT_FALSE(P.take(options("/bin/cat", "V0")));
+  EXPECT_TRUE(P.take(options("/bin/cat", "V4")));
+}
+
+TEST(SessionPool, SkipsExitedProcesses)
+{
+  SessionPool P{1, "warm-"};
+  EXPECT_FALSE(P.take(options("/bin/true")));
+  EXPECT_EQ(P.refill(prepare), 1);
+
+  // Wait until the idle process exits and is reaped.
+  for (int I = 0; I < 1000 && P.statistics().Idle; ++I)
+  {
+    P.reapDead();
+    ::usleep(1000);
+  }
+  EXPECT_EQ(P.statistics().Idle, 0);
+  EXPECT_TRUE(P.needsRefill());
+  EXPECT_FALSE(P.take(options("/bin/true")));
+}
+
+TEST(SessionPool, ReservesGeneratedNames)
+{
+  SessionPool P{0, "warm-"};
+  EXPECT_TRUE(P.isReservedName("warm-"));
+  EXPECT_TRUE(P.isReservedName("warm-7"));
+  EXPECT_FALSE(P.isReservedName("warm"));
+  EXPECT_FALSE(P.isReservedName("my-warm-7"));
+  EXPECT_FALSE(P.isReservedName(""));
+}
@@ -0,0 +1,127 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <memory>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "monomux/system/Pipe.hpp"
+#include "monomux/system/fd.hpp"
+
+#include "monomux/system/BufferedChannel.hpp"
+
+using namespace monomux;
+
+TEST(BufferedChannel, BuffersAreAllocatedOnSpill)
+{
+  const BufferedChannel::MemoryStatistics Before =
+    BufferedChannel::memoryStatistics();
+
+  std::unique_ptr<Pipe> Read;
+  {
+    int FDs[2];
+    ASSERT_EQ(::pipe(FDs), 0);
+    Read = std::make_unique<Pipe>(Pipe::wrap(fd{FDs[0]}, Pipe::Read));
+    auto Write = std::make_unique<Pipe>(Pipe::wrap(fd{FDs[1]}, Pipe::Write));
+    EXPECT_EQ(Read->readBufferStatistics().Capacity, 0);
+    EXPECT_FALSE(Read->hasBufferedRead());
+
+    EXPECT_EQ(Write->write("Hello World!"), 12);
+    EXPECT_FALSE(Write->hasBufferedWrite());
+    EXPECT_EQ(Write->writeBufferStatistics().Capacity, 0);
+  }
+  EXPECT_EQ(BufferedChannel::memoryStatistics().Buffers, Before.Buffers);
+
+  EXPECT_EQ(Read->read(5), "Hello");
+  EXPECT_TRUE(Read->hasBufferedRead());
+  EXPECT_EQ(Read->readBufferStatistics().Size, 7);
+
+  BufferedChannel::MemoryStatistics During =
+    BufferedChannel::memoryStatistics();
+  EXPECT_EQ(During.Buffers, Before.Buffers + 1);
+  EXPECT_EQ(During.Bytes,
+            Before.Bytes + Read->readBufferStatistics().Capacity);
+  EXPECT_EQ(Read->bufferMemory(), Read->readBufferStatistics().Capacity);
+  EXPECT_GE(During.PeakBytes, During.Bytes);
+
+  EXPECT_EQ(Read->read(7), " World!");
+  // The buffer was used just now, so it is not idle yet.
+  Read->tryFreeResources();
+  EXPECT_EQ(BufferedChannel::memoryStatistics().Buffers, Before.Buffers + 1);
+
+  Read.reset();
+  BufferedChannel::MemoryStatistics After = BufferedChannel::memoryStatistics();
+  EXPECT_EQ(After.Buffers, Before.Buffers);
+  EXPECT_EQ(After.Bytes, Before.Bytes);
+  EXPECT_EQ(After.PooledBuffers, Before.PooledBuffers + 1);
+  EXPECT_EQ(After.PeakBytes, During.PeakBytes);
+
+  BufferedChannel::releasePool();
+  EXPECT_EQ(BufferedChannel::memoryStatistics().PooledBuffers, 0);
+}
+
+TEST(BufferedChannel, WriteDelayIsMeasuredInBoundedMemory)
+{
+  int FDs[2];
+  ASSERT_EQ(::pipe(FDs), 0);
+  Pipe Read = Pipe::wrap(fd{FDs[0]}, Pipe::Read);
+  Pipe Write = Pipe::wrap(fd{FDs[1]}, Pipe::Write);
+  Write.setNonblocking();
+  LatencyHistogram H;
+  Write.setWriteDelayHistogram(&H);
+
+  // Fill the pipe, so every further store is buffered.
+  std::string Chunk(4096, 'x');
+  while (!Write.hasBufferedWrite())
+    Write.write(Chunk);
+  for (int I = 0; I < 1000; ++I)
+    Write.write("y");
+  EXPECT_EQ(H.count(), 0);
+
+  while (Write.hasBufferedWrite())
+  {
+    Read.read(1 << 16);
+    Write.flushWrites();
+  }
+  // Far more stores were buffered than the number of times measured, as the
+  // stores made while the marks were exhausted are measured together.
+  EXPECT_GT(H.count(), 0);
+  EXPECT_LT(H.count(), 1000);
+  Write.setWriteDelayHistogram(nullptr);
+}
+
+TEST(BufferedChannel, LoadReadsIntoTheBuffer)
+{
+  int FDs[2];
+  ASSERT_EQ(::pipe(FDs), 0);
+  Pipe Read = Pipe::wrap(fd{FDs[0]}, Pipe::Read);
+  Pipe Write = Pipe::wrap(fd{FDs[1]}, Pipe::Write);
+  Read.setNonblocking();
+
+  std::string Data(3 * Read.optimalReadSize() + 5, 'x');
+  Data.back() = 'y';
+  EXPECT_EQ(Write.write(Data), Data.size());
+  EXPECT_EQ(Read.load(Data.size()), Data.size());
+  EXPECT_EQ(Read.readInBuffer(), Data.size());
+  EXPECT_EQ(Read.load(1), 0);
+
+  EXPECT_EQ(Read.read(Data.size()), Data);
+  EXPECT_FALSE(Read.hasBufferedRead());
+}
@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <thread>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "monomux/system/fd.hpp"
+
+#include "monomux/system/Event.hpp"
+
+using namespace monomux;
+
+namespace
+{
+
+/// \returns the file descriptors reported by the last \p wait() of \p Poll.
+std::vector<raw_fd> reported(EPoll& Poll, std::size_t Count)
+{
+  std::vector<raw_fd> Ret;
+  for (std::size_t I = 0; I < Count; ++I)
+    Ret.emplace_back(Poll.eventAt(I).FD);
+  return Ret;
+}
+
+} // namespace
+
+TEST(EPoll, TimersFireBeforeEventsAreCollected)
+{
+  int FDs[2];
+  ASSERT_EQ(::pipe(FDs), 0);
+  fd Read{FDs[0]};
+  fd Write{FDs[1]};
+  int Other[2];
+  ASSERT_EQ(::pipe(Other), 0);
+  fd OtherRead{Other[0]};
+  fd OtherWrite{Other[1]};
+  ASSERT_EQ(::write(Write.get(), "x", 1), 1);
+  ASSERT_EQ(::write(OtherWrite.get(), "x", 1), 1);
+
+  EPoll Poll{4};
+  Poll.listen(Read.get(), /* Incoming =*/true, /* Outgoing =*/false);
+  Poll.listen(OtherRead.get(), /* Incoming =*/true, /* Outgoing =*/false);
+  bool Fired = false;
+  Poll.timers().arm(TimerWheel::Clock::now(), [&] {
+    Fired = true;
+    Poll.stop(Read.get());
+  });
+  std::this_thread::sleep_for(2 * EPoll::TimerResolution);
+
+  // The readable pipe must not be reported, as the timer removed it.
+  std::size_t N = Poll.wait();
+  EXPECT_TRUE(Fired);
+  EXPECT_EQ(reported(Poll, N), std::vector<raw_fd>{OtherRead.get()});
+}
+
+TEST(EPoll, StopDiscardsScheduledEvents)
+{
+  int FDs[2];
+  ASSERT_EQ(::pipe(FDs), 0);
+  fd Read{FDs[0]};
+  fd Write{FDs[1]};
+  int Other[2];
+  ASSERT_EQ(::pipe(Other), 0);
+  fd OtherRead{Other[0]};
+  fd OtherWrite{Other[1]};
+
+  EPoll Poll{4};
+  Poll.listen(Read.get(), /* Incoming =*/true, /* Outgoing =*/false);
+  Poll.listen(OtherRead.get(), /* Incoming =*/true, /* Outgoing =*/false);
+  Poll.schedule(Read.get(), /* Incoming =*/true, /* Outgoing =*/false);
+  Poll.schedule(OtherRead.get(), /* Incoming =*/true, /* Outgoing =*/false);
+  Poll.stop(Read.get());
+
+  std::size_t N = Poll.wait();
+  EXPECT_EQ(reported(Poll, N), std::vector<raw_fd>{OtherRead.get()});
+}
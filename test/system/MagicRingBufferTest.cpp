@@ -0,0 +1,80 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "monomux/system/MagicRingBuffer.hpp"
+
+using namespace monomux;
+
+TEST(MagicRingBuffer, CapacityIsWholePages)
+{
+  MagicRingBuffer B{1};
+  EXPECT_GE(B.capacity(), 4096);
+  EXPECT_EQ(B.capacity() & (B.capacity() - 1), 0);
+  EXPECT_EQ(B.originalCapacity(), B.capacity());
+  EXPECT_TRUE(B.empty());
+}
+
+TEST(MagicRingBuffer, ViewsAreContiguousOverPhysicalEnd)
+{
+  MagicRingBuffer B{1};
+  const std::size_t Capacity = B.capacity();
+
+  std::string Filler(Capacity - 3, 'x');
+  B.putBack(Filler.data(), Filler.size());
+  B.putBack("ab", 2);
+  B.dropFront(Filler.size());
+  EXPECT_EQ(B.peek(), "ab");
+
+  // The next write straddles the physical end of the storage.
+  const char* Hello = "Hello World!";
+  B.putBack(Hello, std::strlen(Hello));
+  EXPECT_EQ(B.capacity(), Capacity);
+  EXPECT_EQ(B.peek(), "abHello World!");
+
+  B.dropFront(4);
+  EXPECT_EQ(B.peek(), "llo World!");
+  B.dropFront(100);
+  EXPECT_TRUE(B.empty());
+  EXPECT_EQ(B.peek(), "");
+}
+
+TEST(MagicRingBuffer, ReserveCommitAndGrow)
+{
+  MagicRingBuffer B{1};
+  const std::size_t Capacity = B.capacity();
+
+  std::string Filler(Capacity - 1, 'x');
+  B.putBack(Filler.data(), Filler.size());
+  B.dropFront(Capacity - 2);
+  EXPECT_EQ(B.size(), 1);
+
+  char* Area = B.reserve(Capacity);
+  EXPECT_GT(B.capacity(), Capacity);
+  std::memset(Area, 'y', Capacity);
+  B.commit(Capacity);
+
+  EXPECT_EQ(B.size(), Capacity + 1);
+  std::string_view View = B.peek();
+  EXPECT_EQ(View.front(), 'x');
+  EXPECT_EQ(View.substr(1), std::string(Capacity, 'y'));
+}
@@ -0,0 +1,66 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <csignal>
+
+#include <gtest/gtest.h>
+
+#include "monomux/system/Event.hpp"
+#include "monomux/system/fd.hpp"
+
+#include "monomux/system/Process.hpp"
+
+using namespace monomux;
+
+TEST(Process, PidFDReportsTermination)
+{
+  Process::SpawnOptions SO;
+  SO.Program = "/bin/sh";
+  SO.Arguments = {"-c", "exit 7"};
+  Process P = Process::spawn(SO);
+  if (P.pidFD() == fd::Invalid)
+  {
+    P.wait();
+    GTEST_SKIP() << "pidfd_open() is not supported by the system";
+  }
+
+  EPoll Poll{4};
+  Poll.listen(P.pidFD(), /* Incoming =*/true, /* Outgoing =*/false);
+  ASSERT_EQ(Poll.wait(), 1);
+  EXPECT_EQ(Poll.eventAt(0).FD, P.pidFD());
+  EXPECT_TRUE(Poll.eventAt(0).Incoming);
+
+  // The process is a zombie by now, so it is reaped without blocking.
+  EXPECT_TRUE(P.reapIfDead());
+  EXPECT_TRUE(P.dead());
+  EXPECT_EQ(P.exitCode(), 7);
+  Poll.stop(P.pidFD());
+}
+
+TEST(Process, SignalReportsFailure)
+{
+  Process::SpawnOptions SO;
+  SO.Program = "/bin/sh";
+  SO.Arguments = {"-c", "sleep 5"};
+  Process P = Process::spawn(SO);
+  EXPECT_TRUE(P.signal(SIGKILL));
+  P.wait();
+
+  // The process was reaped, so there is nothing to send the signal to.
+  EXPECT_FALSE(P.signal(SIGKILL));
+}
@@ -0,0 +1,57 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <csignal>
+
+#include <gtest/gtest.h>
+
+#include "monomux/system/SignalFD.hpp"
+
+using namespace monomux;
+
+static bool isBlocked(int SigNum)
+{
+  ::sigset_t Mask;
+  ::sigemptyset(&Mask);
+  ::pthread_sigmask(SIG_BLOCK, nullptr, &Mask);
+  return ::sigismember(&Mask, SigNum) == 1;
+}
+
+TEST(SignalFD, ReceivesSignalsAsData)
+{
+  SignalFD S{SIGUSR1, SIGUSR2};
+  EXPECT_TRUE(isBlocked(SIGUSR1));
+  EXPECT_TRUE(isBlocked(SIGUSR2));
+  EXPECT_FALSE(S.read());
+
+  ::raise(SIGUSR2);
+  auto Info = S.read();
+  ASSERT_TRUE(Info);
+  EXPECT_EQ(Info->ssi_signo, SIGUSR2);
+  EXPECT_FALSE(S.read());
+}
+
+TEST(SignalFD, RestoresMaskAndDiscardsPending)
+{
+  {
+    SignalFD S{SIGUSR1};
+    // Left pending, it would kill the test when unblocked.
+    ::raise(SIGUSR1);
+  }
+  EXPECT_FALSE(isBlocked(SIGUSR1));
+}
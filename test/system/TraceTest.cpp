@@ -0,0 +1,104 @@
+/**
+ * Copyright (C) 2022 Whisperity
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "monomux/system/Trace.hpp"
+
+using namespace monomux;
+
+namespace
+{
+
+/// \returns the position of the line in the decoded \p Out that contains the
+/// event \p Name with the \p Payload.
+std::size_t findEvent(const std::string& Out,
+                      const std::string& Name,
+                      const std::string& Payload)
+{
+  std::istringstream IS{Out};
+  std::string Line;
+  std::size_t Position = 0;
+  while (std::getline(IS, Line))
+  {
+    if (Line.find(" " + Name + " ") != std::string::npos &&
+        Line.size() >= Payload.size() &&
+        Line.compare(Line.size() - Payload.size(), Payload.size(), Payload) ==
+          0)
+      return Position;
+    Position += Line.size() + 1;
+  }
+  return std::string::npos;
+}
+
+} // namespace
+
+TEST(FlightRecorder, SnapshotDecodesInOrder)
+{
+  trace::record(trace::EventID::ClientAccept, 5, 0, 1); // NOLINT
+  trace::record(trace::EventID::SessionRead, 6, 4096, 0); // NOLINT
+  std::thread{[] {
+    trace::record(trace::EventID::ClientExit, 5, 0, 1); // NOLINT
+  }}.join();
+
+  std::string Data = trace::snapshot();
+  std::ostringstream OS;
+  ASSERT_TRUE(trace::decode(Data, OS));
+
+  std::string Out = OS.str();
+  auto Accept = findEvent(Out, "ClientAccept", "fd=5 bytes=0 id=1");
+  auto Read = findEvent(Out, "SessionRead", "fd=6 bytes=4096 id=0");
+  auto Exit = findEvent(Out, "ClientExit", "fd=5 bytes=0 id=1");
+  ASSERT_NE(Accept, std::string::npos);
+  ASSERT_NE(Read, std::string::npos);
+  ASSERT_NE(Exit, std::string::npos);
+  EXPECT_LT(Accept, Read);
+  EXPECT_LT(Read, Exit);
+}
+
+TEST(FlightRecorder, RingKeepsLatestEvents)
+{
+  std::thread{[] {
+    for (std::size_t I = 0; I < trace::Ring::Capacity + 10; ++I)
+      trace::record(trace::EventID::Flush, 0, 0, I);
+  }}.join();
+
+  std::ostringstream OS;
+  ASSERT_TRUE(trace::decode(trace::snapshot(), OS));
+  std::string Out = OS.str();
+  EXPECT_NE(Out.find(std::to_string(trace::Ring::Capacity + 10) +
+                     " events, " + std::to_string(trace::Ring::Capacity) +
+                     " retained."),
+            std::string::npos);
+  EXPECT_EQ(findEvent(Out, "Flush", "fd=0 bytes=0 id=9"), std::string::npos);
+  EXPECT_NE(findEvent(Out, "Flush", "fd=0 bytes=0 id=10"), std::string::npos);
+}
+
+TEST(FlightRecorder, RejectsGarbage)
+{
+  std::ostringstream OS;
+  EXPECT_FALSE(trace::decode("Not a trace at all, really.", OS));
+
+  std::string Data = trace::snapshot();
+  Data.resize(Data.size() - 1);
+  EXPECT_FALSE(trace::decode(Data, OS));
+}